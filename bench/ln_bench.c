@@ -0,0 +1,223 @@
+/*
+ * Copyright (c) 2018-2020 Zhixu Zhao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <getopt.h>
+#include <libgen.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <time.h>
+#include "ln_bench.h"
+#include "ln_arch.h"
+
+/* Return monotonic seconds, finer than ln_clock() for short runs. */
+double ln_bench_clock(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static int double_cmp(const void *p1, const void *p2)
+{
+    double d1 = *(const double *)p1;
+    double d2 = *(const double *)p2;
+
+    return d1 < d2 ? -1 : d1 > d2;
+}
+
+/* nearest-rank percentile `p` of sorted `samples` */
+static double percentile(const double *samples, size_t n, double p)
+{
+    size_t rank = (size_t)(p / 100 * n + 0.999999);
+
+    return samples[rank > 0 ? rank - 1 : 0];
+}
+
+/* Summarize `n` (> 0) timed `samples` in seconds, which are sorted in place. */
+void ln_bench_stat_compute(ln_bench_stat *stat, double *samples, size_t n)
+{
+    size_t i;
+
+    qsort(samples, n, sizeof(double), double_cmp);
+    stat->n = n;
+    stat->min = samples[0];
+    stat->max = samples[n - 1];
+    stat->total = 0;
+    for (i = 0; i < n; i++)
+        stat->total += samples[i];
+    stat->mean = stat->total / n;
+    stat->p50 = percentile(samples, n, 50);
+    stat->p95 = percentile(samples, n, 95);
+    stat->p99 = percentile(samples, n, 99);
+}
+
+/* Print the fields of `stat` into a JSON object, latencies in ms. */
+void ln_bench_fprint_stat(FILE *fp, const ln_bench_stat *stat)
+{
+    fprintf(fp, "\"iterations\": %lu, \"min_ms\": %.6f, \"mean_ms\": %.6f, "
+            "\"p50_ms\": %.6f, \"p95_ms\": %.6f, \"p99_ms\": %.6f, "
+            "\"max_ms\": %.6f, \"throughput\": %.3f",
+            (unsigned long)stat->n, stat->min * 1e3, stat->mean * 1e3,
+            stat->p50 * 1e3, stat->p95 * 1e3, stat->p99 * 1e3,
+            stat->max * 1e3, stat->total > 0 ? stat->n / stat->total : 0);
+}
+
+/* Print `file` without directories and extension as a JSON string. */
+void ln_bench_fprint_name(FILE *fp, const char *file)
+{
+    char *path = ln_strdup(file);
+    char *name = basename(path);
+    char *dot = strrchr(name, '.');
+
+    if (dot && dot != name)
+        *dot = '\0';
+    fputc('"', fp);
+    for (; *name; name++) {
+        if (*name == '"' || *name == '\\')
+            fputc('\\', fp);
+        fputc(*name, fp);
+    }
+    fputc('"', fp);
+    ln_free(path);
+}
+
+static void print_usage_exit(const char *prog_name)
+{
+    const char *usage = "\
+Usage: %s [OPTION...] IR_FILE...\n\
+  or:  %s -m [OPTION...] [IR_FILE...]\n\
+Benchmark the LightNet IR models in IR_FILEs, printing a JSON object per\n\
+model and line.\n\
+With -m, run microbenchmarks of the compiler's containers instead, and replay\n\
+the memory plans of IR_FILEs on a memory pool, printing a JSON object per\n\
+benchmark, size and line.\n\
+\n\
+Options:\n\
+  -h, --help               display this message\n\
+  -m, --micro              run the microbenchmarks\n\
+  -t, --target=TARGET      compile the models for TARGET [cpu]\n\
+  -w, --warmup=N           run N untimed iterations first [3]\n\
+  -n, --iterations=N       run N timed iterations [20]\n\
+  -b, --budget=SECONDS     stop a microbenchmark at a size after SECONDS and\n\
+                           skip its larger sizes [2]\n\
+  -o, --outfile=OUTFILE    print the results to OUTFILE [stdout]\n\
+";
+
+    fprintf(stderr, usage, prog_name, prog_name);
+    exit(EXIT_SUCCESS);
+}
+
+static int parse_count(const char *name, const char *arg, int min)
+{
+    char *end;
+    long n;
+
+    n = strtol(arg, &end, 10);
+    if (*end || end == arg || n < min || n > INT_MAX) {
+        fprintf(stderr, "invalid %s: %s\n", name, arg);
+        exit(EXIT_FAILURE);
+    }
+    return (int)n;
+}
+
+int main(int argc, char **argv)
+{
+    ln_bench_opt opt = {"cpu", 3, 20, 2};
+    const char *outfile = NULL;
+    FILE *fp = stdout;
+    int optindex, c, i;
+    int micro = 0;
+    const struct option longopts[] = {
+        {"help",       no_argument,       NULL, 'h'},
+        {"micro",      no_argument,       NULL, 'm'},
+        {"target",     required_argument, NULL, 't'},
+        {"warmup",     required_argument, NULL, 'w'},
+        {"iterations", required_argument, NULL, 'n'},
+        {"budget",     required_argument, NULL, 'b'},
+        {"outfile",    required_argument, NULL, 'o'},
+        {0, 0, 0, 0}
+    };
+
+    while ((c = getopt_long(argc, argv, ":hmt:w:n:b:o:", longopts,
+                            &optindex)) != -1) {
+        switch (c) {
+        case 'h':
+            print_usage_exit(argv[0]);
+            break;
+        case 'm':
+            micro = 1;
+            break;
+        case 't':
+            opt.target = optarg;
+            break;
+        case 'w':
+            opt.warmup = parse_count("warmup", optarg, 0);
+            break;
+        case 'n':
+            opt.iterations = parse_count("iterations", optarg, 1);
+            break;
+        case 'b':
+            opt.budget = parse_count("budget", optarg, 1);
+            break;
+        case 'o':
+            outfile = optarg;
+            break;
+        case ':':
+            fprintf(stderr, "option %s needs a value\n", argv[optind-1]);
+            exit(EXIT_FAILURE);
+            break;
+        case '?':
+            fprintf(stderr, "unknown option %s\n", argv[optind-1]);
+            exit(EXIT_FAILURE);
+            break;
+        default:
+            fprintf(stderr, "getopt_long() returned character code %d\n", c);
+            exit(EXIT_FAILURE);
+            break;
+        }
+    }
+    if (optind >= argc && !micro) {
+        fprintf(stderr, "no IR file given\n");
+        exit(EXIT_FAILURE);
+    }
+    if (outfile && !(fp = fopen(outfile, "w"))) {
+        perror(outfile);
+        exit(EXIT_FAILURE);
+    }
+
+    ln_arch_init();
+    if (micro)
+        ln_bench_micro(fp, &opt);
+    for (i = optind; i < argc; i++) {
+        if (micro)
+            ln_bench_micro_trace(fp, argv[i], &opt);
+        else
+            ln_bench_net(fp, argv[i], &opt);
+        fflush(fp);
+    }
+    ln_arch_cleanup();
+
+    if (fp != stdout)
+        fclose(fp);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2018-2020 Zhixu Zhao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _LN_BENCH_H_
+#define _LN_BENCH_H_
+
+#include <stdio.h>
+#include "ln_util.h"
+
+/* options shared by the benchmarks */
+struct ln_bench_opt {
+    const char *target;         /* compilation target of net benchmarks */
+    int         warmup;         /* untimed iterations before timing */
+    int         iterations;     /* timed iterations */
+    double      budget;         /* seconds a microbenchmark may take at a
+                                   size before larger sizes are skipped */
+};
+typedef struct ln_bench_opt ln_bench_opt;
+
+/* summary of the timed samples of a benchmark, in seconds */
+struct ln_bench_stat {
+    size_t  n;
+    double  min;
+    double  max;
+    double  mean;
+    double  total;
+    double  p50;
+    double  p95;
+    double  p99;
+};
+typedef struct ln_bench_stat ln_bench_stat;
+
+#ifdef __cplusplus
+LN_CPPSTART
+#endif
+
+double ln_bench_clock(void);
+void ln_bench_stat_compute(ln_bench_stat *stat, double *samples, size_t n);
+void ln_bench_fprint_stat(FILE *fp, const ln_bench_stat *stat);
+void ln_bench_fprint_name(FILE *fp, const char *file);
+void ln_bench_net(FILE *fp, const char *file, const ln_bench_opt *opt);
+void ln_bench_micro(FILE *fp, const ln_bench_opt *opt);
+void ln_bench_micro_trace(FILE *fp, const char *file, const ln_bench_opt *opt);
+
+#ifdef __cplusplus
+LN_CPPEND
+#endif
+
+#endif  /* _LN_BENCH_H_ */
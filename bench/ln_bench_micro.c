@@ -0,0 +1,654 @@
+/*
+ * Copyright (c) 2018-2020 Zhixu Zhao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "ln_bench.h"
+#include "ln_hash.h"
+#include "ln_list.h"
+#include "ln_mem.h"
+#include "ln_graph.h"
+#include "ln_context.h"
+
+/* sizes every microbenchmark runs at, until it exceeds opt->budget */
+static const size_t bench_sizes[] = {1000, 10000, 100000, 1000000};
+#define NUM_SIZES (sizeof(bench_sizes) / sizeof(bench_sizes[0]))
+
+/* room for a tensor name like the ones the compiler makes */
+#define KEY_LEN 32
+
+/* list finds and removes probe this many elements spread over the list */
+#define LIST_PROBES 1000
+
+/* blocks kept alive by the synthetic pool pattern, about the number of
+   tensors alive at a time in the protos/net models */
+#define POOL_LIVE 32
+#define POOL_SIZE ((size_t)1 << 40)
+#define POOL_ALIGN 64
+
+/* the farthest back a skip connection of the synthetic DAGs reaches */
+#define DAG_WINDOW 16
+
+/*
+ * A microbenchmark. create() builds the state for a size once, reset()
+ * prepares it untimed before each run, and run() is timed and returns the
+ * number of operations it did.
+ */
+struct micro_bench {
+    const char *name;
+    void     *(*create)(size_t n);
+    void      (*reset)(void *s);
+    size_t    (*run)(void *s);
+    void      (*free)(void *s);
+};
+typedef struct micro_bench micro_bench;
+
+static volatile size_t sink;
+
+static uint32_t rand_next(uint32_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+struct hash_state {
+    size_t   n;
+    char    *buf;
+    char   **keys;              /* shuffled tensor-like names */
+    ln_hash *hash;
+};
+
+static void *hash_create(size_t n)
+{
+    struct hash_state *s;
+    uint32_t seed = 1;
+    char *key;
+    size_t i, j;
+
+    s = ln_alloc(sizeof(struct hash_state));
+    s->n = n;
+    s->buf = ln_alloc(n * KEY_LEN);
+    s->keys = ln_alloc(n * sizeof(char *));
+    s->hash = NULL;
+    for (i = 0; i < n; i++) {
+        s->keys[i] = s->buf + i * KEY_LEN;
+        snprintf(s->keys[i], KEY_LEN, "tensor%lu", (unsigned long)i);
+    }
+    for (i = n - 1; i > 0; i--) {
+        j = rand_next(&seed) % (i + 1);
+        key = s->keys[i];
+        s->keys[i] = s->keys[j];
+        s->keys[j] = key;
+    }
+    return s;
+}
+
+static void hash_reset_empty(void *p)
+{
+    struct hash_state *s = p;
+
+    if (s->hash)
+        ln_hash_free(s->hash);
+    s->hash = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+}
+
+static void hash_reset_full(void *p)
+{
+    struct hash_state *s = p;
+    size_t i;
+
+    hash_reset_empty(s);
+    for (i = 0; i < s->n; i++)
+        ln_hash_insert(s->hash, s->keys[i], s->keys[i]);
+}
+
+/* finds don't change the table, so it is filled only once */
+static void hash_reset_once(void *p)
+{
+    struct hash_state *s = p;
+
+    if (!s->hash)
+        hash_reset_full(s);
+}
+
+static size_t hash_insert_run(void *p)
+{
+    struct hash_state *s = p;
+    size_t i;
+
+    for (i = 0; i < s->n; i++)
+        ln_hash_insert(s->hash, s->keys[i], s->keys[i]);
+    return s->n;
+}
+
+static size_t hash_find_run(void *p)
+{
+    struct hash_state *s = p;
+    size_t i, found = 0;
+
+    for (i = 0; i < s->n; i++)
+        found += ln_hash_find(s->hash, s->keys[s->n - 1 - i]) != NULL;
+    sink = found;
+    return s->n;
+}
+
+static size_t hash_remove_run(void *p)
+{
+    struct hash_state *s = p;
+    size_t i;
+
+    for (i = 0; i < s->n; i++)
+        ln_hash_remove(s->hash, s->keys[s->n - 1 - i]);
+    return s->n;
+}
+
+static void hash_free(void *p)
+{
+    struct hash_state *s = p;
+
+    if (s->hash)
+        ln_hash_free(s->hash);
+    ln_free(s->keys);
+    ln_free(s->buf);
+    ln_free(s);
+}
+
+/* list elements are the numbers 1..n as pointers */
+struct list_state {
+    size_t   n;
+    ln_list *list;
+};
+
+static ln_list *list_build(size_t n)
+{
+    ln_list *list = NULL;
+    size_t i;
+
+    for (i = n; i > 0; i--)
+        list = ln_list_prepend(list, (void *)i);
+    return list;
+}
+
+static size_t list_probes(size_t n)
+{
+    return n < LIST_PROBES ? n : LIST_PROBES;
+}
+
+static void *list_create(size_t n)
+{
+    struct list_state *s;
+
+    s = ln_alloc(sizeof(struct list_state));
+    s->n = n;
+    s->list = NULL;
+    return s;
+}
+
+static void list_reset_empty(void *p)
+{
+    struct list_state *s = p;
+
+    ln_list_free(s->list);
+    s->list = NULL;
+}
+
+static void list_reset_full(void *p)
+{
+    struct list_state *s = p;
+
+    ln_list_free(s->list);
+    s->list = list_build(s->n);
+}
+
+static void list_reset_once(void *p)
+{
+    struct list_state *s = p;
+
+    if (!s->list)
+        s->list = list_build(s->n);
+}
+
+static size_t list_prepend_run(void *p)
+{
+    struct list_state *s = p;
+    size_t i;
+
+    for (i = s->n; i > 0; i--)
+        s->list = ln_list_prepend(s->list, (void *)i);
+    return s->n;
+}
+
+static size_t list_append_run(void *p)
+{
+    struct list_state *s = p;
+    size_t i;
+
+    for (i = 1; i <= s->n; i++)
+        s->list = ln_list_append(s->list, (void *)i);
+    return s->n;
+}
+
+static size_t list_find_run(void *p)
+{
+    struct list_state *s = p;
+    size_t i, probes = list_probes(s->n), found = 0;
+
+    for (i = 0; i < probes; i++)
+        found += ln_list_find(s->list, (void *)(s->n - i * s->n / probes))
+                != NULL;
+    sink = found;
+    return probes;
+}
+
+static size_t list_remove_run(void *p)
+{
+    struct list_state *s = p;
+    size_t i, probes = list_probes(s->n);
+
+    for (i = 0; i < probes; i++)
+        s->list = ln_list_remove(s->list, (void *)(s->n - i * s->n / probes));
+    return probes;
+}
+
+static void list_free(void *p)
+{
+    struct list_state *s = p;
+
+    ln_list_free(s->list);
+    ln_free(s);
+}
+
+/* an allocation if size is not 0, otherwise a deallocation of block id */
+struct pool_event {
+    size_t id;
+    size_t size;
+};
+
+struct pool_state {
+    size_t             n;       /* number of events */
+    struct pool_event *events;
+    size_t            *addrs;   /* address of each block id */
+    ln_mem_pool       *pool;
+};
+
+static struct pool_state *pool_state_create(struct pool_event *events,
+                                            size_t n, size_t nblocks)
+{
+    struct pool_state *s;
+
+    s = ln_alloc(sizeof(struct pool_state));
+    s->n = n;
+    s->events = events;
+    s->addrs = ln_alloc(sizeof(size_t) * (nblocks ? nblocks : 1));
+    s->pool = NULL;
+    return s;
+}
+
+/*
+ * Like the mem_plan pass on a chain of ops, every op allocates its output
+ * of 256 B to 4 MB and, once POOL_LIVE blocks are alive, deallocates a
+ * random one of them.
+ */
+static void *pool_create(size_t n)
+{
+    struct pool_event *events;
+    size_t live[POOL_LIVE + 1];
+    size_t nlive = 0, nevents = 0, i, j;
+    uint32_t seed = 1;
+
+    events = ln_alloc(sizeof(struct pool_event) * 2 * n);
+    for (i = 0; nevents < n; i++) {
+        events[nevents].id = i;
+        events[nevents++].size = (size_t)1 << (8 + rand_next(&seed) % 15);
+        live[nlive++] = i;
+        if (nlive <= POOL_LIVE || nevents >= n)
+            continue;
+        j = rand_next(&seed) % nlive;
+        events[nevents].id = live[j];
+        events[nevents++].size = 0;
+        live[j] = live[--nlive];
+    }
+    return pool_state_create(events, nevents, i);
+}
+
+static void pool_reset(void *p)
+{
+    struct pool_state *s = p;
+
+    if (s->pool)
+        ln_mem_pool_free(s->pool);
+    s->pool = ln_mem_pool_create(POOL_SIZE, POOL_ALIGN);
+}
+
+static size_t pool_run(void *p)
+{
+    struct pool_state *s = p;
+    struct pool_event *e;
+    size_t i;
+
+    for (i = 0; i < s->n; i++) {
+        e = &s->events[i];
+        if (e->size)
+            s->addrs[e->id] = ln_mem_pool_alloc(s->pool, e->size);
+        else
+            ln_mem_pool_dealloc(s->pool, s->addrs[e->id]);
+    }
+    return s->n;
+}
+
+static void pool_free(void *p)
+{
+    struct pool_state *s = p;
+
+    if (s->pool)
+        ln_mem_pool_free(s->pool);
+    ln_free(s->addrs);
+    ln_free(s->events);
+    ln_free(s);
+}
+
+struct graph_state {
+    size_t    n;
+    size_t   *ids;
+    ln_graph *graph;
+};
+
+/*
+ * A chain of n nodes like the ops of a net, where a quarter of the nodes
+ * also take an input from up to DAG_WINDOW nodes back. Nodes are linked
+ * into the list directly, since ln_graph_add() appends in linear time.
+ */
+static void *graph_create(size_t n)
+{
+    struct graph_state *s;
+    ln_graph_node **nodes;
+    ln_list *list = NULL;
+    uint32_t seed = 1;
+    size_t i, back;
+
+    s = ln_alloc(sizeof(struct graph_state));
+    s->n = n;
+    s->ids = ln_alloc(sizeof(size_t) * n);
+    s->graph = ln_graph_create(ln_direct_cmp, ln_direct_cmp);
+    nodes = ln_alloc(sizeof(ln_graph_node *) * n);
+    for (i = 0; i < n; i++) {
+        s->ids[i] = i;
+        nodes[i] = ln_graph_node_create(&s->ids[i], ln_direct_cmp);
+        list = ln_list_prepend(list, nodes[i]);
+    }
+    s->graph->nodes = ln_list_reverse(list);
+    s->graph->size = n;
+    for (i = 1; i < n; i++) {
+        ln_graph_link_node(s->graph, nodes[i - 1], nodes[i], NULL);
+        if (rand_next(&seed) % 4)
+            continue;
+        back = 2 + rand_next(&seed) % (DAG_WINDOW - 1);
+        if (back <= i)
+            ln_graph_link_node(s->graph, nodes[i - back], nodes[i], NULL);
+    }
+    ln_free(nodes);
+    return s;
+}
+
+static void graph_reset(void *p)
+{
+}
+
+static size_t graph_topsort_run(void *p)
+{
+    struct graph_state *s = p;
+    ln_list *layers;
+
+    sink = ln_graph_topsort(s->graph, &layers);
+    ln_graph_free_topsortlist(layers);
+    return s->n;
+}
+
+static void graph_free(void *p)
+{
+    struct graph_state *s = p;
+
+    ln_graph_free(s->graph);
+    ln_free(s->ids);
+    ln_free(s);
+}
+
+static const micro_bench benches[] = {
+    {"hash_insert", hash_create, hash_reset_empty, hash_insert_run, hash_free},
+    {"hash_find", hash_create, hash_reset_once, hash_find_run, hash_free},
+    {"hash_remove", hash_create, hash_reset_full, hash_remove_run, hash_free},
+    {"list_prepend", list_create, list_reset_empty, list_prepend_run, list_free},
+    {"list_append", list_create, list_reset_empty, list_append_run, list_free},
+    {"list_find", list_create, list_reset_once, list_find_run, list_free},
+    {"list_remove", list_create, list_reset_full, list_remove_run, list_free},
+    {"mem_pool", pool_create, pool_reset, pool_run, pool_free},
+    {"graph_topsort", graph_create, graph_reset, graph_topsort_run, graph_free},
+};
+
+/* the mem_pool benchmark on traces of models, whose states are made by
+   trace_mem_plan() */
+static const micro_bench trace_bench =
+    {"mem_pool_trace", NULL, pool_reset, pool_run, pool_free};
+
+/*
+ * Time opt->iterations runs of `bench` on state `s` after opt->warmup runs,
+ * both cut short once they take opt->budget seconds. Return 1 if the budget
+ * ran out, otherwise 0.
+ */
+static int measure(const micro_bench *bench, void *s, const ln_bench_opt *opt,
+                   ln_bench_stat *stat, size_t *ops)
+{
+    double *samples;
+    double elapsed, t1;
+    int i;
+
+    elapsed = 0;
+    for (i = 0; i < opt->warmup && elapsed <= opt->budget; i++) {
+        bench->reset(s);
+        t1 = ln_bench_clock();
+        bench->run(s);
+        elapsed += ln_bench_clock() - t1;
+    }
+
+    samples = ln_alloc(sizeof(double) * opt->iterations);
+    elapsed = 0;
+    for (i = 0; i < opt->iterations && elapsed <= opt->budget; i++) {
+        bench->reset(s);
+        t1 = ln_bench_clock();
+        *ops = bench->run(s);
+        samples[i] = ln_bench_clock() - t1;
+        elapsed += samples[i];
+    }
+    ln_bench_stat_compute(stat, samples, i);
+    ln_free(samples);
+    return elapsed > opt->budget;
+}
+
+static void fprint_result(FILE *fp, size_t size, const ln_bench_opt *opt,
+                          const ln_bench_stat *stat, size_t ops)
+{
+    fprintf(fp, ", \"size\": %lu, \"warmup\": %d, ",
+            (unsigned long)size, opt->warmup);
+    ln_bench_fprint_stat(fp, stat);
+    fprintf(fp, ", \"ops\": %lu, \"ns_per_op\": %.3f}\n", (unsigned long)ops,
+            ops ? stat->mean / ops * 1e9 : 0);
+}
+
+/*
+ * Run the microbenchmarks of the containers the compiler is built on at
+ * growing sizes, printing a JSON object per benchmark and size in a line of
+ * `fp`. A benchmark skips the sizes after the one it ran out of opt->budget
+ * at, so that the quadratic ones finish.
+ */
+void ln_bench_micro(FILE *fp, const ln_bench_opt *opt)
+{
+    const micro_bench *bench;
+    ln_bench_stat stat;
+    size_t i, j, ops;
+    int over;
+    void *s;
+
+    for (i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+        bench = &benches[i];
+        for (j = 0; j < NUM_SIZES; j++) {
+            s = bench->create(bench_sizes[j]);
+            over = measure(bench, s, opt, &stat, &ops);
+            bench->free(s);
+            fprintf(fp, "{\"bench\": \"micro\", \"name\": \"%s\"", bench->name);
+            fprint_result(fp, bench_sizes[j], opt, &stat, ops);
+            fflush(fp);
+            if (over && j + 1 < NUM_SIZES) {
+                fprintf(stderr, "%s: skipping sizes above %lu, "
+                        "which took over %g s\n", bench->name,
+                        (unsigned long)bench_sizes[j], opt->budget);
+                break;
+            }
+        }
+    }
+}
+
+struct trace_tensor {
+    size_t id;
+    int    uses;
+    int    alive;
+};
+
+/* the tensor a tensor shares memory with, which the pool allocates */
+static ln_tensor_entry *root_entry(ln_hash *tensor_table, ln_tensor_entry *te)
+{
+    while (te->owner)
+        te = ln_tensor_table_find(tensor_table, te->owner);
+    return te;
+}
+
+static ln_tensor_entry *trace_entry(ln_context *ctx, const char *name)
+{
+    ln_tensor_entry *te;
+
+    te = root_entry(ctx->tensor_table,
+                    ln_tensor_table_find(ctx->tensor_table, name));
+    if (te->isstatic || ln_context_is_weight(ctx, te->name))
+        return NULL;
+    return te;
+}
+
+static struct trace_tensor *trace_tensor(ln_hash *tensors, ln_tensor_entry *te)
+{
+    struct trace_tensor *tt;
+
+    if ((tt = ln_hash_find(tensors, te)))
+        return tt;
+    tt = ln_alloc(sizeof(struct trace_tensor));
+    tt->id = ln_hash_size(tensors);
+    tt->uses = 0;
+    tt->alive = 0;
+    ln_hash_insert(tensors, te, tt);
+    return tt;
+}
+
+static void add_event(struct pool_event **events, size_t *n, size_t *cap,
+                      size_t id, size_t size)
+{
+    if (*n == *cap) {
+        *cap = *cap ? *cap * 2 : 256;
+        *events = ln_realloc(*events, sizeof(struct pool_event) * *cap);
+    }
+    (*events)[*n].id = id;
+    (*events)[(*n)++].size = size;
+}
+
+/*
+ * Record the pool allocations and deallocations planning the memory of the
+ * compiled `ctx` does: an op allocates the tensors it writes first and frees
+ * the tensors it reads last. Weights and static tensors persist and aren't
+ * traced.
+ */
+static struct pool_state *trace_mem_plan(ln_context *ctx)
+{
+    struct pool_event *events = NULL;
+    struct trace_tensor *tt;
+    ln_tensor_list_entry *tle;
+    ln_tensor_entry *te;
+    ln_hash *tensors;
+    size_t n = 0, cap = 0, size;
+    ln_op *op;
+
+    tensors = ln_hash_create(ln_direct_hash, ln_direct_cmp, NULL, ln_free);
+    LN_LIST_FOREACH(op, ctx->ops) {
+        LN_LIST_FOREACH(tle, op->op_arg->tensors_in) {
+            if ((te = trace_entry(ctx, tle->name)))
+                trace_tensor(tensors, te)->uses++;
+        }
+    }
+    LN_LIST_FOREACH(op, ctx->ops) {
+        LN_LIST_FOREACH(tle, op->op_arg->tensors_out) {
+            if (!(te = trace_entry(ctx, tle->name)))
+                continue;
+            tt = trace_tensor(tensors, te);
+            if (tt->alive)
+                continue;
+            size = tl_tensor_size(te->tensor);
+            size = (size + POOL_ALIGN - 1) / POOL_ALIGN * POOL_ALIGN;
+            add_event(&events, &n, &cap, tt->id, size ? size : POOL_ALIGN);
+            tt->alive = 1;
+        }
+        LN_LIST_FOREACH(tle, op->op_arg->tensors_in) {
+            if (!(te = trace_entry(ctx, tle->name)))
+                continue;
+            tt = trace_tensor(tensors, te);
+            if (--tt->uses == 0 && tt->alive) {
+                add_event(&events, &n, &cap, tt->id, 0);
+                tt->alive = 0;
+            }
+        }
+    }
+    size = ln_hash_size(tensors);
+    ln_hash_free(tensors);
+    return pool_state_create(events, n, size);
+}
+
+/*
+ * Replay the memory plan of the IR model in `file` compiled for opt->target
+ * on a memory pool, printing the timing as a JSON object in a line of `fp`.
+ */
+void ln_bench_micro_trace(FILE *fp, const char *file, const ln_bench_opt *opt)
+{
+    struct pool_state *s;
+    ln_bench_stat stat;
+    ln_context *ctx;
+    size_t ops;
+
+    ctx = ln_context_create();
+    ln_context_init(ctx, file);
+    ln_context_compile(ctx, opt->target, NULL);
+    s = trace_mem_plan(ctx);
+    ln_context_cleanup(ctx);
+    ln_context_free(ctx);
+
+    measure(&trace_bench, s, opt, &stat, &ops);
+    fprintf(fp, "{\"bench\": \"micro\", \"name\": \"%s\", \"model\": ",
+            trace_bench.name);
+    ln_bench_fprint_name(fp, file);
+    fprint_result(fp, s->n, opt, &stat, ops);
+    trace_bench.free(s);
+}
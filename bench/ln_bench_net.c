@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2018-2020 Zhixu Zhao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "ln_bench.h"
+#include "ln_context.h"
+
+/*
+ * Compile the IR model in `file` for opt->target, load it without a data
+ * file, so that weights are the random data of their create ops, and time
+ * opt->iterations runs after opt->warmup runs. Print the timing and memory
+ * statistics as a JSON object in a line of `fp`.
+ */
+void ln_bench_net(FILE *fp, const char *file, const ln_bench_opt *opt)
+{
+    ln_context *ctx;
+    ln_bench_stat stat;
+    double *samples;
+    double compile_time, load_time, t1;
+    int i;
+
+    ctx = ln_context_create();
+    ln_context_init(ctx, file);
+    t1 = ln_bench_clock();
+    ln_context_compile(ctx, opt->target, NULL);
+    compile_time = ln_bench_clock() - t1;
+    t1 = ln_bench_clock();
+    ln_context_load(ctx, NULL);
+    load_time = ln_bench_clock() - t1;
+
+    for (i = 0; i < opt->warmup; i++)
+        ln_context_run(ctx);
+    samples = ln_alloc(sizeof(double) * opt->iterations);
+    for (i = 0; i < opt->iterations; i++) {
+        t1 = ln_bench_clock();
+        ln_context_run(ctx);
+        samples[i] = ln_bench_clock() - t1;
+    }
+    ln_bench_stat_compute(&stat, samples, opt->iterations);
+
+    fprintf(fp, "{\"bench\": \"net\", \"name\": ");
+    ln_bench_fprint_name(fp, file);
+    fprintf(fp, ", \"target\": \"%s\", \"warmup\": %d, ",
+            opt->target, opt->warmup);
+    ln_bench_fprint_stat(fp, &stat);
+    fprintf(fp, ", \"compile_s\": %.6f, \"load_s\": %.6f, "
+            "\"arena_bytes\": %lu, \"weight_bytes\": %lu}\n",
+            compile_time, load_time,
+            (unsigned long)ctx->mem_sizes[LN_MEM_CPU],
+            (unsigned long)ctx->weight_sizes[LN_MEM_CPU]);
+
+    ln_free(samples);
+    ln_context_unload(ctx);
+    ln_context_cleanup(ctx);
+    ln_context_free(ctx);
+}
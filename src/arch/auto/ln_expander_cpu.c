@@ -463,6 +463,34 @@ static ln_list *ep_resize(const ln_context *ctx, const ln_op *self, int *match)
     }
 }
 
+static ln_list *ep_channel_shuffle(const ln_context *ctx, const ln_op *self, int *match)
+{
+    /* auto variables */
+
+
+   /* replace self with new ops */
+    if (1) {
+        ln_op *new_op = ln_op_copy_to_optype(LN_ARCH.op_proto_table,
+                                             self, "channel_shuffle_cpu");
+        *match = 1;
+        return ln_list_append(NULL, new_op);
+    }
+}
+
+static ln_list *ep_topk(const ln_context *ctx, const ln_op *self, int *match)
+{
+    /* auto variables */
+
+
+   /* replace self with new ops */
+    if (1) {
+        ln_op *new_op = ln_op_copy_to_optype(LN_ARCH.op_proto_table,
+                                             self, "topk_cpu");
+        *match = 1;
+        return ln_list_append(NULL, new_op);
+    }
+}
+
 static ln_hash_init_entry init_ep_funcs[] = {
     {"create", ep_create},
     {"conv2d", ep_conv2d},
@@ -495,6 +523,8 @@ static ln_hash_init_entry init_ep_funcs[] = {
     {"avgpool2d", ep_avgpool2d},
     {"submean", ep_submean},
     {"resize", ep_resize},
+    {"channel_shuffle", ep_channel_shuffle},
+    {"topk", ep_topk},
     LN_HASH_INIT_ENTRY_NULL
 };
 static ln_hash *ep_funcs_hash = NULL;
@@ -21,6 +21,7 @@
  */
 
 #include "ln_arch.h"
+#include "ln_cpu.h"
 
 extern ln_op ln_opimpl_arange_cpu;
 extern ln_op ln_opimpl_avgpool2d_cpu;
@@ -59,6 +60,9 @@ extern ln_op ln_opimpl_deconv2d_cpu;
 extern ln_op ln_opimpl_submean_cpu;
 extern ln_op ln_opimpl_dot_product_cpu;
 extern ln_op ln_opimpl_forward_cpu;
+extern ln_op ln_opimpl_elew_chain_cpu;
+extern ln_op ln_opimpl_channel_shuffle_cpu;
+extern ln_op ln_opimpl_topk_cpu;
 /* end of declare cpu ops */
 
 static ln_op *ops_cpu[] = {
@@ -99,6 +103,9 @@ static ln_op *ops_cpu[] = {
     &ln_opimpl_submean_cpu,
     &ln_opimpl_dot_product_cpu,
     &ln_opimpl_forward_cpu,
+    &ln_opimpl_elew_chain_cpu,
+    &ln_opimpl_channel_shuffle_cpu,
+    &ln_opimpl_topk_cpu,
 /* end of init cpu ops */
     NULL
 };
@@ -124,16 +131,431 @@ static void cleanup_cpu(void **priv_p)
 /* end of exec cpu cleanup funcs */
 }
 
+static int is_chainable(const ln_context *ctx, const ln_op *op)
+{
+    const char *optype = op->op_arg->optype;
+    ln_tensor_list_entry *tle;
+    ln_tensor_entry *te;
+
+    if (!ln_streq(optype, "relu_cpu") && !ln_streq(optype, "lrelu_cpu") &&
+        !ln_streq(optype, "sigmoid_cpu") && !ln_streq(optype, "elew_cpu") &&
+        !ln_streq(optype, "elew_chain_cpu"))
+        return 0;
+
+    LN_LIST_FOREACH(tle, op->op_arg->tensors_in) {
+        te = ln_tensor_table_find(ctx->tensor_table, tle->name);
+        if (te->tensor->dtype != TL_FLOAT)
+            return 0;
+    }
+    LN_LIST_FOREACH(tle, op->op_arg->tensors_out) {
+        te = ln_tensor_table_find(ctx->tensor_table, tle->name);
+        if (te->isstatic)
+            return 0;
+    }
+    return 1;
+}
+
+static int elew_opcode(const char *elew_op, int reversed)
+{
+    if (ln_streq(elew_op, "TL_MUL"))
+        return LN_CPU_EW_MUL;
+    if (ln_streq(elew_op, "TL_SUM"))
+        return LN_CPU_EW_ADD;
+    if (ln_streq(elew_op, "TL_MAX"))
+        return LN_CPU_EW_MAX;
+    if (ln_streq(elew_op, "TL_MIN"))
+        return LN_CPU_EW_MIN;
+    if (ln_streq(elew_op, "TL_DIV"))
+        return reversed ? LN_CPU_EW_RDIV : LN_CPU_EW_DIV;
+    if (ln_streq(elew_op, "TL_SUB"))
+        return reversed ? LN_CPU_EW_RSUB : LN_CPU_EW_SUB;
+    if (ln_streq(elew_op, "TL_POW"))
+        return reversed ? LN_CPU_EW_RPOW : LN_CPU_EW_POW;
+    return -1;
+}
+
+/*
+ * A chain of pointwise ops: tensor names in srcs, where srcs[0] is the one
+ * streamed through, and the elew_chain_cpu code as [opcode, src, imm] triples.
+ */
+struct chain {
+    ln_list *srcs;
+    double  *code;
+    int      code_len;
+};
+
+static int chain_src(struct chain *c, const char *name)
+{
+    ln_list *l;
+    int i;
+
+    for (i = 0, l = c->srcs; l; l = l->next, i++) {
+        if (ln_streq(l->data, name))
+            return i;
+    }
+    c->srcs = ln_list_append(c->srcs, (void *)name);
+    return i;
+}
+
+static void chain_emit(struct chain *c, int opcode, int src, double imm)
+{
+    c->code = ln_realloc(c->code, sizeof(double) * (c->code_len + 3));
+    c->code[c->code_len++] = opcode;
+    c->code[c->code_len++] = src;
+    c->code[c->code_len++] = imm;
+}
+
+static void chain_fini(struct chain *c)
+{
+    ln_list_free(c->srcs);
+    ln_free(c->code);
+}
+
+static const char *chain_stream(const ln_op *op)
+{
+    const char *arg_name = "src";
+
+    if (ln_streq(op->op_arg->optype, "elew_cpu"))
+        arg_name = "src1";
+    else if (ln_streq(op->op_arg->optype, "elew_chain_cpu"))
+        arg_name = "src0";
+    return ln_tensor_list_find_name(op->op_arg->tensors_in, arg_name);
+}
+
+/* Describe the chainable `op` as a chain streaming tensor `stream`.
+   Returns 0 if that's not possible. */
+static int chain_init(struct chain *c, const ln_op *op, const char *stream)
+{
+    ln_op_arg *op_arg = op->op_arg;
+    ln_param_entry *pe;
+    ln_tensor_list_entry *tle;
+    const char *src1, *src2;
+    char arg_name[LN_MAX_NAME_LEN];
+    int opcode;
+    int i, n;
+
+    memset(c, 0, sizeof(*c));
+    if (ln_streq(op_arg->optype, "elew_cpu")) {
+        pe = ln_param_list_find(op_arg->params, "elew_op");
+        src1 = ln_tensor_list_find_name(op_arg->tensors_in, "src1");
+        src2 = ln_tensor_list_find_name(op_arg->tensors_in, "src2");
+        chain_src(c, stream);
+        if (ln_streq(src1, stream) && ln_streq(src2, stream)) {
+            opcode = elew_opcode(pe->value_string, 0);
+            chain_emit(c, opcode, -1, 0);
+        } else if (ln_streq(src1, stream)) {
+            opcode = elew_opcode(pe->value_string, 0);
+            chain_emit(c, opcode, chain_src(c, src2), 0);
+        } else {
+            opcode = elew_opcode(pe->value_string, 1);
+            chain_emit(c, opcode, chain_src(c, src1), 0);
+        }
+        return opcode >= 0;
+    }
+
+    if (ln_streq(op_arg->optype, "elew_chain_cpu")) {
+        n = ln_tensor_list_length(op_arg->tensors_in);
+        for (i = 0; i < n; i++) {
+            snprintf(arg_name, LN_MAX_NAME_LEN, "src%d", i);
+            tle = ln_tensor_list_find_by_arg_name(op_arg->tensors_in, arg_name);
+            c->srcs = ln_list_append(c->srcs, tle->name);
+        }
+        pe = ln_param_list_find(op_arg->params, "code");
+        c->code_len = pe->array_len;
+        c->code = ln_alloc(sizeof(double) * c->code_len);
+        memmove(c->code, pe->value_array_double, sizeof(double) * c->code_len);
+        return ln_streq(c->srcs->data, stream);
+    }
+
+    chain_src(c, ln_tensor_list_find_name(op_arg->tensors_in, "src"));
+    if (ln_streq(op_arg->optype, "relu_cpu")) {
+        chain_emit(c, LN_CPU_EW_RELU, 0, 0);
+    } else if (ln_streq(op_arg->optype, "lrelu_cpu")) {
+        pe = ln_param_list_find(op_arg->params, "negslope");
+        chain_emit(c, LN_CPU_EW_LRELU, 0, pe->value_double);
+    } else {
+        chain_emit(c, LN_CPU_EW_SIGMOID, 0, 0);
+    }
+    return 1;
+}
+
+/* Append chain `b`, which streams a's result `acc`, to `a`. `acc` is never
+   materialized, so `b` may not read it other than through its accumulator. */
+static int chain_concat(struct chain *a, const struct chain *b,
+                        const char *acc)
+{
+    ln_list *l;
+    int *src_map;
+    int opcode, src;
+    int i, n;
+
+    n = ln_list_length(b->srcs);
+    for (i = 0; i < b->code_len; i += 3) {
+        if (b->code[i] >= LN_CPU_EW_MUL && b->code[i + 1] == 0)
+            return 0;
+    }
+    for (l = b->srcs->next; l; l = l->next) {
+        if (ln_streq(l->data, acc))
+            return 0;
+    }
+    src_map = ln_alloc(sizeof(int) * n);
+    for (i = 1, l = b->srcs->next; l; l = l->next, i++)
+        src_map[i] = chain_src(a, l->data);
+    for (i = 0; i < b->code_len; i += 3) {
+        opcode = b->code[i];
+        src = b->code[i + 1];
+        if (opcode >= LN_CPU_EW_MUL && src > 0)
+            src = src_map[src];
+        chain_emit(a, opcode, src, b->code[i + 2]);
+    }
+    ln_free(src_map);
+    return 1;
+}
+
+static int is_only_successor(const ln_context *ctx, const ln_op *op,
+                             const char *tname, const ln_op *next)
+{
+    ln_list *suc_ops;
+    ln_op *suc_op;
+    int ret = 1;
+
+    suc_ops = ln_dfg_nexts(ctx->dfg, op, tname);
+    if (!suc_ops)
+        return 0;
+    LN_LIST_FOREACH(suc_op, suc_ops) {
+        if (!ln_streq(suc_op->op_arg->name, next->op_arg->name))
+            ret = 0;
+    }
+    ln_list_free(suc_ops);
+    return ret;
+}
+
+/* Collapse two adjacent pointwise ops, where the second one is the only
+   reader of the first one's result, into one elew_chain_cpu. Repeating the
+   combiner until it's stable fuses maximal chains. */
+static ln_list *cb_func_elew_chain(const ln_context *ctx,
+                                   const ln_list *win_ops, size_t win_size,
+                                   int *match)
+{
+    ln_op *op1 = win_ops->data;
+    ln_op *op2 = win_ops->next->data;
+    ln_op *proto;
+    ln_op *new_op;
+    ln_list *tensors_in = NULL;
+    ln_list *l;
+    char *acc;
+    struct chain c1 = {0}, c2 = {0};
+    char arg_name[LN_MAX_NAME_LEN];
+    int i;
+
+    *match = 0;
+    if (!is_chainable(ctx, op1) || !is_chainable(ctx, op2))
+        return NULL;
+    acc = ln_tensor_list_find_name(op1->op_arg->tensors_out, "dst");
+    if (!is_only_successor(ctx, op1, acc, op2))
+        return NULL;
+
+    if (!chain_init(&c1, op1, chain_stream(op1)) ||
+        !chain_init(&c2, op2, acc) || !chain_concat(&c1, &c2, acc)) {
+        chain_fini(&c1);
+        chain_fini(&c2);
+        return NULL;
+    }
+    *match = 1;
+
+    for (i = 0, l = c1.srcs; l; l = l->next, i++) {
+        snprintf(arg_name, LN_MAX_NAME_LEN, "src%d", i);
+        tensors_in = ln_tensor_list_append(tensors_in, arg_name, l->data);
+    }
+    proto = ln_hash_find(LN_ARCH.op_proto_table, "elew_chain_cpu");
+    new_op = ln_op_create_from_proto(proto, op1->op_arg->name, tensors_in,
+                                     ln_tensor_list_copy(op2->op_arg->tensors_out),
+                                     ln_param_list_append_array_number(NULL, "code",
+                                                                       c1.code_len,
+                                                                       c1.code),
+                                     ctx->tensor_table);
+    chain_fini(&c1);
+    chain_fini(&c2);
+    return ln_list_append(NULL, new_op);
+}
+
+static tl_tensor *find_tensor(const ln_context *ctx, const ln_op *op,
+                              const char *arg_name, int out)
+{
+    char *name;
+
+    name = ln_tensor_list_find_name(out ? op->op_arg->tensors_out :
+                                    op->op_arg->tensors_in, arg_name);
+    return ln_tensor_table_find(ctx->tensor_table, name)->tensor;
+}
+
+/* Return the axis that reshape -> transpose -> reshape splits into
+   [group, dims[axis] / group], swaps the two and merges back, i.e. the
+   axis of a channel shuffle. Return -1 if the ops aren't that. */
+static int match_channel_shuffle(const ln_context *ctx, const ln_op *op1,
+                                 const ln_op *op2, const ln_op *op3,
+                                 int *group)
+{
+    tl_tensor *src, *split, *dst;
+    const char *split_name, *trans_name;
+    ln_param_entry *pe;
+    int axis, i;
+
+    if (!ln_streq(op1->op_arg->optype, "reshape_cpu") ||
+        !ln_streq(op2->op_arg->optype, "transpose_cpu") ||
+        !ln_streq(op3->op_arg->optype, "reshape_cpu"))
+        return -1;
+    split_name = ln_tensor_list_find_name(op1->op_arg->tensors_out, "dst");
+    trans_name = ln_tensor_list_find_name(op2->op_arg->tensors_out, "dst");
+    if (!ln_streq(ln_tensor_list_find_name(op2->op_arg->tensors_in, "src"),
+                  split_name) ||
+        !ln_streq(ln_tensor_list_find_name(op3->op_arg->tensors_in, "src"),
+                  trans_name) ||
+        !is_only_successor(ctx, op1, split_name, op2) ||
+        !is_only_successor(ctx, op2, trans_name, op3))
+        return -1;
+
+    src = find_tensor(ctx, op1, "src", 0);
+    split = find_tensor(ctx, op1, "dst", 1);
+    dst = find_tensor(ctx, op3, "dst", 1);
+    if (split->ndim != src->ndim + 1 || !tl_tensor_issameshape(src, dst))
+        return -1;
+    for (axis = 0; axis < src->ndim - 1; axis++) {
+        if (split->dims[axis] != src->dims[axis])
+            break;
+    }
+    if (split->dims[axis] * split->dims[axis + 1] != src->dims[axis])
+        return -1;
+    for (i = axis + 1; i < src->ndim; i++) {
+        if (split->dims[i + 1] != src->dims[i])
+            return -1;
+    }
+
+    pe = ln_param_list_find(op2->op_arg->params, "axes");
+    for (i = 0; i < split->ndim; i++) {
+        if (pe->value_array_int[i] !=
+            (i == axis ? axis + 1 : i == axis + 1 ? axis : i))
+            return -1;
+    }
+
+    *group = split->dims[axis];
+    return axis;
+}
+
+/* Replace the reshape -> transpose -> reshape of a channel shuffle with a
+   single channel_shuffle_cpu. */
+static ln_list *cb_func_channel_shuffle(const ln_context *ctx,
+                                        const ln_list *win_ops,
+                                        size_t win_size, int *match)
+{
+    ln_op *op1 = win_ops->data;
+    ln_op *op2 = win_ops->next->data;
+    ln_op *op3 = win_ops->next->next->data;
+    ln_op *proto;
+    ln_op *new_op;
+    ln_list *params;
+    int axis, group;
+
+    *match = 0;
+    axis = match_channel_shuffle(ctx, op1, op2, op3, &group);
+    if (axis < 0)
+        return NULL;
+    *match = 1;
+
+    params = ln_param_list_append_int(NULL, "axis", axis);
+    params = ln_param_list_append_int(params, "group", group);
+    proto = ln_hash_find(LN_ARCH.op_proto_table, "channel_shuffle_cpu");
+    new_op = ln_op_create_from_proto(proto, op2->op_arg->name,
+                                     ln_tensor_list_copy(op1->op_arg->tensors_in),
+                                     ln_tensor_list_copy(op3->op_arg->tensors_out),
+                                     params, ctx->tensor_table);
+    return ln_list_append(NULL, new_op);
+}
+
+/* Return the largest 'len' of the pick1d_cpu ops that read tname as their
+   src_index, or 0 if tname has other readers or none at all. */
+static int max_pick_len(const ln_context *ctx, const ln_op *op,
+                        const char *tname)
+{
+    ln_list *suc_ops;
+    ln_op *suc_op;
+    int len, max_len = 0;
+
+    suc_ops = ln_dfg_nexts(ctx->dfg, op, tname);
+    LN_LIST_FOREACH(suc_op, suc_ops) {
+        if (!ln_streq(suc_op->op_arg->optype, "pick1d_cpu") ||
+            ln_streq(ln_tensor_list_find_name(suc_op->op_arg->tensors_in,
+                                              "src"), tname)) {
+            max_len = 0;
+            break;
+        }
+        len = ln_param_list_find(suc_op->op_arg->params, "len")->value_int;
+        if (len > max_len)
+            max_len = len;
+    }
+    ln_list_free(suc_ops);
+    return max_len;
+}
+
+/* Replace a sort1d_by_key_cpu whose sorted keys are unused and whose sorted
+   values are only picked from their head by pick1d_cpus with a topk_cpu,
+   which doesn't sort the part nobody reads. */
+static ln_list *ep_func_topk(const ln_context *ctx, const ln_op *op,
+                             int *match)
+{
+    ln_op *proto;
+    ln_op *new_op;
+    ln_list *suc_ops;
+    ln_list *params;
+    char *dst_key, *dst_val;
+    int k;
+
+    *match = 0;
+    if (!ln_streq(op->op_arg->optype, "sort1d_by_key_cpu"))
+        return NULL;
+    dst_key = ln_tensor_list_find_name(op->op_arg->tensors_out, "dst_key");
+    dst_val = ln_tensor_list_find_name(op->op_arg->tensors_out, "dst_val");
+    suc_ops = ln_dfg_nexts(ctx->dfg, op, dst_key);
+    if (suc_ops) {
+        ln_list_free(suc_ops);
+        return NULL;
+    }
+    k = max_pick_len(ctx, op, dst_val);
+    if (k <= 0 || k >= find_tensor(ctx, op, "src_key", 0)->len)
+        return NULL;
+    *match = 1;
+
+    params = ln_param_list_append_int(NULL, "k", k);
+    params = ln_param_list_append_string(params, "dir",
+                                         ln_param_list_find(op->op_arg->params,
+                                                            "dir")->value_string);
+    proto = ln_hash_find(LN_ARCH.op_proto_table, "topk_cpu");
+    new_op = ln_op_create_from_proto(proto, op->op_arg->name,
+                                     ln_tensor_list_copy(op->op_arg->tensors_in),
+                                     ln_tensor_list_copy(op->op_arg->tensors_out),
+                                     params, ctx->tensor_table);
+    return ln_list_append(NULL, new_op);
+}
+
 static void optimize_cpu (ln_context *ctx, const char *datafile)
 {
+    ln_pass_timer timer;
+
     ln_pass_preprocess(ctx);
     ln_pass_expander(ctx, ln_expander_cpu);
     ln_pass_preprocess(ctx);
+    ln_pass_expander(ctx, ep_func_topk);
+    ln_pass_combiner(ctx, 3, cb_func_channel_shuffle);
+    ln_pass_combiner(ctx, 2, cb_func_elew_chain);
 
     /* make ops consistent */
+    ln_pass_timer_start(ctx, &timer, "op post_run");
     ln_op_list_do_post_run(ctx->ops);
+    ln_pass_timer_stop(ctx, &timer);
     assert(ln_hash_size(ctx->tensor_table) == 0);
+    ln_pass_timer_start(ctx, &timer, "op pre_run");
     ln_op_list_do_pre_run(ctx->ops);
+    ln_pass_timer_stop(ctx, &timer);
 
     ln_pass_mem_plan(ctx);
     /* ln_context_print(ctx, "out_debug.json"); */
@@ -218,15 +218,21 @@ static void cleanup_cuda(void **priv_p)
 
 static void optimize_cuda (ln_context *ctx, const char *datafile)
 {
+    ln_pass_timer timer;
+
     ln_pass_preprocess(ctx);
     ln_pass_expander(ctx, ln_expander_cuda);
     ln_pass_preprocess(ctx);
     ln_pass_combiner(ctx, 2, cb_func_single_replace);
 
     /* make ops consistent */
+    ln_pass_timer_start(ctx, &timer, "op post_run");
     ln_op_list_do_post_run(ctx->ops);
+    ln_pass_timer_stop(ctx, &timer);
     assert(ln_hash_size(ctx->tensor_table) == 0);
+    ln_pass_timer_start(ctx, &timer, "op pre_run");
     ln_op_list_do_pre_run(ctx->ops);
+    ln_pass_timer_stop(ctx, &timer);
 
     ln_pass_mem_plan(ctx);
     /* ln_context_print(ctx, "out_debug.json"); */
@@ -34,12 +34,12 @@ static ln_op *ops_cudnn[] = {
 
 static void init_cudnn(void **priv_p)
 {
-    *priv_p = ln_cudnn_context_create();
+    /* cudnn contexts are per thread, see ln_cudnn_context_get() */
 }
 
 static void cleanup_cudnn(void **priv_p)
 {
-    ln_cudnn_context_free(*priv_p);
+    ln_cudnn_context_release();
 }
 
 static void optimize_cudnn (ln_context *ctx, const char *datafile)
@@ -163,6 +163,8 @@ ln_list *ln_scheduler_dpu(const ln_dfg *dfg)
 
 static void optimize_dpu (ln_context *ctx, const char *datafile)
 {
+    ln_pass_timer timer;
+
     ln_pass_preprocess(ctx);
     ln_pass_expander(ctx, ln_expander_dpu);
     ln_pass_preprocess(ctx);
@@ -171,9 +173,13 @@ static void optimize_dpu (ln_context *ctx, const char *datafile)
     /* ln_pass_schedule(ctx, ln_scheduler_dpu); */
 
     /* make ops consistent */
+    ln_pass_timer_start(ctx, &timer, "op post_run");
     ln_op_list_do_post_run(ctx->ops);
+    ln_pass_timer_stop(ctx, &timer);
     assert(ln_hash_size(ctx->tensor_table) == 0);
+    ln_pass_timer_start(ctx, &timer, "op pre_run");
     ln_op_list_do_pre_run(ctx->ops);
+    ln_pass_timer_stop(ctx, &timer);
 
     ln_pass_mem_plan(ctx);
     /* ln_context_print(ctx, "out_debug.json"); */
@@ -58,6 +58,8 @@ extern ln_op ln_opimpl_deconv2d;
 extern ln_op ln_opimpl_submean;
 extern ln_op ln_opimpl_dot_product;
 extern ln_op ln_opimpl_forward;
+extern ln_op ln_opimpl_channel_shuffle;
+extern ln_op ln_opimpl_topk;
 /* end of declare none ops */
 
 /* TODO: use a hash */
@@ -98,6 +100,8 @@ static ln_op *ops_none[] = {
     &ln_opimpl_submean,
     &ln_opimpl_dot_product,
     &ln_opimpl_forward,
+    &ln_opimpl_channel_shuffle,
+    &ln_opimpl_topk,
 /* end of init none ops */
     NULL
 };
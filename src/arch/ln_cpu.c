@@ -0,0 +1,1073 @@
+/*
+ * Copyright (c) 2018-2020 Zhixu Zhao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "ln_cpu.h"
+#include "ln_msg.h"
+
+#define MR LN_CPU_SGEMM_MR
+#define NR LN_CPU_SGEMM_NR
+#define MC LN_CPU_SGEMM_MC
+#define KC LN_CPU_SGEMM_KC
+#define NC LN_CPU_SGEMM_NC
+
+#if MR != 4 || NR != 8
+#error "micro_kernel() is written for a 4 x 8 register tile"
+#endif
+
+#define round_up(x, n) (((x) + (n) - 1) / (n) * (n))
+#define min(a, b) ((a) < (b) ? (a) : (b))
+
+/* GCC generic vectors, lowered to whatever SIMD the target provides */
+typedef float v4sf __attribute__ ((vector_size (16)));
+typedef int v4si __attribute__ ((vector_size (16)));
+
+static inline v4sf v4sf_load(const float *p)
+{
+    v4sf v;
+
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline void v4sf_store(float *p, v4sf v)
+{
+    memcpy(p, &v, sizeof(v));
+}
+
+/*
+ * Allocate a CPU arena aligned to LN_CPU_ALIGN_SIZE. Large ones are aligned
+ * and padded to hugepages, and advised to be backed by them, to save TLB
+ * misses when walking through the tensors.
+ */
+void *ln_alloc_cpu(size_t size)
+{
+    void *p = NULL;
+    size_t align;
+    int ret;
+
+    if (size == 0)
+        return NULL;
+    align = LN_CPU_ALIGN_SIZE;
+    if (size >= LN_CPU_HUGEPAGE_THRESHOLD) {
+        align = LN_CPU_HUGEPAGE_SIZE;
+        size = round_up(size, align);
+    }
+    ret = posix_memalign(&p, align, size);
+    if (ret)
+        ln_msg_error("ln_alloc_cpu(): posix_memalign(%lu, %lu) failed: %s",
+                     align, size, strerror(ret));
+#ifdef MADV_HUGEPAGE
+    if (align == LN_CPU_HUGEPAGE_SIZE && madvise(p, size, MADV_HUGEPAGE))
+        ln_msg_debug("ln_alloc_cpu(): no transparent hugepages for %lu bytes",
+                     size);
+#endif
+
+    return p;
+}
+
+void ln_free_cpu(void *p)
+{
+    free(p);
+}
+
+static pthread_once_t num_threads_once = PTHREAD_ONCE_INIT;
+static int num_threads = 1;
+
+static void init_num_threads(void)
+{
+    const char *env;
+    long n;
+
+    env = getenv(LN_CPU_NUM_THREADS_ENV);
+    if (env && (n = atol(env)) > 0) {
+        num_threads = n;
+        return;
+    }
+    n = sysconf(_SC_NPROCESSORS_ONLN);
+    num_threads = n > 0 ? n : 1;
+}
+
+int ln_cpu_num_threads(void)
+{
+    pthread_once(&num_threads_once, init_num_threads);
+    return num_threads;
+}
+
+/*
+ * Workers of ln_cpu_run_parallel(), created on its first call and kept for
+ * the process, so that a parallel call costs a wakeup rather than creating
+ * and joining threads. The shares [1, n) of the job are taken in order by
+ * the workers and the calling thread, which waits for them all.
+ */
+struct parallel_pool {
+    pthread_mutex_t       mutex;
+    pthread_cond_t        work;     /* a job is posted */
+    pthread_cond_t        done;     /* all the shares of the job are done */
+    ln_cpu_parallel_func  func;
+    void                 *arg;
+    int                   n;
+    int                   next;     /* the next share to take */
+    int                   finished;
+    int                   nworkers;
+};
+
+static struct parallel_pool pool = {
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER,
+    PTHREAD_COND_INITIALIZER, NULL, NULL, 0, 0, 0, 0
+};
+/* held by the thread whose job the pool runs */
+static pthread_mutex_t pool_busy = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+/* Run the shares of the job left untaken; called with pool.mutex held. */
+static void run_shares(void)
+{
+    ln_cpu_parallel_func func;
+    void *arg;
+    int id, n;
+
+    while (pool.next < pool.n) {
+        id = pool.next++;
+        func = pool.func;
+        arg = pool.arg;
+        n = pool.n;
+        pthread_mutex_unlock(&pool.mutex);
+        func(arg, id, n);
+        pthread_mutex_lock(&pool.mutex);
+        if (++pool.finished == pool.n)
+            pthread_cond_signal(&pool.done);
+    }
+}
+
+static void *parallel_worker(void *p)
+{
+    pthread_mutex_lock(&pool.mutex);
+    for (;;) {
+        while (pool.next >= pool.n)
+            pthread_cond_wait(&pool.work, &pool.mutex);
+        run_shares();
+    }
+    return NULL;
+}
+
+/* Grow the pool to `nworkers` workers, as many as can be created. */
+static void grow_pool(int nworkers)
+{
+    pthread_t thread;
+
+    while (pool.nworkers < nworkers) {
+        if (pthread_create(&thread, NULL, parallel_worker, NULL))
+            break;
+        pthread_detach(thread);
+        pool.nworkers++;
+    }
+}
+
+static void init_pool(void)
+{
+    grow_pool(ln_cpu_num_threads() - 1);
+}
+
+/* Run func(arg, id, n) for id in [0, n) concurrently. The calling thread
+   takes id 0. If the pool is running another job, such as the one calling
+   this, or has no workers, all the shares run in the caller. */
+void ln_cpu_run_parallel(int n, ln_cpu_parallel_func func, void *arg)
+{
+    int i;
+
+    if (n <= 1) {
+        func(arg, 0, 1);
+        return;
+    }
+
+    pthread_once(&pool_once, init_pool);
+    if (pthread_mutex_trylock(&pool_busy)) {
+        for (i = 0; i < n; i++)
+            func(arg, i, n);
+        return;
+    }
+    grow_pool(n - 1);
+
+    pthread_mutex_lock(&pool.mutex);
+    pool.func = func;
+    pool.arg = arg;
+    pool.n = n;
+    pool.next = 1;
+    pool.finished = 1;
+    pthread_cond_broadcast(&pool.work);
+    pthread_mutex_unlock(&pool.mutex);
+
+    func(arg, 0, n);
+
+    pthread_mutex_lock(&pool.mutex);
+    run_shares();
+    while (pool.finished < pool.n)
+        pthread_cond_wait(&pool.done, &pool.mutex);
+    pool.n = 0;
+    pool.next = 0;
+    pthread_mutex_unlock(&pool.mutex);
+    pthread_mutex_unlock(&pool_busy);
+}
+
+/* Pack an mc x kc block of A into MR-row panels, each stored as kc columns of
+   MR contiguous floats. Rows past mc are zero-filled. */
+static void pack_a(int mc, int kc, const float *a, int rsa, int csa, float *pa)
+{
+    int i, ii, p, mr;
+    const float *ap;
+
+    for (i = 0; i < mc; i += MR) {
+        mr = min(MR, mc - i);
+        for (p = 0; p < kc; p++) {
+            ap = a + (size_t)i * rsa + (size_t)p * csa;
+            for (ii = 0; ii < mr; ii++)
+                pa[ii] = ap[(size_t)ii * rsa];
+            for (; ii < MR; ii++)
+                pa[ii] = 0;
+            pa += MR;
+        }
+    }
+}
+
+/* Pack a kc x nc block of B into NR-column panels, each stored as kc rows of
+   NR contiguous floats. Columns past nc are zero-filled. */
+static void pack_b(int kc, int nc, const float *b, int rsb, int csb, float *pb)
+{
+    int j, jj, p, nr;
+    const float *bp;
+
+    for (j = 0; j < nc; j += NR) {
+        nr = min(NR, nc - j);
+        for (p = 0; p < kc; p++) {
+            bp = b + (size_t)p * rsb + (size_t)j * csb;
+            for (jj = 0; jj < nr; jj++)
+                pb[jj] = bp[(size_t)jj * csb];
+            for (; jj < NR; jj++)
+                pb[jj] = 0;
+            pb += NR;
+        }
+    }
+}
+
+/* ab[MR][NR] = pa[kc][MR]^T * pb[kc][NR] */
+static void micro_kernel(int kc, const float *pa, const float *pb, float *ab)
+{
+    v4sf c00 = {0}, c01 = {0}, c10 = {0}, c11 = {0};
+    v4sf c20 = {0}, c21 = {0}, c30 = {0}, c31 = {0};
+    v4sf b0, b1;
+    int p;
+
+    for (p = 0; p < kc; p++) {
+        b0 = v4sf_load(pb);
+        b1 = v4sf_load(pb + 4);
+        c00 += pa[0] * b0;
+        c01 += pa[0] * b1;
+        c10 += pa[1] * b0;
+        c11 += pa[1] * b1;
+        c20 += pa[2] * b0;
+        c21 += pa[2] * b1;
+        c30 += pa[3] * b0;
+        c31 += pa[3] * b1;
+        pa += MR;
+        pb += NR;
+    }
+
+    v4sf_store(ab + 0 * NR, c00);
+    v4sf_store(ab + 0 * NR + 4, c01);
+    v4sf_store(ab + 1 * NR, c10);
+    v4sf_store(ab + 1 * NR + 4, c11);
+    v4sf_store(ab + 2 * NR, c20);
+    v4sf_store(ab + 2 * NR + 4, c21);
+    v4sf_store(ab + 3 * NR, c30);
+    v4sf_store(ab + 3 * NR + 4, c31);
+}
+
+static void macro_kernel(int mc, int nc, int kc, float alpha,
+                         const float *pa, const float *pb, float beta,
+                         float *c, int rsc, int csc)
+{
+    float ab[MR * NR];
+    float *cp;
+    int i, j, ii, jj, mr, nr;
+
+    for (j = 0; j < nc; j += NR) {
+        nr = min(NR, nc - j);
+        for (i = 0; i < mc; i += MR) {
+            mr = min(MR, mc - i);
+            micro_kernel(kc, pa + (size_t)i * kc, pb + (size_t)j * kc, ab);
+            cp = c + (size_t)i * rsc + (size_t)j * csc;
+            for (ii = 0; ii < mr; ii++) {
+                for (jj = 0; jj < nr; jj++) {
+                    float *e = cp + (size_t)ii * rsc + (size_t)jj * csc;
+                    if (beta == 0)
+                        *e = alpha * ab[ii * NR + jj];
+                    else
+                        *e = alpha * ab[ii * NR + jj] + beta * *e;
+                }
+            }
+        }
+    }
+}
+
+struct sgemm_arg {
+    int          m;
+    int          n;
+    int          k;
+    float        alpha;
+    const float *a;
+    int          rsa;
+    int          csa;
+    const float *b;
+    int          rsb;
+    int          csb;
+    const float *packed_b;      /* if not NULL, b is ignored */
+    int          n_packed;      /* n rounded up to NR */
+    float        beta;
+    float       *c;
+    int          rsc;
+    int          csc;
+    int          split_m;       /* parallelize over rows or columns of C */
+};
+
+static void sgemm_block(const struct sgemm_arg *arg, int m0, int m1,
+                        int n0, int n1)
+{
+    float *pa, *pb = NULL;
+    const float *bp;
+    int jc, pc, ic, mc, nc, kc;
+    float beta;
+
+    pa = ln_alloc(sizeof(float) * MC * KC);
+    if (!arg->packed_b)
+        pb = ln_alloc(sizeof(float) * KC * round_up(min(NC, n1 - n0), NR));
+
+    for (jc = n0; jc < n1; jc += NC) {
+        nc = min(NC, n1 - jc);
+        for (pc = 0; pc < arg->k; pc += KC) {
+            kc = min(KC, arg->k - pc);
+            beta = pc == 0 ? arg->beta : 1;
+            if (arg->packed_b) {
+                bp = arg->packed_b + (size_t)pc * arg->n_packed +
+                    (size_t)jc * kc;
+            } else {
+                pack_b(kc, nc, arg->b + (size_t)pc * arg->rsb +
+                       (size_t)jc * arg->csb, arg->rsb, arg->csb, pb);
+                bp = pb;
+            }
+            for (ic = m0; ic < m1; ic += MC) {
+                mc = min(MC, m1 - ic);
+                pack_a(mc, kc, arg->a + (size_t)ic * arg->rsa +
+                       (size_t)pc * arg->csa, arg->rsa, arg->csa, pa);
+                macro_kernel(mc, nc, kc, arg->alpha, pa, bp, beta,
+                             arg->c + (size_t)ic * arg->rsc +
+                             (size_t)jc * arg->csc, arg->rsc, arg->csc);
+            }
+        }
+    }
+
+    ln_free(pa);
+    ln_free(pb);
+}
+
+static void sgemm_worker(void *p, int id, int n)
+{
+    const struct sgemm_arg *arg = p;
+    int units, start, end;
+
+    if (arg->split_m) {
+        units = (arg->m + MR - 1) / MR;
+        start = (long)units * id / n * MR;
+        end = min((long)units * (id + 1) / n * MR, arg->m);
+        if (start < end)
+            sgemm_block(arg, start, end, 0, arg->n);
+    } else {
+        units = (arg->n + NR - 1) / NR;
+        start = (long)units * id / n * NR;
+        end = min((long)units * (id + 1) / n * NR, arg->n);
+        if (start < end)
+            sgemm_block(arg, 0, arg->m, start, end);
+    }
+}
+
+static void sgemm_scale_c(int m, int n, float beta, float *c, int rsc, int csc)
+{
+    int i, j;
+
+    for (i = 0; i < m; i++) {
+        for (j = 0; j < n; j++) {
+            float *e = c + (size_t)i * rsc + (size_t)j * csc;
+            *e = beta == 0 ? 0 : beta * *e;
+        }
+    }
+}
+
+static void sgemm_run(struct sgemm_arg *arg)
+{
+    int nthreads, units;
+
+    if (arg->m <= 0 || arg->n <= 0)
+        return;
+    if (arg->k <= 0) {
+        sgemm_scale_c(arg->m, arg->n, arg->beta, arg->c, arg->rsc, arg->csc);
+        return;
+    }
+
+    nthreads = ln_cpu_num_threads();
+    if ((double)arg->m * arg->n * arg->k < LN_CPU_SGEMM_MT_THRESHOLD)
+        nthreads = 1;
+    arg->split_m = arg->m >= arg->n;
+    units = arg->split_m ? (arg->m + MR - 1) / MR : (arg->n + NR - 1) / NR;
+    nthreads = min(nthreads, units);
+    ln_cpu_run_parallel(nthreads, sgemm_worker, arg);
+}
+
+size_t ln_cpu_sgemm_pack_b_size(int k, int n)
+{
+    return sizeof(float) * k * round_up(n, NR);
+}
+
+/* Pack the k x n matrix B (element (i, j) at b[i*rsb + j*csb]) for
+   ln_cpu_sgemm_packed() into `packed_b` of ln_cpu_sgemm_pack_b_size(k, n)
+   bytes. */
+void ln_cpu_sgemm_pack_b(int k, int n, const float *b, int rsb, int csb,
+                         float *packed_b)
+{
+    int pc, kc, n_packed;
+
+    assert(k > 0 && n > 0);
+    n_packed = round_up(n, NR);
+    for (pc = 0; pc < k; pc += KC) {
+        kc = min(KC, k - pc);
+        pack_b(kc, n, b + (size_t)pc * rsb, rsb, csb,
+               packed_b + (size_t)pc * n_packed);
+    }
+}
+
+/* C = alpha * A * B + beta * C, with B from ln_cpu_sgemm_pack_b(). */
+void ln_cpu_sgemm_packed(int m, int n, int k, float alpha,
+                         const float *a, int rsa, int csa,
+                         const float *packed_b, float beta,
+                         float *c, int rsc, int csc)
+{
+    struct sgemm_arg arg = {
+        .m = m, .n = n, .k = k, .alpha = alpha,
+        .a = a, .rsa = rsa, .csa = csa,
+        .packed_b = packed_b, .n_packed = round_up(n, NR),
+        .beta = beta, .c = c, .rsc = rsc, .csc = csc,
+    };
+
+    sgemm_run(&arg);
+}
+
+/* C = alpha * A * B + beta * C, where A is m x k, B is k x n and C is m x n.
+   Matrices are addressed by row and column strides, so transposed operands
+   need no copy. C isn't read if beta is 0. */
+void ln_cpu_sgemm(int m, int n, int k, float alpha,
+                  const float *a, int rsa, int csa,
+                  const float *b, int rsb, int csb, float beta,
+                  float *c, int rsc, int csc)
+{
+    struct sgemm_arg arg = {
+        .m = m, .n = n, .k = k, .alpha = alpha,
+        .a = a, .rsa = rsa, .csa = csa,
+        .b = b, .rsb = rsb, .csb = csb,
+        .beta = beta, .c = c, .rsc = rsc, .csc = csc,
+    };
+
+    sgemm_run(&arg);
+}
+
+static float sdot_serial(size_t n, const float *x, const float *y)
+{
+    v4sf acc0 = {0}, acc1 = {0};
+    float sum;
+    size_t i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        acc0 += v4sf_load(x + i) * v4sf_load(y + i);
+        acc1 += v4sf_load(x + i + 4) * v4sf_load(y + i + 4);
+    }
+    acc0 += acc1;
+    sum = acc0[0] + acc0[1] + acc0[2] + acc0[3];
+    for (; i < n; i++)
+        sum += x[i] * y[i];
+
+    return sum;
+}
+
+struct sdot_arg {
+    size_t       n;
+    const float *x;
+    const float *y;
+    float       *sums;
+};
+
+static void sdot_worker(void *p, int id, int n)
+{
+    struct sdot_arg *arg = p;
+    size_t start, end;
+
+    start = arg->n * id / n;
+    end = arg->n * (id + 1) / n;
+    arg->sums[id] = sdot_serial(end - start, arg->x + start, arg->y + start);
+}
+
+float ln_cpu_sdot(size_t n, const float *x, const float *y)
+{
+    struct sdot_arg arg;
+    float sum = 0;
+    int nthreads, i;
+
+    nthreads = ln_cpu_num_threads();
+    if (n < LN_CPU_SGEMM_MT_THRESHOLD)
+        nthreads = 1;
+    if (nthreads == 1)
+        return sdot_serial(n, x, y);
+
+    arg.n = n;
+    arg.x = x;
+    arg.y = y;
+    arg.sums = ln_alloc(sizeof(float) * nthreads);
+    ln_cpu_run_parallel(nthreads, sdot_worker, &arg);
+    for (i = 0; i < nthreads; i++)
+        sum += arg.sums[i];
+    ln_free(arg.sums);
+
+    return sum;
+}
+
+/* Elementwise kernels below may be called with dst == src. */
+
+static inline v4sf v4sf_lrelu(v4sf x, v4sf zero, v4sf slope)
+{
+    v4si mask = x > zero;
+
+    return (v4sf)(((v4si)x & mask) | ((v4si)(x * slope) & ~mask));
+}
+
+/* dst = src > 0 ? src : src * negslope */
+void ln_cpu_slrelu(size_t n, const float *src, float *dst, float negslope)
+{
+    v4sf zero = {0}, slope = zero + negslope;
+    v4sf x0, x1;
+    size_t i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        x0 = v4sf_load(src + i);
+        x1 = v4sf_load(src + i + 4);
+        v4sf_store(dst + i, v4sf_lrelu(x0, zero, slope));
+        v4sf_store(dst + i + 4, v4sf_lrelu(x1, zero, slope));
+    }
+    for (; i < n; i++)
+        dst[i] = src[i] > 0 ? src[i] : src[i] * negslope;
+}
+
+static void saxpb(size_t n, const float *src, float *dst, float a, float b)
+{
+    v4sf va = {0}, vb = {0};
+    size_t i;
+
+    va += a;
+    vb += b;
+    for (i = 0; i + 8 <= n; i += 8) {
+        v4sf_store(dst + i, v4sf_load(src + i) * va + vb);
+        v4sf_store(dst + i + 4, v4sf_load(src + i + 4) * va + vb);
+    }
+    for (; i < n; i++)
+        dst[i] = src[i] * a + b;
+}
+
+/* Batch normalization of a [batch, channel, spatial] tensor with channel-wise
+   statistics, folded to dst = src * a + b for every channel. */
+void ln_cpu_sbatchnorm(const float *src, float *dst, int batch, int channel,
+                       size_t spatial, const float *scale, const float *offset,
+                       const float *mean, const float *var, float epsilon)
+{
+    float a, b;
+    size_t base;
+    int i, c;
+
+    for (c = 0; c < channel; c++) {
+        a = scale[c] / sqrtf(var[c] + epsilon);
+        b = offset[c] - mean[c] * a;
+        for (i = 0; i < batch; i++) {
+            base = ((size_t)i * channel + c) * spatial;
+            saxpb(spatial, src + base, dst + base, a, b);
+        }
+    }
+}
+
+/* dst = 1 / (1 + exp(-src)) */
+void ln_cpu_ssigmoid(size_t n, const float *src, float *dst)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++)
+        dst[i] = 1 / (1 + expf(-src[i]));
+}
+
+static inline v4sf v4sf_max(v4sf a, v4sf b)
+{
+    v4si mask = a > b;
+
+    return (v4sf)(((v4si)a & mask) | ((v4si)b & ~mask));
+}
+
+static inline v4sf v4sf_min(v4sf a, v4sf b)
+{
+    v4si mask = a < b;
+
+    return (v4sf)(((v4si)a & mask) | ((v4si)b & ~mask));
+}
+
+#define EW_BINARY(expr)                         \
+    for (i = 0; i < m; i += 4) {                \
+        a = v4sf_load(x + i);                   \
+        b = v4sf_load(y + i);                   \
+        v4sf_store(x + i, (expr));              \
+    }                                           \
+    break
+
+/* Apply one instruction to x[0, m), m being a multiple of 4. */
+static void ew_exec(const ln_cpu_ew_inst *inst, float *x, const float *y,
+                    size_t m)
+{
+    v4sf zero = {0}, slope = zero + inst->imm;
+    v4sf a, b;
+    size_t i;
+
+    switch (inst->opcode) {
+    case LN_CPU_EW_RELU:
+        slope = zero;
+        /* fall through */
+    case LN_CPU_EW_LRELU:
+        for (i = 0; i < m; i += 4)
+            v4sf_store(x + i, v4sf_lrelu(v4sf_load(x + i), zero, slope));
+        break;
+    case LN_CPU_EW_SIGMOID:
+        ln_cpu_ssigmoid(m, x, x);
+        break;
+    case LN_CPU_EW_MUL:
+        EW_BINARY(a * b);
+    case LN_CPU_EW_DIV:
+        EW_BINARY(a / b);
+    case LN_CPU_EW_ADD:
+        EW_BINARY(a + b);
+    case LN_CPU_EW_SUB:
+        EW_BINARY(a - b);
+    case LN_CPU_EW_MAX:
+        EW_BINARY(v4sf_max(a, b));
+    case LN_CPU_EW_MIN:
+        EW_BINARY(v4sf_min(a, b));
+    case LN_CPU_EW_RDIV:
+        EW_BINARY(b / a);
+    case LN_CPU_EW_RSUB:
+        EW_BINARY(b - a);
+    case LN_CPU_EW_POW:
+        for (i = 0; i < m; i++)
+            x[i] = powf(x[i], y[i]);
+        break;
+    case LN_CPU_EW_RPOW:
+        for (i = 0; i < m; i++)
+            x[i] = powf(y[i], x[i]);
+        break;
+    default:
+        ln_msg_inter_error("unknown elementwise opcode %d", inst->opcode);
+    }
+}
+
+#undef EW_BINARY
+
+/* Run an elementwise chain program over n floats. Instead of one pass over
+   memory per instruction, each block of LN_CPU_EW_BLOCK floats is loaded
+   once, runs through the whole program in cache and is stored once.
+   dst may alias any of srcs. */
+void ln_cpu_selew_chain(size_t n, const float *const *srcs, float *dst,
+                        const ln_cpu_ew_inst *prog, int prog_len)
+{
+    float x[LN_CPU_EW_BLOCK], y[LN_CPU_EW_BLOCK];
+    const float *yp;
+    size_t off, len, m;
+    int i;
+
+    for (off = 0; off < n; off += LN_CPU_EW_BLOCK) {
+        len = min(LN_CPU_EW_BLOCK, n - off);
+        m = round_up(len, 4);
+        if (len < m)
+            memset(x + len, 0, sizeof(float) * (m - len));
+        memcpy(x, srcs[0] + off, sizeof(float) * len);
+        for (i = 0; i < prog_len; i++) {
+            yp = NULL;
+            if (prog[i].opcode >= LN_CPU_EW_MUL) {
+                if (prog[i].src < 0) {
+                    yp = x;
+                } else if (len == m) {
+                    yp = srcs[prog[i].src] + off;
+                } else {
+                    memset(y + len, 0, sizeof(float) * (m - len));
+                    memcpy(y, srcs[prog[i].src] + off, sizeof(float) * len);
+                    yp = y;
+                }
+            }
+            ew_exec(&prog[i], x, yp, m);
+        }
+        memcpy(dst + off, x, sizeof(float) * len);
+    }
+}
+
+/* dst[i] = start + i * step */
+void ln_cpu_sarange(size_t n, float *dst, double start, double step)
+{
+    size_t i;
+
+    for (i = 0; i < n; i++)
+        dst[i] = start + i * step;
+}
+
+struct topk_item {
+    float   key;
+    int32_t val;
+    size_t  pos;
+};
+
+/* whether a ranks strictly before b; equal keys keep their input order */
+static inline int topk_before(const struct topk_item *a,
+                              const struct topk_item *b, int descending)
+{
+    if (a->key != b->key)
+        return descending ? a->key > b->key : a->key < b->key;
+    return a->pos < b->pos;
+}
+
+/* restore the heap below i, whose root is the item ranking last */
+static void topk_sift_down(struct topk_item *heap, size_t len, size_t i,
+                           int descending)
+{
+    struct topk_item t = heap[i];
+    size_t c;
+
+    while ((c = 2 * i + 1) < len) {
+        if (c + 1 < len && topk_before(&heap[c], &heap[c + 1], descending))
+            c++;
+        if (!topk_before(&t, &heap[c], descending))
+            break;
+        heap[i] = heap[c];
+        i = c;
+    }
+    heap[i] = t;
+}
+
+/*
+ * Select the k first items of key (by descending or ascending order) with a
+ * bounded heap in O(n log k), then heapsort them into dst_key. val carries a
+ * payload along with each key and may be NULL, in which case dst_val is
+ * ignored. dst_key and dst_val may alias key and val.
+ */
+void ln_cpu_stopk(size_t n, const float *key, const int32_t *val, size_t k,
+                  int descending, float *dst_key, int32_t *dst_val)
+{
+    struct topk_item *heap;
+    struct topk_item t;
+    size_t len, i;
+
+    if (k > n)
+        k = n;
+    if (k == 0)
+        return;
+
+    heap = ln_alloc(sizeof(struct topk_item) * k);
+    for (i = 0; i < k; i++) {
+        heap[i].key = key[i];
+        heap[i].val = val ? val[i] : 0;
+        heap[i].pos = i;
+    }
+    for (i = k / 2; i-- > 0;)
+        topk_sift_down(heap, k, i, descending);
+
+    for (i = k; i < n; i++) {
+        t.key = key[i];
+        t.pos = i;
+        if (!topk_before(&t, &heap[0], descending))
+            continue;
+        t.val = val ? val[i] : 0;
+        heap[0] = t;
+        topk_sift_down(heap, k, 0, descending);
+    }
+
+    for (len = k; len > 1; len--) {
+        t = heap[0];
+        heap[0] = heap[len - 1];
+        heap[len - 1] = t;
+        topk_sift_down(heap, len - 1, 0, descending);
+    }
+
+    for (i = 0; i < k; i++) {
+        dst_key[i] = heap[i].key;
+        if (val)
+            dst_val[i] = heap[i].val;
+    }
+    ln_free(heap);
+}
+
+#define TILE LN_CPU_TRANSPOSE_TILE
+
+/* d[j * ds + i] = s[i * ss + j] for a 4 x 4 block of 32-bit elements */
+static inline void transpose4x4(const uint32_t *s, size_t ss,
+                                uint32_t *d, size_t ds)
+{
+    v4si r0, r1, r2, r3, t0, t1, t2, t3;
+
+    memcpy(&r0, s, sizeof(r0));
+    memcpy(&r1, s + ss, sizeof(r1));
+    memcpy(&r2, s + 2 * ss, sizeof(r2));
+    memcpy(&r3, s + 3 * ss, sizeof(r3));
+    t0 = __builtin_shuffle(r0, r1, (v4si){0, 4, 1, 5});
+    t1 = __builtin_shuffle(r0, r1, (v4si){2, 6, 3, 7});
+    t2 = __builtin_shuffle(r2, r3, (v4si){0, 4, 1, 5});
+    t3 = __builtin_shuffle(r2, r3, (v4si){2, 6, 3, 7});
+    r0 = __builtin_shuffle(t0, t2, (v4si){0, 1, 4, 5});
+    r1 = __builtin_shuffle(t0, t2, (v4si){2, 3, 6, 7});
+    r2 = __builtin_shuffle(t1, t3, (v4si){0, 1, 4, 5});
+    r3 = __builtin_shuffle(t1, t3, (v4si){2, 3, 6, 7});
+    memcpy(d, &r0, sizeof(r0));
+    memcpy(d + ds, &r1, sizeof(r1));
+    memcpy(d + 2 * ds, &r2, sizeof(r2));
+    memcpy(d + 3 * ds, &r3, sizeof(r3));
+}
+
+static void transpose2d_32(const void *src, size_t ss, void *dst, size_t ds,
+                           int rows, int cols)
+{
+    const uint32_t *s = src;
+    uint32_t *d = dst;
+    int i0, j0, i, j, ie, je;
+
+    for (i0 = 0; i0 < rows; i0 += TILE) {
+        ie = min(i0 + TILE, rows);
+        for (j0 = 0; j0 < cols; j0 += TILE) {
+            je = min(j0 + TILE, cols);
+            for (i = i0; i + 4 <= ie; i += 4) {
+                for (j = j0; j + 4 <= je; j += 4)
+                    transpose4x4(s + i * ss + j, ss, d + j * ds + i, ds);
+                for (; j < je; j++) {
+                    d[j * ds + i] = s[i * ss + j];
+                    d[j * ds + i + 1] = s[(i + 1) * ss + j];
+                    d[j * ds + i + 2] = s[(i + 2) * ss + j];
+                    d[j * ds + i + 3] = s[(i + 3) * ss + j];
+                }
+            }
+            for (; i < ie; i++)
+                for (j = j0; j < je; j++)
+                    d[j * ds + i] = s[i * ss + j];
+        }
+    }
+}
+
+#define DEFINE_TRANSPOSE2D(bits)                                        \
+    static void transpose2d_##bits(const void *src, size_t ss,          \
+                                   void *dst, size_t ds,                \
+                                   int rows, int cols)                  \
+    {                                                                   \
+        const uint##bits##_t *s = src;                                  \
+        uint##bits##_t *d = dst;                                        \
+        int i0, j0, i, j, ie, je;                                       \
+                                                                        \
+        for (i0 = 0; i0 < rows; i0 += TILE) {                           \
+            ie = min(i0 + TILE, rows);                                  \
+            for (j0 = 0; j0 < cols; j0 += TILE) {                       \
+                je = min(j0 + TILE, cols);                              \
+                for (i = i0; i < ie; i++)                               \
+                    for (j = j0; j < je; j++)                           \
+                        d[j * ds + i] = s[i * ss + j];                  \
+            }                                                           \
+        }                                                               \
+    }
+
+DEFINE_TRANSPOSE2D(8)
+DEFINE_TRANSPOSE2D(16)
+DEFINE_TRANSPOSE2D(64)
+
+#undef DEFINE_TRANSPOSE2D
+#undef TILE
+
+typedef void (*transpose2d_func)(const void *src, size_t ss, void *dst,
+                                 size_t ds, int rows, int cols);
+
+/*
+ * Permute a tensor of `dims` so that dst's dimension i is src's dimension
+ * axes[i]. Size-1 dimensions are dropped and dimensions that stay adjacent
+ * are merged first, so that e.g. NCHW -> NHWC becomes a batch of [C, HW]
+ * matrix transposes. Those go through cache-sized tiles, with 4 x 4 in-register
+ * transposes for 32-bit elements. If the innermost dimension doesn't move,
+ * rows are copied as they are.
+ */
+void ln_cpu_transpose(const void *src, void *dst, int ndim, const int *dims,
+                      const int *axes, size_t size)
+{
+    int map[LN_CPU_MAXDIM], p[LN_CPU_MAXDIM], run[LN_CPU_MAXDIM];
+    int d[LN_CPU_MAXDIM], e[LN_CPU_MAXDIM], outer[LN_CPU_MAXDIM];
+    int idx[LN_CPU_MAXDIM];
+    size_t ss[LN_CPU_MAXDIM], ds[LN_CPU_MAXDIM];
+    size_t total, soff, doff, stride;
+    size_t inner = 0;
+    transpose2d_func func = NULL;
+    int n, m, nouter, a, b;
+    int i, j;
+
+    assert(ndim <= LN_CPU_MAXDIM);
+
+    /* drop size-1 dimensions */
+    total = 1;
+    for (i = 0, n = 0; i < ndim; i++) {
+        total *= dims[i];
+        map[i] = dims[i] == 1 ? -1 : n++;
+    }
+    for (i = 0, m = 0; i < ndim; i++) {
+        if (map[axes[i]] >= 0)
+            p[m++] = map[axes[i]];
+    }
+    for (i = 0, j = 0; i < ndim; i++) {
+        if (dims[i] != 1)
+            d[j++] = dims[i];
+    }
+
+    /* merge src dimensions that stay adjacent in dst */
+    for (i = 0; i < n; i++)
+        run[i] = 1;             /* 1 if src dimension i starts a new run */
+    for (i = 1; i < n; i++) {
+        if (p[i] == p[i - 1] + 1)
+            run[p[i]] = 0;
+    }
+    for (i = 0, j = -1; i < n; i++) {
+        if (run[i]) {
+            d[++j] = d[i];
+            map[i] = j;
+        } else {
+            d[j] *= d[i];
+        }
+    }
+    for (i = 0, m = 0; i < n; i++) {
+        if (run[p[i]])
+            p[m++] = map[p[i]];
+    }
+    n = m;
+
+    if (n <= 1) {
+        memmove(dst, src, total * size);
+        return;
+    }
+
+    for (i = n - 1, stride = 1; i >= 0; i--) {
+        ss[i] = stride;
+        stride *= d[i];
+    }
+    for (i = n - 1, stride = 1; i >= 0; i--) {
+        e[i] = d[p[i]];
+        ds[i] = stride;
+        stride *= e[i];
+    }
+
+    b = n - 1;
+    for (a = 0; p[a] != n - 1; a++)
+        ;
+    if (a == b) {
+        inner = (size_t)e[b] * size;
+    } else {
+        switch (size) {
+        case 1: func = transpose2d_8; break;
+        case 2: func = transpose2d_16; break;
+        case 4: func = transpose2d_32; break;
+        case 8: func = transpose2d_64; break;
+        default:
+            ln_msg_inter_error("unsupported element size %zu", size);
+        }
+    }
+
+    for (i = 0, nouter = 0, total = 1; i < n; i++) {
+        if (i == a || i == b)
+            continue;
+        outer[nouter++] = i;
+        total *= e[i];
+    }
+    memset(idx, 0, sizeof(idx));
+    while (total--) {
+        soff = doff = 0;
+        for (i = 0; i < nouter; i++) {
+            soff += idx[i] * ss[p[outer[i]]];
+            doff += idx[i] * ds[outer[i]];
+        }
+        if (a == b)
+            memmove((char *)dst + doff * size, (const char *)src + soff * size,
+                    inner);
+        else
+            func((const char *)src + soff * size, ss[p[b]],
+                 (char *)dst + doff * size, ds[a], e[b], e[a]);
+        for (i = nouter - 1; i >= 0; i--) {
+            if (++idx[i] < e[outer[i]])
+                break;
+            idx[i] = 0;
+        }
+    }
+}
+
+/* Unfold a [channel, height, width] image into a
+   [channel * size[0] * size[1], out_height * out_width] matrix. */
+void ln_cpu_im2col(const float *src, int channel, int height, int width,
+                   const int *size, const int *stride, const int *padding,
+                   const int *dilation, int out_height, int out_width,
+                   float *col)
+{
+    int c, kh, kw, oy, ox, iy, ix;
+    const float *src_c;
+    float *dst;
+
+    for (c = 0; c < channel; c++) {
+        src_c = src + (size_t)c * height * width;
+        for (kh = 0; kh < size[0]; kh++) {
+            for (kw = 0; kw < size[1]; kw++) {
+                for (oy = 0; oy < out_height; oy++) {
+                    dst = col + (size_t)out_height * out_width *
+                        ((c * size[0] + kh) * size[1] + kw) +
+                        (size_t)oy * out_width;
+                    iy = oy * stride[0] - padding[0] + kh * dilation[0];
+                    if (iy < 0 || iy >= height) {
+                        memset(dst, 0, sizeof(float) * out_width);
+                        continue;
+                    }
+                    for (ox = 0; ox < out_width; ox++) {
+                        ix = ox * stride[1] - padding[1] + kw * dilation[1];
+                        dst[ox] = ix < 0 || ix >= width ?
+                            0 : src_c[(size_t)iy * width + ix];
+                    }
+                }
+            }
+        }
+    }
+}
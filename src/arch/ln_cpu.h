@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2018-2020 Zhixu Zhao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _LN_CPU_H_
+#define _LN_CPU_H_
+
+#include "ln_util.h"
+
+/*
+ * Blocking parameters of the packed-panel SGEMM. A micro-kernel computes an
+ * MR x NR tile of C kept in registers; an MC x KC block of A is packed to stay
+ * in L2 and a KC x NR panel of B to stay in L1.
+ */
+#define LN_CPU_SGEMM_MR 4
+#define LN_CPU_SGEMM_NR 8
+#define LN_CPU_SGEMM_MC 128
+#define LN_CPU_SGEMM_KC 256
+#define LN_CPU_SGEMM_NC 4096
+
+/* problems with fewer multiply-adds than this run single-threaded */
+#define LN_CPU_SGEMM_MT_THRESHOLD (1 << 20)
+
+/* alignment of CPU tensors, a cache line and the widest SIMD register */
+#define LN_CPU_ALIGN_SIZE 64
+
+/* CPU arenas at least this large are backed by transparent hugepages */
+#define LN_CPU_HUGEPAGE_THRESHOLD (4 << 20)
+#define LN_CPU_HUGEPAGE_SIZE (2 << 20)
+
+/* environment variable to override the number of worker threads */
+#define LN_CPU_NUM_THREADS_ENV "LN_NUM_THREADS"
+
+/* max number of dimensions ln_cpu_transpose() handles */
+#define LN_CPU_MAXDIM 8
+
+/* side of the square tiles ln_cpu_transpose() works on, in elements */
+#define LN_CPU_TRANSPOSE_TILE 32
+
+/* number of floats an elementwise chain evaluates at a time, kept in L1 */
+#define LN_CPU_EW_BLOCK 512
+
+/*
+ * Opcodes of an elementwise chain program. Every instruction updates the
+ * accumulator x, which starts as srcs[0]. Binary opcodes take their other
+ * operand from srcs[src], or from x itself if src is -1; the R* variants
+ * swap the operands. LRELU uses imm as its negative slope.
+ */
+enum ln_cpu_ew_opcode {
+    LN_CPU_EW_RELU = 0,
+    LN_CPU_EW_LRELU,
+    LN_CPU_EW_SIGMOID,
+    LN_CPU_EW_MUL,
+    LN_CPU_EW_DIV,
+    LN_CPU_EW_ADD,
+    LN_CPU_EW_SUB,
+    LN_CPU_EW_MAX,
+    LN_CPU_EW_MIN,
+    LN_CPU_EW_POW,
+    LN_CPU_EW_RDIV,
+    LN_CPU_EW_RSUB,
+    LN_CPU_EW_RPOW,
+    LN_CPU_EW_OPCODE_SIZE
+};
+typedef enum ln_cpu_ew_opcode ln_cpu_ew_opcode;
+
+struct ln_cpu_ew_inst {
+    ln_cpu_ew_opcode opcode;
+    int              src;
+    float            imm;
+};
+typedef struct ln_cpu_ew_inst ln_cpu_ew_inst;
+
+typedef void (*ln_cpu_parallel_func)(void *arg, int id, int n);
+
+#ifdef __cplusplus
+LN_CPPSTART
+#endif
+
+void *ln_alloc_cpu(size_t size);
+void ln_free_cpu(void *p);
+int ln_cpu_num_threads(void);
+void ln_cpu_run_parallel(int n, ln_cpu_parallel_func func, void *arg);
+size_t ln_cpu_sgemm_pack_b_size(int k, int n);
+void ln_cpu_sgemm_pack_b(int k, int n, const float *b, int rsb, int csb,
+                         float *packed_b);
+void ln_cpu_sgemm_packed(int m, int n, int k, float alpha,
+                         const float *a, int rsa, int csa,
+                         const float *packed_b, float beta,
+                         float *c, int rsc, int csc);
+void ln_cpu_sgemm(int m, int n, int k, float alpha,
+                  const float *a, int rsa, int csa,
+                  const float *b, int rsb, int csb, float beta,
+                  float *c, int rsc, int csc);
+float ln_cpu_sdot(size_t n, const float *x, const float *y);
+void ln_cpu_slrelu(size_t n, const float *src, float *dst, float negslope);
+void ln_cpu_ssigmoid(size_t n, const float *src, float *dst);
+void ln_cpu_selew_chain(size_t n, const float *const *srcs, float *dst,
+                        const ln_cpu_ew_inst *prog, int prog_len);
+void ln_cpu_sbatchnorm(const float *src, float *dst, int batch, int channel,
+                       size_t spatial, const float *scale, const float *offset,
+                       const float *mean, const float *var, float epsilon);
+void ln_cpu_sarange(size_t n, float *dst, double start, double step);
+void ln_cpu_stopk(size_t n, const float *key, const int32_t *val, size_t k,
+                  int descending, float *dst_key, int32_t *dst_val);
+void ln_cpu_transpose(const void *src, void *dst, int ndim, const int *dims,
+                      const int *axes, size_t size);
+void ln_cpu_im2col(const float *src, int channel, int height, int width,
+                   const int *size, const int *stride, const int *padding,
+                   const int *dilation, int out_height, int out_width,
+                   float *col);
+
+#ifdef __cplusplus
+LN_CPPEND
+#endif
+
+#endif  /* _LN_CPU_H_ */
@@ -20,6 +20,7 @@
  * SOFTWARE.
  */
 
+#include <pthread.h>
 #include "ln_util.h"
 #include "ln_tensor.h"
 #include "ln_msg.h"
@@ -41,6 +42,49 @@ void ln_cudnn_context_free(ln_cudnn_context *context)
     ln_free(context);
 }
 
+/* cuDNN handles shouldn't be shared by threads, so each thread running
+   cudnn ops gets its own, freed when the thread exits. */
+static pthread_key_t context_key;
+static pthread_once_t context_key_once = PTHREAD_ONCE_INIT;
+
+static void free_context(void *context)
+{
+    ln_cudnn_context_free(context);
+}
+
+static void init_context_key(void)
+{
+    if (pthread_key_create(&context_key, free_context))
+        ln_msg_error("can't create the thread-specific key of cudnn contexts");
+}
+
+/* Return the calling thread's cudnn context, creating it on first use. */
+ln_cudnn_context *ln_cudnn_context_get(void)
+{
+    ln_cudnn_context *context;
+
+    pthread_once(&context_key_once, init_context_key);
+    context = pthread_getspecific(context_key);
+    if (!context) {
+        context = ln_cudnn_context_create();
+        pthread_setspecific(context_key, context);
+    }
+    return context;
+}
+
+/* Free the calling thread's cudnn context now, if it has one. */
+void ln_cudnn_context_release(void)
+{
+    ln_cudnn_context *context;
+
+    pthread_once(&context_key_once, init_context_key);
+    context = pthread_getspecific(context_key);
+    if (!context)
+        return;
+    pthread_setspecific(context_key, NULL);
+    ln_cudnn_context_free(context);
+}
+
 cudnnDataType_t ln_cudnn_datatype(tl_dtype dtype)
 {
     cudnnDataType_t ret = CUDNN_DATA_FLOAT;
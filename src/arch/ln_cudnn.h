@@ -45,6 +45,8 @@ LN_CPPSTART
 
 ln_cudnn_context *ln_cudnn_context_create(void);
 void ln_cudnn_context_free(ln_cudnn_context *context);
+ln_cudnn_context *ln_cudnn_context_get(void);
+void ln_cudnn_context_release(void);
 cudnnDataType_t ln_cudnn_datatype(tl_dtype dtype);
 cudnnTensorDescriptor_t ln_cudnn_tensor_nchw_init(tl_tensor *tensor);
 void ln_cudnn_tensor_cleanup(cudnnTensorDescriptor_t desc);
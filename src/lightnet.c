@@ -27,21 +27,38 @@ int main(int argc, char **argv)
     ln_context *ctx;
     ln_option *option;
     double time;
+    size_t bytes;
 
     option = ln_option_create(argc, argv);
     ln_msg_init(option);
     ln_arch_init();
     ctx = ln_context_create();
     ln_context_init(ctx, option->source);
+    if (option->batch)
+        ln_context_set_batch(ctx, option->inputs, option->batch);
+    if (option->mem_align)
+        ln_context_set_mem_align(ctx, option->mem_align);
 
     if (option->compile) {
+        if (option->time_passes || option->debug)
+            ln_context_set_time_passes(ctx, 1);
         ln_context_compile(ctx, option->target, option->datafile);
         if (!ln_streq(option->outfile, "!"))
             ln_context_print(ctx, option->outfile);
     }
+    if (option->mem_report)
+        ln_context_print_mem_plan(ctx, option->mem_report);
 
     if (option->run) {
+        if (option->load_threads)
+            ln_context_set_load_threads(ctx, option->load_threads);
+        if (option->verify_weights)
+            ln_context_set_verify_weights(ctx, 1);
+        if (option->lazy_weights)
+            ln_context_set_lazy_weights(ctx, 1);
         ln_context_load(ctx, option->datafile);
+        if ((bytes = ln_context_loaded_bytes(ctx, &time)))
+            ln_msg_info("load time: %fs (%.2f MB/s)", time, bytes / 1e6 / time);
         LN_TIMEIT_START;
         ln_context_run(ctx);
         LN_TIMEIT_END(&time);
@@ -20,6 +20,7 @@
  * SOFTWARE.
  */
 
+#include <pthread.h>
 #include "ln_arch.h"
 
 extern ln_arch ln_archimpl_none;
@@ -61,11 +62,22 @@ static ln_arch *archs[] = {
 
 ln_arch_info ln_global_arch_info;
 
+/* LN_ARCH is only written by the first ln_arch_init() and the last
+   ln_arch_cleanup(), and read-only for contexts in between. */
+static pthread_mutex_t arch_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int arch_refcount = 0;
+
 LN_EXPORT void ln_arch_init(void)
 {
     ln_op *op;
     int ret;
 
+    pthread_mutex_lock(&arch_mutex);
+    if (arch_refcount++ > 0) {
+        pthread_mutex_unlock(&arch_mutex);
+        return;
+    }
+
     LN_ARCH.arch_table = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
     LN_ARCH.op_proto_table = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
 
@@ -84,10 +96,17 @@ LN_EXPORT void ln_arch_init(void)
                                    op->op_arg->optype);
         }
     }
+    pthread_mutex_unlock(&arch_mutex);
 }
 
 LN_EXPORT void ln_arch_cleanup(void)
 {
+    pthread_mutex_lock(&arch_mutex);
+    if (arch_refcount == 0 || --arch_refcount > 0) {
+        pthread_mutex_unlock(&arch_mutex);
+        return;
+    }
+
     for (int i = 0; archs[i]; i++) {
         if (archs[i]->cleanup_func)
             archs[i]->cleanup_func(&archs[i]->priv);
@@ -95,4 +114,7 @@ LN_EXPORT void ln_arch_cleanup(void)
 
     ln_hash_free(LN_ARCH.arch_table);
     ln_hash_free(LN_ARCH.op_proto_table);
+    LN_ARCH.arch_table = NULL;
+    LN_ARCH.op_proto_table = NULL;
+    pthread_mutex_unlock(&arch_mutex);
 }
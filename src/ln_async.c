@@ -0,0 +1,247 @@
+/*
+ * Copyright (c) 2018-2020 Zhixu Zhao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <assert.h>
+#include <pthread.h>
+#include "ln_async.h"
+
+/*
+ * A worker thread runs the submitted runs of a context in order. The data of
+ * the context's inputs is staged: ln_async_set_data() writes a copy in the
+ * stage being filled, which the worker copies to the input tensors right
+ * before the run it was submitted with. So the next frame can be set while
+ * the current one is run. Callbacks run on the worker between the runs, where
+ * the context is used synchronously: input data is set without staging.
+ */
+
+struct stage {
+    void           **bufs;      /* staged data of each input */
+    int             *set;       /* whether an input is set in this stage */
+    int              busy;      /* submitted and not copied to the inputs */
+    ln_run_callback  callback;
+    void            *data;
+};
+
+struct ln_async {
+    ln_context      *ctx;
+    pthread_t        thread;
+    pthread_mutex_t  mutex;
+    pthread_cond_t   cond;
+    char           **inputs;
+    size_t          *sizes;
+    int              n_inputs;
+    struct stage     stages[LN_ASYNC_NSTAGES];
+    int              fill;      /* the stage set_data writes in */
+    int              head;      /* the next stage to run */
+    int              n_queued;  /* stages submitted but not started */
+    int              n_pending; /* runs submitted but not finished */
+    int              quit;
+};
+
+static void copy_in(ln_async *async, struct stage *stage)
+{
+    ln_tensor_entry *te;
+    ln_copy_func copy;
+    int i;
+
+    for (i = 0; i < async->n_inputs; i++) {
+        if (!stage->set[i])
+            continue;
+        te = ln_tensor_table_find(async->ctx->tensor_table, async->inputs[i]);
+        copy = ln_mem_type_copy_func(te->mtype, LN_MEM_CPU);
+        copy(te->tensor->data, stage->bufs[i], async->sizes[i]);
+        ln_tensor_table_find_root(async->ctx->tensor_table,
+                                  async->inputs[i])->dirty = 1;
+        stage->set[i] = 0;
+    }
+}
+
+static void *worker(void *arg)
+{
+    ln_async *async = arg;
+    struct stage *stage;
+    ln_run_callback callback;
+    void *data;
+
+    for (;;) {
+        pthread_mutex_lock(&async->mutex);
+        while (async->n_queued == 0 && !async->quit)
+            pthread_cond_wait(&async->cond, &async->mutex);
+        if (async->n_queued == 0) {
+            pthread_mutex_unlock(&async->mutex);
+            break;
+        }
+        stage = &async->stages[async->head];
+        pthread_mutex_unlock(&async->mutex);
+
+        copy_in(async, stage);
+        callback = stage->callback;
+        data = stage->data;
+
+        pthread_mutex_lock(&async->mutex);
+        stage->busy = 0;
+        async->head = (async->head + 1) % LN_ASYNC_NSTAGES;
+        async->n_queued--;
+        pthread_cond_broadcast(&async->cond);
+        pthread_mutex_unlock(&async->mutex);
+
+        ln_context_run_steps(async->ctx);
+        if (callback)
+            callback(async->ctx, data);
+
+        pthread_mutex_lock(&async->mutex);
+        async->n_pending--;
+        pthread_cond_broadcast(&async->cond);
+        pthread_mutex_unlock(&async->mutex);
+    }
+    return NULL;
+}
+
+/* The context should be loaded. Its inputs are those in `ctx->inputs`. */
+ln_async *ln_async_create(ln_context *ctx)
+{
+    ln_async *async;
+    char *names, *name, *saveptr;
+    int i, s;
+
+    async = ln_alloc(sizeof(ln_async));
+    async->ctx = ctx;
+    if (ctx->inputs) {
+        names = ln_strdup(ctx->inputs);
+        for (name = strtok_r(names, ",", &saveptr); name;
+             name = strtok_r(NULL, ",", &saveptr)) {
+            i = async->n_inputs++;
+            async->inputs = ln_realloc(async->inputs,
+                                       sizeof(char *) * async->n_inputs);
+            async->sizes = ln_realloc(async->sizes,
+                                      sizeof(size_t) * async->n_inputs);
+            async->inputs[i] = ln_strdup(name);
+            async->sizes[i] = ln_context_data_size(ctx, name);
+        }
+        ln_free(names);
+    }
+    for (s = 0; s < LN_ASYNC_NSTAGES; s++) {
+        async->stages[s].bufs = ln_alloc(sizeof(void *) * (async->n_inputs + 1));
+        async->stages[s].set = ln_alloc(sizeof(int) * (async->n_inputs + 1));
+        for (i = 0; i < async->n_inputs; i++)
+            async->stages[s].bufs[i] = ln_alloc(async->sizes[i]);
+    }
+
+    pthread_mutex_init(&async->mutex, NULL);
+    pthread_cond_init(&async->cond, NULL);
+    if (pthread_create(&async->thread, NULL, worker, async))
+        ln_msg_error_sys("cannot create the worker thread of ln_context_run_async()");
+    return async;
+}
+
+/* Finish the submitted runs and free `async`. */
+void ln_async_free(ln_async *async)
+{
+    int i, s;
+
+    pthread_mutex_lock(&async->mutex);
+    async->quit = 1;
+    pthread_cond_broadcast(&async->cond);
+    pthread_mutex_unlock(&async->mutex);
+    pthread_join(async->thread, NULL);
+    pthread_mutex_destroy(&async->mutex);
+    pthread_cond_destroy(&async->cond);
+
+    for (s = 0; s < LN_ASYNC_NSTAGES; s++) {
+        for (i = 0; i < async->n_inputs; i++)
+            ln_free(async->stages[s].bufs[i]);
+        ln_free(async->stages[s].bufs);
+        ln_free(async->stages[s].set);
+    }
+    for (i = 0; i < async->n_inputs; i++)
+        ln_free(async->inputs[i]);
+    ln_free(async->inputs);
+    ln_free(async->sizes);
+    ln_free(async);
+}
+
+/*
+ * Submit a run with the stage being filled, and start filling the next one,
+ * waiting for it to be free. `callback` is called with `data` on the worker
+ * thread after the run, before the next run starts.
+ */
+void ln_async_submit(ln_async *async, ln_run_callback callback, void *data)
+{
+    struct stage *stage;
+
+    pthread_mutex_lock(&async->mutex);
+    stage = &async->stages[async->fill];
+    while (stage->busy)
+        pthread_cond_wait(&async->cond, &async->mutex);
+    stage->busy = 1;
+    stage->callback = callback;
+    stage->data = data;
+    async->fill = (async->fill + 1) % LN_ASYNC_NSTAGES;
+    async->n_queued++;
+    async->n_pending++;
+    pthread_cond_broadcast(&async->cond);
+    pthread_mutex_unlock(&async->mutex);
+}
+
+/* Wait for all the submitted runs to finish. A no-op on the worker thread,
+   i.e. in callbacks, where no run is going on. */
+void ln_async_wait(ln_async *async)
+{
+    if (ln_async_in_worker(async))
+        return;
+    pthread_mutex_lock(&async->mutex);
+    while (async->n_pending > 0)
+        pthread_cond_wait(&async->cond, &async->mutex);
+    pthread_mutex_unlock(&async->mutex);
+}
+
+/* Whether the calling thread is the worker, i.e. in a callback. */
+int ln_async_in_worker(const ln_async *async)
+{
+    return pthread_equal(pthread_self(), async->thread);
+}
+
+/* Stage `data` of input `tname` for the next submitted run. Return 0 if
+   `tname` is not an input, or in a callback. */
+int ln_async_set_data(ln_async *async, const char *tname, const void *data)
+{
+    struct stage *stage;
+    int i;
+
+    if (ln_async_in_worker(async))
+        return 0;
+    for (i = 0; i < async->n_inputs; i++) {
+        if (ln_streq(async->inputs[i], tname))
+            break;
+    }
+    if (i == async->n_inputs)
+        return 0;
+
+    pthread_mutex_lock(&async->mutex);
+    stage = &async->stages[async->fill];
+    while (stage->busy)
+        pthread_cond_wait(&async->cond, &async->mutex);
+    pthread_mutex_unlock(&async->mutex);
+    memmove(stage->bufs[i], data, async->sizes[i]);
+    stage->set[i] = 1;
+    return 1;
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2018-2020 Zhixu Zhao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _LN_ASYNC_H_
+#define _LN_ASYNC_H_
+
+#include "ln_context.h"
+
+/* number of input stages, one being filled while the other is run */
+#define LN_ASYNC_NSTAGES 2
+
+#ifdef __cplusplus
+LN_CPPSTART
+#endif
+
+ln_async *ln_async_create(ln_context *ctx);
+void ln_async_free(ln_async *async);
+void ln_async_submit(ln_async *async, ln_run_callback callback, void *data);
+void ln_async_wait(ln_async *async);
+int ln_async_in_worker(const ln_async *async);
+int ln_async_set_data(ln_async *async, const char *tname, const void *data);
+
+#ifdef __cplusplus
+LN_CPPEND
+#endif
+
+#endif  /* _LN_ASYNC_H_ */
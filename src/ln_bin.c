@@ -0,0 +1,569 @@
+/*
+ * Copyright (c) 2018-2020 Zhixu Zhao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include "ln_bin.h"
+
+/*
+ * Layout of a binary IR file. Integers are little-endian, offsets are from
+ * the start of the file, and records are 8-byte aligned, so that the file is
+ * read into one buffer and walked in place without building a tree.
+ *
+ *   struct bin_header
+ *   uint64_t mem_sizes[mem_type_count], uint64_t weight_sizes[mem_type_count]
+ *   uint32_t op_offsets[op_count]
+ *   for each op: struct bin_op, n_in + n_out struct bin_tensor,
+ *                n_params struct bin_param, then the values of array params
+ *   string table of deduplicated null-terminated strings
+ *
+ * Strings are referred to by their offsets in the string table, or BIN_NOSTR
+ * for NULL.
+ */
+#define BIN_NOSTR 0xffffffffU
+#define BIN_ALIGN 8
+
+#define PARSE_ERROR(fmt, varg...) ln_msg_error("binary IR parse error: "fmt, ##varg)
+#define PRINT_ERROR(fmt, varg...) ln_msg_error("ln_bin_create() failed: "fmt, ##varg)
+
+struct bin_header {
+    char     magic[LN_BIN_MAGIC_LEN];
+    uint32_t version;
+    uint32_t op_count;
+    uint32_t mem_type_count;
+    uint32_t inputs;
+    uint32_t ops;               /* offset of op_offsets */
+    uint32_t strtab;
+    uint32_t strtab_size;
+    uint32_t reserved;
+};
+
+struct bin_op {
+    uint32_t name;
+    uint32_t optype;
+    uint32_t n_in;
+    uint32_t n_out;
+    uint32_t n_params;
+    uint32_t reserved;
+};
+
+struct bin_tensor {
+    uint32_t arg_name;
+    uint32_t name;
+    uint64_t offset;
+};
+
+struct bin_param {
+    uint32_t arg_name;
+    int32_t  type;
+    uint32_t array_len;
+    uint32_t reserved;
+    union {
+        double   number;
+        uint32_t boolean;
+        uint32_t string;
+        uint64_t array;         /* offset of double, uint32_t bool or
+                                   uint32_t string values */
+    } value;
+};
+
+struct reader {
+    const char *buf;
+    size_t      size;
+    const char *strtab;
+    uint32_t    strtab_size;
+};
+
+static const void *get(const struct reader *r, uint64_t offset, uint64_t len,
+                       const char *what)
+{
+    if (offset > r->size || len > r->size - offset)
+        PARSE_ERROR("%s at offset %lu is out of range", what,
+                    (unsigned long)offset);
+    return r->buf + offset;
+}
+
+static const void *get_aligned(const struct reader *r, uint64_t offset,
+                               uint64_t len, const char *what)
+{
+    if (offset % BIN_ALIGN)
+        PARSE_ERROR("%s at offset %lu is not aligned", what,
+                    (unsigned long)offset);
+    return get(r, offset, len, what);
+}
+
+static const char *get_str(const struct reader *r, uint32_t ref)
+{
+    if (ref == BIN_NOSTR)
+        return NULL;
+    if (ref >= r->strtab_size)
+        PARSE_ERROR("string %u is out of range", ref);
+    return r->strtab + ref;
+}
+
+static const char *get_name(const struct reader *r, uint32_t ref,
+                            const char *what)
+{
+    const char *str;
+
+    if (!(str = get_str(r, ref)))
+        PARSE_ERROR("%s is NULL", what);
+    return str;
+}
+
+static ln_list *parse_param(const struct reader *r, const struct bin_param *bp,
+                            const char *op_name, ln_list *params)
+{
+    const char *arg_name;
+    const double *numbers;
+    const uint32_t *values;
+    ln_bool *bools;
+    const char **strings;
+    uint32_t i, len;
+
+    arg_name = get_name(r, bp->arg_name, "param arg_name");
+    len = bp->array_len;
+    switch (bp->type) {
+    case LN_PARAM_NULL:
+        return ln_param_list_append_null(params, arg_name);
+    case LN_PARAM_STRING:
+        return ln_param_list_append_string(params, arg_name,
+                                           get_name(r, bp->value.string,
+                                                    "param value"));
+    case LN_PARAM_NUMBER:
+        return ln_param_list_append_number(params, arg_name, bp->value.number);
+    case LN_PARAM_BOOL:
+        return ln_param_list_append_bool(params, arg_name,
+                                         bp->value.boolean ? LN_TRUE : LN_FALSE);
+    case LN_PARAM_ARRAY_STRING:
+    case LN_PARAM_ARRAY_NUMBER:
+    case LN_PARAM_ARRAY_BOOL:
+        if (len == 0 || len > INT32_MAX)
+            PARSE_ERROR("op %s's param %s's value has a bad length %u",
+                        op_name, arg_name, len);
+        break;
+    default:
+        PARSE_ERROR("op %s's param %s has an unsupported type %d",
+                    op_name, arg_name, bp->type);
+        break;
+    }
+
+    if (bp->type == LN_PARAM_ARRAY_NUMBER) {
+        numbers = get_aligned(r, bp->value.array, (uint64_t)len * sizeof(double),
+                              "param value");
+        return ln_param_list_append_array_number(params, arg_name, len,
+                                                 numbers);
+    }
+
+    values = get_aligned(r, bp->value.array, (uint64_t)len * sizeof(uint32_t),
+                         "param value");
+    if (bp->type == LN_PARAM_ARRAY_BOOL) {
+        bools = ln_alloc(sizeof(ln_bool) * len);
+        for (i = 0; i < len; i++)
+            bools[i] = values[i] ? LN_TRUE : LN_FALSE;
+        params = ln_param_list_append_array_bool(params, arg_name, len, bools);
+        ln_free(bools);
+    } else {
+        strings = ln_alloc(sizeof(char *) * len);
+        for (i = 0; i < len; i++)
+            strings[i] = get_name(r, values[i], "param value");
+        params = ln_param_list_append_array_string(params, arg_name, len,
+                                                   strings);
+        ln_free(strings);
+    }
+
+    return params;
+}
+
+static ln_list *parse_tensors(const struct reader *r,
+                              const struct bin_tensor *bts, uint32_t n)
+{
+    ln_list *tensors = NULL;
+    ln_tensor_list_entry *tle;
+
+    while (n--) {
+        tle = ln_tensor_list_entry_create(
+            get_name(r, bts[n].arg_name, "tensor arg_name"),
+            get_name(r, bts[n].name, "tensor name"));
+        tle->offset = bts[n].offset;
+        tensors = ln_list_prepend(tensors, tle);
+    }
+
+    return tensors;
+}
+
+static ln_op *parse_op(const struct reader *r, uint64_t offset, ln_context *ctx,
+                       int idx)
+{
+    const struct bin_op *bop;
+    const struct bin_tensor *bts;
+    const struct bin_param *bps;
+    const char *name, *optype;
+    ln_list *tensors_in, *tensors_out;
+    ln_list *params = NULL;
+    ln_op *proto_op;
+    uint64_t n_tensors;
+
+    bop = get_aligned(r, offset, sizeof(*bop), "op");
+    if (!(name = get_str(r, bop->name)))
+        PARSE_ERROR("ops[%d] doesn't have a name", idx);
+    optype = get_name(r, bop->optype, "op optype");
+    offset += sizeof(*bop);
+    n_tensors = (uint64_t)bop->n_in + bop->n_out;
+    bts = get_aligned(r, offset, n_tensors * sizeof(*bts), "op tensors");
+    offset += n_tensors * sizeof(*bts);
+    bps = get_aligned(r, offset, (uint64_t)bop->n_params * sizeof(*bps),
+                      "op params");
+
+    tensors_in = parse_tensors(r, bts, bop->n_in);
+    tensors_out = parse_tensors(r, bts + bop->n_in, bop->n_out);
+    for (uint32_t i = 0; i < bop->n_params; i++)
+        params = parse_param(r, &bps[i], name, params);
+
+    proto_op = ln_hash_find(LN_ARCH.op_proto_table, optype);
+    if (!proto_op)
+        PARSE_ERROR("op %s's optype %s is not registered", name, optype);
+
+    return ln_op_create_from_proto(proto_op, name, tensors_in, tensors_out,
+                                   params, ctx->tensor_table);
+}
+
+ln_list *ln_bin_parse(const void *buf, size_t size, ln_context *ctx)
+{
+    struct reader r;
+    const struct bin_header *header;
+    const uint64_t *sizes;
+    const uint32_t *op_offsets;
+    const char *inputs;
+    ln_list *ops = NULL;
+    uint32_t i;
+
+    r.buf = buf;
+    r.size = size;
+    header = get(&r, 0, sizeof(*header), "header");
+    if (memcmp(header->magic, LN_BIN_MAGIC, LN_BIN_MAGIC_LEN))
+        PARSE_ERROR("bad magic number");
+    if (header->version != LN_BIN_VERSION)
+        PARSE_ERROR("unsupported version %u", header->version);
+    r.strtab = get(&r, header->strtab, header->strtab_size, "string table");
+    r.strtab_size = header->strtab_size;
+    if (r.strtab_size && r.strtab[r.strtab_size - 1] != '\0')
+        PARSE_ERROR("the string table is not null-terminated");
+
+    if (header->mem_type_count) {
+        if (header->mem_type_count != LN_MEM_TYPE_SIZE)
+            PARSE_ERROR("the number of memory types %u is not equal to LN_MEM_TYPE_SIZE %d",
+                        header->mem_type_count, LN_MEM_TYPE_SIZE);
+        sizes = get_aligned(&r, sizeof(*header),
+                            sizeof(uint64_t) * 2 * LN_MEM_TYPE_SIZE,
+                            "memory sizes");
+        for (i = 0; i < LN_MEM_TYPE_SIZE; i++) {
+            ctx->mem_sizes[i] = sizes[i];
+            ctx->weight_sizes[i] = sizes[LN_MEM_TYPE_SIZE + i];
+        }
+    }
+    if ((inputs = get_str(&r, header->inputs))) {
+        ln_free(ctx->inputs);
+        ctx->inputs = ln_strdup(inputs);
+    }
+
+    op_offsets = get(&r, header->ops, (uint64_t)header->op_count *
+                     sizeof(uint32_t), "op table");
+    for (i = 0; i < header->op_count; i++)
+        ops = ln_list_prepend(ops, parse_op(&r, op_offsets[i], ctx, i));
+    ops = ln_list_reverse(ops);
+
+    ctx->ops = ops;
+    return ops;
+}
+
+ln_list *ln_bin_parse_file(const char *file, ln_context *ctx)
+{
+    FILE *fp;
+    void *buf;
+    long size;
+    ln_list *ops;
+
+    if (!(fp = fopen(file, "rb")))
+        ln_msg_error_sys("ln_bin_parse_file(): cannot open %s", file);
+    if (fseek(fp, 0, SEEK_END) < 0)
+        ln_msg_error_sys("ln_bin_parse_file(): cannot seek %s", file);
+    size = ftell(fp);
+    if (size < 0 || fseek(fp, 0, SEEK_SET) < 0)
+        ln_msg_error_sys("ln_bin_parse_file(): cannot seek %s", file);
+    buf = ln_alloc(size);
+    if (fread(buf, 1, size, fp) != (size_t)size)
+        ln_msg_error_sys("ln_bin_parse_file(): cannot read %s", file);
+    fclose(fp);
+
+    ops = ln_bin_parse(buf, size, ctx);
+    ln_free(buf);
+
+    return ops;
+}
+
+/* Whether `file` starts with LN_BIN_MAGIC. Standard input ("-") is never. */
+int ln_bin_is_bin_file(const char *file)
+{
+    FILE *fp;
+    char magic[LN_BIN_MAGIC_LEN];
+    int ret = 0;
+
+    if (ln_streq(file, "-"))
+        return 0;
+    if (!(fp = fopen(file, "rb")))
+        ln_msg_error_sys("ln_bin_is_bin_file(): cannot open %s", file);
+    if (fread(magic, LN_BIN_MAGIC_LEN, 1, fp) == 1 &&
+        !memcmp(magic, LN_BIN_MAGIC, LN_BIN_MAGIC_LEN))
+        ret = 1;
+    fclose(fp);
+
+    return ret;
+}
+
+/* Whether `file` is named with LN_BIN_SUFFIX. */
+int ln_bin_is_bin_name(const char *file)
+{
+    const char *ext;
+
+    ext = strrchr(file, '.');
+    return ext && ln_streq(ext, LN_BIN_SUFFIX);
+}
+
+struct buf {
+    char   *data;
+    size_t  len;
+    size_t  cap;
+};
+
+struct writer {
+    struct buf  buf;
+    struct buf  strtab;
+    ln_hash    *strs;           /* string -> its offset in strtab plus 1 */
+};
+
+/* Append `n` bytes of `data`, or zeros if `data` is NULL. Return the offset. */
+static size_t buf_put(struct buf *b, const void *data, size_t n)
+{
+    size_t offset = b->len;
+
+    if (b->len + n > b->cap) {
+        while (b->len + n > b->cap)
+            b->cap = b->cap ? b->cap * 2 : 4096;
+        b->data = ln_realloc(b->data, b->cap);
+    }
+    if (data)
+        memcpy(b->data + offset, data, n);
+    else
+        memset(b->data + offset, 0, n);
+    b->len += n;
+
+    return offset;
+}
+
+static size_t buf_align(struct buf *b)
+{
+    buf_put(b, NULL, (BIN_ALIGN - b->len % BIN_ALIGN) % BIN_ALIGN);
+    return b->len;
+}
+
+static uint32_t to_u32(size_t n)
+{
+    if (n >= BIN_NOSTR)
+        PRINT_ERROR("the IR is larger than 4GB");
+    return n;
+}
+
+static uint32_t add_str(struct writer *w, const char *str)
+{
+    void *found;
+    size_t offset;
+
+    if (!str)
+        return BIN_NOSTR;
+    if ((found = ln_hash_find(w->strs, str)))
+        return (uintptr_t)found - 1;
+    offset = buf_put(&w->strtab, str, strlen(str) + 1);
+    ln_hash_insert(w->strs, str, (void *)(uintptr_t)(offset + 1));
+    return to_u32(offset);
+}
+
+static void add_tensors(struct writer *w, ln_list *tensors,
+                        ln_hash *tensor_table)
+{
+    ln_tensor_list_entry *tle;
+    ln_tensor_entry *te;
+    struct bin_tensor bt;
+
+    LN_LIST_FOREACH(tle, tensors) {
+        memset(&bt, 0, sizeof(bt));
+        bt.arg_name = add_str(w, tle->arg_name);
+        bt.name = add_str(w, tle->name);
+        if (tensor_table && (te = ln_tensor_table_find(tensor_table, tle->name)))
+            bt.offset = te->offset;
+        buf_put(&w->buf, &bt, sizeof(bt));
+    }
+}
+
+static void add_param(struct writer *w, const ln_param_entry *pe,
+                      struct bin_param *bp)
+{
+    uint32_t value;
+    int i;
+
+    memset(bp, 0, sizeof(*bp));
+    bp->arg_name = add_str(w, pe->arg_name);
+    bp->type = pe->type;
+    bp->array_len = pe->array_len;
+    switch (pe->type) {
+    case LN_PARAM_NULL:
+        break;
+    case LN_PARAM_STRING:
+        bp->value.string = add_str(w, pe->value_string);
+        break;
+    case LN_PARAM_NUMBER:
+        bp->value.number = pe->value_double;
+        break;
+    case LN_PARAM_BOOL:
+        bp->value.boolean = pe->value_bool ? 1 : 0;
+        break;
+    case LN_PARAM_ARRAY_NUMBER:
+        bp->value.array = buf_put(&w->buf, pe->value_array_double,
+                                  sizeof(double) * pe->array_len);
+        break;
+    case LN_PARAM_ARRAY_BOOL:
+    case LN_PARAM_ARRAY_STRING:
+        bp->value.array = w->buf.len;
+        for (i = 0; i < pe->array_len; i++) {
+            if (pe->type == LN_PARAM_ARRAY_BOOL)
+                value = pe->value_array_bool[i] ? 1 : 0;
+            else
+                value = add_str(w, pe->value_array_string[i]);
+            buf_put(&w->buf, &value, sizeof(value));
+        }
+        buf_align(&w->buf);
+        break;
+    default:
+        assert(0 && "unsupported ln_param_type");
+        break;
+    }
+}
+
+static size_t add_op(struct writer *w, const ln_op *op)
+{
+    struct bin_op bop;
+    struct bin_param bp;
+    ln_param_entry *pe;
+    size_t offset, params_offset;
+    int i;
+
+    memset(&bop, 0, sizeof(bop));
+    bop.name = add_str(w, op->op_arg->name);
+    bop.optype = add_str(w, op->op_arg->optype);
+    bop.n_in = ln_list_length(op->op_arg->tensors_in);
+    bop.n_out = ln_list_length(op->op_arg->tensors_out);
+    bop.n_params = ln_list_length(op->op_arg->params);
+    offset = buf_put(&w->buf, &bop, sizeof(bop));
+    add_tensors(w, op->op_arg->tensors_in, op->op_arg->tensor_table);
+    add_tensors(w, op->op_arg->tensors_out, op->op_arg->tensor_table);
+
+    /* array values follow the param records */
+    params_offset = buf_put(&w->buf, NULL, sizeof(bp) * bop.n_params);
+    i = 0;
+    LN_LIST_FOREACH(pe, op->op_arg->params) {
+        add_param(w, pe, &bp);
+        memcpy(w->buf.data + params_offset + sizeof(bp) * i++, &bp, sizeof(bp));
+    }
+
+    return offset;
+}
+
+/* Serialize `ctx` to a binary IR of `*size` bytes, which is freed by ln_free(). */
+void *ln_bin_create(const ln_context *ctx, size_t *size)
+{
+    struct writer w;
+    struct bin_header header;
+    uint64_t mem_size;
+    size_t offset;
+    ln_op *op;
+    int i;
+
+    memset(&w, 0, sizeof(w));
+    w.strs = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, LN_BIN_MAGIC, LN_BIN_MAGIC_LEN);
+    header.version = LN_BIN_VERSION;
+    header.op_count = ln_list_length(ctx->ops);
+    header.mem_type_count = LN_MEM_TYPE_SIZE;
+    header.inputs = add_str(&w, ctx->inputs);
+
+    buf_put(&w.buf, NULL, sizeof(header));
+    for (i = 0; i < LN_MEM_TYPE_SIZE; i++) {
+        mem_size = ctx->mem_sizes[i];
+        buf_put(&w.buf, &mem_size, sizeof(mem_size));
+    }
+    for (i = 0; i < LN_MEM_TYPE_SIZE; i++) {
+        mem_size = ctx->weight_sizes[i];
+        buf_put(&w.buf, &mem_size, sizeof(mem_size));
+    }
+    header.ops = buf_put(&w.buf, NULL, sizeof(uint32_t) * header.op_count);
+    buf_align(&w.buf);
+
+    i = 0;
+    LN_LIST_FOREACH(op, ctx->ops) {
+        offset = add_op(&w, op);
+        ((uint32_t *)(w.buf.data + header.ops))[i++] = to_u32(offset);
+    }
+
+    header.strtab = to_u32(buf_align(&w.buf));
+    header.strtab_size = to_u32(w.strtab.len);
+    buf_put(&w.buf, w.strtab.data, w.strtab.len);
+    to_u32(w.buf.len);
+    memcpy(w.buf.data, &header, sizeof(header));
+
+    ln_free(w.strtab.data);
+    ln_hash_free(w.strs);
+    *size = w.buf.len;
+    return w.buf.data;
+}
+
+void ln_bin_fprint(FILE *fp, const ln_context *ctx)
+{
+    void *buf;
+    size_t size;
+
+    buf = ln_bin_create(ctx, &size);
+    if (fwrite(buf, 1, size, fp) != size)
+        ln_msg_error_sys("ln_bin_fprint(): write failed");
+    ln_free(buf);
+}
+
+void ln_bin_print_file(const char *file, const ln_context *ctx)
+{
+    FILE *fp;
+
+    if (!(fp = fopen(file, "wb")))
+        ln_msg_error_sys("ln_bin_print_file(): cannot open %s", file);
+    ln_bin_fprint(fp, ctx);
+    fclose(fp);
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2018-2020 Zhixu Zhao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _LN_BIN_H_
+#define _LN_BIN_H_
+
+#include <stdio.h>
+#include "ln_op.h"
+#include "ln_arch.h"
+#include "ln_context.h"
+
+/* binary IR, an alternative to the JSON IR for big compiled nets */
+#define LN_BIN_MAGIC "LNIRBIN"
+#define LN_BIN_MAGIC_LEN 8      /* including the terminating null byte */
+#define LN_BIN_VERSION 1
+#define LN_BIN_SUFFIX ".lnb"
+
+#ifdef __cplusplus
+LN_CPPSTART
+#endif
+
+ln_list *ln_bin_parse(const void *buf, size_t size, ln_context *ctx);
+ln_list *ln_bin_parse_file(const char *file, ln_context *ctx);
+int ln_bin_is_bin_file(const char *file);
+int ln_bin_is_bin_name(const char *file);
+void *ln_bin_create(const ln_context *ctx, size_t *size);
+void ln_bin_fprint(FILE *fp, const ln_context *ctx);
+void ln_bin_print_file(const char *file, const ln_context *ctx);
+
+#ifdef __cplusplus
+LN_CPPEND
+#endif
+
+#endif  /* _LN_BIN_H_ */
@@ -21,9 +21,17 @@
  */
 
 #include <stdarg.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "ln_context.h"
+#include "ln_async.h"
 #include "ln_json.h"
+#include "ln_bin.h"
 #include "ln_pass.h"
+#include "ln_report.h"
 
 LN_EXPORT ln_context *ln_context_create(void)
 {
@@ -36,86 +44,1180 @@ LN_EXPORT ln_context *ln_context_create(void)
     ctx->ops = NULL;
     memset(ctx->mem_starts, 0, sizeof(ctx->mem_starts));
     memset(ctx->mem_sizes, 0, sizeof(ctx->mem_sizes));
+    memset(ctx->weight_sizes, 0, sizeof(ctx->weight_sizes));
+    ctx->weights = NULL;
+    ctx->inputs = NULL;
+    ctx->mem_align = 0;
+    ctx->async = NULL;
+    ctx->steps = NULL;
+    ctx->load_threads = 0;
+    ctx->verify_weights = 0;
+    ctx->lazy_weights = 0;
+    ctx->prefetch = NULL;
+    memset(&ctx->load_stat, 0, sizeof(ctx->load_stat));
+    ctx->time_passes = 0;
+    ctx->pass_stats = NULL;
 
     return ctx;
 }
 
+static void weights_release(ln_weights *weights);
+static void prefetch_free(ln_prefetch *prefetch);
+static void assign_data(ln_context *ctx);
+
 LN_EXPORT void ln_context_free(ln_context *ctx)
 {
+    if (ctx->async)
+        ln_async_free(ctx->async);
+    ln_op_steps_free(ctx->steps);
+    if (ctx->weights)
+        weights_release(ctx->weights);
+    prefetch_free(ctx->prefetch);
+    ln_free(ctx->inputs);
     ln_tensor_table_free(ctx->tensor_table);
     ln_op_table_free(ctx->op_table);
     ln_dfg_free(ctx->dfg);
     ln_op_list_free(ctx->ops);
+    ln_pass_stats_free(ctx->pass_stats);
     ln_free(ctx);
 }
 
 
+/*
+ * `source` is a binary IR (see ln_bin.c) if it starts with LN_BIN_MAGIC, or a
+ * JSON IR otherwise.
+ */
 LN_EXPORT void ln_context_init(ln_context *ctx, const char *source)
 {
-    ln_json_parse_file(source, ctx);
+    if (ln_bin_is_bin_file(source))
+        ln_bin_parse_file(source, ctx);
+    else
+        ln_json_parse_file(source, ctx);
     ln_context_init_ops(ctx);
 }
 
+/*
+ * Whether a reshape op keeps the leading dimension of its source, judged by
+ * its declared dims: a leading 0 or -1, or fixed trailing dims whose length
+ * is that of a leading slice of the source.
+ */
+static int keeps_batch(const ln_context *ctx, const ln_op *op)
+{
+    ln_tensor_entry *te;
+    ln_param_entry *pe;
+    int len = 1;
+
+    if (!ln_streqn(op->op_arg->optype, "reshape", 7))
+        return 0;
+    pe = ln_param_list_find(op->op_arg->params, "dims");
+    if (pe->value_array_int[0] <= 0)
+        return 1;
+    for (int i = 1; i < pe->array_len; i++) {
+        if (pe->value_array_int[i] <= 0)
+            return 0;
+        len *= pe->value_array_int[i];
+    }
+    te = ln_tensor_table_find(ctx->tensor_table,
+                              ln_tensor_list_find_name(op->op_arg->tensors_in,
+                                                       "src"));
+    return len * te->tensor->dims[0] == te->tensor->len;
+}
+
+/* Whether `name` is in the comma-separated list `names`. */
+static int in_names(const char *names, const char *name)
+{
+    size_t len = strlen(name);
+    const char *p;
+
+    for (p = names; p; p = strchr(p, ',') ? strchr(p, ',') + 1 : NULL) {
+        if (ln_streqn(p, name, len) && (p[len] == ',' || p[len] == '\0'))
+            return 1;
+    }
+    return 0;
+}
+
+static void set_leading_dim(ln_param_entry *pe, int dim)
+{
+    pe->value_array_double[0] = dim;
+    pe->value_array_float[0] = dim;
+    pe->value_array_int[0] = dim;
+}
+
+static int is_loaded(const ln_context *ctx)
+{
+    int i;
+
+    if (ctx->weights)
+        return 1;
+    for (i = LN_MEM_NONE+1; i < LN_MEM_TYPE_SIZE; i++) {
+        if (ctx->mem_starts[i])
+            return 1;
+    }
+    return 0;
+}
+
+static int is_planned(const ln_context *ctx)
+{
+    int i;
+
+    for (i = LN_MEM_NONE+1; i < LN_MEM_TYPE_SIZE; i++) {
+        if (ctx->mem_sizes[i] || ctx->weight_sizes[i])
+            return 1;
+    }
+    return 0;
+}
+
+/* Return the `create` op of the input tensor `name`. */
+static ln_op *find_input_creater(const ln_context *ctx, const char *name)
+{
+    ln_tensor_entry *te;
+    ln_op *op;
+
+    te = ln_tensor_table_find(ctx->tensor_table, name);
+    if (!te)
+        ln_msg_error("tensor name '%s' not found", name);
+    op = ln_op_table_find(ctx->op_table, te->creater);
+    if (!ln_streqn(op->op_arg->optype, "create", 6))
+        ln_msg_error("input tensor '%s' should be created by a 'create' operator",
+                     name);
+    return op;
+}
+
+/*
+ * Redo the shape inference of all operators, with the `dims` of the `create`
+ * ops of the tensors in `new_dims` overridden by its values. Reshapes that
+ * keep the leading dimension of their source keep it with the new size.
+ */
+static void override_dims(ln_context *ctx, ln_hash *new_dims)
+{
+    ln_op *op;
+    ln_list *follow_ops = NULL;
+    ln_tensor_list_entry *tle;
+    ln_tensor_entry *te;
+    ln_param_entry *pe;
+    const int *dims;
+
+    /* a leading 0 or -1 is resolved by pre_run from the new source itself */
+    LN_LIST_FOREACH(op, ctx->ops) {
+        if (keeps_batch(ctx, op) &&
+            ln_param_list_find(op->op_arg->params, "dims")->value_array_int[0] > 0)
+            follow_ops = ln_list_append(follow_ops, op);
+    }
+
+    ln_op_list_do_post_run(ctx->ops);
+    LN_LIST_FOREACH(op, ctx->ops) {
+        if (ln_list_find(follow_ops, op)) {
+            te = ln_tensor_table_find(ctx->tensor_table,
+                                      ln_tensor_list_find_name(op->op_arg->tensors_in,
+                                                               "src"));
+            set_leading_dim(ln_param_list_find(op->op_arg->params, "dims"),
+                            te->tensor->dims[0]);
+        }
+        LN_LIST_FOREACH(tle, op->op_arg->tensors_out) {
+            if (!(dims = ln_hash_find(new_dims, tle->name)))
+                continue;
+            pe = ln_param_list_find(op->op_arg->params, "dims");
+            for (int i = 0; i < pe->array_len; i++) {
+                pe->value_array_double[i] = dims[i];
+                pe->value_array_float[i] = dims[i];
+                pe->value_array_int[i] = dims[i];
+            }
+        }
+        op->pre_run(op->op_arg);
+    }
+    ln_list_free(follow_ops);
+
+    if (is_planned(ctx))
+        ln_pass_mem_plan(ctx);
+}
+
+/*
+ * Override the leading dimension of the tensors created by the `create` ops
+ * in the comma-separated list `inputs` with `batch`, and redo the shape
+ * inference of all operators. Reshapes that keep the leading dimension of
+ * their source keep it with the new size. If the context has been compiled,
+ * memory is re-planned. Should be called before ln_context_load().
+ */
+LN_EXPORT void ln_context_set_batch(ln_context *ctx, const char *inputs,
+                                    int batch)
+{
+    ln_hash *new_dims;
+    ln_param_entry *pe;
+    char *names, *name, *saveptr;
+    int *dims;
+
+    if (batch <= 0)
+        ln_msg_error("batch size should be positive, got %d", batch);
+    if (is_loaded(ctx))
+        ln_msg_error("ln_context_set_batch() should be called before ln_context_load()");
+
+    new_dims = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, ln_free);
+    names = ln_strdup(inputs);
+    for (name = strtok_r(names, ",", &saveptr); name;
+         name = strtok_r(NULL, ",", &saveptr)) {
+        pe = ln_param_list_find(find_input_creater(ctx, name)->op_arg->params,
+                                "dims");
+        dims = ln_clone(pe->value_array_int, sizeof(int) * pe->array_len);
+        dims[0] = batch;
+        ln_hash_insert(new_dims, name, dims);
+    }
+    override_dims(ctx, new_dims);
+    ln_hash_free(new_dims);
+    ln_free(names);
+}
+
+/*
+ * Override the dims of the tensors created by the `create` ops in the
+ * comma-separated list `inputs` with `dims`, the dims of each of them in
+ * order, keeping their numbers of dimensions, and redo the shape inference of
+ * all operators. Reshapes that keep the leading dimension of their source
+ * keep it with the new size; other reshapes to fixed dims can't follow.
+ * If the context has been compiled, memory is re-planned.
+ * Should be called before ln_context_load().
+ */
+LN_EXPORT void ln_context_set_dims(ln_context *ctx, const char *inputs,
+                                   const int *dims)
+{
+    ln_hash *new_dims;
+    ln_param_entry *pe;
+    char *names, *name, *saveptr;
+
+    if (is_loaded(ctx))
+        ln_msg_error("ln_context_set_dims() should be called before ln_context_load()");
+
+    new_dims = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+    names = ln_strdup(inputs);
+    for (name = strtok_r(names, ",", &saveptr); name;
+         name = strtok_r(NULL, ",", &saveptr)) {
+        pe = ln_param_list_find(find_input_creater(ctx, name)->op_arg->params,
+                                "dims");
+        for (int i = 0; i < pe->array_len; i++) {
+            if (dims[i] <= 0)
+                ln_msg_error("dims of input tensor '%s' should be positive, got %d",
+                             name, dims[i]);
+        }
+        ln_hash_insert(new_dims, name, (void *)dims);
+        dims += pe->array_len;
+    }
+    override_dims(ctx, new_dims);
+    ln_hash_free(new_dims);
+    ln_free(names);
+}
+
+/*
+ * Declare the static tensors in the comma-separated list `inputs`, which the
+ * user writes between runs, so that memory planning keeps them in the
+ * context's own memory instead of the weights it may share with other
+ * contexts. If the context has been compiled, memory is re-planned.
+ * Should be called before ln_context_load().
+ */
+LN_EXPORT void ln_context_set_inputs(ln_context *ctx, const char *inputs)
+{
+    char *names, *name, *saveptr;
+
+    if (is_loaded(ctx))
+        ln_msg_error("ln_context_set_inputs() should be called before ln_context_load()");
+    names = ln_strdup(inputs);
+    for (name = strtok_r(names, ",", &saveptr); name;
+         name = strtok_r(NULL, ",", &saveptr)) {
+        if (!ln_tensor_table_find(ctx->tensor_table, name))
+            ln_msg_error("tensor name '%s' not found", name);
+    }
+    ln_free(names);
+
+    ln_free(ctx->inputs);
+    ctx->inputs = ln_strdup(inputs);
+    if (is_planned(ctx))
+        ln_pass_mem_plan(ctx);
+}
+
+/*
+ * Align the offsets and pad the sizes of planned tensors to at least `align`
+ * bytes, a power of 2, besides the alignment their memory types require.
+ * Should be called before ln_context_load().
+ */
+LN_EXPORT void ln_context_set_mem_align(ln_context *ctx, size_t align)
+{
+    if (is_loaded(ctx))
+        ln_msg_error("ln_context_set_mem_align() should be called before ln_context_load()");
+    if (align == 0 || (align & (align - 1)))
+        ln_msg_error("memory alignment %lu is not a power of 2", align);
+
+    ctx->mem_align = align;
+    if (is_planned(ctx))
+        ln_pass_mem_plan(ctx);
+}
+
+/*
+ * With `time_passes` not 0, ln_context_compile() measures the time and
+ * counts the replacements, DFG checks and hash table lookups of every pass,
+ * and prints a report of them to stderr.
+ */
+LN_EXPORT void ln_context_set_time_passes(ln_context *ctx, int time_passes)
+{
+    ctx->time_passes = time_passes;
+}
+
 LN_EXPORT void ln_context_compile(ln_context *ctx, const char *target, const char *datafile)
 {
     ln_arch *arch;
+    ln_pass_timer timer;
 
     arch = ln_hash_find(LN_ARCH.arch_table, target);
     if (!arch->optimize_func)
         return;
+    ln_pass_stats_free(ctx->pass_stats);
+    ctx->pass_stats = NULL;
+    ln_pass_timer_start(ctx, &timer, "total");
     arch->optimize_func(ctx, datafile);
+    ln_pass_timer_stop(ctx, &timer);
+    if (ctx->time_passes)
+        ln_pass_stats_fprint(stderr, ctx->pass_stats);
 }
 
+/* Print a binary IR if `outfile` ends with LN_BIN_SUFFIX, a JSON IR otherwise. */
 LN_EXPORT void ln_context_print(const ln_context *ctx, const char *outfile)
 {
-    if (ln_streq(outfile, "-"))
+    if (ln_bin_is_bin_name(outfile))
+        ln_bin_print_file(outfile, ctx);
+    else if (ln_streq(outfile, "-"))
         ln_json_fprint(stdout, ctx);
     else
         ln_json_print_file(outfile, ctx);
 }
 
+/*
+ * Print a report of the memory plan to `outfile`: the offsets, sizes and
+ * lifetimes of the tensors, and the peak live bytes and the fragmentation of
+ * the planned memory. If `outfile` ends with .svg or .html, a timeline of the
+ * memory is printed too. Should be called after the context is compiled.
+ */
+LN_EXPORT void ln_context_print_mem_plan(const ln_context *ctx,
+                                         const char *outfile)
+{
+    if (!is_planned(ctx))
+        ln_msg_error("ln_context_print_mem_plan() should be called after the memory is planned");
+    if (ln_streq(outfile, "-"))
+        ln_report_mem_plan(stdout, ctx, LN_REPORT_TEXT);
+    else
+        ln_report_mem_plan_file(outfile, ctx);
+}
+
+static void set_dirty(ln_context *ctx, const char *tname)
+{
+    ln_tensor_entry *te;
+
+    te = ln_tensor_table_find_root(ctx->tensor_table, tname);
+    if (te) {
+        te->dirty = 1;
+        te->version++;
+    }
+}
+
+/* Whether nothing but `op` and the views of the root of `te` uses its
+   memory, so its data stays between runs. Views written by the runs of other
+   ops, like the in-place outputs of sort1d_by_key, don't keep it. */
+static int keeps_data(const ln_context *ctx, const ln_op *op,
+                      ln_tensor_entry *te)
+{
+    ln_tensor_list_entry *tle;
+    ln_tensor_entry *root, *e, *v;
+    ln_op *o;
+    char *start, *end, *e_start;
+
+    root = ln_tensor_table_find_root(ctx->tensor_table, te->name);
+    start = root->tensor->data;
+    end = start + tl_tensor_size(root->tensor);
+    LN_LIST_FOREACH(o, ctx->ops) {
+        LN_LIST_FOREACH(tle, o->op_arg->tensors_out) {
+            e = ln_tensor_table_find(ctx->tensor_table, tle->name);
+            e_start = e->tensor->data;
+            if (e == root || e->mtype != root->mtype ||
+                e_start + tl_tensor_size(e->tensor) <= start ||
+                e_start >= end)
+                continue;
+            for (v = e; v->owner && !v->inplace;
+                 v = ln_tensor_table_find(ctx->tensor_table, v->owner))
+                ;
+            if (v != root ? !root->isstatic : o != op && o->run)
+                return 0;
+        }
+    }
+    return 1;
+}
+
+static ln_tensor_entry **root_entries(const ln_context *ctx, ln_list *tles)
+{
+    ln_tensor_list_entry *tle;
+    ln_tensor_entry **tes;
+    int n = 0;
+
+    tes = ln_alloc(sizeof(ln_tensor_entry *) * (ln_list_length(tles) + 1));
+    LN_LIST_FOREACH(tle, tles) {
+        tes[n] = ln_tensor_table_find_root(ctx->tensor_table, tle->name);
+        tes[n++]->dirty = 1;
+    }
+    tes[n] = NULL;
+    return tes;
+}
+
+/* Whether an op reads one of the outputs of `op`, whose names are in
+   `reads`. Ops nobody reads from, like print, run for their side effects. */
+static int is_read(ln_op *op, ln_hash *reads)
+{
+    ln_tensor_list_entry *tle;
+
+    LN_LIST_FOREACH(tle, op->op_arg->tensors_out) {
+        if (ln_hash_find_extended(reads, tle->name, NULL, NULL))
+            return 1;
+    }
+    return 0;
+}
+
+/* Let the steps of the constant ops whose outputs keep their data between
+   runs skip until something they depend on is set. mem_plan makes sure the
+   outputs of the ops depending only on weights do if inputs are declared.
+   Ops without readers of their outputs always run. */
+static void cache_steps(ln_context *ctx)
+{
+    ln_tensor_list_entry *tle;
+    ln_tensor_entry *te;
+    ln_op_step *step;
+    ln_hash *consts;
+    ln_hash *reads;
+    ln_op *op;
+    int constant;
+
+    consts = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+    reads = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+    LN_LIST_FOREACH(op, ctx->ops) {
+        LN_LIST_FOREACH(tle, op->op_arg->tensors_in)
+            ln_hash_insert(reads, tle->name, NULL);
+    }
+    step = ctx->steps;
+    LN_LIST_FOREACH(op, ctx->ops) {
+        constant = ln_context_is_constant_op(ctx, op, consts, 0) &&
+                is_read(op, reads);
+        LN_LIST_FOREACH(tle, op->op_arg->tensors_out) {
+            if (!constant)
+                break;
+            te = ln_tensor_table_find(ctx->tensor_table, tle->name);
+            if (!te->scratch)
+                constant = keeps_data(ctx, op, te);
+        }
+        if (constant) {
+            LN_LIST_FOREACH(tle, op->op_arg->tensors_out)
+                ln_hash_insert(consts, tle->name, NULL);
+        }
+        if (!op->run)
+            continue;
+        assert(step->op_arg == op->op_arg);
+        if (constant) {
+            step->ins = root_entries(ctx, op->op_arg->tensors_in);
+            step->outs = root_entries(ctx, op->op_arg->tensors_out);
+            ln_msg_debug("cache the outputs of op %s", op->op_arg->name);
+        }
+        step++;
+    }
+    ln_hash_free(reads);
+    ln_hash_free(consts);
+}
+
+/* a cpu weight pointing into the mapped weight file, at `offset` of the
+   planned weights */
+struct mapped_range {
+    size_t       offset;
+    size_t       size;
+    void        *data;
+};
+
+struct ln_weights {
+    void        *starts[LN_MEM_TYPE_SIZE];
+    void        *map;           /* mmap()ed image backing the cpu weights */
+    size_t       map_size;
+    void        *file_map;      /* weight file mapped by lazy loading */
+    size_t       file_map_size;
+    struct mapped_range *ranges; /* sorted by offset */
+    int          nranges;
+    int          refcount;
+};
+
+/* madvise() plan prefetching the mapped weights the next steps read, during
+   the first run of a lazily loaded context */
+struct ln_prefetch {
+    struct mapped_range *ranges; /* page-aligned, `offset` unused */
+    int         *starts;        /* step i reads ranges[starts[i]..starts[i+1]) */
+    int          nsteps;
+    int          next;          /* next step to advise */
+};
+
+static pthread_mutex_t weights_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static ln_weights *weights_create(void)
+{
+    ln_weights *weights;
+
+    weights = ln_alloc(sizeof(ln_weights));
+    memset(weights, 0, sizeof(ln_weights));
+    weights->refcount = 1;
+    return weights;
+}
+
+/*
+ * Allocate the weights of `sizes`. If `lazy`, the cpu weights are anonymous
+ * pages, most of which stay untouched since the weights from the weight file
+ * are mapped elsewhere.
+ */
+static ln_weights *weights_alloc(const size_t *sizes, int lazy)
+{
+    ln_weights *weights;
+    int i;
+
+    weights = weights_create();
+    for (i = LN_MEM_NONE+1; i < LN_MEM_TYPE_SIZE; i++) {
+        if (sizes[i] == 0)
+            continue;
+        if (lazy && i == LN_MEM_CPU) {
+            weights->map = mmap(NULL, sizes[i], PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (weights->map == MAP_FAILED)
+                ln_msg_error_sys("cannot mmap %lu bytes of weights", sizes[i]);
+            weights->map_size = sizes[i];
+            weights->starts[i] = weights->map;
+            continue;
+        }
+        weights->starts[i] = ln_mem_type_info(i).alloc_func(sizes[i]);
+        if (ln_mem_type_info(i).memset_func)
+            ln_mem_type_info(i).memset_func(weights->starts[i], 0, sizes[i]);
+        ln_msg_debug("allocate weights %s: %lu bytes at address %p",
+                     ln_mem_type_name(i), sizes[i], weights->starts[i]);
+        assert(weights->starts[i]);
+    }
+    return weights;
+}
+
+static ln_weights *weights_ref(ln_weights *weights)
+{
+    pthread_mutex_lock(&weights_mutex);
+    weights->refcount++;
+    pthread_mutex_unlock(&weights_mutex);
+    return weights;
+}
+
+static void weights_release(ln_weights *weights)
+{
+    int i, last;
+
+    pthread_mutex_lock(&weights_mutex);
+    last = --weights->refcount == 0;
+    pthread_mutex_unlock(&weights_mutex);
+    if (!last)
+        return;
+
+    if (weights->map) {
+        munmap(weights->map, weights->map_size);
+        weights->starts[LN_MEM_CPU] = NULL;
+    }
+    if (weights->file_map)
+        munmap(weights->file_map, weights->file_map_size);
+    ln_free(weights->ranges);
+    for (i = LN_MEM_NONE+1; i < LN_MEM_TYPE_SIZE; i++) {
+        if (weights->starts[i])
+            ln_mem_type_info(i).free_func(weights->starts[i]);
+    }
+    ln_free(weights);
+}
+
+/* Return the data of the cpu weight at `offset` of `size` bytes in the
+   mapped weight file, or NULL if it isn't mapped. */
+static void *mapped_data(const ln_weights *weights, size_t offset, size_t size)
+{
+    const struct mapped_range *r;
+    int lo = 0, hi = weights->nranges - 1, mid;
+
+    while (lo <= hi) {
+        mid = lo + (hi - lo) / 2;
+        if (weights->ranges[mid].offset <= offset)
+            lo = mid + 1;
+        else
+            hi = mid - 1;
+    }
+    if (hi < 0)
+        return NULL;
+    r = &weights->ranges[hi];
+    if (offset + size > r->offset + r->size)
+        return NULL;
+    return (char *)r->data + (offset - r->offset);
+}
+
+static int in_file_map(const ln_weights *weights, const void *data)
+{
+    return weights->file_map && (const char *)data >= (char *)weights->file_map &&
+        (const char *)data < (char *)weights->file_map + weights->file_map_size;
+}
+
+static void prefetch_free(ln_prefetch *prefetch)
+{
+    if (!prefetch)
+        return;
+    ln_free(prefetch->ranges);
+    ln_free(prefetch->starts);
+    ln_free(prefetch);
+}
+
+/* Whether `op` only fills weights, which are already there if shared. */
+static int fills_weights(const ln_context *ctx, const ln_op *op)
+{
+    ln_tensor_list_entry *tle;
+
+    if (!op->op_arg->tensors_out)
+        return 0;
+    LN_LIST_FOREACH(tle, op->op_arg->tensors_out) {
+        if (!ln_context_is_weight(ctx, tle->name))
+            return 0;
+    }
+    return 1;
+}
+
+/*
+ * Load binary weight files with `nthreads` threads, or as many threads as
+ * ln_cpu_num_threads() if `nthreads` <= 0, the default.
+ */
+LN_EXPORT void ln_context_set_load_threads(ln_context *ctx, int nthreads)
+{
+    ctx->load_threads = nthreads;
+}
+
+/*
+ * Whether to check the CRC-32 of every blob when loading binary weight files,
+ * which costs a pass over the weights. Off by default.
+ */
+LN_EXPORT void ln_context_set_verify_weights(ln_context *ctx, int verify)
+{
+    ctx->verify_weights = verify;
+}
+
+/*
+ * Whether to map the cpu weights from a binary weight file instead of
+ * loading them, so that they are read on first use and shared with the page
+ * cache. Off by default. Should be called before ln_context_load().
+ */
+LN_EXPORT void ln_context_set_lazy_weights(ln_context *ctx, int lazy)
+{
+    if (is_loaded(ctx))
+        ln_msg_error("ln_context_set_lazy_weights() should be called before ln_context_load()");
+    ctx->lazy_weights = lazy;
+}
+
+/* The data of the mapped weight file is only 64-byte aligned. */
+static int is_lazy_weight(const ln_tensor_entry *te, void *arg)
+{
+    const ln_context *ctx = arg;
+
+    return te->mtype == LN_MEM_CPU && ctx->weight_sizes[LN_MEM_CPU] &&
+        ln_context_is_weight(ctx, te->name) &&
+        ctx->mem_align <= LN_WEIGHT_FILE_ALIGN;
+}
+
+static int mapped_range_cmp(const void *p1, const void *p2)
+{
+    const struct mapped_range *r1 = p1, *r2 = p2;
+
+    return r1->offset < r2->offset ? -1 : r1->offset > r2->offset;
+}
+
+/* Record the page-aligned mapped ranges of the inputs of every step. */
+static ln_prefetch *prefetch_create(const ln_context *ctx)
+{
+    ln_prefetch *prefetch;
+    ln_tensor_list_entry *tle;
+    ln_tensor_entry *te;
+    const ln_op_step *step;
+    size_t page = sysconf(_SC_PAGESIZE);
+    uintptr_t start, end;
+    int n = 0, cap = 0;
+
+    prefetch = ln_alloc(sizeof(ln_prefetch));
+    for (prefetch->nsteps = 0; ctx->steps[prefetch->nsteps].run;
+         prefetch->nsteps++)
+        ;
+    prefetch->starts = ln_alloc(sizeof(int) * (prefetch->nsteps + 1));
+    prefetch->ranges = NULL;
+    prefetch->next = 0;
+    for (step = ctx->steps; step->run; step++) {
+        prefetch->starts[step - ctx->steps] = n;
+        LN_LIST_FOREACH(tle, step->op_arg->tensors_in) {
+            te = ln_tensor_table_find(ctx->tensor_table, tle->name);
+            if (!te || !in_file_map(ctx->weights, te->tensor->data))
+                continue;
+            if (n == cap) {
+                cap = cap ? cap * 2 : 64;
+                prefetch->ranges = ln_realloc(prefetch->ranges,
+                                              sizeof(struct mapped_range) * cap);
+            }
+            start = (uintptr_t)te->tensor->data & ~(page - 1);
+            end = (uintptr_t)te->tensor->data + tl_tensor_size(te->tensor);
+            prefetch->ranges[n].data = (void *)start;
+            prefetch->ranges[n].size = end - start;
+            n++;
+        }
+    }
+    prefetch->starts[prefetch->nsteps] = n;
+    return prefetch;
+}
+
+/* Advise the kernel to read ahead the weights of the next steps. */
+static void prefetch_hook(int index, void *arg)
+{
+    ln_prefetch *prefetch = arg;
+    struct mapped_range *r;
+    int last;
+
+    last = index + LN_CONTEXT_PREFETCH_STEPS;
+    if (last >= prefetch->nsteps)
+        last = prefetch->nsteps - 1;
+    for (; prefetch->next <= last; prefetch->next++) {
+        for (r = &prefetch->ranges[prefetch->starts[prefetch->next]];
+             r < &prefetch->ranges[prefetch->starts[prefetch->next + 1]]; r++)
+            madvise(r->data, r->size, MADV_WILLNEED);
+    }
+}
+
+/*
+ * Map the weight file `datafile` and point the cpu weights into it. The
+ * planned tensors viewing the mapped weights, such as reshaped ones, are
+ * pointed into it by their planned offsets.
+ */
+static void load_lazily(ln_context *ctx, const char *datafile)
+{
+    ln_weights *weights = ctx->weights;
+    ln_op *op;
+    ln_tensor_list_entry *tle;
+    ln_tensor_entry *te;
+    int cap = 0;
+
+    weights->file_map = ln_tensor_table_map_weight_file(ctx->tensor_table,
+                                                        datafile,
+                                                        is_lazy_weight, ctx,
+                                                        &weights->file_map_size);
+    LN_LIST_FOREACH(op, ctx->ops) {
+        LN_LIST_FOREACH(tle, op->op_arg->tensors_out) {
+            te = ln_tensor_table_find(ctx->tensor_table, tle->name);
+            if (!in_file_map(weights, te->tensor->data))
+                continue;
+            if (weights->nranges == cap) {
+                cap = cap ? cap * 2 : 64;
+                weights->ranges = ln_realloc(weights->ranges,
+                                             sizeof(struct mapped_range) * cap);
+            }
+            weights->ranges[weights->nranges].offset = te->offset;
+            weights->ranges[weights->nranges].size = tl_tensor_size(te->tensor);
+            weights->ranges[weights->nranges].data = te->tensor->data;
+            weights->nranges++;
+        }
+    }
+    qsort(weights->ranges, weights->nranges, sizeof(struct mapped_range),
+          mapped_range_cmp);
+    assign_data(ctx);
+    ln_msg_debug("mapped %d weights from %s", weights->nranges, datafile);
+}
+
+/*
+ * Allocate memory and load data. If the context shares its weights with
+ * another context or maps them from an image, `datafile` is ignored and the
+ * ops that only fill weights are not static-run. With lazy weights, a
+ * binary weight file is mapped instead of read.
+ */
 LN_EXPORT void ln_context_load(ln_context *ctx, const char *datafile)
 {
+    ln_op *op;
+    int shared, lazy;
+
+    shared = ctx->weights != NULL;
+    lazy = !shared && ctx->lazy_weights && datafile &&
+        ctx->weight_sizes[LN_MEM_CPU] && ln_tensor_is_weight_file(datafile);
+    if (!shared && ctx->lazy_weights && datafile && !lazy)
+        ln_msg_warn("can't map the weights from %s lazily; loading them",
+                    datafile);
+    if (lazy && ctx->verify_weights)
+        ln_msg_warn("CRC-32s of lazily mapped weights are not verified");
+    memset(&ctx->load_stat, 0, sizeof(ctx->load_stat));
+    if (lazy)
+        ctx->weights = weights_alloc(ctx->weight_sizes, 1);
     ln_context_alloc_mem(ctx);
-    if (datafile)
-        ln_tensor_table_load_trt_weight_file(ctx->tensor_table, datafile);
-    ln_op_list_do_static_run(ctx->ops);
+    if (!shared) {
+        if (lazy)
+            load_lazily(ctx, datafile);
+        else if (datafile)
+            ln_tensor_table_load_data_file(ctx->tensor_table, datafile,
+                                           ctx->load_threads,
+                                           ctx->verify_weights,
+                                           &ctx->load_stat);
+        ln_op_list_do_static_run(ctx->ops);
+    } else {
+        LN_LIST_FOREACH(op, ctx->ops) {
+            if (op->static_run && !fills_weights(ctx, op))
+                op->static_run(op->op_arg);
+        }
+    }
+    ctx->steps = ln_op_list_flatten_run(ctx->ops);
+    cache_steps(ctx);
+    if (lazy)
+        ctx->prefetch = prefetch_create(ctx);
+}
+
+/*
+ * Return the number of bytes loaded from the binary weight file by the last
+ * ln_context_load(), and its loading time in seconds in `time` if not NULL.
+ */
+LN_EXPORT size_t ln_context_loaded_bytes(const ln_context *ctx, double *time)
+{
+    if (time)
+        *time = ctx->load_stat.time;
+    return ctx->load_stat.bytes;
+}
+
+/* Whether the weights of `ctx` are planned as those of `src`, reporting the
+   difference by ln_msg_error() if `must` */
+static int weights_match(const ln_context *ctx, const ln_context *src,
+                         int must)
+{
+    ln_op *op;
+    ln_tensor_list_entry *tle;
+    ln_tensor_entry *te, *src_te;
+    int i;
+
+    for (i = LN_MEM_NONE+1; i < LN_MEM_TYPE_SIZE; i++) {
+        if (ctx->weight_sizes[i] == src->weight_sizes[i])
+            continue;
+        if (must)
+            ln_msg_error("can't share weights of %lu bytes of %s with a context needing %lu bytes",
+                         src->weight_sizes[i], ln_mem_type_name(i),
+                         ctx->weight_sizes[i]);
+        return 0;
+    }
+    LN_LIST_FOREACH(op, ctx->ops) {
+        LN_LIST_FOREACH(tle, op->op_arg->tensors_out) {
+            te = ln_tensor_table_find(ctx->tensor_table, tle->name);
+            if (!te->isstatic || !ln_context_is_weight(ctx, te->name))
+                continue;
+            src_te = ln_tensor_table_find(src->tensor_table, te->name);
+            if (src_te && src_te->isstatic &&
+                ln_context_is_weight(src, te->name) &&
+                src_te->mtype == te->mtype && src_te->offset == te->offset &&
+                tl_tensor_size(src_te->tensor) == tl_tensor_size(te->tensor))
+                continue;
+            if (must)
+                ln_msg_error("can't share weights: weight '%s' is planned differently",
+                             te->name);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Whether the compiled `ctx` can use the weights of `src` by
+   ln_context_share_weights() */
+int ln_context_can_share_weights(const ln_context *ctx, const ln_context *src)
+{
+    return weights_match(ctx, src, 0);
+}
+
+/*
+ * Make `ctx` use the weights of the loaded context `src` of the same model
+ * instead of a copy of its own. `ctx` should be compiled the same way as
+ * `src`, its inputs declared by ln_context_set_inputs(), and this should be
+ * called before ln_context_load(ctx).
+ */
+LN_EXPORT void ln_context_share_weights(ln_context *ctx, const ln_context *src)
+{
+    if (!src->weights)
+        ln_msg_error("the context to share weights from should be loaded");
+    if (is_loaded(ctx))
+        ln_msg_error("ln_context_share_weights() should be called before ln_context_load()");
+    if (!ctx->inputs)
+        ln_msg_error("ln_context_set_inputs() should be called before ln_context_share_weights(), or the inputs are shared as weights");
+    weights_match(ctx, src, 1);
+    ctx->weights = weights_ref(src->weights);
+}
+
+#define WEIGHTS_MAGIC "LNWEIGHT"
+#define WEIGHTS_HEADER_SIZE 64
+
+static void check_cpu_weights(const ln_context *ctx)
+{
+    int i;
+
+    for (i = LN_MEM_NONE+1; i < LN_MEM_TYPE_SIZE; i++) {
+        if (i != LN_MEM_CPU && ctx->weight_sizes[i])
+            ln_msg_error("weight image only holds %s weights, but the model has %lu bytes of %s weights",
+                         ln_mem_type_name(LN_MEM_CPU), ctx->weight_sizes[i],
+                         ln_mem_type_name(i));
+    }
+}
+
+/* Write the `size` bytes of cpu weights, some of which may be mapped. */
+static int write_weights(FILE *fp, const ln_weights *weights, size_t size)
+{
+    const char *start = weights->starts[LN_MEM_CPU];
+    const struct mapped_range *r;
+    size_t offset = 0;
+    int i;
+
+    for (i = 0; i < weights->nranges; i++) {
+        r = &weights->ranges[i];
+        if (r->offset < offset)
+            continue;
+        if ((r->offset > offset &&
+             fwrite(start + offset, r->offset - offset, 1, fp) != 1) ||
+            (r->size && fwrite(r->data, r->size, 1, fp) != 1))
+            return -1;
+        offset = r->offset + r->size;
+    }
+    if (size > offset && fwrite(start + offset, size - offset, 1, fp) != 1)
+        return -1;
+    return 0;
+}
+
+/*
+ * Write the cpu weights of the loaded context to an image `file`, which
+ * ln_context_map_weights() maps in place of loading the weights.
+ * The image starts with a WEIGHTS_HEADER_SIZE-byte header of the magic
+ * WEIGHTS_MAGIC and the size of the weights in uint64_t, followed by the
+ * weights as planned.
+ */
+LN_EXPORT void ln_context_save_weights(const ln_context *ctx, const char *file)
+{
+    char header[WEIGHTS_HEADER_SIZE];
+    uint64_t size;
+    FILE *fp;
+
+    if (!ctx->weights)
+        ln_msg_error("ln_context_save_weights() should be called after ln_context_load()");
+    check_cpu_weights(ctx);
+
+    size = ctx->weight_sizes[LN_MEM_CPU];
+    memset(header, 0, sizeof(header));
+    memcpy(header, WEIGHTS_MAGIC, strlen(WEIGHTS_MAGIC));
+    memcpy(header + strlen(WEIGHTS_MAGIC), &size, sizeof(size));
+    if (!(fp = fopen(file, "wb")))
+        ln_msg_error_sys("cannot open %s", file);
+    if (fwrite(header, sizeof(header), 1, fp) != 1 ||
+        write_weights(fp, ctx->weights, size) < 0)
+        ln_msg_error_sys("error writing weight image %s", file);
+    fclose(fp);
 }
 
+/*
+ * Map the cpu weights of the compiled context read-only from an image `file`
+ * written by ln_context_save_weights(), instead of allocating and loading
+ * them. The pages are shared by all the contexts and processes mapping the
+ * same image. The inputs should be declared by ln_context_set_inputs(), and
+ * this should be called before ln_context_load().
+ */
+LN_EXPORT void ln_context_map_weights(ln_context *ctx, const char *file)
+{
+    ln_weights *weights;
+    struct stat st;
+    uint64_t size;
+    void *map;
+    int fd;
+
+    if (is_loaded(ctx))
+        ln_msg_error("ln_context_map_weights() should be called before ln_context_load()");
+    if (!ctx->inputs)
+        ln_msg_error("ln_context_set_inputs() should be called before ln_context_map_weights(), or the inputs are mapped read-only as weights");
+    check_cpu_weights(ctx);
+
+    if ((fd = open(file, O_RDONLY)) < 0)
+        ln_msg_error_sys("cannot open %s", file);
+    if (fstat(fd, &st) < 0)
+        ln_msg_error_sys("cannot stat %s", file);
+    if (st.st_size < WEIGHTS_HEADER_SIZE)
+        ln_msg_error("invalid weight image %s: file too short", file);
+    map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED)
+        ln_msg_error_sys("cannot mmap %s", file);
+    close(fd);
+
+    if (memcmp(map, WEIGHTS_MAGIC, strlen(WEIGHTS_MAGIC)))
+        ln_msg_error("invalid weight image %s: bad magic", file);
+    memcpy(&size, (char *)map + strlen(WEIGHTS_MAGIC), sizeof(size));
+    if (size != ctx->weight_sizes[LN_MEM_CPU] ||
+        (uint64_t)st.st_size != WEIGHTS_HEADER_SIZE + size)
+        ln_msg_error("invalid weight image %s: has %lu bytes of weights, but the model needs %lu bytes",
+                     file, (size_t)size, ctx->weight_sizes[LN_MEM_CPU]);
+
+    weights = weights_create();
+    weights->map = map;
+    weights->map_size = st.st_size;
+    if (size)
+        weights->starts[LN_MEM_CPU] = (char *)map + WEIGHTS_HEADER_SIZE;
+    ctx->weights = weights;
+}
+
+/* If runs are submitted by ln_context_run_async(), data of the inputs is
+   staged for the next run, and other data access waits for the runs. */
 LN_EXPORT void ln_context_set_data(ln_context *ctx, const char *tname, const void *data)
 {
+    if (ctx->async) {
+        if (ln_async_set_data(ctx->async, tname, data))
+            return;
+        ln_async_wait(ctx->async);
+    }
     ln_tensor_table_set_data(ctx->tensor_table, tname, data);
+    set_dirty(ctx, tname);
 }
 
 LN_EXPORT void *ln_context_get_data(ln_context *ctx, const char *tname, void *data)
 {
+    if (ctx->async)
+        ln_async_wait(ctx->async);
     return ln_tensor_table_get_data(ctx->tensor_table, tname, data);
 }
 
+LN_EXPORT void ln_context_set_frame(ln_context *ctx, const char *tname,
+                                    int frame, const void *data)
+{
+    if (ctx->async)
+        ln_async_wait(ctx->async);
+    ln_tensor_table_set_frame(ctx->tensor_table, tname, frame, data);
+    set_dirty(ctx, tname);
+}
+
+LN_EXPORT void *ln_context_get_frame(ln_context *ctx, const char *tname,
+                                     int frame, void *data)
+{
+    if (ctx->async)
+        ln_async_wait(ctx->async);
+    return ln_tensor_table_get_frame(ctx->tensor_table, tname, frame, data);
+}
+
 LN_EXPORT size_t ln_context_data_size(ln_context *ctx, const char *tname)
 {
     return ln_tensor_table_data_size(ctx->tensor_table, tname);
 }
 
+/*
+ * Return the number of dimensions of tensor `tname`, and store its dims in
+ * `dims` if it's not NULL.
+ */
+LN_EXPORT int ln_context_data_shape(ln_context *ctx, const char *tname,
+                                    int *dims)
+{
+    return ln_tensor_table_data_shape(ctx->tensor_table, tname, dims);
+}
+
+/* Return the name of the data type of tensor `tname`, like "TL_FLOAT". */
+LN_EXPORT const char *ln_context_data_dtype(ln_context *ctx, const char *tname)
+{
+    return ln_tensor_table_data_dtype(ctx->tensor_table, tname);
+}
+
+/*
+ * Return the data of tensor `tname` without copying if it is in CPU memory,
+ * otherwise NULL, after waiting for the runs submitted by
+ * ln_context_run_async(). The data is valid until ln_context_unload(), and is
+ * overwritten by the next run.
+ */
+LN_EXPORT void *ln_context_data_ptr(ln_context *ctx, const char *tname)
+{
+    if (ctx->async)
+        ln_async_wait(ctx->async);
+    return ln_tensor_table_data_ptr(ctx->tensor_table, tname);
+}
+
 LN_EXPORT void ln_context_set_param(ln_context *ctx, const char *opname,
                           const char *pname, ...)
 {
+    ln_tensor_list_entry *tle;
+    ln_op_step *step;
+    ln_op *op;
     va_list ap;
 
+    if (ctx->async)
+        ln_async_wait(ctx->async);
     va_start(ap, pname);
     ln_op_table_vset_param(ctx->op_table, opname, pname, ap);
     va_end(ap);
+    op = ln_op_table_find(ctx->op_table, opname);
+    LN_LIST_FOREACH(tle, op->op_arg->tensors_out)
+        set_dirty(ctx, tle->name);
+    /* a cached step of the op has clean inputs, but should run again */
+    for (step = ctx->steps; step && step->run; step++) {
+        if (step->op_arg == op->op_arg)
+            step->force = 1;
+    }
+}
+
+/* Run the ops of the context on the calling thread, prefetching lazily
+   mapped weights during the first run. */
+void ln_context_run_steps(const ln_context *ctx)
+{
+    if (ctx->prefetch && ctx->prefetch->next < ctx->prefetch->nsteps)
+        ln_op_steps_do_run_hook(ctx->steps, prefetch_hook, ctx->prefetch);
+    else if (ctx->steps)
+        ln_op_steps_do_run(ctx->steps);
+    else
+        ln_op_list_do_run(ctx->ops);
 }
 
+/* different contexts may run concurrently, but not the same one */
 LN_EXPORT void ln_context_run(const ln_context *ctx)
 {
+    if (ctx->async && !ln_async_in_worker(ctx->async)) {
+        ln_async_submit(ctx->async, NULL, NULL);
+        ln_async_wait(ctx->async);
+        return;
+    }
     /* LN_TIMEIT_START; */
-    ln_op_list_do_run(ctx->ops);
+    ln_context_run_steps(ctx);
     /* LN_TIMEIT_END("time of ln_context_run(): "); */
 }
 
+/*
+ * Submit a run to the context's worker thread and return. Runs are done in
+ * submission order, and `callback` is called with `data` on the worker thread
+ * after its run, when outputs can be read, before the next run starts.
+ * Data of the inputs declared by ln_context_set_inputs() set after this call
+ * goes to the next run, without waiting for this one. Should be called after
+ * ln_context_load(). Callbacks can run the context by ln_context_run() on the
+ * worker thread, but not submit runs, which would wait for themselves.
+ */
+LN_EXPORT void ln_context_run_async(ln_context *ctx, ln_run_callback callback,
+                                    void *data)
+{
+    if (!is_loaded(ctx))
+        ln_msg_error("ln_context_run_async() should be called after ln_context_load()");
+    if (ctx->async && ln_async_in_worker(ctx->async))
+        ln_msg_error("ln_context_run_async() can't be called in its callbacks");
+    if (!ctx->async)
+        ctx->async = ln_async_create(ctx);
+    ln_async_submit(ctx->async, callback, data);
+}
+
+/* Wait for all the runs submitted by ln_context_run_async() to finish. */
+LN_EXPORT void ln_context_wait(ln_context *ctx)
+{
+    if (!ctx->async)
+        return;
+    if (ln_async_in_worker(ctx->async))
+        ln_msg_error("ln_context_wait() can't be called in the callbacks of ln_context_run_async()");
+    ln_async_wait(ctx->async);
+}
+
 LN_EXPORT void ln_context_unload(ln_context *ctx)
 {
+    if (ctx->async) {
+        if (ln_async_in_worker(ctx->async))
+            ln_msg_error("ln_context_unload() can't be called in the callbacks of ln_context_run_async()");
+        ln_async_free(ctx->async);
+        ctx->async = NULL;
+    }
+    ln_op_steps_free(ctx->steps);
+    ctx->steps = NULL;
+    prefetch_free(ctx->prefetch);
+    ctx->prefetch = NULL;
     ln_context_dealloc_mem(ctx);
 }
 
@@ -153,6 +1255,7 @@ void ln_context_init_ops(ln_context *ctx)
     LN_LIST_FOREACH(op, ctx->ops) {
         init_op(ctx, op);
     }
+    ln_pass_mark_written_roots(ctx);
     ln_context_check(ctx);
 }
 
@@ -240,27 +1343,53 @@ int ln_context_check(const ln_context *ctx)
     /* return 0; */
 }
 
-void ln_context_alloc_mem(ln_context *ctx)
+/* Whether tensor `tname`'s data is in the weights, i.e. it is owned by a
+   static tensor that is not one of the inputs, and no op writes in its run. */
+int ln_context_is_weight(const ln_context *ctx, const char *tname)
+{
+    ln_tensor_entry *te;
+
+    te = ln_tensor_table_find_root(ctx->tensor_table, tname);
+    assert(te);
+    return te->isstatic && !te->written &&
+        !(ctx->inputs && in_names(ctx->inputs, te->name));
+}
+
+/*
+ * Whether `op` computes the same outputs until one of its inputs is set,
+ * i.e. it has outputs and its inputs are all static (weights if
+ * `weights_only`) or in the hash set `consts` of the outputs of such ops
+ * before it.
+ */
+int ln_context_is_constant_op(const ln_context *ctx, const ln_op *op,
+                              ln_hash *consts, int weights_only)
 {
-    ln_op *op;
     ln_tensor_list_entry *tle;
     ln_tensor_entry *te;
-    size_t water_level;
-    int i;
 
-    for (i = LN_MEM_NONE+1; i < LN_MEM_TYPE_SIZE; i++) {
-        if (ctx->mem_sizes[i] == 0)
+    if (!op->op_arg->tensors_in || !op->op_arg->tensors_out)
+        return 0;
+    LN_LIST_FOREACH(tle, op->op_arg->tensors_in) {
+        if (ln_hash_find_extended(consts, tle->name, NULL, NULL))
             continue;
-        ctx->mem_starts[i] = ln_mem_type_info(i).alloc_func(ctx->mem_sizes[i]);
-        if (ln_mem_type_info(i).memset_func)
-            ln_mem_type_info(i).memset_func(ctx->mem_starts[i], 0,
-                                            ctx->mem_sizes[i]);
-        ln_msg_debug("allocate memory %s: %lu bytes at address %p",
-                     ln_mem_type_name(i), ctx->mem_sizes[i],
-                     ctx->mem_starts[i]);
-        if (ctx->mem_sizes[i])
-            assert(ctx->mem_starts[i]);
+        te = ln_tensor_table_find(ctx->tensor_table, tle->name);
+        if (!te->isstatic ||
+            (weights_only && !ln_context_is_weight(ctx, tle->name)))
+            return 0;
     }
+    return 1;
+}
+
+/* Point the data of the planned tensors to their memory. */
+static void assign_data(ln_context *ctx)
+{
+    ln_op *op;
+    ln_tensor_list_entry *tle;
+    ln_tensor_entry *te;
+    size_t water_level;
+    size_t size;
+    void *start, *mapped;
+
     LN_LIST_FOREACH(op, ctx->ops) {
         LN_LIST_FOREACH(tle, op->op_arg->tensors_out) {
             te = ln_tensor_table_find(op->op_arg->tensor_table, tle->name);
@@ -271,17 +1400,52 @@ void ln_context_alloc_mem(ln_context *ctx)
             if (te->offset == 0)
                 ln_msg_error("invalid data offset %p of tensor '%s'",
                              te->offset, te->name);
+            /* plans without weight sizes keep all tensors in mem_starts */
+            if (ctx->weight_sizes[te->mtype] &&
+                ln_context_is_weight(ctx, te->name)) {
+                start = ctx->weights->starts[te->mtype];
+                size = ctx->weight_sizes[te->mtype];
+            } else {
+                start = ctx->mem_starts[te->mtype];
+                size = ctx->mem_sizes[te->mtype];
+            }
             water_level = te->offset + tl_tensor_size(te->tensor);
-            if (water_level > ctx->mem_sizes[te->mtype])
+            if (water_level > size)
                 ln_msg_error("data of tensor '%s' exceeds planned %s memory size %lu by %lu bytes",
                              te->name, ln_mem_type_name(te->mtype),
-                             ctx->mem_sizes[te->mtype],
-                             water_level - ctx->mem_sizes[te->mtype]);
-            te->tensor->data = te->offset + ctx->mem_starts[te->mtype];
+                             size, water_level - size);
+            te->tensor->data = (char *)start + te->offset;
+            if (ctx->weights->nranges && te->mtype == LN_MEM_CPU &&
+                start == ctx->weights->starts[LN_MEM_CPU] &&
+                (mapped = mapped_data(ctx->weights, te->offset,
+                                      tl_tensor_size(te->tensor))))
+                te->tensor->data = mapped;
         }
     }
 }
 
+void ln_context_alloc_mem(ln_context *ctx)
+{
+    int i;
+
+    for (i = LN_MEM_NONE+1; i < LN_MEM_TYPE_SIZE; i++) {
+        if (ctx->mem_sizes[i] == 0)
+            continue;
+        ctx->mem_starts[i] = ln_mem_type_info(i).alloc_func(ctx->mem_sizes[i]);
+        if (ln_mem_type_info(i).memset_func)
+            ln_mem_type_info(i).memset_func(ctx->mem_starts[i], 0,
+                                            ctx->mem_sizes[i]);
+        ln_msg_debug("allocate memory %s: %lu bytes at address %p",
+                     ln_mem_type_name(i), ctx->mem_sizes[i],
+                     ctx->mem_starts[i]);
+        if (ctx->mem_sizes[i])
+            assert(ctx->mem_starts[i]);
+    }
+    if (!ctx->weights)
+        ctx->weights = weights_alloc(ctx->weight_sizes, 0);
+    assign_data(ctx);
+}
+
 void ln_context_dealloc_mem(ln_context *ctx)
 {
     int i;
@@ -295,4 +1459,8 @@ void ln_context_dealloc_mem(ln_context *ctx)
         ln_mem_type_info(i).free_func(ctx->mem_starts[i]);
         ctx->mem_starts[i] = 0;
     }
+    if (ctx->weights) {
+        weights_release(ctx->weights);
+        ctx->weights = NULL;
+    }
 }
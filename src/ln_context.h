@@ -30,6 +30,20 @@
 #include "ln_op.h"
 #include "ln_dfg.h"
 
+/* read-only segment holding the weights of a loaded model, shared by
+   refcount among the contexts of the same model */
+struct ln_weights;
+typedef struct ln_weights ln_weights;
+
+struct ln_async;
+typedef struct ln_async ln_async;
+
+struct ln_prefetch;
+typedef struct ln_prefetch ln_prefetch;
+
+/* steps ahead whose lazily mapped weights are prefetched in the first run */
+#define LN_CONTEXT_PREFETCH_STEPS 4
+
 struct ln_context {
     ln_hash     *tensor_table;
     ln_hash     *op_table;
@@ -37,9 +51,24 @@ struct ln_context {
     ln_list     *ops;
     void        *mem_starts[LN_MEM_TYPE_SIZE];
     size_t       mem_sizes[LN_MEM_TYPE_SIZE];
+    size_t       weight_sizes[LN_MEM_TYPE_SIZE];
+    ln_weights  *weights;
+    char        *inputs;        /* static tensors kept out of the weights */
+    size_t       mem_align;     /* min alignment of planned tensors */
+    ln_async    *async;         /* runner of ln_context_run_async() */
+    ln_op_step  *steps;         /* flattened runs of ops, when loaded */
+    int          load_threads;  /* threads loading weight files, 0 for all */
+    int          verify_weights; /* check CRC-32s of weight files */
+    int          lazy_weights;  /* map weight files instead of loading */
+    ln_prefetch *prefetch;      /* of the lazily mapped weights */
+    ln_weight_load_stat load_stat; /* of the last loaded weight file */
+    int          time_passes;   /* collect and print pass statistics */
+    ln_list     *pass_stats;    /* of the last compilation */
 };
 typedef struct ln_context ln_context;
 
+typedef void (*ln_run_callback)(ln_context *ctx, void *data);
+
 #ifdef __cplusplus
 LN_CPPSTART
 #endif
@@ -47,15 +76,38 @@ LN_CPPSTART
 ln_context *ln_context_create(void);
 void ln_context_free(ln_context *ctx);
 void ln_context_init(ln_context *ctx, const char *source);
+void ln_context_set_batch(ln_context *ctx, const char *inputs, int batch);
+void ln_context_set_dims(ln_context *ctx, const char *inputs, const int *dims);
+void ln_context_set_inputs(ln_context *ctx, const char *inputs);
+void ln_context_set_mem_align(ln_context *ctx, size_t align);
 void ln_context_compile(ln_context *ctx, const char *target, const char *datafile);
+void ln_context_set_time_passes(ln_context *ctx, int time_passes);
 void ln_context_print(const ln_context *ctx, const char *outfile);
+void ln_context_print_mem_plan(const ln_context *ctx, const char *outfile);
+void ln_context_set_load_threads(ln_context *ctx, int nthreads);
+void ln_context_set_verify_weights(ln_context *ctx, int verify);
+void ln_context_set_lazy_weights(ln_context *ctx, int lazy);
 void ln_context_load(ln_context *ctx, const char *datafile);
+size_t ln_context_loaded_bytes(const ln_context *ctx, double *time);
+void ln_context_share_weights(ln_context *ctx, const ln_context *src);
+void ln_context_save_weights(const ln_context *ctx, const char *file);
+void ln_context_map_weights(ln_context *ctx, const char *file);
 void ln_context_set_data(ln_context *ctx, const char *tname, const void *data);
 void *ln_context_get_data(ln_context *ctx, const char *tname, void *data);
+void ln_context_set_frame(ln_context *ctx, const char *tname, int frame,
+                          const void *data);
+void *ln_context_get_frame(ln_context *ctx, const char *tname, int frame,
+                           void *data);
 size_t ln_context_data_size(ln_context *ctx, const char *tname);
+int ln_context_data_shape(ln_context *ctx, const char *tname, int *dims);
+const char *ln_context_data_dtype(ln_context *ctx, const char *tname);
+void *ln_context_data_ptr(ln_context *ctx, const char *tname);
 void ln_context_set_param(ln_context *ctx, const char *opname,
                           const char *pname, ...);
 void ln_context_run(const ln_context *ctx);
+void ln_context_run_async(ln_context *ctx, ln_run_callback callback,
+                          void *data);
+void ln_context_wait(ln_context *ctx);
 void ln_context_unload(ln_context *ctx);
 void ln_context_cleanup(ln_context *ctx);
 
@@ -67,8 +119,13 @@ void ln_context_remove_op(ln_context *ctx, ln_list **positio);
 void ln_context_add_op(ln_context *ctx, ln_list **position, ln_op *new_op);
 void ln_context_subgraph(ln_context *ctx, ln_list *old_ops, ln_list *new_ops);
 int ln_context_check(const ln_context *ctx);
+int ln_context_is_weight(const ln_context *ctx, const char *tname);
+int ln_context_can_share_weights(const ln_context *ctx, const ln_context *src);
+int ln_context_is_constant_op(const ln_context *ctx, const ln_op *op,
+                              ln_hash *consts, int weights_only);
 void ln_context_alloc_mem(ln_context *ctx);
 void ln_context_dealloc_mem(ln_context *ctx);
+void ln_context_run_steps(const ln_context *ctx);
 
 #ifdef __cplusplus
 LN_CPPEND
@@ -22,6 +22,9 @@
 
 #include "ln_dfg.h"
 
+/* checks by the calling thread, for compile-time statistics */
+static __thread size_t checks = 0;
+
 static void ln_graph_node_free_wrapper(void *p)
 {
     ln_graph_node_free(p);
@@ -317,6 +320,7 @@ int ln_dfg_check(const ln_dfg *dfg)
     ln_op *op;
     char *tname;
 
+    checks++;
     LN_LIST_FOREACH(en, dfg->dangling_ins) {
         op = en->node->data;
         tname = en->edge_data;
@@ -333,6 +337,12 @@ int ln_dfg_check(const ln_dfg *dfg)
     return 1;
 }
 
+/* Return the number of ln_dfg_check() calls by the calling thread. */
+size_t ln_dfg_checks(void)
+{
+    return checks;
+}
+
 static void fprint_node(FILE *fp, const void *p)
 {
     const ln_op *op = p;
@@ -52,6 +52,7 @@ ln_op *ln_dfg_next(const ln_dfg *dfg, const ln_op *op, const char *tname);
 ln_list *ln_dfg_nexts(const ln_dfg *dfg, const ln_op *op, const char *tname);
 ln_op *ln_dfg_prev(const ln_dfg *dfg, const ln_op *op, const char *tname);
 int ln_dfg_check(const ln_dfg *dfg);
+size_t ln_dfg_checks(void);
 void ln_dfg_fprint(FILE *fp, const ln_dfg *dfg);
 void ln_dfg_print(const ln_dfg *dfg);
 
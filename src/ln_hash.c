@@ -26,6 +26,9 @@
 
 #define MAX_CAPACITY  (1 << 30)
 
+/* lookups by the calling thread, for compile-time statistics */
+static __thread size_t lookups = 0;
+
 static const int DEFAULT_INIT_CAPACITY = 16;
 static const float DEFAULT_LOAD_FACTOR = 0.75f;
 
@@ -179,6 +182,8 @@ int ln_hash_insert(ln_hash *hash, const void *key, void *value)
     int hash_value = hash->hash_func(key);
     int idx = index_of(hash_value, hash->capacity);
 
+    lookups++;
+
     for (hash_entry *e = hash->table[idx]; e; e = e->next) {
         if (e->hash_value == hash_value && !hash->cmp_func(key, e->key)) {
             if (value == e->value)
@@ -203,6 +208,9 @@ void *ln_hash_find(const ln_hash *hash, const void *key)
 {
     int hash_value = hash->hash_func(key);
     int idx = index_of(hash_value, hash->capacity);
+
+    lookups++;
+
     for (hash_entry *e = hash->table[idx]; e; e = e->next) {
         if (e->hash_value == hash_value && !hash->cmp_func(key, e->key))
             return e->value;
@@ -216,6 +224,9 @@ int ln_hash_find_extended(const ln_hash *hash, const void *key,
 {
     int hash_value = hash->hash_func(key);
     int idx = index_of(hash_value, hash->capacity);
+
+    lookups++;
+
     for (hash_entry *e = hash->table[idx]; e; e = e->next) {
         if (e->hash_value == hash_value && !hash->cmp_func(key, e->key)) {
             if (found_key)
@@ -232,6 +243,9 @@ int ln_hash_remove(ln_hash *hash, const void *key)
 {
     int hash_value = hash->hash_func(key);
     int idx = index_of(hash_value, hash->capacity);
+
+    lookups++;
+
     for (hash_entry **ep = &hash->table[idx]; *ep; ep = &(*ep)->next) {
         hash_entry *e = *ep;
         if (e->hash_value == hash_value && !hash->cmp_func(key, e->key)) {
@@ -244,6 +258,13 @@ int ln_hash_remove(ln_hash *hash, const void *key)
     return 0;
 }
 
+/* Return the number of lookups, insertions and removals done by the calling
+   thread in all hash tables. */
+size_t ln_hash_lookups(void)
+{
+    return lookups;
+}
+
 int ln_hash_size(ln_hash *hash)
 {
     return hash->size;
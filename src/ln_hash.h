@@ -60,6 +60,7 @@ int ln_hash_find_extended(const ln_hash *hash, const void *key, void **found_key
                           void **found_value);
 int ln_hash_remove(ln_hash *hash, const void *key);
 int ln_hash_size(ln_hash *hash);
+size_t ln_hash_lookups(void);
 
 #ifdef __cplusplus
 LN_CPPEND
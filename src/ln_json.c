@@ -21,12 +21,41 @@
  */
 
 #include <string.h>
+#include <ctype.h>
+#include <limits.h>
 #include <assert.h>
 #include "cJSON.h"
 #include "ln_json.h"
 
 #define MASK_32L 0xffffffff
-#define PARSE_ERROR(fmt, varg...) ln_msg_error("parse error: "fmt, ##varg)
+#define PARSE_ERROR(p, fmt, varg...)                                    \
+    ln_msg_error("parse error at line %d: "fmt, (p)->line, ##varg)
+
+/*
+ * The JSON IR is parsed in one pass from a FILE stream, without building a
+ * tree. An op is created as soon as its object in "ops" is complete, so the
+ * memory used by the parser is proportional to the biggest op.
+ */
+struct parser {
+    FILE   *fp;
+    int     line;
+    char   *buf;                /* the last string or number token */
+    size_t  len;
+    size_t  cap;
+};
+
+/* value of a param, before knowing its arg_name */
+struct value {
+    ln_param_type  type;
+    double         number;
+    ln_bool        boolean;
+    char          *string;
+    int            len;
+    int            cap;
+    double        *numbers;
+    char         **strings;
+    ln_bool       *bools;
+};
 
 static size_t int2size_t(int high, int low)
 {
@@ -44,483 +73,729 @@ static void size_t2int(size_t size, int *high, int *low)
     *low = size & MASK_32L;
 }
 
-static ln_list *parse_array_value(const cJSON *array_json,
-                                  const cJSON *name_json,
-                                  const cJSON *param_arg_name_json,
-                                  ln_list *param_list)
-{
-    ln_param_type first_type = LN_PARAM_INVALID;
-    ln_param_type type = LN_PARAM_INVALID;
-    cJSON *element_json;
-    int array_len = cJSON_GetArraySize(array_json);
-    char **array_string = NULL;
-    double *array_number = NULL;
-    ln_bool *array_bool = NULL;
-
-    /* check the consistence of elements' types */
-    int idx = 0;
-    cJSON_ArrayForEach(element_json, array_json) {
-        if (cJSON_IsNumber(element_json)) {
-            type = LN_PARAM_NUMBER;
-        }
-        else if (cJSON_IsString(element_json)) {
-            type = LN_PARAM_STRING;
-        }
-        else if (cJSON_IsTrue(element_json)) {
-            type = LN_PARAM_BOOL;
+/* saturating conversion, as cJSON's valueint */
+static int double2int(double number)
+{
+    if (number >= INT_MAX)
+        return INT_MAX;
+    if (number <= (double)INT_MIN)
+        return INT_MIN;
+    return (int)number;
+}
+
+static int get_char(struct parser *p)
+{
+    int c;
+
+    c = getc_unlocked(p->fp);
+    if (c == '\n')
+        p->line++;
+    return c;
+}
+
+static void unget_char(struct parser *p, int c)
+{
+    if (c == EOF)
+        return;
+    if (c == '\n')
+        p->line--;
+    ungetc(c, p->fp);
+}
+
+/* Skip blanks and C-style comments. */
+static void skip_space(struct parser *p)
+{
+    int c, line;
+
+    while ((c = get_char(p)) != EOF) {
+        if (isspace(c))
+            continue;
+        if (c != '/') {
+            unget_char(p, c);
+            return;
         }
-        else if (cJSON_IsFalse(element_json)) {
-            type = LN_PARAM_BOOL;
+        line = p->line;
+        c = get_char(p);
+        if (c == '/') {
+            while ((c = get_char(p)) != EOF && c != '\n')
+                ;
+        } else if (c == '*') {
+            int last = 0;
+            while ((c = get_char(p)) != EOF && !(last == '*' && c == '/'))
+                last = c;
+            if (c == EOF)
+                ln_msg_error("parse error at line %d: unterminated comment",
+                             line);
+        } else {
+            PARSE_ERROR(p, "unexpected '/'");
         }
-        else {
-            PARSE_ERROR("op %s's param %s's value has an unsupported JSON array element type at element index %d",
-                             name_json->valuestring,
-                             param_arg_name_json->valuestring, idx);
+    }
+}
+
+static int peek_char(struct parser *p)
+{
+    int c;
+
+    skip_space(p);
+    c = get_char(p);
+    unget_char(p, c);
+    return c;
+}
+
+static void expect_char(struct parser *p, int expected)
+{
+    int c;
+
+    skip_space(p);
+    if ((c = get_char(p)) != expected) {
+        if (c == EOF)
+            PARSE_ERROR(p, "expect '%c' but reach the end", expected);
+        PARSE_ERROR(p, "expect '%c' but get '%c'", expected, c);
+    }
+}
+
+/*
+ * Iterate the members of an object or the elements of an array, whose
+ * opening bracket has been consumed. Return 0 at the `close` bracket.
+ */
+static int next_item(struct parser *p, int close, int *first)
+{
+    int c;
+
+    skip_space(p);
+    c = get_char(p);
+    if (c == close)
+        return 0;
+    if (!*first && c != ',')
+        PARSE_ERROR(p, "expect ',' or '%c'", close);
+    if (*first)
+        unget_char(p, c);
+    *first = 0;
+    return 1;
+}
+
+static void buf_clear(struct parser *p)
+{
+    if (!p->buf) {
+        p->cap = 256;
+        p->buf = ln_alloc(p->cap);
+    }
+    p->len = 0;
+    p->buf[0] = '\0';
+}
+
+static void buf_push(struct parser *p, char c)
+{
+    if (p->len + 1 >= p->cap) {
+        p->cap = p->cap ? p->cap * 2 : 256;
+        p->buf = ln_realloc(p->buf, p->cap);
+    }
+    p->buf[p->len++] = c;
+    p->buf[p->len] = '\0';
+}
+
+static void buf_push_utf8(struct parser *p, unsigned long cp)
+{
+    if (cp < 0x80) {
+        buf_push(p, cp);
+    } else if (cp < 0x800) {
+        buf_push(p, 0xc0 | (cp >> 6));
+        buf_push(p, 0x80 | (cp & 0x3f));
+    } else if (cp < 0x10000) {
+        buf_push(p, 0xe0 | (cp >> 12));
+        buf_push(p, 0x80 | ((cp >> 6) & 0x3f));
+        buf_push(p, 0x80 | (cp & 0x3f));
+    } else {
+        buf_push(p, 0xf0 | (cp >> 18));
+        buf_push(p, 0x80 | ((cp >> 12) & 0x3f));
+        buf_push(p, 0x80 | ((cp >> 6) & 0x3f));
+        buf_push(p, 0x80 | (cp & 0x3f));
+    }
+}
+
+static unsigned long parse_hex4(struct parser *p)
+{
+    unsigned long cp = 0;
+    int c, i;
+
+    for (i = 0; i < 4; i++) {
+        c = get_char(p);
+        if (!isxdigit(c))
+            PARSE_ERROR(p, "invalid \\u escape in a String");
+        cp = cp * 16 + (isdigit(c) ? c - '0' : tolower(c) - 'a' + 10);
+    }
+    return cp;
+}
+
+/* Parse a String to p->buf, which is valid till the next token. */
+static char *parse_string(struct parser *p)
+{
+    unsigned long cp, low;
+    int c;
+
+    expect_char(p, '"');
+    buf_clear(p);
+    while ((c = get_char(p)) != '"') {
+        if (c == EOF)
+            PARSE_ERROR(p, "unterminated String");
+        if (c != '\\') {
+            buf_push(p, c);
+            continue;
         }
-        if (first_type == LN_PARAM_INVALID) {
-            first_type = type;
-            switch (first_type) {
-            case LN_PARAM_STRING:
-                array_string = ln_alloc(sizeof(char *)*array_len);
-                break;
-            case LN_PARAM_NUMBER:
-                array_number = ln_alloc(sizeof(double)*array_len);
-                break;
-            case LN_PARAM_BOOL:
-                array_bool = ln_alloc(sizeof(ln_bool)*array_len);
-                break;
-            default:
-                assert(0 && "handled before, shouldn't get here");
-                break;
+        switch (c = get_char(p)) {
+        case '"': case '\\': case '/': buf_push(p, c); break;
+        case 'b': buf_push(p, '\b'); break;
+        case 'f': buf_push(p, '\f'); break;
+        case 'n': buf_push(p, '\n'); break;
+        case 'r': buf_push(p, '\r'); break;
+        case 't': buf_push(p, '\t'); break;
+        case 'u':
+            cp = parse_hex4(p);
+            if (cp >= 0xd800 && cp <= 0xdbff) {
+                if (get_char(p) != '\\' || get_char(p) != 'u')
+                    PARSE_ERROR(p, "invalid UTF-16 surrogate pair in a String");
+                low = parse_hex4(p);
+                if (low < 0xdc00 || low > 0xdfff)
+                    PARSE_ERROR(p, "invalid UTF-16 surrogate pair in a String");
+                cp = 0x10000 + ((cp - 0xd800) << 10) + (low - 0xdc00);
             }
-        }
-        else if (first_type != type) {
-            PARSE_ERROR("op %s's param %s's value is inconsistent among its elements' JSON type at element index %d",
-                              name_json->valuestring,
-                              param_arg_name_json->valuestring, idx);
-        }
-        switch (type) {
-        case LN_PARAM_STRING:
-            array_string[idx] =
-                ln_alloc(sizeof(char)*(strlen(element_json->valuestring)+1));
-            strcpy(array_string[idx], element_json->valuestring);
-            break;
-        case LN_PARAM_NUMBER:
-            array_number[idx] = element_json->valuedouble;
-            break;
-        case LN_PARAM_BOOL:
-            array_bool[idx] = cJSON_IsTrue(element_json) ? LN_TRUE : LN_FALSE;
+            buf_push_utf8(p, cp);
             break;
         default:
-            assert(0 && "handled before, shouldn't get here");
+            PARSE_ERROR(p, "invalid escape in a String");
             break;
         }
-        idx++;
     }
 
-    assert(idx == array_len);
+    return p->buf;
+}
+
+static double parse_number(struct parser *p)
+{
+    double number;
+    char *end;
+    int c;
+
+    skip_space(p);
+    buf_clear(p);
+    while ((c = get_char(p)) != EOF &&
+           (isdigit(c) || c == '-' || c == '+' || c == '.' || c == 'e' ||
+            c == 'E'))
+        buf_push(p, c);
+    unget_char(p, c);
+    if (p->len == 0)
+        PARSE_ERROR(p, "expect a Number");
+    number = strtod(p->buf, &end);
+    if (*end)
+        PARSE_ERROR(p, "invalid Number %s", p->buf);
+
+    return number;
+}
+
+/* Parse true, false or null, returning the first letter. */
+static int parse_literal(struct parser *p)
+{
+    static const char *literals[] = {"true", "false", "null"};
+    const char *literal;
+    int c, i;
+
+    skip_space(p);
+    c = get_char(p);
+    for (i = 0; i < 3; i++) {
+        if (c != literals[i][0])
+            continue;
+        for (literal = literals[i] + 1; *literal; literal++)
+            if (get_char(p) != *literal)
+                PARSE_ERROR(p, "invalid literal, expect %s", literals[i]);
+        return c;
+    }
+    PARSE_ERROR(p, "unexpected '%c'", c);
+    return c;
+}
+
+static char *parse_key(struct parser *p)
+{
+    char *key;
+
+    if (peek_char(p) != '"')
+        PARSE_ERROR(p, "expect a String as the key of an Object");
+    key = parse_string(p);
+    expect_char(p, ':');
+    return key;
+}
+
+static int is_number_start(int c)
+{
+    return isdigit(c) || c == '-';
+}
+
+static void skip_value(struct parser *p)
+{
+    int c, first = 1;
+
+    c = peek_char(p);
+    if (c == '"') {
+        parse_string(p);
+    } else if (is_number_start(c)) {
+        parse_number(p);
+    } else if (c == '{') {
+        expect_char(p, '{');
+        while (next_item(p, '}', &first)) {
+            parse_key(p);
+            skip_value(p);
+        }
+    } else if (c == '[') {
+        expect_char(p, '[');
+        while (next_item(p, ']', &first))
+            skip_value(p);
+    } else {
+        parse_literal(p);
+    }
+}
+
+static ln_param_type parse_scalar(struct parser *p, struct value *v)
+{
+    int c;
+
+    c = peek_char(p);
+    if (c == '"') {
+        parse_string(p);
+        return LN_PARAM_STRING;
+    }
+    if (is_number_start(c)) {
+        v->number = parse_number(p);
+        return LN_PARAM_NUMBER;
+    }
+    if (c == '[' || c == '{')
+        return LN_PARAM_INVALID;
+    c = parse_literal(p);
+    if (c == 'n')
+        return LN_PARAM_NULL;
+    v->boolean = c == 't' ? LN_TRUE : LN_FALSE;
+    return LN_PARAM_BOOL;
+}
+
+static void value_free(struct value *v)
+{
+    int i;
+
+    ln_free(v->string);
+    ln_free(v->numbers);
+    ln_free(v->bools);
+    if (v->strings) {
+        for (i = 0; i < v->len; i++)
+            ln_free(v->strings[i]);
+        ln_free(v->strings);
+    }
+    memset(v, 0, sizeof(*v));
+    v->type = LN_PARAM_INVALID;
+}
+
+static void parse_array_value(struct parser *p, struct value *v,
+                              const char *op_name, const char *arg_name)
+{
+    ln_param_type type, first_type = LN_PARAM_INVALID;
+    int first = 1;
+
+    expect_char(p, '[');
+    while (next_item(p, ']', &first)) {
+        type = parse_scalar(p, v);
+        if (type == LN_PARAM_INVALID || type == LN_PARAM_NULL)
+            PARSE_ERROR(p, "op %s's param %s's value has an unsupported JSON array element type at element index %d",
+                        op_name, arg_name, v->len);
+        if (first_type == LN_PARAM_INVALID)
+            first_type = type;
+        else if (first_type != type)
+            PARSE_ERROR(p, "op %s's param %s's value is inconsistent among its elements' JSON type at element index %d",
+                        op_name, arg_name, v->len);
+        if (v->len == v->cap) {
+            v->cap = v->cap ? v->cap * 2 : 8;
+            if (type == LN_PARAM_NUMBER)
+                v->numbers = ln_realloc(v->numbers, sizeof(double) * v->cap);
+            else if (type == LN_PARAM_STRING)
+                v->strings = ln_realloc(v->strings, sizeof(char *) * v->cap);
+            else
+                v->bools = ln_realloc(v->bools, sizeof(ln_bool) * v->cap);
+        }
+        if (type == LN_PARAM_NUMBER)
+            v->numbers[v->len++] = v->number;
+        else if (type == LN_PARAM_STRING)
+            v->strings[v->len++] = ln_strdup(p->buf);
+        else
+            v->bools[v->len++] = v->boolean;
+    }
+
     switch (first_type) {
     case LN_PARAM_STRING:
-        param_list = ln_param_list_append_array_string(param_list,
-                                                       param_arg_name_json->valuestring,
-                                                       array_len, (const char **)array_string);
+        v->type = LN_PARAM_ARRAY_STRING;
         break;
     case LN_PARAM_NUMBER:
-        param_list = ln_param_list_append_array_number(param_list,
-                                                       param_arg_name_json->valuestring,
-                                                       array_len, array_number);
+        v->type = LN_PARAM_ARRAY_NUMBER;
         break;
     case LN_PARAM_BOOL:
-        param_list = ln_param_list_append_array_bool(param_list,
-                                                     param_arg_name_json->valuestring,
-                                                     array_len, array_bool);
-        break;
-    case LN_PARAM_INVALID:
-        assert(array_len == 0);
-        PARSE_ERROR("op %s's param %s's value is an empty array",
-                         name_json->valuestring,
-                         param_arg_name_json->valuestring);
+        v->type = LN_PARAM_ARRAY_BOOL;
         break;
     default:
-        assert(0 && "handled before, shouldn't get here");
+        PARSE_ERROR(p, "op %s's param %s's value is an empty array",
+                    op_name, arg_name);
         break;
     }
+}
 
-    if (array_bool)
-        ln_free(array_bool);
-    if (array_number)
-        ln_free(array_number);
-    if (array_string) {
-        for (int i = 0; i < array_len; i++)
-            ln_free(array_string[i]);
-        ln_free(array_string);
+static void parse_value(struct parser *p, struct value *v,
+                        const char *op_name, const char *arg_name)
+{
+    value_free(v);
+    if (peek_char(p) == '[') {
+        parse_array_value(p, v, op_name, arg_name);
+        return;
     }
+    v->type = parse_scalar(p, v);
+    if (v->type == LN_PARAM_INVALID)
+        PARSE_ERROR(p, "op %s's param %s's value is an unsupported JSON type",
+                    op_name, arg_name);
+    if (v->type == LN_PARAM_STRING)
+        v->string = ln_strdup(p->buf);
+}
 
-    return param_list;
+static ln_list *append_param(ln_list *params, const char *arg_name,
+                             const struct value *v)
+{
+    switch (v->type) {
+    case LN_PARAM_NULL:
+        return ln_param_list_append_null(params, arg_name);
+    case LN_PARAM_STRING:
+        return ln_param_list_append_string(params, arg_name, v->string);
+    case LN_PARAM_NUMBER:
+        return ln_param_list_append_number(params, arg_name, v->number);
+    case LN_PARAM_BOOL:
+        return ln_param_list_append_bool(params, arg_name, v->boolean);
+    case LN_PARAM_ARRAY_STRING:
+        return ln_param_list_append_array_string(params, arg_name, v->len,
+                                                 (const char **)v->strings);
+    case LN_PARAM_ARRAY_NUMBER:
+        return ln_param_list_append_array_number(params, arg_name, v->len,
+                                                 v->numbers);
+    case LN_PARAM_ARRAY_BOOL:
+        return ln_param_list_append_array_bool(params, arg_name, v->len,
+                                               v->bools);
+    default:
+        assert(0 && "handled before, shouldn't get here");
+        return params;
+    }
 }
 
-static size_t parse_offset(const cJSON *tensor_json)
+static ln_list *parse_param(struct parser *p, const char *op_name, int idx,
+                            ln_list *params)
 {
-    const cJSON *offset_h_json;
-    const cJSON *offset_l_json;
+    struct value v;
+    char *arg_name = NULL;
+    char *key;
+    int first = 1;
+
+    memset(&v, 0, sizeof(v));
+    v.type = LN_PARAM_INVALID;
+    if (peek_char(p) != '{')
+        PARSE_ERROR(p, "one of op %s's params is not an Object at param index %d",
+                    op_name, idx);
+    expect_char(p, '{');
+    while (next_item(p, '}', &first)) {
+        key = parse_key(p);
+        if (ln_streq(key, "arg_name")) {
+            if (peek_char(p) != '"')
+                PARSE_ERROR(p, "one of op %s's params's arg_name is not a String at param index %d",
+                            op_name, idx);
+            ln_free(arg_name);
+            arg_name = ln_strdup(parse_string(p));
+        } else if (ln_streq(key, "value")) {
+            parse_value(p, &v, op_name, arg_name ? arg_name : "?");
+        } else {
+            skip_value(p);
+        }
+    }
+    if (!arg_name)
+        PARSE_ERROR(p, "one of op %s's params doesn't have an \"arg_name\" key at param index %d",
+                    op_name, idx);
+    if (v.type == LN_PARAM_INVALID)
+        PARSE_ERROR(p, "op %s's %s param doesn't have a \"value\" key",
+                    op_name, arg_name);
+
+    params = append_param(params, arg_name, &v);
+    value_free(&v);
+    ln_free(arg_name);
+    return params;
+}
 
-    offset_h_json = cJSON_GetObjectItem(tensor_json, "offset_h");
-    offset_l_json = cJSON_GetObjectItem(tensor_json, "offset_l");
-    if (!offset_h_json || !offset_l_json)
-        return 0;
+static ln_list *parse_tensor(struct parser *p, const char *op_name,
+                             const char *kind, int idx, ln_list *tensors)
+{
+    ln_tensor_list_entry *tle;
+    char *arg_name = NULL;
+    char *name = NULL;
+    int offset_h = 0, offset_l = 0;
+    int has_offset_h = 0, has_offset_l = 0;
+    char *key;
+    int first = 1;
+
+    if (peek_char(p) != '{')
+        PARSE_ERROR(p, "one of op %s's %s tensors is not an Object at tensor index %d",
+                    op_name, kind, idx);
+    expect_char(p, '{');
+    while (next_item(p, '}', &first)) {
+        key = parse_key(p);
+        if (ln_streq(key, "arg_name")) {
+            if (peek_char(p) != '"')
+                PARSE_ERROR(p, "one of op %s's %s tensors's arg_name is not a String at tensor index %d",
+                            op_name, kind, idx);
+            ln_free(arg_name);
+            arg_name = ln_strdup(parse_string(p));
+        } else if (ln_streq(key, "name")) {
+            if (peek_char(p) != '"')
+                PARSE_ERROR(p, "op %s's %s tensor at index %d's name is not a String",
+                            op_name, kind, idx);
+            ln_free(name);
+            name = ln_strdup(parse_string(p));
+        } else if (ln_streq(key, "offset_h") || ln_streq(key, "offset_l")) {
+            int is_h = key[7] == 'h';
+            if (!is_number_start(peek_char(p)))
+                PARSE_ERROR(p, "op %s's %s tensor at index %d's 'offset_h' and 'offset_l' should be Numbers",
+                            op_name, kind, idx);
+            if (is_h) {
+                offset_h = double2int(parse_number(p));
+                has_offset_h = 1;
+            } else {
+                offset_l = double2int(parse_number(p));
+                has_offset_l = 1;
+            }
+        } else {
+            skip_value(p);
+        }
+    }
+    if (!arg_name)
+        PARSE_ERROR(p, "one of op %s's %s tensors doesn't have an \"arg_name\" key at tensor index %d",
+                    op_name, kind, idx);
+    if (!name)
+        PARSE_ERROR(p, "op %s's tensor %s doesn't have a \"name\" key",
+                    op_name, arg_name);
+
+    tle = ln_tensor_list_entry_create(arg_name, name);
+    if (has_offset_h && has_offset_l)
+        tle->offset = int2size_t(offset_h, offset_l);
+    ln_free(arg_name);
+    ln_free(name);
+    return ln_list_append(tensors, tle);
+}
 
-    if (!cJSON_IsNumber(offset_h_json) || !cJSON_IsNumber(offset_l_json))
-        PARSE_ERROR("op %s's tensor %s's 'offset_h' and 'offset_l' should be Numbers",
-                    cJSON_GetObjectItem(tensor_json, "name")->valuestring,
-                    cJSON_GetObjectItem(tensor_json, "arg_name")->valuestring);
+static ln_list *parse_tensors(struct parser *p, const char *op_name,
+                              const char *key, const char *kind)
+{
+    ln_list *tensors = NULL;
+    int first = 1;
+    int i = 0;
 
-    return int2size_t(offset_h_json->valueint, offset_l_json->valueint);
+    if (peek_char(p) != '[')
+        PARSE_ERROR(p, "op %s's \"%s\" is not an Array", op_name, key);
+    expect_char(p, '[');
+    while (next_item(p, ']', &first))
+        tensors = parse_tensor(p, op_name, kind, i++, tensors);
+    return tensors;
 }
 
-static ln_op *parse_op(const cJSON *op_json, ln_context *ctx, int idx)
+static ln_op *parse_op(struct parser *p, ln_context *ctx, int idx)
 {
-    ln_op *op, *proto_op;
+    char label[LN_MAX_NAME_LEN];
+    char *name = NULL;
+    char *optype = NULL;
     ln_list *tensors_in = NULL;
     ln_list *tensors_out = NULL;
     ln_list *params = NULL;
-
-    cJSON *name_json = cJSON_GetObjectItem(op_json, "name");
-    cJSON *optype_json = cJSON_GetObjectItem(op_json, "optype");
-    cJSON *tensors_in_json = cJSON_GetObjectItem(op_json, "tensors_in");
-    cJSON *tensors_out_json = cJSON_GetObjectItem(op_json, "tensors_out");
-    cJSON *params_json = cJSON_GetObjectItem(op_json, "params");
-
-    if (!name_json)
-        PARSE_ERROR("ops[%d] doesn't have a \"name\" key", idx);
-
-    if (!cJSON_IsString(name_json))
-        PARSE_ERROR("ops[%d]'s name is not a String", idx);
-
-    if (!optype_json)
-        PARSE_ERROR("op %s doesn't have an \"optype\" key",
-                         name_json->valuestring);
-
-    if (!cJSON_IsString(optype_json))
-        PARSE_ERROR("op %s's \"optype\" is not a String",
-                         name_json->valuestring);
-
-    if (!tensors_in_json)
-        PARSE_ERROR("op %s doesn't have a \"tensors_in\" key",
-                         name_json->valuestring);
-
-    if (!tensors_out_json)
-        PARSE_ERROR("op %s doesn't have a \"tensors_out\" key",
-                         name_json->valuestring);
-
-    if (!cJSON_IsArray(tensors_in_json))
-        PARSE_ERROR("op %s's \"tensors_in\" is not an Array",
-                         name_json->valuestring);
-
-    if (!cJSON_IsArray(tensors_out_json))
-        PARSE_ERROR("op %s's \"tensors_out\" is not an Array",
-                         name_json->valuestring);
-
-    if (!params_json)
-        PARSE_ERROR("op %s doesn't have a \"params\" key",
-                         name_json->valuestring);
-
-    if (!cJSON_IsArray(params_json))
-        PARSE_ERROR("op %s's \"params\" is not an Array",
-                         name_json->valuestring);
-
-    cJSON *tensor_json, *param_json;
-    cJSON *tensor_arg_name_json, *tensor_name_json;
-    cJSON *param_arg_name_json, *param_value_json;
-    ln_tensor_list_entry *tle;
-    int i = 0;
-    cJSON_ArrayForEach(tensor_json, tensors_in_json) {
-        tensor_arg_name_json = cJSON_GetObjectItem(tensor_json, "arg_name");
-        tensor_name_json = cJSON_GetObjectItem(tensor_json, "name");
-        if (!tensor_arg_name_json)
-            PARSE_ERROR("one of op %s's input tensors doesn't have an \"arg_name\" key at tensor index %d",
-                             name_json->valuestring, i);
-
-        if (!cJSON_IsString(tensor_arg_name_json))
-            PARSE_ERROR("one of op %s's input tensors's arg_name is not a String at tensor index %d",
-                             name_json->valuestring, i);
-
-        if (!tensor_name_json)
-            PARSE_ERROR("op %s's tensor %s doesn't have a \"name\" key",
-                             name_json->valuestring,
-                             tensor_arg_name_json->valuestring);
-
-        if (!cJSON_IsString(tensor_name_json))
-            PARSE_ERROR("op %s's tensor %s's name is not a String",
-                             name_json->valuestring,
-                             tensor_arg_name_json->valuestring);
-
-        tle = ln_tensor_list_entry_create(tensor_arg_name_json->valuestring,
-                                          tensor_name_json->valuestring);
-        tle->offset = parse_offset(tensor_json);
-        tensors_in = ln_list_append(tensors_in, tle);
-        i++;
-    }
-    i = 0;
-    cJSON_ArrayForEach(tensor_json, tensors_out_json) {
-        tensor_arg_name_json = cJSON_GetObjectItem(tensor_json, "arg_name");
-        tensor_name_json = cJSON_GetObjectItem(tensor_json, "name");
-        if (!tensor_arg_name_json)
-            PARSE_ERROR("one of op %s's output tensors doesn't have an \"arg_name\" key at tensor index %d",
-                             name_json->valuestring, i);
-
-        if (!cJSON_IsString(tensor_arg_name_json))
-            PARSE_ERROR("one of op %s's output tensors's arg_name is not a String at tensor index %d",
-                             name_json->valuestring, i);
-
-        if (!tensor_name_json)
-            PARSE_ERROR("op %s's tensor %s doesn't have a \"name\" key",
-                             name_json->valuestring,
-                             tensor_arg_name_json->valuestring);
-
-        if (!cJSON_IsString(tensor_name_json))
-            PARSE_ERROR("op %s's tensor %s's name is not a String",
-                             name_json->valuestring,
-                             tensor_arg_name_json->valuestring);
-
-        tle = ln_tensor_list_entry_create(tensor_arg_name_json->valuestring,
-                                          tensor_name_json->valuestring);
-        tle->offset = parse_offset(tensor_json);
-        tensors_out = ln_list_append(tensors_out, tle);
-        i++;
-    }
-    i = 0;
-    cJSON_ArrayForEach(param_json, params_json) {
-        param_arg_name_json = cJSON_GetObjectItem(param_json, "arg_name");
-        if (!param_arg_name_json)
-            PARSE_ERROR("one of op %s's params doesn't have an \"arg_name\" key at param index %d",
-                             name_json->valuestring, i);
-
-        if (!cJSON_IsString(param_arg_name_json))
-            PARSE_ERROR("one of op %s's params's arg_name is not a String at param index %d",
-                             name_json->valuestring);
-
-        param_value_json = cJSON_GetObjectItem(param_json, "value");
-
-        if (!param_value_json)
-            PARSE_ERROR("op %s's %s param doesn't have a \"value\" key",
-                             name_json->valuestring,
-                             param_arg_name_json->valuestring);
-
-        if (cJSON_IsNumber(param_value_json)) {
-            params = ln_param_list_append_number(params,
-                                                 param_arg_name_json->valuestring,
-                                                 param_value_json->valuedouble);
-        }
-        else if (cJSON_IsString(param_value_json)) {
-            params = ln_param_list_append_string(params,
-                                                 param_arg_name_json->valuestring,
-                                                 param_value_json->valuestring);
-        }
-        else if (cJSON_IsTrue(param_value_json)) {
-            params = ln_param_list_append_bool(params,
-                                               param_arg_name_json->valuestring,
-                                               LN_TRUE);
-        }
-        else if (cJSON_IsFalse(param_value_json)) {
-            params = ln_param_list_append_bool(params,
-                                               param_arg_name_json->valuestring,
-                                               LN_FALSE);
-        }
-        else if (cJSON_IsNull(param_value_json)) {
-            params = ln_param_list_append_null(params,
-                                               param_arg_name_json->valuestring);
-        }
-        else if (cJSON_IsArray(param_value_json)) {
-            params = parse_array_value(param_value_json, name_json,
-                                       param_arg_name_json, params);
-        }
-        else {
-            PARSE_ERROR("op %s's param %s's value is an unsupported JSON type",
-                             name_json->valuestring,
-                             param_arg_name_json->valuestring);
+    int has_tensors_in = 0, has_tensors_out = 0, has_params = 0;
+    int first = 1, first_param, i;
+    ln_op *op, *proto_op;
+    char *key;
+
+    /* name the op by its index till its name is known */
+    snprintf(label, sizeof(label), "ops[%d]", idx);
+    if (peek_char(p) != '{')
+        PARSE_ERROR(p, "ops[%d] is not an Object", idx);
+    expect_char(p, '{');
+    while (next_item(p, '}', &first)) {
+        key = parse_key(p);
+        if (ln_streq(key, "name")) {
+            if (peek_char(p) != '"')
+                PARSE_ERROR(p, "ops[%d]'s name is not a String", idx);
+            ln_free(name);
+            name = ln_strdup(parse_string(p));
+            snprintf(label, sizeof(label), "%s", name);
+        } else if (ln_streq(key, "optype")) {
+            if (peek_char(p) != '"')
+                PARSE_ERROR(p, "op %s's \"optype\" is not a String", label);
+            ln_free(optype);
+            optype = ln_strdup(parse_string(p));
+        } else if (ln_streq(key, "tensors_in")) {
+            tensors_in = parse_tensors(p, label, "tensors_in", "input");
+            has_tensors_in = 1;
+        } else if (ln_streq(key, "tensors_out")) {
+            tensors_out = parse_tensors(p, label, "tensors_out", "output");
+            has_tensors_out = 1;
+        } else if (ln_streq(key, "params")) {
+            if (peek_char(p) != '[')
+                PARSE_ERROR(p, "op %s's \"params\" is not an Array", label);
+            expect_char(p, '[');
+            first_param = 1;
+            i = 0;
+            while (next_item(p, ']', &first_param))
+                params = parse_param(p, label, i++, params);
+            has_params = 1;
+        } else {
+            skip_value(p);
         }
-        i++;
     }
-    proto_op = ln_hash_find(LN_ARCH.op_proto_table, optype_json->valuestring);
-    if (!proto_op) {
-        PARSE_ERROR("op %s's optype %s is not registered",
-                         name_json->valuestring,
-                         optype_json->valuestring);
-    }
-
-    op = ln_op_create_from_proto(proto_op, name_json->valuestring, tensors_in,
-                                 tensors_out, params, ctx->tensor_table);
 
+    if (!name)
+        PARSE_ERROR(p, "ops[%d] doesn't have a \"name\" key", idx);
+    if (!optype)
+        PARSE_ERROR(p, "op %s doesn't have an \"optype\" key", name);
+    if (!has_tensors_in)
+        PARSE_ERROR(p, "op %s doesn't have a \"tensors_in\" key", name);
+    if (!has_tensors_out)
+        PARSE_ERROR(p, "op %s doesn't have a \"tensors_out\" key", name);
+    if (!has_params)
+        PARSE_ERROR(p, "op %s doesn't have a \"params\" key", name);
+
+    proto_op = ln_hash_find(LN_ARCH.op_proto_table, optype);
+    if (!proto_op)
+        PARSE_ERROR(p, "op %s's optype %s is not registered", name, optype);
+
+    op = ln_op_create_from_proto(proto_op, name, tensors_in, tensors_out,
+                                 params, ctx->tensor_table);
+    ln_free(name);
+    ln_free(optype);
     return op;
 }
 
-static void parse_mem_sizes(const cJSON *json, ln_context *ctx)
+struct sizes {
+    int n;
+    int values[LN_MEM_TYPE_SIZE];
+};
+
+static void parse_sizes(struct parser *p, const char *key, struct sizes *sizes)
+{
+    int first = 1;
+
+    if (peek_char(p) != '[')
+        PARSE_ERROR(p, "'%s' should be an array", key);
+    expect_char(p, '[');
+    sizes->n = 0;
+    while (next_item(p, ']', &first)) {
+        if (!is_number_start(peek_char(p)))
+            PARSE_ERROR(p, "the %dth element of '%s' is not a number",
+                        sizes->n, key);
+        if (sizes->n >= LN_MEM_TYPE_SIZE)
+            PARSE_ERROR(p, "the length of '%s' is larger than LN_MEM_TYPE_SIZE %d",
+                        key, LN_MEM_TYPE_SIZE);
+        sizes->values[sizes->n++] = double2int(parse_number(p));
+    }
+}
+
+static void set_sizes(struct parser *p, const char *key_h, const char *key_l,
+                      const struct sizes *sizes_h, const struct sizes *sizes_l,
+                      size_t *sizes)
 {
-    const cJSON *mem_sizes_h_json;
-    const cJSON *mem_sizes_l_json;
-    cJSON *h_json;
-    cJSON *l_json;
-    int array_size;
     int i;
 
-    mem_sizes_h_json = cJSON_GetObjectItem(json, "mem_sizes_h");
-    mem_sizes_l_json = cJSON_GetObjectItem(json, "mem_sizes_l");
-    if (!mem_sizes_h_json || !mem_sizes_l_json)
+    if (sizes_h->n < 0 || sizes_l->n < 0)
         return;
-
-    if (!cJSON_IsArray(mem_sizes_h_json) ||
-        !cJSON_IsArray(mem_sizes_l_json))
-        PARSE_ERROR("'mem_sizes_h' and 'mem_sizes_l' should be arrays");
-
-    array_size = cJSON_GetArraySize(mem_sizes_h_json);
-    if (array_size != cJSON_GetArraySize(mem_sizes_l_json))
-        PARSE_ERROR("the length of 'mem_sizes_h' and 'mem_sizes_l' is not equal");
-    if (array_size != LN_MEM_TYPE_SIZE)
-        PARSE_ERROR("the length of 'mem_sizes_h' and 'mem_sizes_l' is not equal to LN_MEM_TYPE_SIZE %d",
-                         LN_MEM_TYPE_SIZE);
-    for (i = 0, h_json = mem_sizes_h_json->child,
-             l_json = mem_sizes_l_json->child;
-         i < array_size && h_json && l_json;
-         i++, h_json = h_json->next, l_json = l_json->next) {
-        if (!cJSON_IsNumber(h_json))
-            PARSE_ERROR("the %dth element of 'mem_sizes_h' is not a number",
-                             i);
-        if (!cJSON_IsNumber(l_json))
-            PARSE_ERROR("the %dth element of 'mem_sizes_l' is not a number",
-                             i);
-         ctx->mem_sizes[i] = int2size_t(h_json->valueint, l_json->valueint);
-    }
+    if (sizes_h->n != sizes_l->n)
+        PARSE_ERROR(p, "the length of '%s' and '%s' is not equal", key_h, key_l);
+    if (sizes_h->n != LN_MEM_TYPE_SIZE)
+        PARSE_ERROR(p, "the length of '%s' and '%s' is not equal to LN_MEM_TYPE_SIZE %d",
+                    key_h, key_l, LN_MEM_TYPE_SIZE);
+    for (i = 0; i < LN_MEM_TYPE_SIZE; i++)
+        sizes[i] = int2size_t(sizes_h->values[i], sizes_l->values[i]);
 }
 
-/* static int line_num(int index, int *newline_indices) */
-/* { */
-/*      int *array = newline_indices + 1; */
-/*      int len = newline_indices[0]; */
-/*      int low = 0, high = len - 1, mid; */
-
-/*      while (low <= high) { */
-/*           mid = (high - low) / 2 + low; */
-/*           if (array[mid] < index) */
-/*                low = mid + 1; */
-/*           else if (array[mid] > index) */
-/*                high = mid - 1; */
-/*           else */
-/*                break; */
-/*      } */
-
-/*      return array[mid] <= index ? mid + 1 : mid; */
-/* } */
-
-#define RECORD_NEWLINE                                          \
-    do {                                                        \
-        if (i >= array_size) {                                  \
-            array_size *= 2;                                    \
-            array = ln_realloc(array, sizeof(int)*array_size);  \
-        }                                                       \
-        array[0] = i;                                           \
-        array[i++] = p - json_str;                              \
-    } while (0)
-
-/* Replace comments to blanks, and record newlines' positions.
-   The first element of returned array is the number of newlines,
-   and others are positions of newlines. */
-static int *preprocess(char *json_str)
-{
-    int *array;
-    int array_size = 256;
-    int i = 1;
-
-    array = ln_realloc(NULL, sizeof(int)*array_size);
-
-    for (char *p = json_str; *p; p++) {
-        if (*p == '\n') {
-            RECORD_NEWLINE;
-            continue;
-        }
-        if (*p == '\"') {
-            for (p++; *p && *p != '\"'; p++) {
-                if (*p == '\n')
-                    RECORD_NEWLINE;
-            }
-            if (!*p)
-                break;
-            continue;
-        }
-        if (*p == '/' && *(p+1) == '/') {
-            for (; *p && *p != '\n'; p++)
-                *p = ' ';
-            if (!*p)
-                break;
-            RECORD_NEWLINE;
-            continue;
-        }
-        if (*p == '/' && *(p+1) == '*') {
-            char *mark = p;  /* TODO: strdup */
-            for (; *p && !(*p == '*' && *(p+1) == '/'); p++) {
-                if (*p == '\n') {
-                    RECORD_NEWLINE;
-                    continue;
-                }
-                *p = ' ';
-            }
-            if (!*p)
-                ln_msg_emit(LN_MSG_ERROR, "unterminated comment: %s", mark);
-            *p++ = ' ';
-            *p = ' ';
-            continue;
+/* Parse the JSON IR from `fp` till the end of its top object. */
+ln_list *ln_json_fparse(FILE *fp, ln_context *ctx)
+{
+    struct parser parser = {fp, 1, NULL, 0, 0};
+    struct parser *p = &parser;
+    struct sizes mem_h = {-1}, mem_l = {-1}, weight_h = {-1}, weight_l = {-1};
+    ln_list *ops = NULL;
+    int has_ops = 0;
+    int first = 1, first_op, i;
+    char *key;
+
+    flockfile(fp);
+    if (peek_char(p) != '{')
+        PARSE_ERROR(p, "top level should be an Object");
+    expect_char(p, '{');
+    while (next_item(p, '}', &first)) {
+        key = parse_key(p);
+        if (ln_streq(key, "ops")) {
+            if (peek_char(p) != '[')
+                PARSE_ERROR(p, "item 'ops' has to be an Array");
+            expect_char(p, '[');
+            first_op = 1;
+            i = 0;
+            while (next_item(p, ']', &first_op))
+                ops = ln_list_prepend(ops, parse_op(p, ctx, i++));
+            has_ops = 1;
+        } else if (ln_streq(key, "mem_sizes_h")) {
+            parse_sizes(p, "mem_sizes_h", &mem_h);
+        } else if (ln_streq(key, "mem_sizes_l")) {
+            parse_sizes(p, "mem_sizes_l", &mem_l);
+        } else if (ln_streq(key, "weight_sizes_h")) {
+            parse_sizes(p, "weight_sizes_h", &weight_h);
+        } else if (ln_streq(key, "weight_sizes_l")) {
+            parse_sizes(p, "weight_sizes_l", &weight_l);
+        } else if (ln_streq(key, "inputs")) {
+            if (peek_char(p) != '"')
+                PARSE_ERROR(p, "'inputs' should be a String");
+            ln_free(ctx->inputs);
+            ctx->inputs = ln_strdup(parse_string(p));
+        } else {
+            skip_value(p);
         }
     }
-
-    return array;
+    funlockfile(fp);
+    if (!has_ops)
+        PARSE_ERROR(p, "top object should have an 'ops' item");
+    set_sizes(p, "mem_sizes_h", "mem_sizes_l", &mem_h, &mem_l, ctx->mem_sizes);
+    set_sizes(p, "weight_sizes_h", "weight_sizes_l", &weight_h, &weight_l,
+              ctx->weight_sizes);
+
+    ln_free(parser.buf);
+    ops = ln_list_reverse(ops);
+    ctx->ops = ops;
+    return ops;
 }
 
 ln_list *ln_json_parse(char *json_str, ln_context *ctx)
 {
-    int *newline_indices;
-    const cJSON *ops_json;
-    const cJSON *op_json;
-    cJSON *json;
-    ln_list *ops = NULL;
-    ln_op *op;
-
-    newline_indices = preprocess(json_str);
-    json = cJSON_Parse(json_str);
-    if (!json)
-        PARSE_ERROR("syntax error in %s", cJSON_GetErrorPtr());
-    parse_mem_sizes(json, ctx);
-
-    ops_json = cJSON_GetObjectItem(json, "ops");
-    if (!ops_json)
-        PARSE_ERROR("top object should have an 'ops' item");
-
-    if (!cJSON_IsArray(ops_json))
-        PARSE_ERROR("item 'ops' has to be an Array");
+    FILE *fp;
+    ln_list *ops;
 
-    int i = 0;
-    cJSON_ArrayForEach(op_json, ops_json) {
-        op = parse_op(op_json, ctx, i);
-        ops = ln_list_append(ops, op);
-        i++;
-    }
+    if (!(fp = fmemopen(json_str, strlen(json_str), "r")))
+        ln_msg_error_sys("ln_json_parse(): fmemopen() failed");
+    ops = ln_json_fparse(fp, ctx);
+    fclose(fp);
 
-    ctx->ops = ops;
-    cJSON_Delete(json);
-    ln_free(newline_indices);
     return ops;
 }
 
 ln_list *ln_json_parse_file(const char *file, ln_context *ctx)
 {
-    char *str;
+    FILE *fp;
     ln_list *ops;
 
     if (ln_streq(file, "-"))
-        str = ln_read_stdin();
-    else
-        str = ln_read_text(file);
+        return ln_json_fparse(stdin, ctx);
 
-    ops = ln_json_parse(str, ctx);
-    ln_free(str);
+    if (!(fp = fopen(file, "r")))
+        ln_msg_error_sys("ln_json_parse_file(): cannot open %s", file);
+    ops = ln_json_fparse(fp, ctx);
+    fclose(fp);
 
     return ops;
 }
@@ -636,24 +911,33 @@ static void add_params(cJSON *params_json, ln_list *params)
     }
 }
 
-static void add_mem_sizes(cJSON *json, const ln_context *ctx)
+static void add_sizes(cJSON *json, const char *key_h, const char *key_l,
+                      const size_t *sizes)
 {
-    int mem_sizes_h[LN_MEM_TYPE_SIZE];
-    int mem_sizes_l[LN_MEM_TYPE_SIZE];
+    int sizes_h[LN_MEM_TYPE_SIZE];
+    int sizes_l[LN_MEM_TYPE_SIZE];
     cJSON *item = NULL;
     int i;
 
     for (i = 0; i < LN_MEM_TYPE_SIZE; i++)
-        size_t2int(ctx->mem_sizes[i], &mem_sizes_h[i], &mem_sizes_l[i]);
+        size_t2int(sizes[i], &sizes_h[i], &sizes_l[i]);
 
-    item = cJSON_CreateIntArray(mem_sizes_h, LN_MEM_TYPE_SIZE);
+    item = cJSON_CreateIntArray(sizes_h, LN_MEM_TYPE_SIZE);
     if (!item)
         PRINT_ERROR;
-    cJSON_AddItemToObject(json, "mem_sizes_h", item);
-    item = cJSON_CreateIntArray(mem_sizes_l, LN_MEM_TYPE_SIZE);
+    cJSON_AddItemToObject(json, key_h, item);
+    item = cJSON_CreateIntArray(sizes_l, LN_MEM_TYPE_SIZE);
     if (!item)
         PRINT_ERROR;
-    cJSON_AddItemToObject(json, "mem_sizes_l", item);
+    cJSON_AddItemToObject(json, key_l, item);
+}
+
+static void add_mem_sizes(cJSON *json, const ln_context *ctx)
+{
+    add_sizes(json, "mem_sizes_h", "mem_sizes_l", ctx->mem_sizes);
+    add_sizes(json, "weight_sizes_h", "weight_sizes_l", ctx->weight_sizes);
+    if (ctx->inputs && !cJSON_AddStringToObject(json, "inputs", ctx->inputs))
+        PRINT_ERROR;
 }
 
 char *ln_json_create_json_str(const ln_context *ctx)
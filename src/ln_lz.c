@@ -0,0 +1,214 @@
+/*
+ * Copyright (c) 2018-2020 Zhixu Zhao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#include <assert.h>
+#include "ln_lz.h"
+
+/* the last bytes are always literals, and the last match starts before the
+   last MFLIMIT bytes, as the LZ4 block format requires */
+#define LAST_LITERALS 5
+#define MFLIMIT 12
+#define HASH_LOG 16
+/* after this many missed positions, the search steps faster */
+#define SKIP_TRIGGER 6
+
+static inline uint32_t read32(const unsigned char *p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint64_t read64(const unsigned char *p)
+{
+    uint64_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t hash4(uint32_t v)
+{
+    return (v * 2654435761U) >> (32 - HASH_LOG);
+}
+
+size_t ln_lz_compress_bound(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+static unsigned char *put_length(unsigned char *op, size_t len)
+{
+    for (; len >= 255; len -= 255)
+        *op++ = 255;
+    *op++ = (unsigned char)len;
+    return op;
+}
+
+static unsigned char *put_sequence(unsigned char *op, const unsigned char *lit,
+                                   size_t lit_len, size_t match_len,
+                                   size_t offset)
+{
+    unsigned char *token = op++;
+
+    *token = (lit_len >= 15 ? 15 : lit_len) << 4;
+    if (lit_len >= 15)
+        op = put_length(op, lit_len - 15);
+    memcpy(op, lit, lit_len);
+    op += lit_len;
+    if (match_len == 0)
+        return op;
+    *op++ = offset & 0xff;
+    *op++ = offset >> 8;
+    match_len -= LN_LZ_MIN_MATCH;
+    *token |= match_len >= 15 ? 15 : match_len;
+    if (match_len >= 15)
+        op = put_length(op, match_len - 15);
+    return op;
+}
+
+/*
+ * Compress `size` bytes of `src` to `dst` of `cap` bytes. Return the
+ * compressed size, or 0 if `cap` is less than ln_lz_compress_bound(size).
+ */
+size_t ln_lz_compress(const void *src, size_t size, void *dst, size_t cap)
+{
+    const unsigned char *base = src, *ip = base, *anchor = base;
+    const unsigned char *end = base + size, *match_limit, *ref;
+    unsigned char *op = dst;
+    uint32_t *table;
+    uint32_t h;
+    size_t len, step, missed = 0;
+
+    assert(size <= UINT32_MAX);
+    if (cap < ln_lz_compress_bound(size))
+        return 0;
+    if (size < MFLIMIT + 1)
+        return put_sequence(op, base, size, 0, 0) - (unsigned char *)dst;
+
+    table = ln_alloc(sizeof(uint32_t) << HASH_LOG);
+    memset(table, 0xff, sizeof(uint32_t) << HASH_LOG);
+    match_limit = end - MFLIMIT;
+    while (ip < match_limit) {
+        h = hash4(read32(ip));
+        ref = table[h] == UINT32_MAX ? NULL : base + table[h];
+        table[h] = ip - base;
+        if (!ref || ip - ref > LN_LZ_MAX_OFFSET ||
+            read32(ref) != read32(ip)) {
+            step = 1 + (missed++ >> SKIP_TRIGGER);
+            ip += step;
+            continue;
+        }
+        missed = 0;
+        while (ip > anchor && ref > base && ip[-1] == ref[-1]) {
+            ip--;
+            ref--;
+        }
+        len = LN_LZ_MIN_MATCH;
+        while (ip + len + 8 <= end - LAST_LITERALS &&
+               read64(ip + len) == read64(ref + len))
+            len += 8;
+        while (ip + len < end - LAST_LITERALS && ip[len] == ref[len])
+            len++;
+        op = put_sequence(op, anchor, ip - anchor, len, ip - ref);
+        ip += len;
+        anchor = ip;
+        if (ip < match_limit)
+            table[hash4(read32(ip - 2))] = ip - 2 - base;
+    }
+    op = put_sequence(op, anchor, end - anchor, 0, 0);
+    ln_free(table);
+
+    return op - (unsigned char *)dst;
+}
+
+static int get_length(const unsigned char **ipp, const unsigned char *end,
+                      size_t *len)
+{
+    const unsigned char *ip = *ipp;
+    unsigned char b;
+
+    do {
+        if (ip >= end)
+            return -1;
+        b = *ip++;
+        *len += b;
+    } while (b == 255);
+    *ipp = ip;
+    return 0;
+}
+
+/*
+ * Decompress `size` bytes of `src` to exactly `dst_size` bytes of `dst`.
+ * Return 0 on success, -1 if `src` is corrupt or doesn't decompress to
+ * `dst_size` bytes. Never reads or writes out of the buffers.
+ */
+int ln_lz_decompress(const void *src, size_t size, void *dst, size_t dst_size)
+{
+    const unsigned char *ip = src, *end = ip + size;
+    unsigned char *op = dst, *oend = op + dst_size;
+    const unsigned char *ref;
+    size_t lit_len, match_len, offset;
+    unsigned token;
+
+    while (ip < end) {
+        token = *ip++;
+        lit_len = token >> 4;
+        if (lit_len == 15 && get_length(&ip, end, &lit_len) < 0)
+            return -1;
+        if (lit_len > (size_t)(end - ip) || lit_len > (size_t)(oend - op))
+            return -1;
+        memcpy(op, ip, lit_len);
+        ip += lit_len;
+        op += lit_len;
+        if (ip == end)
+            break;
+
+        if (end - ip < 2)
+            return -1;
+        offset = ip[0] | ip[1] << 8;
+        ip += 2;
+        if (offset == 0 || offset > (size_t)(op - (unsigned char *)dst))
+            return -1;
+        match_len = token & 15;
+        if (match_len == 15 && get_length(&ip, end, &match_len) < 0)
+            return -1;
+        match_len += LN_LZ_MIN_MATCH;
+        if (match_len > (size_t)(oend - op))
+            return -1;
+        ref = op - offset;
+        if (offset >= match_len) {
+            memcpy(op, ref, match_len);
+            op += match_len;
+            continue;
+        }
+        /* overlapping, so the copied bytes repeat with period `offset` */
+        if (offset >= 8) {
+            for (; match_len >= 8; match_len -= 8, op += 8, ref += 8)
+                memcpy(op, ref, 8);
+        }
+        while (match_len--)
+            *op++ = *ref++;
+    }
+
+    return op == oend ? 0 : -1;
+}
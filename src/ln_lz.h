@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2018-2020 Zhixu Zhao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#ifndef _LN_LZ_H_
+#define _LN_LZ_H_
+
+#include "ln_util.h"
+
+/*
+ * A fast LZ77 codec for weight blobs, producing the LZ4 block format:
+ * sequences of a token of 4-bit literal length and 4-bit match length
+ * minus LN_LZ_MIN_MATCH (15 for longer, continued with bytes of 255 and a
+ * last byte < 255), the literals, and a little-endian uint16 match offset.
+ * The last sequence has only literals.
+ */
+#define LN_LZ_MIN_MATCH 4
+#define LN_LZ_MAX_OFFSET 65535
+
+#ifdef __cplusplus
+LN_CPPSTART
+#endif
+
+size_t ln_lz_compress_bound(size_t size);
+size_t ln_lz_compress(const void *src, size_t size, void *dst, size_t cap);
+int ln_lz_decompress(const void *src, size_t size, void *dst, size_t dst_size);
+
+#ifdef __cplusplus
+LN_CPPEND
+#endif
+
+#endif  /* _LN_LZ_H_ */
@@ -23,6 +23,7 @@
 #include <assert.h>
 #include "ln_mem.h"
 #include "ln_msg.h"
+#include "arch/ln_cpu.h"
 #include "arch/ln_cuda.h"
 #include "arch/ln_dpu.h"
 
@@ -46,12 +47,11 @@ struct ln_mem_pool {
 };
 
 #define DEFAULT_MAX_SIZE 17179869184 /* 16GB */
-#define DEFAULT_ALIGN_SIZE 1
 
 static const ln_mem_info ln_mem_infos[] = {
     {"LN_MEM_NONE", NULL, NULL, NULL, 0, 0},
-    {"LN_MEM_CPU", ln_alloc, ln_free, memset,
-     DEFAULT_MAX_SIZE, DEFAULT_ALIGN_SIZE},
+    {"LN_MEM_CPU", ln_alloc_cpu, ln_free_cpu, memset,
+     DEFAULT_MAX_SIZE, LN_CPU_ALIGN_SIZE},
 #ifdef LN_CUDA
     {"LN_MEM_CUDA", ln_alloc_cuda, ln_free_cuda, ln_memset_cuda,
      DEFAULT_MAX_SIZE, 32}, /* 32-byte L2 cache in compute capability >= 3.0*/
@@ -318,17 +318,21 @@ static void mem_pool_free_wrapper(void *p)
     ln_mem_pool_free(p);
 }
 
-ln_hash *ln_mem_pool_table_create(void)
+/* Pools are aligned to `align_size` or their memory types' alignment, whichever
+   is larger. */
+ln_hash *ln_mem_pool_table_create(size_t align_size)
 {
     ln_hash *mpt;
     ln_mem_pool *mp;
+    size_t align;
     int i;
 
     mpt = ln_hash_create(ln_direct_hash, ln_direct_cmp, NULL,
                          mem_pool_free_wrapper);
     for (i = LN_MEM_NONE+1; i < LN_MEM_TYPE_SIZE; i++) {
-        mp = ln_mem_pool_create(ln_mem_infos[i].max_size,
-                                ln_mem_infos[i].align_size);
+        align = ln_mem_infos[i].align_size > align_size ?
+            ln_mem_infos[i].align_size : align_size;
+        mp = ln_mem_pool_create(ln_mem_infos[i].max_size, align);
         ln_hash_insert(mpt, (void *)(size_t)i, mp);
     }
     return mpt;
@@ -67,7 +67,7 @@ size_t ln_mem_pool_alloc(ln_mem_pool *mem_pool, size_t size);
 void ln_mem_pool_dealloc(ln_mem_pool *mem_pool, size_t addr);
 int ln_mem_pool_exist(ln_mem_pool *mem_pool, size_t addr);
 void ln_mem_pool_dump(ln_mem_pool *mem_pool, FILE *fp);
-ln_hash *ln_mem_pool_table_create(void);
+ln_hash *ln_mem_pool_table_create(size_t align_size);
 void ln_mem_pool_table_free(ln_hash *mpt);
 
 #ifdef __cplusplus
@@ -165,22 +165,39 @@ ln_op *ln_op_copy(const ln_op *op)
                                    op->op_arg->tensor_table);
 }
 
+/* Outputs `new_optype` has but `op` doesn't, like the buffers of the new op,
+   are named after the op as in ln_op_create_with_names(). */
 ln_op *ln_op_copy_to_optype(const ln_hash *op_proto_table, const ln_op *op,
                             const char *new_optype)
 {
     ln_op *new_op_proto;
     ln_op *new_op;
+    ln_list *tensors_out;
+    const char *arg_name;
+    char tensor_name[LN_MAX_NAME_LEN];
+    int i;
     /* char opname[LN_MAX_NAME_LEN]; */
 
     new_op_proto = ln_hash_find(op_proto_table, new_optype);
     if (!new_op_proto)
         ln_msg_inter_error("optype %s not found", new_optype);
+    tensors_out = ln_tensor_list_copy(op->op_arg->tensors_out);
+    for (i = 0; (arg_name = new_op_proto->op_arg->out_arg_names[i]); i++) {
+        if (ln_tensor_list_find_by_arg_name(tensors_out, arg_name))
+            continue;
+        if (strlen(op->op_arg->name) + strlen(arg_name) + 2 > LN_MAX_NAME_LEN)
+            ln_msg_inter_error("result '%s_%s' length exceeds LN_MAX_NAME_LEN",
+                               op->op_arg->name, arg_name);
+        snprintf(tensor_name, LN_MAX_NAME_LEN, "%s_%s", op->op_arg->name,
+                 arg_name);
+        tensors_out = ln_tensor_list_append(tensors_out, arg_name, tensor_name);
+    }
     /* strncpy(opname, ln_name_unique(new_op_proto->op_arg->optype, name_hash), */
     /*         LN_MAX_NAME_LEN); */
     /* FIXME: use opname? */
     new_op = ln_op_create_from_proto(new_op_proto, op->op_arg->name,
                                      ln_tensor_list_copy(op->op_arg->tensors_in),
-                                     ln_tensor_list_copy(op->op_arg->tensors_out),
+                                     tensors_out,
                                      ln_param_list_copy(op->op_arg->params),
                                      op->op_arg->tensor_table);
 
@@ -372,6 +389,99 @@ void ln_op_list_do_run(ln_list *ops)
     }
 }
 
+/* Flatten the `run`s of `ops` into a contiguous array, skipping the ops
+   without one. Should be done again if `ops` changes. Need to be freed. */
+ln_op_step *ln_op_list_flatten_run(ln_list *ops)
+{
+    ln_op_step *steps;
+    ln_op *op;
+    int n = 0;
+
+    steps = ln_alloc(sizeof(ln_op_step) * (ln_list_length(ops) + 1));
+    LN_LIST_FOREACH(op, ops) {
+        if (!op->run)
+            continue;
+        steps[n].run = op->run;
+        steps[n].op_arg = op->op_arg;
+        steps[n].ins = NULL;
+        steps[n].outs = NULL;
+        steps[n].force = 0;
+        n++;
+    }
+    steps[n].run = NULL;
+    steps[n].op_arg = NULL;
+    steps[n].ins = NULL;
+    steps[n].outs = NULL;
+    steps[n].force = 0;
+    return steps;
+}
+
+static int any_dirty(ln_tensor_entry **tes)
+{
+    for (; *tes; tes++) {
+        if ((*tes)->dirty)
+            return 1;
+    }
+    return 0;
+}
+
+static void set_dirty(ln_tensor_entry **tes, int dirty)
+{
+    for (; *tes; tes++)
+        (*tes)->dirty = dirty;
+}
+
+/* The dirty marks are cleared after all the steps have seen them. */
+void ln_op_steps_do_run(ln_op_step *steps)
+{
+    ln_op_steps_do_run_hook(steps, NULL, NULL);
+}
+
+/* Like ln_op_steps_do_run(), calling `hook` with the index of every step
+   before it may run, if `hook` isn't NULL. */
+void ln_op_steps_do_run_hook(ln_op_step *steps, ln_op_step_hook hook,
+                             void *arg)
+{
+    ln_op_step *step;
+    int skippable = 0;
+
+    for (step = steps; step->run; step++) {
+        if (hook)
+            hook(step - steps, arg);
+        if (!step->ins) {
+            step->run(step->op_arg);
+            continue;
+        }
+        skippable = 1;
+        if (!step->force && !any_dirty(step->ins))
+            continue;
+        step->run(step->op_arg);
+        step->force = 0;
+        set_dirty(step->outs, 1);
+    }
+    if (!skippable)
+        return;
+    for (step = steps; step->run; step++) {
+        if (!step->ins)
+            continue;
+        set_dirty(step->ins, 0);
+        set_dirty(step->outs, 0);
+    }
+}
+
+void ln_op_steps_free(ln_op_step *steps)
+{
+    ln_op_step *step;
+
+    if (!steps)
+        return;
+    for (step = steps; step->run; step++) {
+        ln_free(step->ins);
+        ln_free(step->outs);
+    }
+    ln_free(steps);
+}
+
 void ln_op_list_do_post_run(ln_list *ops)
 {
     ln_op *op;
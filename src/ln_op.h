@@ -63,6 +63,22 @@ struct ln_op {
 };
 typedef struct ln_op ln_op;
 
+/* A run of an op in a flattened execution plan, which is an array of steps
+   terminated by one with a NULL `run`. A step with `ins` is skipped unless
+   one of the root tensors in `ins` is dirty or `force` is set, and makes
+   those in `outs` dirty; both are NULL terminated. `force` is cleared after
+   the run, and is set when the op's params change. */
+struct ln_op_step {
+    ln_op_func          run;
+    ln_op_arg          *op_arg;
+    ln_tensor_entry   **ins;
+    ln_tensor_entry   **outs;
+    int                 force;
+};
+typedef struct ln_op_step ln_op_step;
+
+typedef void (*ln_op_step_hook)(int index, void *arg);
+
 #ifdef __cplusplus
 LN_CPPSTART
 #endif
@@ -98,6 +114,11 @@ void ln_op_list_do_pre_run(ln_list *ops);
 void ln_op_list_do_static_run(ln_list *ops);
 void ln_op_list_do_run(ln_list *ops);
 void ln_op_list_do_post_run(ln_list *ops);
+ln_op_step *ln_op_list_flatten_run(ln_list *ops);
+void ln_op_steps_do_run(ln_op_step *steps);
+void ln_op_steps_do_run_hook(ln_op_step *steps, ln_op_step_hook hook,
+                             void *arg);
+void ln_op_steps_free(ln_op_step *steps);
 /* Create a new opname with `prefix` suffixed with the next number.
    Need to be freed. `ops` should not be modified */
 /* char *ln_op_list_new_opname(const ln_list *ops, const char *prefix); */
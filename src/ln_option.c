@@ -58,9 +58,26 @@ Options:\n\
   -v, --version          display version information\n\
   -o, --outfile=FILE     specify output file name; if FILE is -, print to\n\
                          standard output; if FILE is !, do not print;\n\
+                         if FILE ends with .lnb, print the binary IR\n\
                          (default: out.json)\n\
   -t, --target=TARGET    specify target platform (default: cpu)\n\
   -f, --datafile=FILE    specify tensor data file\n\
+  -b, --batch=N          set the leading dimension of input tensors to N\n\
+  -i, --inputs=NAMES     specify the comma-separated names of input tensors\n\
+                         whose batch size --batch sets (default: input)\n\
+  -a, --mem-align=N      align planned tensors to at least N bytes, a power\n\
+                         of 2 (default: required by the memory type)\n\
+  -m, --mem-report=FILE  print a report of the memory plan to FILE; if FILE\n\
+                         ends with .svg or .html, with a timeline of the\n\
+                         memory; if FILE is -, print to standard output\n\
+  -j, --load-threads=N   load the binary weight file with N threads\n\
+                         (default: the number of CPUs)\n\
+  --verify-weights       check the CRC-32 of every weight in the binary\n\
+                         weight file when loading it\n\
+  --lazy-weights         map the binary weight file instead of loading it,\n\
+                         reading the weights when they are first used\n\
+  --time-passes          print the time and statistics of every compiler\n\
+                         pass after compiling (implied by --debug)\n\
   -c, --compile          compile only; do not run\n\
   -r, --run              run only; do not compile; SOURCE should have been\n\
                          memory-planned\n\
@@ -87,8 +104,16 @@ LN_EXPORT ln_option *ln_option_create(int argc, char **argv)
     option->outfile = NULL;
     option->target = NULL;
     option->datafile = NULL;
+    option->inputs = NULL;
+    option->mem_report = NULL;
     option->compile = 1;
     option->run = 1;
+    option->batch = 0;
+    option->mem_align = 0;
+    option->load_threads = 0;
+    option->verify_weights = 0;
+    option->lazy_weights = 0;
+    option->time_passes = 0;
     option->Winter = 1;
     option->Wwarn = 1;
     option->debug = 0;
@@ -99,6 +124,14 @@ LN_EXPORT ln_option *ln_option_create(int argc, char **argv)
         {"outfile",   required_argument, NULL, 'o'},
         {"target",    required_argument, NULL, 't'},
         {"datafile",  required_argument, NULL, 'f'},
+        {"batch",     required_argument, NULL, 'b'},
+        {"inputs",    required_argument, NULL, 'i'},
+        {"mem-align", required_argument, NULL, 'a'},
+        {"mem-report", required_argument, NULL, 'm'},
+        {"load-threads", required_argument, NULL, 'j'},
+        {"verify-weights", no_argument, &option->verify_weights, 1},
+        {"lazy-weights", no_argument, &option->lazy_weights, 1},
+        {"time-passes", no_argument, &option->time_passes, 1},
         {"compile",   no_argument, NULL, 'c'},
         {"run",       no_argument, NULL, 'r'},
         {"Winter",    no_argument, &option->Winter, 1},
@@ -110,7 +143,7 @@ LN_EXPORT ln_option *ln_option_create(int argc, char **argv)
     };
 
     optind = 1;
-    while ((opt = getopt_long_only(option->argc, option->argv, ":hvo:t:f:crwd",
+    while ((opt = getopt_long_only(option->argc, option->argv, ":hvo:t:f:b:i:a:m:j:crwd",
                                    longopts, &optindex)) != -1) {
         switch (opt) {
         case 0:
@@ -130,6 +163,28 @@ LN_EXPORT ln_option *ln_option_create(int argc, char **argv)
         case 'f':
             option->datafile = optarg;
             break;
+        case 'b':
+            option->batch = atoi(optarg);
+            if (option->batch <= 0)
+                ln_msg_error("invalid batch size %s", optarg);
+            break;
+        case 'i':
+            option->inputs = optarg;
+            break;
+        case 'a':
+            option->mem_align = atoi(optarg);
+            if (option->mem_align <= 0 ||
+                (option->mem_align & (option->mem_align - 1)))
+                ln_msg_error("invalid memory alignment %s", optarg);
+            break;
+        case 'm':
+            option->mem_report = optarg;
+            break;
+        case 'j':
+            option->load_threads = atoi(optarg);
+            if (option->load_threads <= 0)
+                ln_msg_error("invalid number of threads %s", optarg);
+            break;
         case 'c':
             if (option->compile == 0 && option->run == 1) {
                 option->compile = 1;
@@ -173,6 +228,8 @@ LN_EXPORT ln_option *ln_option_create(int argc, char **argv)
         option->outfile = "out.json";
     if (!option->target)
         option->target = "cpu";
+    if (!option->inputs)
+        option->inputs = "input";
 
     return option;
 }
@@ -203,6 +260,16 @@ LN_EXPORT const char *ln_option_get_datafile(ln_option *option)
     return option->datafile;
 }
 
+LN_EXPORT const char *ln_option_get_inputs(ln_option *option)
+{
+    return option->inputs;
+}
+
+LN_EXPORT const char *ln_option_get_mem_report(ln_option *option)
+{
+    return option->mem_report;
+}
+
 LN_EXPORT int ln_option_get_compile(ln_option *option)
 {
     return option->compile;
@@ -213,6 +280,36 @@ LN_EXPORT int ln_option_get_run(ln_option *option)
     return option->run;
 }
 
+LN_EXPORT int ln_option_get_batch(ln_option *option)
+{
+    return option->batch;
+}
+
+LN_EXPORT int ln_option_get_mem_align(ln_option *option)
+{
+    return option->mem_align;
+}
+
+LN_EXPORT int ln_option_get_load_threads(ln_option *option)
+{
+    return option->load_threads;
+}
+
+LN_EXPORT int ln_option_get_verify_weights(ln_option *option)
+{
+    return option->verify_weights;
+}
+
+LN_EXPORT int ln_option_get_lazy_weights(ln_option *option)
+{
+    return option->lazy_weights;
+}
+
+LN_EXPORT int ln_option_get_time_passes(ln_option *option)
+{
+    return option->time_passes;
+}
+
 LN_EXPORT int ln_option_get_Winter(ln_option *option)
 {
     return option->Winter;
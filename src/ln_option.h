@@ -28,10 +28,18 @@ struct ln_option {
     const char  *outfile;
     const char  *target;
     const char  *datafile;
+    const char  *inputs;
+    const char  *mem_report;
     char       **argv;
     int          argc;
     int          compile;
     int          run;
+    int          batch;
+    int          mem_align;
+    int          load_threads;
+    int          verify_weights;
+    int          lazy_weights;
+    int          time_passes;
     int          Winter;
     int          Wwarn;
     int          debug;
@@ -51,8 +59,16 @@ const char *ln_option_get_source(ln_option *option);
 const char *ln_option_get_outfile(ln_option *option);
 const char *ln_option_get_target(ln_option *option);
 const char *ln_option_get_datafile(ln_option *option);
+const char *ln_option_get_inputs(ln_option *option);
+const char *ln_option_get_mem_report(ln_option *option);
 int ln_option_get_compile(ln_option *option);
 int ln_option_get_run(ln_option *option);
+int ln_option_get_batch(ln_option *option);
+int ln_option_get_mem_align(ln_option *option);
+int ln_option_get_load_threads(ln_option *option);
+int ln_option_get_verify_weights(ln_option *option);
+int ln_option_get_lazy_weights(ln_option *option);
+int ln_option_get_time_passes(ln_option *option);
 int ln_option_get_Winter(ln_option *option);
 int ln_option_get_Wwarn(ln_option *option);
 int ln_option_get_debug(ln_option *option);
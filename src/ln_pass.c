@@ -75,7 +75,9 @@ void ln_pass_preprocess(ln_context *ctx)
     ln_op *op_copy;
     ln_tensor_list_entry *tle;
     ln_tensor_entry *te;
+    ln_pass_timer timer;
 
+    ln_pass_timer_start(ctx, &timer, "preprocess");
     /* move all ops without tensors_in or with static tensors_in and with static
        tensors_out to the beginning of ops */
     for (lp = &ctx->ops; *lp;) {
@@ -96,12 +98,14 @@ void ln_pass_preprocess(ln_context *ctx)
             op_copy = ln_op_copy(op);
             ln_context_remove_op(ctx, lp);
             ln_context_add_op(ctx, pos, op_copy);
+            timer.replacements++;
             continue;
         }
     no_move:
         lp = &(*lp)->next;
     }
     ln_context_check(ctx);
+    ln_pass_timer_stop(ctx, &timer);
 }
 
 void ln_pass_expander(ln_context *ctx, ln_expander_func ep_func)
@@ -111,7 +115,9 @@ void ln_pass_expander(ln_context *ctx, ln_expander_func ep_func)
     ln_list *ep_ops;
     int ep_ops_len;
     int match;
+    ln_pass_timer timer;
 
+    ln_pass_timer_start(ctx, &timer, "expander");
     ep_ops = NULL;
     for (lp = &ctx->ops; *lp;) {
         op = (*lp)->data;
@@ -124,9 +130,11 @@ void ln_pass_expander(ln_context *ctx, ln_expander_func ep_func)
         ep_ops_len = ln_list_length(ep_ops);
         ln_context_replace_ops(ctx, lp, 1, ep_ops);
         ln_context_check(ctx);
+        timer.replacements++;
         while (ep_ops_len--)
             lp = &(*lp)->next;
     }
+    ln_pass_timer_stop(ctx, &timer);
 }
 
 void ln_pass_combiner(ln_context *ctx, size_t win_size, ln_combiner_func cb_func)
@@ -136,7 +144,9 @@ void ln_pass_combiner(ln_context *ctx, size_t win_size, ln_combiner_func cb_func
     int stable = 0;
     int count = 0;
     int match;
+    ln_pass_timer timer;
 
+    ln_pass_timer_start(ctx, &timer, "combiner");
     while (!stable) {
         stable = 1;
         for (lp = &ctx->ops; *lp; lp = &(*lp)->next) {
@@ -149,6 +159,7 @@ void ln_pass_combiner(ln_context *ctx, size_t win_size, ln_combiner_func cb_func
             stable = 0;
             ln_context_replace_ops(ctx, lp, win_size, win_out);
             ln_context_check(ctx);
+            timer.replacements++;
         }
         if (++count > MAX_PEEPHOLE_PASSES) {
             ln_msg_emit(LN_MSG_INTER_WARN,
@@ -156,23 +167,30 @@ void ln_pass_combiner(ln_context *ctx, size_t win_size, ln_combiner_func cb_func
                         MAX_PEEPHOLE_PASSES);
         }
     }
+    ln_pass_timer_stop(ctx, &timer);
 }
 
 void ln_pass_subgraph(ln_context *ctx, ln_subgraph_func sg_func)
 {
     ln_list *old_ops = NULL;
     ln_list *new_ops = NULL;
+    ln_pass_timer timer;
 
+    ln_pass_timer_start(ctx, &timer, "subgraph");
     new_ops = sg_func(ctx, &old_ops);
-    if (!old_ops)
+    if (!old_ops) {
+        ln_pass_timer_stop(ctx, &timer);
         return;
+    }
 
     ln_context_subgraph(ctx, old_ops, new_ops);
     ln_context_check(ctx);
+    timer.replacements += ln_list_length(old_ops);
     ln_list_free(old_ops);
     ln_list_free(new_ops);
     old_ops = NULL;
     new_ops = NULL;
+    ln_pass_timer_stop(ctx, &timer);
 }
 
 void ln_pass_schedule(ln_context *ctx, ln_schedule_func sd_func)
@@ -180,10 +198,14 @@ void ln_pass_schedule(ln_context *ctx, ln_schedule_func sd_func)
     ln_list *ops;
     ln_op *op;
     int n;
+    ln_pass_timer timer;
 
+    ln_pass_timer_start(ctx, &timer, "schedule");
     ops = sd_func(ctx);
-    if (!ops)
+    if (!ops) {
+        ln_pass_timer_stop(ctx, &timer);
         return;
+    }
 
     n = 0;
     LN_LIST_FOREACH(op, ops) {
@@ -198,18 +220,22 @@ void ln_pass_schedule(ln_context *ctx, ln_schedule_func sd_func)
 
     ln_list_free(ctx->ops);
     ctx->ops = ops;
+    ln_pass_timer_stop(ctx, &timer);
 }
 
 void ln_pass_optimize_with_data(ln_context *ctx, ln_optdata_func od_func,
                                 const char *datafile)
 {
+    ln_pass_timer timer;
 
     if (!datafile)
         return;
 
+    ln_pass_timer_start(ctx, &timer, "optimize_with_data");
     ln_context_load(ctx, datafile);
     od_func(ctx);
     ln_context_unload(ctx);
+    ln_pass_timer_stop(ctx, &timer);
 }
 
 static void use_count_zero(ln_hash *use_counts, char *name)
@@ -240,16 +266,6 @@ static ssize_t use_count_dec(ln_hash *use_counts, char *name)
     return uc;
 }
 
-static ssize_t use_count_of(ln_hash *use_counts, char *name)
-{
-    int found;
-    ssize_t uc;
-
-    found = ln_hash_find_extended(use_counts, name, NULL, (void **)&uc);
-    assert(found);
-    return uc;
-}
-
 static void set_offset(ln_tensor_entry *te, size_t offset)
 {
     te->offset = offset;
@@ -258,18 +274,37 @@ static void set_offset(ln_tensor_entry *te, size_t offset)
                  tl_tensor_size(te->tensor), te->offset);
 }
 
-static void alloc_set_offset(ln_tensor_entry *te, ln_hash *mem_pools,
-                             ln_context *ctx)
+static size_t mem_align(const ln_context *ctx, ln_mem_type mtype)
+{
+    size_t align;
+
+    align = ln_mem_type_info(mtype).align_size;
+    return align > ctx->mem_align ? align : ctx->mem_align;
+}
+
+/* Sizes are padded to the alignment, so that kernels can read whole vectors
+   at the tails of tensors. */
+size_t ln_pass_planned_size(const ln_context *ctx, const ln_tensor_entry *te)
+{
+    size_t align;
+
+    align = mem_align(ctx, te->mtype);
+    return (tl_tensor_size(te->tensor) + align - 1) / align * align;
+}
+
+static void alloc_set_offset(const ln_context *ctx, ln_tensor_entry *te,
+                             ln_hash *mem_pools, size_t *mem_sizes)
 {
     ln_mem_pool *mp;
     size_t water_level;
+    size_t size;
 
     mp = ln_hash_find(mem_pools, (void *)te->mtype);
-    set_offset(te, ln_mem_pool_alloc(mp, tl_tensor_size(te->tensor)));
-    water_level = te->offset + tl_tensor_size(te->tensor);
-    ctx->mem_sizes[te->mtype] =
-            ctx->mem_sizes[te->mtype] > water_level ?
-            ctx->mem_sizes[te->mtype] : water_level;
+    size = ln_pass_planned_size(ctx, te);
+    set_offset(te, ln_mem_pool_alloc(mp, size));
+    water_level = te->offset + size;
+    mem_sizes[te->mtype] = mem_sizes[te->mtype] > water_level ?
+            mem_sizes[te->mtype] : water_level;
 }
 
 static void dealloc_offset(ln_tensor_entry *te, ln_hash *mem_pools)
@@ -336,20 +371,193 @@ static ln_tensor_entry *find_root_owner(const char *owner, ln_hash *tensor_table
     return te;
 }
 
+/* Whether tensor `name` reads the data that `root` holds before `te` is
+   written, i.e. its owner chain reaches `root` without passing `te`. */
+static int reads_old_data(const char *name, ln_tensor_entry *root,
+                          ln_tensor_entry *te, ln_hash *tensor_table)
+{
+    ln_tensor_entry *e;
+
+    e = ln_tensor_table_find(tensor_table, name);
+    while (e != te) {
+        if (e == root)
+            return 1;
+        if (!e->owner)
+            return 0;
+        e = ln_tensor_table_find(tensor_table, e->owner);
+    }
+    return 0;
+}
+
+/* Static tensors and the outputs of the ops depending only on weights keep
+   their data between runs, see ln_context_is_constant_op(). */
+static int persists(ln_tensor_entry *te, ln_hash *consts)
+{
+    return te->isstatic || ln_hash_find_extended(consts, te->name, NULL, NULL);
+}
+
+/*
+ * Return a set of the outputs of the ops depending only on weights. Without
+ * declared inputs, the model's inputs can't be told from weights, and the set
+ * is empty. It should be freed by ln_hash_free().
+ */
+ln_hash *ln_pass_constant_tensors(const ln_context *ctx)
+{
+    ln_hash *consts;
+    ln_tensor_list_entry *tle;
+    ln_tensor_entry *te;
+    ln_op *op;
+
+    consts = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+    if (!ctx->inputs)
+        return consts;
+    LN_LIST_FOREACH(op, ctx->ops) {
+        if (!ln_context_is_constant_op(ctx, op, consts, 1))
+            continue;
+        LN_LIST_FOREACH(tle, op->op_arg->tensors_out) {
+            te = ln_tensor_table_find(op->op_arg->tensor_table, tle->name);
+            if (!te->scratch)
+                ln_hash_insert(consts, tle->name, NULL);
+        }
+    }
+    return consts;
+}
+
+/* Return a set of the tensors that ops read, see ln_pass_keeps_root(). It
+   should be freed by ln_hash_free(). */
+ln_hash *ln_pass_read_tensors(const ln_context *ctx)
+{
+    ln_tensor_list_entry *tle;
+    ln_hash *reads;
+    ln_op *op;
+
+    reads = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+    LN_LIST_FOREACH(op, ctx->ops) {
+        LN_LIST_FOREACH(tle, op->op_arg->tensors_in)
+            ln_hash_insert(reads, tle->name, NULL);
+    }
+    return reads;
+}
+
+/* Whether the output `te` keeps the memory of its root, itself or the owner
+   it views, through the end of the runs: an output of the model, which no op
+   in `reads` reads, unless it's a scratch tensor living only in its op. */
+int ln_pass_keeps_root(const ln_tensor_entry *te, ln_hash *reads)
+{
+    return !te->scratch && !ln_hash_find_extended(reads, te->name, NULL, NULL);
+}
+
+/* Mark the roots that ops write in their runs, such as the owners of the
+   outputs of rearange and sort1d_by_key, which stay out of the weights
+   shared among contexts or mapped read-only. Done by mem_plan, and for the
+   planned IR parsed by ln_context_init(). */
+void ln_pass_mark_written_roots(ln_context *ctx)
+{
+    ln_tensor_list_entry *tle;
+    ln_tensor_entry *te;
+    ln_op *op;
+
+    LN_LIST_FOREACH(op, ctx->ops) {
+        LN_LIST_FOREACH(tle, op->op_arg->tensors_out) {
+            te = ln_tensor_table_find(op->op_arg->tensor_table, tle->name);
+            te->written = 0;
+        }
+    }
+    LN_LIST_FOREACH(op, ctx->ops) {
+        if (!op->run)
+            continue;
+        /* in-place hints on static roots are dropped by mem_plan */
+        LN_LIST_FOREACH(tle, op->op_arg->tensors_out) {
+            for (te = ln_tensor_table_find(op->op_arg->tensor_table, tle->name);
+                 te->owner && !te->inplace;
+                 te = ln_tensor_table_find(op->op_arg->tensor_table, te->owner))
+                ;
+            te->written = 1;
+        }
+    }
+}
+
+static int inplace_is_safe(ln_list *op_node, ln_tensor_entry *te,
+                           ln_hash *tensor_table, ln_hash *consts)
+{
+    ln_tensor_entry *root;
+    ln_tensor_list_entry *tle;
+    ln_list *l;
+    ln_op *op;
+
+    root = find_root_owner(te->owner, tensor_table);
+    if (persists(root, consts) || root->mtype != te->mtype)
+        return 0;
+    for (l = op_node->next; l; l = l->next) {
+        op = l->data;
+        LN_LIST_FOREACH(tle, op->op_arg->tensors_in) {
+            if (reads_old_data(tle->name, root, te, tensor_table))
+                return 0;
+        }
+    }
+    return 1;
+}
+
+/* Keep the in-place owner hints of tensors only if nothing after their
+   creaters still reads the owner's old data, and the owner's data needn't
+   persist; ops are in execution order. */
+static void resolve_inplace_owners(ln_context *ctx, ln_hash *consts)
+{
+    ln_list *l;
+    ln_op *op;
+    ln_tensor_list_entry *tle;
+    ln_tensor_entry *te;
+
+    for (l = ctx->ops; l; l = l->next) {
+        op = l->data;
+        LN_LIST_FOREACH(tle, op->op_arg->tensors_out) {
+            te = ln_tensor_table_find(op->op_arg->tensor_table, tle->name);
+            if (!te->owner || !te->inplace)
+                continue;
+            if (inplace_is_safe(l, te, op->op_arg->tensor_table, consts)) {
+                ln_msg_debug("plan memory %s: %s in-place of %s",
+                             ln_mem_type_name(te->mtype), te->name, te->owner);
+                continue;
+            }
+            ln_free(te->owner);
+            te->owner = NULL;
+        }
+    }
+}
+
+/*
+ * Static tensors other than the context's inputs are weights, which are
+ * planned in a segment of their own, so that contexts of the same model can
+ * share them. The rest is planned in the per-context activation segment.
+ * The outputs of constant ops are never freed, like static tensors, so that
+ * runs can skip those ops. Scratch outputs are freed right after their ops.
+ */
 void ln_pass_mem_plan(ln_context *ctx)
 {
     ln_op *op;
     ln_op_arg *arg;
     ln_hash *use_counts;
+    ln_hash *reads;
     ln_tensor_entry *te;
     ln_tensor_entry *owner_te;
+    int keeps_root;
     ln_tensor_list_entry *tle;
     ln_hash *mem_pools;
-    ln_list *unused_tles;
+    ln_hash *weight_pools;
+    ln_hash *consts;
     size_t total_sums[LN_MEM_TYPE_SIZE] = {0};
-
-    mem_pools = ln_mem_pool_table_create();
+    ln_pass_timer timer;
+
+    ln_pass_timer_start(ctx, &timer, "mem_plan");
+    ln_pass_mark_written_roots(ctx);
+    consts = ln_pass_constant_tensors(ctx);
+    resolve_inplace_owners(ctx, consts);
+    memset(ctx->mem_sizes, 0, sizeof(ctx->mem_sizes));
+    memset(ctx->weight_sizes, 0, sizeof(ctx->weight_sizes));
+    mem_pools = ln_mem_pool_table_create(ctx->mem_align);
+    weight_pools = ln_mem_pool_table_create(ctx->mem_align);
     use_counts = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+    reads = ln_pass_read_tensors(ctx);
     LN_LIST_FOREACH(op, ctx->ops) {
         arg = op->op_arg;
         LN_LIST_FOREACH(tle, arg->tensors_out) {
@@ -357,13 +565,21 @@ void ln_pass_mem_plan(ln_context *ctx)
             if (te->mtype == LN_MEM_NONE)
                 ln_msg_inter_error("tensor '%s' has an unresolved memory type %s", te->name, ln_mem_type_name(te->mtype));
             if (te->owner) {
+                keeps_root = ln_pass_keeps_root(te, reads);
                 te = find_root_owner(te->owner, arg->tensor_table);
                 if (!ln_hash_find_extended(use_counts, te->name, NULL, NULL))
                     use_count_zero(use_counts, te->name);
+                /* a view nobody reads is an output of the model, which keeps
+                   the memory of its root */
+                if (keeps_root)
+                    use_count_inc(use_counts, te->name);
                 continue;
             }
-            if (te->isstatic) {
-                alloc_set_offset(te, mem_pools, ctx);
+            if (persists(te, consts)) {
+                if (ln_context_is_weight(ctx, te->name))
+                    alloc_set_offset(ctx, te, weight_pools, ctx->weight_sizes);
+                else
+                    alloc_set_offset(ctx, te, mem_pools, ctx->mem_sizes);
                 total_sums[te->mtype] += tl_tensor_size(te->tensor);
                 use_count_zero(use_counts, te->name);
                 continue;
@@ -386,7 +602,6 @@ void ln_pass_mem_plan(ln_context *ctx)
 
     LN_LIST_FOREACH(op, ctx->ops) {
         arg = op->op_arg;
-        unused_tles = NULL;
         LN_LIST_FOREACH(tle, arg->tensors_out) {
             te = ln_tensor_table_find(arg->tensor_table, tle->name);
             if (te->owner) {
@@ -396,37 +611,32 @@ void ln_pass_mem_plan(ln_context *ctx)
                     /* NOTE: it appears that owner_te->owner should always be
                        NULL here in *current* design */
                     assert(!owner_te->owner);
-                    alloc_set_offset(owner_te, mem_pools, ctx);
+                    alloc_set_offset(ctx, owner_te, mem_pools, ctx->mem_sizes);
                     total_sums[owner_te->mtype] +=
                             tl_tensor_size(owner_te->tensor);
                 }
                 set_shared_offset(ctx->dfg, op, te);
                 continue;
             }
-            if (te->isstatic)
+            if (persists(te, consts))
                 continue;
-            alloc_set_offset(te, mem_pools, ctx);
+            /* tensors nobody reads are the outputs of the model, which are
+               never deallocated, except the scratch of the op */
+            alloc_set_offset(ctx, te, mem_pools, ctx->mem_sizes);
             total_sums[te->mtype] += tl_tensor_size(te->tensor);
-            if (use_count_of(use_counts, te->name) == 0)
-                unused_tles = ln_list_prepend(unused_tles, tle);
-        }
-        LN_LIST_FOREACH(tle, unused_tles) {
-            te = ln_tensor_table_find(arg->tensor_table, tle->name);
-            dealloc_offset(te, mem_pools);
         }
-        ln_list_free(unused_tles);
         LN_LIST_FOREACH(tle, arg->tensors_in) {
             te = ln_tensor_table_find(arg->tensor_table, tle->name);
             if (te->owner) {
                 te = find_root_owner(te->owner, arg->tensor_table);
                 if (use_count_dec(use_counts, te->name) == 0) {
-                    if (te->isstatic)
+                    if (persists(te, consts))
                         continue;
                     dealloc_offset(te, mem_pools);
                 }
                 continue;
             }
-            if (te->isstatic) {
+            if (persists(te, consts)) {
                 use_count_dec(use_counts, te->name);
                 continue;
             }
@@ -434,6 +644,13 @@ void ln_pass_mem_plan(ln_context *ctx)
                 dealloc_offset(te, mem_pools);
             }
         }
+        /* scratch outputs are freed only after the inputs, which the op
+           reads while using them */
+        LN_LIST_FOREACH(tle, arg->tensors_out) {
+            te = ln_tensor_table_find(arg->tensor_table, tle->name);
+            if (te->scratch)
+                dealloc_offset(te, mem_pools);
+        }
     }
     assert(ctx->mem_sizes[LN_MEM_NONE] == 0);
 
@@ -441,11 +658,106 @@ void ln_pass_mem_plan(ln_context *ctx)
     for (int i = LN_MEM_NONE+1; i < LN_MEM_TYPE_SIZE; i++) {
         ln_msg_debug("planned usage of memory %s: %lu bytes",
                      ln_mem_type_name(i), ctx->mem_sizes[i]);
+        ln_msg_debug("planned usage of weights %s: %lu bytes",
+                     ln_mem_type_name(i), ctx->weight_sizes[i]);
         ln_msg_debug("counted usage of memory %s: %lu bytes",
                      ln_mem_type_name(i), total_sums[i]);
     }
 #endif  /* LN_DEBUG */
 
+    ln_hash_free(reads);
     ln_hash_free(use_counts);
+    ln_hash_free(consts);
     ln_mem_pool_table_free(mem_pools);
+    ln_mem_pool_table_free(weight_pools);
+    ln_pass_timer_stop(ctx, &timer);
+}
+
+static ln_pass_stat *find_stat(ln_context *ctx, const char *name)
+{
+    ln_pass_stat *stat;
+
+    LN_LIST_FOREACH(stat, ctx->pass_stats) {
+        if (ln_streq(stat->name, name))
+            return stat;
+    }
+    stat = ln_alloc(sizeof(ln_pass_stat));
+    memset(stat, 0, sizeof(ln_pass_stat));
+    stat->name = ln_strdup(name);
+    ctx->pass_stats = ln_list_append(ctx->pass_stats, stat);
+    return stat;
+}
+
+/*
+ * Start measuring a run of the pass `name` with `timer` if ctx->time_passes
+ * is set. Passes of the same name share their statistics, which are kept in
+ * ctx->pass_stats in the order of their first runs. Timers may nest.
+ */
+void ln_pass_timer_start(ln_context *ctx, ln_pass_timer *timer,
+                         const char *name)
+{
+    timer->replacements = 0;
+    if (!ctx->time_passes) {
+        timer->stat = NULL;
+        return;
+    }
+    timer->stat = find_stat(ctx, name);
+    timer->checks = ln_dfg_checks();
+    timer->lookups = ln_hash_lookups();
+    timer->start = ln_clock();
+}
+
+void ln_pass_timer_stop(ln_context *ctx, ln_pass_timer *timer)
+{
+    ln_pass_stat *stat = timer->stat;
+    size_t nops;
+
+    if (!stat)
+        return;
+    stat->time += ln_clock() - timer->start;
+    stat->runs++;
+    stat->replacements += timer->replacements;
+    stat->checks += ln_dfg_checks() - timer->checks;
+    stat->lookups += ln_hash_lookups() - timer->lookups;
+    nops = ln_list_length(ctx->ops);
+    if (nops > stat->max_ops)
+        stat->max_ops = nops;
+}
+
+static void pass_stat_free(void *p)
+{
+    ln_pass_stat *stat = p;
+
+    ln_free(stat->name);
+    ln_free(stat);
+}
+
+void ln_pass_stats_free(ln_list *stats)
+{
+    ln_list_free_deep(stats, pass_stat_free);
+}
+
+/*
+ * Print a report of the pass statistics `stats`, whose first entry is the
+ * whole compilation, to `fp`, like LLVM's -time-passes.
+ */
+void ln_pass_stats_fprint(FILE *fp, ln_list *stats)
+{
+    const ln_pass_stat *total, *stat;
+
+    if (!stats)
+        return;
+    total = stats->data;
+    fprintf(fp, "===--- Pass execution timing report ---===\n");
+    fprintf(fp, "  Total compile time: %.6f seconds\n\n", total->time);
+    fprintf(fp, "  %10s %6s %6s %8s %7s %9s %7s  %s\n", "time (s)", "%",
+            "runs", "replaced", "checks", "lookups", "max ops", "pass");
+    LN_LIST_FOREACH(stat, stats) {
+        fprintf(fp, "  %10.6f %5.1f%% %6d %8lu %7lu %9lu %7lu  %s\n",
+                stat->time,
+                total->time > 0 ? stat->time / total->time * 100 : 0,
+                stat->runs, (unsigned long)stat->replacements,
+                (unsigned long)stat->checks, (unsigned long)stat->lookups,
+                (unsigned long)stat->max_ops, stat->name);
+    }
 }
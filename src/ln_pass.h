@@ -38,6 +38,28 @@ typedef ln_list *(*ln_subgraph_func) (const ln_context *ctx, ln_list **old_ops);
 typedef ln_list *(*ln_schedule_func) (const ln_context *ctx);
 typedef ln_list *(*ln_optdata_func) (const ln_context *ctx);
 
+/* compile-time statistics of a pass, summed over its runs */
+struct ln_pass_stat {
+    char       *name;
+    int         runs;
+    double      time;           /* in seconds */
+    size_t      replacements;   /* ops moved, expanded or combined */
+    size_t      checks;         /* DFG checks */
+    size_t      lookups;        /* hash table lookups */
+    size_t      max_ops;        /* peak number of ops */
+};
+typedef struct ln_pass_stat ln_pass_stat;
+
+/* measures a run of a pass into its ln_pass_stat if ctx->time_passes */
+struct ln_pass_timer {
+    ln_pass_stat *stat;
+    double        start;
+    size_t        checks;
+    size_t        lookups;
+    size_t        replacements; /* counted by the pass */
+};
+typedef struct ln_pass_timer ln_pass_timer;
+
 #ifdef __cplusplus
 LN_CPPSTART
 #endif
@@ -49,7 +71,17 @@ void ln_pass_subgraph(ln_context *ctx, ln_subgraph_func sg_func);
 void ln_pass_schedule(ln_context *ctx, ln_schedule_func sd_func);
 void ln_pass_optimize_with_data(ln_context *ctx, ln_optdata_func od_func,
                                 const char *datafile);
+ln_hash *ln_pass_constant_tensors(const ln_context *ctx);
+ln_hash *ln_pass_read_tensors(const ln_context *ctx);
+int ln_pass_keeps_root(const ln_tensor_entry *te, ln_hash *reads);
+void ln_pass_mark_written_roots(ln_context *ctx);
+size_t ln_pass_planned_size(const ln_context *ctx, const ln_tensor_entry *te);
 void ln_pass_mem_plan(ln_context *ctx);
+void ln_pass_timer_start(ln_context *ctx, ln_pass_timer *timer,
+                         const char *name);
+void ln_pass_timer_stop(ln_context *ctx, ln_pass_timer *timer);
+void ln_pass_stats_free(ln_list *stats);
+void ln_pass_stats_fprint(FILE *fp, ln_list *stats);
 
 #ifdef __cplusplus
 LN_CPPEND
@@ -0,0 +1,200 @@
+/*
+ * Copyright (c) 2018-2020 Zhixu Zhao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string.h>
+#include "ln_plan_cache.h"
+#include "ln_json.h"
+#include "ln_msg.h"
+
+/*
+ * A plan cache compiles a model whose input dims are symbolic on demand, once
+ * for every concrete shape of its inputs, and keeps the loaded contexts of the
+ * most recently used shapes. The weights are loaded once and shared by all
+ * the contexts planning them the same way, see ln_context_share_weights().
+ */
+
+struct plan {
+    int        *dims;           /* concatenated dims of the inputs */
+    ln_context *ctx;
+};
+typedef struct plan plan;
+
+struct ln_plan_cache {
+    char       *source;         /* JSON text of the model */
+    char       *target;
+    char       *datafile;
+    char       *inputs;         /* inputs with symbolic dims */
+    int         n_dims;         /* total number of dims of the inputs */
+    int         capacity;
+    ln_list    *plans;          /* the most recently used first */
+};
+
+static ln_context *parse_context(char *source)
+{
+    ln_context *ctx;
+
+    ctx = ln_context_create();
+    ln_json_parse(source, ctx);
+    ln_context_init_ops(ctx);
+    return ctx;
+}
+
+/*
+ * Create a plan cache of the model in the JSON file `source`, to be compiled
+ * for `target`, with weights loaded from `datafile`. The dims of the tensors
+ * in the comma-separated list `inputs`, created by `create` ops, are symbolic,
+ * and those in `source` only give their numbers of dimensions. The loaded
+ * contexts of at most `capacity` shapes are kept.
+ */
+LN_EXPORT ln_plan_cache *ln_plan_cache_create(const char *source,
+                                              const char *target,
+                                              const char *datafile,
+                                              const char *inputs, int capacity)
+{
+    ln_plan_cache *cache;
+    ln_tensor_entry *te;
+    ln_context *ctx;
+    char *names, *name, *saveptr;
+
+    if (capacity <= 0)
+        ln_msg_error("plan cache capacity should be positive, got %d",
+                     capacity);
+    cache = ln_alloc(sizeof(ln_plan_cache));
+    if (ln_streq(source, "-"))
+        cache->source = ln_read_stdin();
+    else
+        cache->source = ln_read_text(source);
+    cache->target = ln_strdup(target);
+    cache->datafile = datafile ? ln_strdup(datafile) : NULL;
+    cache->inputs = ln_strdup(inputs);
+    cache->n_dims = 0;
+    cache->capacity = capacity;
+    cache->plans = NULL;
+
+    ctx = parse_context(cache->source);
+    names = ln_strdup(inputs);
+    for (name = strtok_r(names, ",", &saveptr); name;
+         name = strtok_r(NULL, ",", &saveptr)) {
+        te = ln_tensor_table_find(ctx->tensor_table, name);
+        if (!te)
+            ln_msg_error("tensor name '%s' not found", name);
+        cache->n_dims += te->tensor->ndim;
+    }
+    ln_free(names);
+    ln_context_cleanup(ctx);
+    ln_context_free(ctx);
+
+    return cache;
+}
+
+static void plan_free(plan *p)
+{
+    ln_context_unload(p->ctx);
+    ln_context_cleanup(p->ctx);
+    ln_context_free(p->ctx);
+    ln_free(p->dims);
+    ln_free(p);
+}
+
+static void plan_free_wrapper(void *p)
+{
+    plan_free(p);
+}
+
+LN_EXPORT void ln_plan_cache_free(ln_plan_cache *cache)
+{
+    ln_list_free_deep(cache->plans, plan_free_wrapper);
+    ln_free(cache->source);
+    ln_free(cache->target);
+    ln_free(cache->datafile);
+    ln_free(cache->inputs);
+    ln_free(cache);
+}
+
+/* A shape may change how the weights are planned, such as by the passes
+   depending on the shapes, in which case the context loads its own. */
+static plan *specialize(ln_plan_cache *cache, const int *dims)
+{
+    plan *p;
+    ln_context *ctx;
+    ln_list *l;
+
+    ctx = parse_context(cache->source);
+    ln_context_set_inputs(ctx, cache->inputs);
+    ln_context_set_dims(ctx, cache->inputs, dims);
+    ln_context_compile(ctx, cache->target, cache->datafile);
+    for (l = cache->plans; l; l = l->next) {
+        p = l->data;
+        if (ln_context_can_share_weights(ctx, p->ctx)) {
+            ln_context_share_weights(ctx, p->ctx);
+            break;
+        }
+    }
+    if (l) {
+        ln_context_load(ctx, NULL);
+    } else {
+        if (cache->plans)
+            ln_msg_debug("weights planned differently for a new shape, loading them again");
+        ln_context_load(ctx, cache->datafile);
+    }
+
+    p = ln_alloc(sizeof(plan));
+    p->dims = ln_clone(dims, sizeof(int) * cache->n_dims);
+    p->ctx = ctx;
+    return p;
+}
+
+/*
+ * Return the loaded context specialized for the inputs having `dims`, the
+ * dims of each input in order, compiling it if it isn't cached. It is owned
+ * by the cache, and is freed when `capacity` other shapes are used after it.
+ * The cache isn't thread-safe.
+ */
+LN_EXPORT ln_context *ln_plan_cache_get(ln_plan_cache *cache, const int *dims)
+{
+    ln_list *l;
+    plan *p;
+
+    for (l = cache->plans; l; l = l->next) {
+        p = l->data;
+        if (memcmp(p->dims, dims, sizeof(int) * cache->n_dims))
+            continue;
+        if (l != cache->plans) {
+            cache->plans = ln_list_remove(cache->plans, p);
+            cache->plans = ln_list_prepend(cache->plans, p);
+        }
+        return p->ctx;
+    }
+
+    p = specialize(cache, dims);
+    cache->plans = ln_list_prepend(cache->plans, p);
+    if (ln_list_length(cache->plans) > cache->capacity)
+        cache->plans = ln_list_remove_nth_deep(cache->plans, cache->capacity,
+                                               plan_free_wrapper);
+    return p->ctx;
+}
+
+/* Return the number of cached plans. */
+LN_EXPORT int ln_plan_cache_size(const ln_plan_cache *cache)
+{
+    return ln_list_length(cache->plans);
+}
@@ -0,0 +1,45 @@
+/*
+ * Copyright (c) 2018-2020 Zhixu Zhao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _LN_PLAN_CACHE_H_
+#define _LN_PLAN_CACHE_H_
+
+#include "ln_context.h"
+
+typedef struct ln_plan_cache ln_plan_cache;
+
+#ifdef __cplusplus
+LN_CPPSTART
+#endif
+
+ln_plan_cache *ln_plan_cache_create(const char *source, const char *target,
+                                    const char *datafile, const char *inputs,
+                                    int capacity);
+void ln_plan_cache_free(ln_plan_cache *cache);
+ln_context *ln_plan_cache_get(ln_plan_cache *cache, const int *dims);
+int ln_plan_cache_size(const ln_plan_cache *cache);
+
+#ifdef __cplusplus
+LN_CPPEND
+#endif
+
+#endif  /* _LN_PLAN_CACHE_H_ */
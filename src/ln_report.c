@@ -0,0 +1,386 @@
+/*
+ * Copyright (c) 2018-2020 Zhixu Zhao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <assert.h>
+#include <string.h>
+#include "ln_report.h"
+#include "ln_pass.h"
+#include "ln_msg.h"
+
+/*
+ * The memory plan report shows when and where every planned tensor lives.
+ * The lifetime of a tensor spans the ops (by their indexes in ctx->ops) from
+ * the one defining it to the last one reading it, through its views too, as
+ * ln_pass_mem_plan() plans it: static tensors and the outputs of the ops
+ * depending only on weights live through all the ops, and so do the roots of
+ * the tensors nobody reads, see ln_pass_keeps_root().
+ */
+
+struct span {
+    ln_tensor_entry *te;        /* root entry, which owns the memory */
+    size_t           size;      /* planned size, padded to the alignment */
+    int              first_def;
+    int              last_use;
+    int              kept;      /* kept through all the ops after first_def */
+};
+typedef struct span span;
+
+/* the memory or the weights of a memory type */
+struct arena {
+    ln_mem_type  mtype;
+    int          isweight;
+    size_t       size;          /* planned size */
+    size_t       peak;          /* max bytes of the tensors live at once */
+    int          peak_op;
+    ln_list     *spans;
+};
+typedef struct arena arena;
+
+#define SVG_WIDTH 960
+#define SVG_MARGIN 80
+#define SVG_PANEL_HEIGHT 320
+#define SVG_PANEL_GAP 60
+
+static span *touch(ln_hash *table, ln_list **spans, const ln_context *ctx,
+                   const char *name, int idx)
+{
+    ln_tensor_entry *te;
+    span *s;
+
+    te = ln_tensor_table_find_root(ctx->tensor_table, name);
+    assert(te);
+    s = ln_hash_find(table, te->name);
+    if (!s) {
+        s = ln_alloc(sizeof(span));
+        s->te = te;
+        s->size = ln_pass_planned_size(ctx, te);
+        s->first_def = idx;
+        s->kept = 0;
+        ln_hash_insert(table, te->name, s);
+        *spans = ln_list_prepend(*spans, s);
+    }
+    s->last_use = idx;
+    return s;
+}
+
+static ln_list *collect_spans(const ln_context *ctx, int *n_ops)
+{
+    ln_tensor_list_entry *tle;
+    ln_list *spans = NULL;
+    ln_hash *table;
+    ln_hash *consts;
+    ln_hash *reads;
+    ln_op *op;
+    span *s;
+    int i = 0;
+
+    table = ln_hash_create(ln_str_hash, ln_str_cmp, NULL, NULL);
+    reads = ln_pass_read_tensors(ctx);
+    LN_LIST_FOREACH(op, ctx->ops) {
+        LN_LIST_FOREACH(tle, op->op_arg->tensors_out) {
+            s = touch(table, &spans, ctx, tle->name, i);
+            if (ln_pass_keeps_root(ln_tensor_table_find(ctx->tensor_table,
+                                                        tle->name), reads))
+                s->kept = 1;
+        }
+        LN_LIST_FOREACH(tle, op->op_arg->tensors_in)
+            touch(table, &spans, ctx, tle->name, i);
+        i++;
+    }
+    *n_ops = i;
+    ln_hash_free(reads);
+    ln_hash_free(table);
+
+    consts = ln_pass_constant_tensors(ctx);
+    LN_LIST_FOREACH(s, spans) {
+        if (s->te->isstatic ||
+            ln_hash_find_extended(consts, s->te->name, NULL, NULL)) {
+            s->first_def = 0;
+            s->last_use = *n_ops - 1;
+        } else if (s->kept) {
+            s->last_use = *n_ops - 1;
+        }
+    }
+    ln_hash_free(consts);
+    return ln_list_reverse(spans);
+}
+
+static int in_weights(const ln_context *ctx, const ln_tensor_entry *te)
+{
+    return ctx->weight_sizes[te->mtype] &&
+        ln_context_is_weight(ctx, te->name);
+}
+
+static ln_list *collect_arenas(const ln_context *ctx, ln_list *spans,
+                               int n_ops)
+{
+    ln_list *arenas = NULL;
+    size_t *live;
+    arena *a;
+    span *s;
+    int i, w;
+
+    live = ln_alloc(sizeof(size_t) * (n_ops > 0 ? n_ops : 1));
+    for (i = LN_MEM_NONE+1; i < LN_MEM_TYPE_SIZE; i++) {
+        for (w = 0; w < 2; w++) {
+            a = ln_alloc(sizeof(arena));
+            a->mtype = i;
+            a->isweight = w;
+            a->size = w ? ctx->weight_sizes[i] : ctx->mem_sizes[i];
+            a->spans = NULL;
+            LN_LIST_FOREACH(s, spans) {
+                if (s->te->mtype == i && in_weights(ctx, s->te) == w)
+                    a->spans = ln_list_prepend(a->spans, s);
+            }
+            if (!a->spans && !a->size) {
+                ln_free(a);
+                continue;
+            }
+            a->spans = ln_list_reverse(a->spans);
+            memset(live, 0, sizeof(size_t) * n_ops);
+            LN_LIST_FOREACH(s, a->spans) {
+                for (int j = s->first_def; j <= s->last_use; j++)
+                    live[j] += s->size;
+            }
+            a->peak = 0;
+            a->peak_op = 0;
+            for (int j = 0; j < n_ops; j++) {
+                if (live[j] > a->peak) {
+                    a->peak = live[j];
+                    a->peak_op = j;
+                }
+            }
+            arenas = ln_list_prepend(arenas, a);
+        }
+    }
+    ln_free(live);
+    return ln_list_reverse(arenas);
+}
+
+static void arena_free(void *p)
+{
+    arena *a = p;
+
+    ln_list_free(a->spans);
+    ln_free(a);
+}
+
+static double fragmentation(const arena *a)
+{
+    return a->size ? 1 - (double)a->peak / a->size : 0;
+}
+
+static const char *op_name(const ln_context *ctx, int idx)
+{
+    ln_op *op;
+
+    op = ln_list_nth_data(ctx->ops, idx);
+    return op ? op->op_arg->name : "";
+}
+
+static void fprint_summary(FILE *fp, const ln_context *ctx, const arena *a)
+{
+    fprintf(fp, "%s %s: %lu bytes planned, %lu bytes live at most at op %d '%s', fragmentation %.2f%%",
+            ln_mem_type_name(a->mtype), a->isweight ? "weights" : "memory",
+            a->size, a->peak, a->peak_op, op_name(ctx, a->peak_op),
+            fragmentation(a) * 100);
+}
+
+static void fprint_text(FILE *fp, const ln_context *ctx, ln_list *arenas,
+                        int n_ops)
+{
+    arena *a;
+    span *s;
+
+    fprintf(fp, "memory plan of %d ops\n", n_ops);
+    LN_LIST_FOREACH(a, arenas) {
+        fprint_summary(fp, ctx, a);
+        fprintf(fp, "\n%12s %12s %9s %9s  %s\n",
+                "offset", "size", "first_def", "last_use", "tensor");
+        LN_LIST_FOREACH(s, a->spans) {
+            fprintf(fp, "%12lu %12lu %9d %9d  %s\n", s->te->offset,
+                    s->size, s->first_def, s->last_use,
+                    s->te->name);
+        }
+    }
+}
+
+static void fprint_escaped(FILE *fp, const char *str)
+{
+    for (; *str; str++) {
+        switch (*str) {
+        case '<':
+            fputs("&lt;", fp);
+            break;
+        case '>':
+            fputs("&gt;", fp);
+            break;
+        case '&':
+            fputs("&amp;", fp);
+            break;
+        case '"':
+            fputs("&quot;", fp);
+            break;
+        default:
+            fputc(*str, fp);
+            break;
+        }
+    }
+}
+
+/* ops on the x axis, offsets on the y axis, one panel per arena */
+static void fprint_svg(FILE *fp, const ln_context *ctx, ln_list *arenas,
+                       int n_ops)
+{
+    double col_width, scale, x, y, width, height;
+    int n_arenas, top;
+    arena *a;
+    span *s;
+
+    n_arenas = ln_list_length(arenas);
+    col_width = (double)(SVG_WIDTH - 2 * SVG_MARGIN) / (n_ops > 0 ? n_ops : 1);
+    fprintf(fp, "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"%d\" height=\"%d\" font-family=\"sans-serif\" font-size=\"12\">\n",
+            SVG_WIDTH, n_arenas * (SVG_PANEL_HEIGHT + SVG_PANEL_GAP) + SVG_PANEL_GAP);
+    top = SVG_PANEL_GAP;
+    LN_LIST_FOREACH(a, arenas) {
+        scale = a->size ? (double)SVG_PANEL_HEIGHT / a->size : 0;
+        fprintf(fp, "<text x=\"%d\" y=\"%d\">", SVG_MARGIN, top - 8);
+        fprint_summary(fp, ctx, a);
+        fprintf(fp, "</text>\n");
+        fprintf(fp, "<rect x=\"%d\" y=\"%d\" width=\"%d\" height=\"%d\" fill=\"none\" stroke=\"black\"/>\n",
+                SVG_MARGIN, top, SVG_WIDTH - 2 * SVG_MARGIN, SVG_PANEL_HEIGHT);
+        fprintf(fp, "<text x=\"%d\" y=\"%d\" text-anchor=\"end\">0</text>\n",
+                SVG_MARGIN - 4, top + 12);
+        fprintf(fp, "<text x=\"%d\" y=\"%d\" text-anchor=\"end\">%lu</text>\n",
+                SVG_MARGIN - 4, top + SVG_PANEL_HEIGHT, a->size);
+        fprintf(fp, "<text x=\"%d\" y=\"%d\">%d</text>\n",
+                SVG_WIDTH - SVG_MARGIN + 4, top + SVG_PANEL_HEIGHT, n_ops);
+        LN_LIST_FOREACH(s, a->spans) {
+            x = SVG_MARGIN + s->first_def * col_width;
+            width = (s->last_use - s->first_def + 1) * col_width;
+            y = top + s->te->offset * scale;
+            height = s->size * scale;
+            fprintf(fp, "<rect x=\"%.2f\" y=\"%.2f\" width=\"%.2f\" height=\"%.2f\" fill=\"hsl(%u,60%%,65%%)\" stroke=\"gray\" stroke-width=\"0.5\"><title>",
+                    x, y, width, height > 1 ? height : 1,
+                    ln_str_hash(s->te->name) % 360);
+            fprint_escaped(fp, s->te->name);
+            fprintf(fp, ": [%lu, %lu), ops %d-%d</title></rect>\n",
+                    s->te->offset,
+                    s->te->offset + s->size,
+                    s->first_def, s->last_use);
+        }
+        x = SVG_MARGIN + (a->peak_op + 0.5) * col_width;
+        fprintf(fp, "<line x1=\"%.2f\" y1=\"%d\" x2=\"%.2f\" y2=\"%d\" stroke=\"red\" stroke-dasharray=\"4\"><title>peak at op %d ",
+                x, top, x, top + SVG_PANEL_HEIGHT, a->peak_op);
+        fprint_escaped(fp, op_name(ctx, a->peak_op));
+        fprintf(fp, "</title></line>\n");
+        top += SVG_PANEL_HEIGHT + SVG_PANEL_GAP;
+    }
+    fprintf(fp, "</svg>\n");
+}
+
+static void fprint_html(FILE *fp, const ln_context *ctx, ln_list *arenas,
+                        int n_ops)
+{
+    ln_op *op;
+    int i = 0;
+    arena *a;
+    span *s;
+
+    fprintf(fp, "<!DOCTYPE html>\n<html>\n<head>\n<meta charset=\"utf-8\">\n"
+            "<title>Lightnet Memory Plan</title>\n"
+            "<style>table{border-collapse:collapse}"
+            "th,td{padding:0 8px;text-align:right}</style>\n"
+            "</head>\n<body>\n");
+    fprint_svg(fp, ctx, arenas, n_ops);
+    LN_LIST_FOREACH(a, arenas) {
+        fprintf(fp, "<h3>");
+        fprint_summary(fp, ctx, a);
+        fprintf(fp, "</h3>\n<table>\n<tr><th>offset</th><th>size</th>"
+                "<th>first_def</th><th>last_use</th><th>tensor</th></tr>\n");
+        LN_LIST_FOREACH(s, a->spans) {
+            fprintf(fp, "<tr><td>%lu</td><td>%lu</td><td>%d</td><td>%d</td><td>",
+                    s->te->offset, s->size,
+                    s->first_def, s->last_use);
+            fprint_escaped(fp, s->te->name);
+            fprintf(fp, "</td></tr>\n");
+        }
+        fprintf(fp, "</table>\n");
+    }
+    fprintf(fp, "<h3>ops</h3>\n<table>\n");
+    LN_LIST_FOREACH(op, ctx->ops) {
+        fprintf(fp, "<tr><td>%d</td><td>", i++);
+        fprint_escaped(fp, op->op_arg->name);
+        fprintf(fp, "</td></tr>\n");
+    }
+    fprintf(fp, "</table>\n</body>\n</html>\n");
+}
+
+/* Guess the report format from the extension of `file`. */
+ln_report_format ln_report_format_of(const char *file)
+{
+    const char *ext;
+
+    ext = strrchr(file, '.');
+    if (ext && ln_streq(ext, ".svg"))
+        return LN_REPORT_SVG;
+    if (ext && (ln_streq(ext, ".html") || ln_streq(ext, ".htm")))
+        return LN_REPORT_HTML;
+    return LN_REPORT_TEXT;
+}
+
+void ln_report_mem_plan(FILE *fp, const ln_context *ctx,
+                        ln_report_format format)
+{
+    ln_list *spans;
+    ln_list *arenas;
+    int n_ops;
+
+    spans = collect_spans(ctx, &n_ops);
+    arenas = collect_arenas(ctx, spans, n_ops);
+    switch (format) {
+    case LN_REPORT_TEXT:
+        fprint_text(fp, ctx, arenas, n_ops);
+        break;
+    case LN_REPORT_SVG:
+        fprint_svg(fp, ctx, arenas, n_ops);
+        break;
+    case LN_REPORT_HTML:
+        fprint_html(fp, ctx, arenas, n_ops);
+        break;
+    default:
+        assert(0 && "unknown ln_report_format");
+        break;
+    }
+    ln_list_free_deep(arenas, arena_free);
+    ln_list_free_deep(spans, ln_free);
+}
+
+void ln_report_mem_plan_file(const char *file, const ln_context *ctx)
+{
+    FILE *fp;
+
+    if (!(fp = fopen(file, "w")))
+        ln_msg_error_sys("ln_report_mem_plan_file(): cannot open %s", file);
+    ln_report_mem_plan(fp, ctx, ln_report_format_of(file));
+    fclose(fp);
+}
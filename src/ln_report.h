@@ -0,0 +1,49 @@
+/*
+ * Copyright (c) 2018-2020 Zhixu Zhao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef _LN_REPORT_H_
+#define _LN_REPORT_H_
+
+#include <stdio.h>
+#include "ln_context.h"
+
+enum ln_report_format {
+    LN_REPORT_TEXT = 0,
+    LN_REPORT_SVG,
+    LN_REPORT_HTML
+};
+typedef enum ln_report_format ln_report_format;
+
+#ifdef __cplusplus
+LN_CPPSTART
+#endif
+
+ln_report_format ln_report_format_of(const char *file);
+void ln_report_mem_plan(FILE *fp, const ln_context *ctx,
+                        ln_report_format format);
+void ln_report_mem_plan_file(const char *file, const ln_context *ctx);
+
+#ifdef __cplusplus
+LN_CPPEND
+#endif
+
+#endif  /* _LN_REPORT_H_ */
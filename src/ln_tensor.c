@@ -20,9 +20,17 @@
  * SOFTWARE.
  */
 
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
 #include "ln_tensor.h"
 #include "ln_util.h"
 #include "ln_msg.h"
+#include "ln_lz.h"
+#include "arch/ln_cpu.h"
 
 ln_tensor_list_entry *ln_tensor_list_entry_create(const char *arg_name,
                                                   const char *name)
@@ -170,6 +178,11 @@ ln_tensor_entry *ln_tensor_entry_create(const char *name, tl_tensor *tensor)
     entry->creater = NULL;
     entry->offset = 0;
     entry->isstatic = 0;
+    entry->inplace = 0;
+    entry->scratch = 0;
+    entry->dirty = 0;
+    entry->version = 0;
+    entry->written = 0;
     entry->mtype = LN_MEM_NONE;
 
     return entry;
@@ -199,6 +212,11 @@ void ln_tensor_entry_set_owner(ln_tensor_entry *entry, ln_hash *tensor_table,
 {
     /* ln_tensor_entry *te; */
 
+    if (!owner) {
+        ln_free(entry->owner);
+        entry->owner = NULL;
+        return;
+    }
     if (ln_streq(entry->name, owner))
         ln_msg_inter_error("tensor (%s)'s owner can't be itself", entry->name);
 
@@ -235,6 +253,17 @@ ln_tensor_entry *ln_tensor_table_find(ln_hash *table, const char *name)
     return ln_hash_find(table, (char *)name);
 }
 
+/* Find the tensor that owns the data of tensor `name`. */
+ln_tensor_entry *ln_tensor_table_find_root(ln_hash *table, const char *name)
+{
+    ln_tensor_entry *te;
+
+    te = ln_tensor_table_find(table, name);
+    while (te && te->owner)
+        te = ln_tensor_table_find(table, te->owner);
+    return te;
+}
+
 void ln_tensor_table_free(ln_hash *table)
 {
     ln_hash_free(table);
@@ -267,6 +296,48 @@ void *ln_tensor_table_get_data(ln_hash *table, const char *name, void *data)
     return te->tensor->data;
 }
 
+/* Return the tensor entry of `name`, after checking that `frame` indexes its
+   leading dimension. */
+static ln_tensor_entry *find_frame(ln_hash *table, const char *name, int frame)
+{
+    ln_tensor_entry *te;
+
+    te = ln_tensor_table_find(table, name);
+    if (!te)
+        ln_msg_error("tensor name '%s' not found", name);
+    if (frame < 0 || frame >= te->tensor->dims[0])
+        ln_msg_error("frame %d of tensor '%s' out of range [0, %d)",
+                     frame, name, te->tensor->dims[0]);
+    return te;
+}
+
+void ln_tensor_table_set_frame(ln_hash *table, const char *name, int frame,
+                               const void *data)
+{
+    ln_tensor_entry *te;
+    ln_copy_func copy;
+    size_t size;
+
+    te = find_frame(table, name, frame);
+    copy = ln_mem_type_copy_func(te->mtype, LN_MEM_CPU);
+    size = tl_tensor_size(te->tensor) / te->tensor->dims[0];
+    copy((char *)te->tensor->data + size * frame, data, size);
+}
+
+void *ln_tensor_table_get_frame(ln_hash *table, const char *name, int frame,
+                                void *data)
+{
+    ln_tensor_entry *te;
+    ln_copy_func copy;
+    size_t size;
+
+    te = find_frame(table, name, frame);
+    copy = ln_mem_type_copy_func(LN_MEM_CPU, te->mtype);
+    size = tl_tensor_size(te->tensor) / te->tensor->dims[0];
+    copy(data, (char *)te->tensor->data + size * frame, size);
+    return (char *)te->tensor->data + size * frame;
+}
+
 size_t ln_tensor_table_data_size(ln_hash *table, const char *name)
 {
     ln_tensor_entry *te;
@@ -277,6 +348,45 @@ size_t ln_tensor_table_data_size(ln_hash *table, const char *name)
     return tl_tensor_size(te->tensor);
 }
 
+/* Return the number of dimensions of tensor `name`, and store its dims in
+   `dims` if it's not NULL. */
+int ln_tensor_table_data_shape(ln_hash *table, const char *name, int *dims)
+{
+    ln_tensor_entry *te;
+
+    te = ln_tensor_table_find(table, name);
+    if (!te)
+        ln_msg_error("tensor name '%s' not found", name);
+    if (dims)
+        memcpy(dims, te->tensor->dims, sizeof(int) * te->tensor->ndim);
+    return te->tensor->ndim;
+}
+
+/* Return the name of the data type of tensor `name`, like "TL_FLOAT". */
+const char *ln_tensor_table_data_dtype(ln_hash *table, const char *name)
+{
+    ln_tensor_entry *te;
+
+    te = ln_tensor_table_find(table, name);
+    if (!te)
+        ln_msg_error("tensor name '%s' not found", name);
+    return tl_dtype_name(te->tensor->dtype);
+}
+
+/* Return the data of tensor `name` if it has been allocated in CPU memory,
+   otherwise NULL. */
+void *ln_tensor_table_data_ptr(ln_hash *table, const char *name)
+{
+    ln_tensor_entry *te;
+
+    te = ln_tensor_table_find(table, name);
+    if (!te)
+        ln_msg_error("tensor name '%s' not found", name);
+    if (te->mtype != LN_MEM_CPU)
+        return NULL;
+    return te->tensor->data;
+}
+
 #define TRT_WEIGHT_ERR(file, fmt, varg...)                    \
     ln_msg_error("load_trt_weight_file(): invalid weight file %s: "fmt, \
                  (file), ##varg)
@@ -387,3 +497,669 @@ void ln_tensor_table_load_trt_weight_file(ln_hash *table, const char *file)
 
     fclose(fp);
 }
+
+/*
+ * Binary weight file, as written by tools/onnx2ln: a header of
+ * LN_WEIGHT_FILE_MAGIC, a uint32 version and a uint32 record count, then
+ * `count` records. Each record starts with a uint32 name length, a uint32
+ * dtype length and a uint64 data size, followed by the name and the dtype
+ * string (like "TL_FLOAT", both without terminating null). The raw
+ * little-endian data follows at the next file offset aligned to
+ * LN_WEIGHT_FILE_ALIGN.
+ *
+ * Since version 2 the header has a uint64 offset of an index following the
+ * records, which has an entry for each record: a uint64 data offset, a
+ * uint64 data size, the uint32 CRC-32 of the data, a uint32 name length, a
+ * uint32 dtype length and a reserved uint32, followed by the name and the
+ * dtype string, padded to 8 bytes. The index lets the loader find all blobs
+ * without a pass over the file; version 1 files are indexed by walking the
+ * record headers.
+ *
+ * Since version 3 there are no records: the blobs are only described by the
+ * index, whose entries get a uint64 stored size after the data size and a
+ * uint32 codec in place of the reserved field, moved after the CRC-32.
+ * Entries of identical data share one blob. A blob of LN_WEIGHT_CODEC_LZ is
+ * split into frames compressed with ln_lz_compress(), and starts with a
+ * uint32 frame size, a uint32 frame count and the uint32 stored sizes of
+ * the frames, followed by the frames.
+ */
+#define BIN_WEIGHT_ERR(file, fmt, varg...)                          \
+    ln_msg_error("load_weight_file(): invalid weight file %s: "fmt, \
+                 (file), ##varg)
+#define BIN_WEIGHT_WARN(file, fmt, varg...)                     \
+    ln_msg_warn("load_weight_file(): weight file %s: "fmt,      \
+                (file), ##varg)
+
+#define MAX_DTYPE_LEN 32
+
+struct weight_file_header {
+    char     magic[LN_WEIGHT_FILE_MAGIC_LEN];
+    uint32_t version;
+    uint32_t count;
+};
+
+struct weight_record_header {
+    uint32_t name_len;
+    uint32_t dtype_len;
+    uint64_t size;
+};
+
+struct weight_index_entry_v2 {
+    uint64_t offset;
+    uint64_t size;
+    uint32_t crc32;
+    uint32_t name_len;
+    uint32_t dtype_len;
+    uint32_t reserved;
+};
+
+struct weight_index_entry {
+    uint64_t offset;
+    uint64_t size;
+    uint64_t stored_size;
+    uint32_t crc32;
+    uint32_t codec;
+    uint32_t name_len;
+    uint32_t dtype_len;
+};
+
+/* a weight blob to load into a tensor */
+struct weight_blob {
+    ln_tensor_entry    *te;
+    uint64_t            offset;
+    uint64_t            size;
+    uint64_t            stored_size;
+    uint32_t            crc32;
+    uint32_t            codec;
+    struct weight_blob *src;    /* blob of the same data loaded instead */
+};
+
+/* a piece of at most LN_WEIGHT_FILE_CHUNK_SIZE bytes of a blob, or a frame
+   of a compressed blob */
+struct weight_chunk {
+    struct weight_blob *blob;
+    uint64_t            start;  /* relative to the blob */
+    uint64_t            size;
+    uint64_t            stored_offset;
+    uint64_t            stored_size;
+    uint32_t            crc32;
+};
+
+struct weight_loader {
+    const char          *file;
+    int                  fd;
+    uint64_t             file_size;
+    int                  has_crc;
+    int                  verify;
+    struct weight_blob  *blobs;
+    size_t               nblobs;
+    struct weight_chunk *chunks;
+    size_t               nchunks;
+    size_t               max_chunk;     /* max size of chunks */
+    size_t               max_stored;    /* max stored size of frames */
+};
+
+int ln_tensor_is_weight_file(const char *file)
+{
+    FILE *fp;
+    char magic[LN_WEIGHT_FILE_MAGIC_LEN];
+    int ret = 0;
+
+    if (!(fp = fopen(file, "rb")))
+        ln_msg_error_sys("is_weight_file(): cannot open %s", file);
+    if (fread(magic, LN_WEIGHT_FILE_MAGIC_LEN, 1, fp) == 1 &&
+        !memcmp(magic, LN_WEIGHT_FILE_MAGIC, LN_WEIGHT_FILE_MAGIC_LEN))
+        ret = 1;
+    fclose(fp);
+
+    return ret;
+}
+
+/* Read `size` bytes at `offset` of `fd`. Return -1 on error or end of file. */
+static int read_at(int fd, void *buf, size_t size, uint64_t offset)
+{
+    char *p = buf;
+    ssize_t n;
+
+    while (size > 0) {
+        n = pread(fd, p, size, (off_t)offset);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return -1;
+        p += n;
+        size -= n;
+        offset += n;
+    }
+    return 0;
+}
+
+/* Match a blob named `name` to its tensor. Return 0 if it's unused. */
+static int add_blob(struct weight_loader *loader, ln_hash *table,
+                    const char *name, const char *dtype_str,
+                    const struct weight_index_entry *entry)
+{
+    struct weight_blob *blob;
+    ln_tensor_entry *te;
+
+    if (entry->offset > loader->file_size ||
+        entry->stored_size > loader->file_size - entry->offset)
+        BIN_WEIGHT_ERR(loader->file, "data of weight %s is out of the file",
+                       name);
+    if (entry->codec >= LN_WEIGHT_CODEC_SIZE)
+        BIN_WEIGHT_ERR(loader->file, "unknown codec %u of weight %s",
+                       entry->codec, name);
+    if (entry->codec == LN_WEIGHT_CODEC_NONE &&
+        entry->stored_size != entry->size)
+        BIN_WEIGHT_ERR(loader->file,
+                       "stored size %lu of uncompressed weight %s isn't its size %lu",
+                       (unsigned long)entry->stored_size, name,
+                       (unsigned long)entry->size);
+    te = ln_tensor_table_find(table, name);
+    if (!te) {
+        BIN_WEIGHT_WARN(loader->file, "ignore unused weight %s", name);
+        return 0;
+    }
+    if (tl_dtype_from_str(dtype_str) != te->tensor->dtype)
+        BIN_WEIGHT_ERR(loader->file,
+                       "data type %s of weight %s doesn't match %s",
+                       dtype_str, name, tl_dtype_name(te->tensor->dtype));
+    if (entry->size != tl_tensor_size(te->tensor))
+        BIN_WEIGHT_ERR(loader->file, "size %lu of weight %s doesn't match %lu",
+                       (unsigned long)entry->size, name,
+                       (unsigned long)tl_tensor_size(te->tensor));
+
+    blob = &loader->blobs[loader->nblobs++];
+    blob->te = te;
+    blob->offset = entry->offset;
+    blob->size = entry->size;
+    blob->stored_size = entry->stored_size;
+    blob->crc32 = entry->crc32;
+    blob->codec = entry->codec;
+    blob->src = NULL;
+    return 1;
+}
+
+static void read_name(struct weight_loader *loader, uint64_t offset,
+                      uint32_t name_len, uint32_t dtype_len,
+                      char *name, char *dtype_str)
+{
+    if (name_len == 0 || name_len >= LN_MAX_NAME_LEN)
+        BIN_WEIGHT_ERR(loader->file, "bad name length %u", name_len);
+    if (dtype_len == 0 || dtype_len >= MAX_DTYPE_LEN)
+        BIN_WEIGHT_ERR(loader->file, "bad dtype length %u", dtype_len);
+    if (read_at(loader->fd, name, name_len, offset) < 0)
+        BIN_WEIGHT_ERR(loader->file, "error reading name");
+    name[name_len] = '\0';
+    if (read_at(loader->fd, dtype_str, dtype_len, offset + name_len) < 0)
+        BIN_WEIGHT_ERR(loader->file, "error reading dtype of weight %s", name);
+    dtype_str[dtype_len] = '\0';
+}
+
+/* version 1 has no index, so walk the record headers */
+static void scan_records(struct weight_loader *loader, ln_hash *table,
+                         uint32_t count, uint64_t offset)
+{
+    struct weight_record_header record;
+    struct weight_index_entry entry;
+    char name[LN_MAX_NAME_LEN];
+    char dtype_str[MAX_DTYPE_LEN];
+
+    memset(&entry, 0, sizeof(entry));
+    while (count--) {
+        if (read_at(loader->fd, &record, sizeof(record), offset) < 0)
+            BIN_WEIGHT_ERR(loader->file, "error reading record header");
+        offset += sizeof(record);
+        read_name(loader, offset, record.name_len, record.dtype_len,
+                  name, dtype_str);
+        offset += record.name_len + record.dtype_len;
+        offset += (LN_WEIGHT_FILE_ALIGN - offset % LN_WEIGHT_FILE_ALIGN) %
+            LN_WEIGHT_FILE_ALIGN;
+        entry.offset = offset;
+        entry.size = entry.stored_size = record.size;
+        add_blob(loader, table, name, dtype_str, &entry);
+        offset += record.size;
+    }
+}
+
+static void read_index(struct weight_loader *loader, ln_hash *table,
+                       uint32_t version, uint32_t count, uint64_t offset)
+{
+    struct weight_index_entry_v2 entry_v2;
+    struct weight_index_entry entry;
+    char name[LN_MAX_NAME_LEN];
+    char dtype_str[MAX_DTYPE_LEN];
+
+    while (count--) {
+        if (version == 2) {
+            if (read_at(loader->fd, &entry_v2, sizeof(entry_v2), offset) < 0)
+                BIN_WEIGHT_ERR(loader->file, "error reading index entry");
+            offset += sizeof(entry_v2);
+            entry.offset = entry_v2.offset;
+            entry.size = entry.stored_size = entry_v2.size;
+            entry.crc32 = entry_v2.crc32;
+            entry.codec = LN_WEIGHT_CODEC_NONE;
+            entry.name_len = entry_v2.name_len;
+            entry.dtype_len = entry_v2.dtype_len;
+        } else {
+            if (read_at(loader->fd, &entry, sizeof(entry), offset) < 0)
+                BIN_WEIGHT_ERR(loader->file, "error reading index entry");
+            offset += sizeof(entry);
+        }
+        read_name(loader, offset, entry.name_len, entry.dtype_len,
+                  name, dtype_str);
+        offset += ln_next_multiple_power2(entry.name_len + entry.dtype_len, 8);
+        add_blob(loader, table, name, dtype_str, &entry);
+    }
+}
+
+static int blob_ptr_cmp(const void *p1, const void *p2)
+{
+    const struct weight_blob *b1 = *(struct weight_blob *const *)p1;
+    const struct weight_blob *b2 = *(struct weight_blob *const *)p2;
+
+    if (b1->offset != b2->offset)
+        return b1->offset < b2->offset ? -1 : 1;
+    return b1 < b2 ? -1 : b1 > b2;
+}
+
+/* Point the blobs sharing data with a former blob to it, to be copied from
+   it instead of loaded again. */
+static void find_duplicates(struct weight_loader *loader)
+{
+    struct weight_blob **sorted, *blob, *first;
+    size_t i;
+
+    if (loader->nblobs < 2)
+        return;
+    sorted = ln_alloc(sizeof(struct weight_blob *) * loader->nblobs);
+    for (i = 0; i < loader->nblobs; i++)
+        sorted[i] = &loader->blobs[i];
+    qsort(sorted, loader->nblobs, sizeof(struct weight_blob *), blob_ptr_cmp);
+    first = sorted[0];
+    for (i = 1; i < loader->nblobs; i++) {
+        blob = sorted[i];
+        if (blob->offset != first->offset) {
+            first = blob;
+            continue;
+        }
+        if (blob->codec != first->codec || blob->size != first->size ||
+            blob->stored_size != first->stored_size)
+            BIN_WEIGHT_ERR(loader->file, "weights %s and %s share data of different sizes",
+                           first->te->name, blob->te->name);
+        blob->src = first;
+    }
+    ln_free(sorted);
+}
+
+/* Read the frame table of a compressed blob into `frames`, or only return
+   the frame count if `frames` is NULL. */
+static uint32_t read_frames(struct weight_loader *loader,
+                            const struct weight_blob *blob,
+                            uint32_t *frame_size, uint32_t *frames)
+{
+    uint32_t head[2];
+    uint64_t table_size, stored = 0;
+    uint32_t i;
+
+    if (blob->stored_size < sizeof(head) ||
+        read_at(loader->fd, head, sizeof(head), blob->offset) < 0)
+        BIN_WEIGHT_ERR(loader->file, "error reading frames of weight %s",
+                       blob->te->name);
+    *frame_size = head[0];
+    if (head[0] == 0 ||
+        head[1] != (blob->size + head[0] - 1) / head[0])
+        BIN_WEIGHT_ERR(loader->file, "bad frames of weight %s",
+                       blob->te->name);
+    if (!frames)
+        return head[1];
+
+    table_size = sizeof(head) + sizeof(uint32_t) * (uint64_t)head[1];
+    if (table_size > blob->stored_size ||
+        read_at(loader->fd, frames, sizeof(uint32_t) * head[1],
+                blob->offset + sizeof(head)) < 0)
+        BIN_WEIGHT_ERR(loader->file, "error reading frames of weight %s",
+                       blob->te->name);
+    for (i = 0; i < head[1]; i++) {
+        if (frames[i] > ln_lz_compress_bound(head[0]))
+            BIN_WEIGHT_ERR(loader->file, "bad frame size %u of weight %s",
+                           frames[i], blob->te->name);
+        stored += frames[i];
+    }
+    if (table_size + stored > blob->stored_size)
+        BIN_WEIGHT_ERR(loader->file, "frames of weight %s exceed its data",
+                       blob->te->name);
+    return head[1];
+}
+
+static void add_chunk(struct weight_loader *loader, struct weight_blob *blob,
+                      uint64_t start, uint64_t size, uint64_t stored_offset,
+                      uint64_t stored_size)
+{
+    struct weight_chunk *chunk = &loader->chunks[loader->nchunks++];
+
+    chunk->blob = blob;
+    chunk->start = start;
+    chunk->size = size;
+    chunk->stored_offset = stored_offset;
+    chunk->stored_size = stored_size;
+    chunk->crc32 = 0;
+    if (size > loader->max_chunk)
+        loader->max_chunk = size;
+    if (blob->codec != LN_WEIGHT_CODEC_NONE &&
+        stored_size > loader->max_stored)
+        loader->max_stored = stored_size;
+}
+
+static void split_chunks(struct weight_loader *loader)
+{
+    struct weight_blob *blob;
+    uint32_t *frames, frame_size, nframes, j;
+    uint64_t start, stored_offset;
+    size_t i, nchunks = 0;
+
+    for (i = 0; i < loader->nblobs; i++) {
+        blob = &loader->blobs[i];
+        if (blob->src)
+            continue;
+        if (blob->codec == LN_WEIGHT_CODEC_NONE)
+            nchunks += (blob->size + LN_WEIGHT_FILE_CHUNK_SIZE - 1) /
+                LN_WEIGHT_FILE_CHUNK_SIZE;
+        else
+            nchunks += read_frames(loader, blob, &frame_size, NULL);
+    }
+    loader->chunks = ln_alloc(sizeof(struct weight_chunk) * (nchunks + 1));
+    loader->nchunks = 0;
+    for (i = 0; i < loader->nblobs; i++) {
+        blob = &loader->blobs[i];
+        if (blob->src)
+            continue;
+        if (blob->codec == LN_WEIGHT_CODEC_NONE) {
+            for (start = 0; start < blob->size;
+                 start += LN_WEIGHT_FILE_CHUNK_SIZE) {
+                add_chunk(loader, blob, start,
+                          blob->size - start < LN_WEIGHT_FILE_CHUNK_SIZE ?
+                          blob->size - start : LN_WEIGHT_FILE_CHUNK_SIZE,
+                          blob->offset + start, 0);
+            }
+            continue;
+        }
+        nframes = read_frames(loader, blob, &frame_size, NULL);
+        frames = ln_alloc(sizeof(uint32_t) * (nframes + 1));
+        read_frames(loader, blob, &frame_size, frames);
+        stored_offset = blob->offset + sizeof(uint32_t) * (2 + nframes);
+        for (j = 0, start = 0; j < nframes; j++, start += frame_size) {
+            add_chunk(loader, blob, start,
+                      blob->size - start < frame_size ?
+                      blob->size - start : frame_size,
+                      stored_offset, frames[j]);
+            stored_offset += frames[j];
+        }
+        ln_free(frames);
+    }
+    loader->chunks[loader->nchunks].blob = NULL;
+}
+
+/* Read the raw data of `chunk` to `dst`, decompressing it from `packed`. */
+static void read_chunk(struct weight_loader *loader,
+                       const struct weight_chunk *chunk, void *dst,
+                       void *packed)
+{
+    const char *name = chunk->blob->te->name;
+
+    if (chunk->blob->codec == LN_WEIGHT_CODEC_NONE) {
+        if (read_at(loader->fd, dst, chunk->size, chunk->stored_offset) < 0)
+            BIN_WEIGHT_ERR(loader->file, "error reading weight %s", name);
+        return;
+    }
+    if (read_at(loader->fd, packed, chunk->stored_size,
+                chunk->stored_offset) < 0)
+        BIN_WEIGHT_ERR(loader->file, "error reading weight %s", name);
+    if (ln_lz_decompress(packed, chunk->stored_size, dst, chunk->size) < 0)
+        BIN_WEIGHT_ERR(loader->file, "corrupt compressed weight %s", name);
+}
+
+/* Worker `id` of `n` loads every n-th chunk, the chunks being similar in size. */
+static void load_chunks_worker(void *arg, int id, int n)
+{
+    struct weight_loader *loader = arg;
+    struct weight_chunk *chunk;
+    ln_tensor_entry *te;
+    ln_copy_func copy;
+    void *buf = NULL, *packed = NULL, *dst;
+    size_t i;
+
+    for (i = id; i < loader->nchunks; i += n) {
+        chunk = &loader->chunks[i];
+        te = chunk->blob->te;
+        if (chunk->blob->codec != LN_WEIGHT_CODEC_NONE && !packed)
+            packed = ln_alloc(loader->max_stored);
+        dst = (char *)te->tensor->data + chunk->start;
+        if (te->mtype != LN_MEM_CPU) {
+            if (!buf)
+                buf = ln_alloc(loader->max_chunk);
+            read_chunk(loader, chunk, buf, packed);
+            copy = ln_mem_type_copy_func(te->mtype, LN_MEM_CPU);
+            copy(dst, buf, chunk->size);
+            if (loader->verify)
+                chunk->crc32 = ln_crc32(0, buf, chunk->size);
+            continue;
+        }
+        read_chunk(loader, chunk, dst, packed);
+        if (loader->verify)
+            chunk->crc32 = ln_crc32(0, dst, chunk->size);
+    }
+    ln_free(buf);
+    ln_free(packed);
+}
+
+/* Copy the data of duplicate blobs from their sources, except those mapped
+   from `map`, if it isn't NULL. */
+static void copy_duplicates(struct weight_loader *loader, const char *map)
+{
+    struct weight_blob *blob;
+    ln_copy_func copy;
+    size_t i;
+
+    for (i = 0; i < loader->nblobs; i++) {
+        blob = &loader->blobs[i];
+        if (!blob->src || (map && blob->te->tensor->data == map + blob->offset))
+            continue;
+        copy = ln_mem_type_copy_func(blob->te->mtype, blob->src->te->mtype);
+        copy(blob->te->tensor->data, blob->src->te->tensor->data, blob->size);
+    }
+}
+
+static void verify_blobs(struct weight_loader *loader)
+{
+    struct weight_chunk *chunk = loader->chunks;
+    struct weight_blob *blob;
+    uint32_t crc32;
+    size_t i;
+
+    for (i = 0; i < loader->nblobs; i++) {
+        blob = &loader->blobs[i];
+        if (blob->src) {
+            if (blob->crc32 != blob->src->crc32)
+                BIN_WEIGHT_ERR(loader->file,
+                               "CRC-32 %08x of weight %s doesn't match %08x",
+                               blob->src->crc32, blob->te->name, blob->crc32);
+            continue;
+        }
+        for (crc32 = 0; chunk->blob == blob; chunk++)
+            crc32 = ln_crc32_combine(crc32, chunk->crc32, chunk->size);
+        if (crc32 != blob->crc32)
+            BIN_WEIGHT_ERR(loader->file,
+                           "CRC-32 %08x of weight %s doesn't match %08x",
+                           crc32, blob->te->name, blob->crc32);
+    }
+}
+
+/* Open `file` and index the blobs of the tensors in `table`. */
+static void open_weight_file(struct weight_loader *loader, ln_hash *table,
+                             const char *file)
+{
+    struct weight_file_header header;
+    uint64_t index_offset;
+    struct stat st;
+
+    memset(loader, 0, sizeof(*loader));
+    loader->file = file;
+    if ((loader->fd = open(file, O_RDONLY)) < 0)
+        ln_msg_error_sys("load_weight_file(): cannot open %s", file);
+    if (fstat(loader->fd, &st) < 0)
+        ln_msg_error_sys("load_weight_file(): cannot stat %s", file);
+    loader->file_size = st.st_size;
+
+    if (read_at(loader->fd, &header, sizeof(header), 0) < 0)
+        BIN_WEIGHT_ERR(file, "error reading header");
+    if (memcmp(header.magic, LN_WEIGHT_FILE_MAGIC, LN_WEIGHT_FILE_MAGIC_LEN))
+        BIN_WEIGHT_ERR(file, "bad magic number");
+    if (header.version == 0 || header.version > LN_WEIGHT_FILE_VERSION)
+        BIN_WEIGHT_ERR(file, "unsupported version %u", header.version);
+    if (header.count > loader->file_size / sizeof(struct weight_record_header))
+        BIN_WEIGHT_ERR(file, "bad record count %u", header.count);
+
+    loader->blobs = ln_alloc(sizeof(struct weight_blob) * (header.count + 1));
+    if (header.version == 1) {
+        scan_records(loader, table, header.count, sizeof(header));
+        return;
+    }
+    if (read_at(loader->fd, &index_offset, sizeof(index_offset),
+                sizeof(header)) < 0)
+        BIN_WEIGHT_ERR(file, "error reading index offset");
+    read_index(loader, table, header.version, header.count, index_offset);
+    find_duplicates(loader);
+    loader->has_crc = 1;
+}
+
+static uint64_t close_weight_file(struct weight_loader *loader)
+{
+    uint64_t bytes = 0;
+    size_t i;
+
+    for (i = 0; i < loader->nblobs; i++)
+        bytes += loader->blobs[i].size;
+    close(loader->fd);
+    ln_free(loader->chunks);
+    ln_free(loader->blobs);
+    return bytes;
+}
+
+/*
+ * Load the weights in `file` to the tensors of the same names in `table`.
+ * The blobs are split into chunks, or frames if compressed, which
+ * `nthreads` threads, or ln_cpu_num_threads() threads if `nthreads` <= 0,
+ * read with pread() and decompress directly into the tensors. Weights of
+ * the same data are read once and copied. With `verify`, the CRC-32s in the
+ * index are checked. If `stat` isn't NULL, it gets the loading statistics.
+ */
+void ln_tensor_table_load_weight_file(ln_hash *table, const char *file,
+                                      int nthreads, int verify,
+                                      ln_weight_load_stat *stat)
+{
+    struct weight_loader loader;
+    uint64_t bytes;
+    size_t count;
+    double t1, t2;
+
+    t1 = ln_clock();
+    open_weight_file(&loader, table, file);
+    if (verify && !loader.has_crc)
+        BIN_WEIGHT_WARN(file, "version 1 has no CRC-32 to verify");
+    loader.verify = verify && loader.has_crc;
+
+    split_chunks(&loader);
+    if (nthreads <= 0)
+        nthreads = ln_cpu_num_threads();
+    if ((size_t)nthreads > loader.nchunks)
+        nthreads = loader.nchunks > 0 ? loader.nchunks : 1;
+    ln_cpu_run_parallel(nthreads, load_chunks_worker, &loader);
+    if (loader.verify)
+        verify_blobs(&loader);
+    copy_duplicates(&loader, NULL);
+    count = loader.nblobs;
+    bytes = close_weight_file(&loader);
+
+    t2 = ln_clock();
+    ln_msg_debug("loaded %lu weights of %lu bytes from %s with %d threads in %fs (%.2f MB/s)",
+                 (unsigned long)count, (unsigned long)bytes, file,
+                 nthreads, t2 - t1, bytes / 1e6 / (t2 - t1));
+    if (stat) {
+        stat->count = count;
+        stat->bytes = bytes;
+        stat->threads = nthreads;
+        stat->time = t2 - t1;
+    }
+}
+
+/*
+ * Map `file` privately and point the data of the tensors in `table` for
+ * which `lazy` returns non-zero into the mapping, where their pages are read
+ * on first touch and shared with the page cache until written. Weights of
+ * the same data share their pages. The other weights, and the compressed
+ * ones, are copied. Return the mapping of `*size` bytes, which should be
+ * munmap()ed after the tensors are done with.
+ */
+void *ln_tensor_table_map_weight_file(ln_hash *table, const char *file,
+                                      ln_tensor_filter_func lazy, void *arg,
+                                      size_t *size)
+{
+    struct weight_loader loader;
+    struct weight_blob *blob;
+    struct weight_chunk *chunk;
+    ln_copy_func copy;
+    char *map, *buf = NULL;
+    size_t i;
+
+    open_weight_file(&loader, table, file);
+    map = mmap(NULL, loader.file_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+               loader.fd, 0);
+    if (map == MAP_FAILED)
+        ln_msg_error_sys("map_weight_file(): cannot mmap %s", file);
+    for (i = 0; i < loader.nblobs; i++) {
+        blob = &loader.blobs[i];
+        if (blob->codec == LN_WEIGHT_CODEC_NONE && lazy(blob->te, arg)) {
+            ln_msg_debug("mapping data %s to %p", blob->te->name,
+                         map + blob->offset);
+            blob->te->tensor->data = map + blob->offset;
+        }
+    }
+
+    split_chunks(&loader);
+    for (i = 0; i < loader.nchunks; i++) {
+        chunk = &loader.chunks[i];
+        blob = chunk->blob;
+        if ((char *)blob->te->tensor->data == map + blob->offset)
+            continue;
+        copy = ln_mem_type_copy_func(blob->te->mtype, LN_MEM_CPU);
+        if (blob->codec == LN_WEIGHT_CODEC_NONE) {
+            copy((char *)blob->te->tensor->data + chunk->start,
+                 map + chunk->stored_offset, chunk->size);
+            continue;
+        }
+        if (!buf)
+            buf = ln_alloc(loader.max_chunk);
+        if (ln_lz_decompress(map + chunk->stored_offset, chunk->stored_size,
+                             buf, chunk->size) < 0)
+            BIN_WEIGHT_ERR(file, "corrupt compressed weight %s",
+                           blob->te->name);
+        copy((char *)blob->te->tensor->data + chunk->start, buf, chunk->size);
+    }
+    ln_free(buf);
+    copy_duplicates(&loader, map);
+    *size = loader.file_size;
+    close_weight_file(&loader);
+
+    return map;
+}
+
+void ln_tensor_table_load_data_file(ln_hash *table, const char *file,
+                                    int nthreads, int verify,
+                                    ln_weight_load_stat *stat)
+{
+    if (ln_tensor_is_weight_file(file))
+        ln_tensor_table_load_weight_file(table, file, nthreads, verify, stat);
+    else
+        ln_tensor_table_load_trt_weight_file(table, file);
+}
@@ -28,6 +28,32 @@
 #include "ln_hash.h"
 #include "ln_mem.h"
 
+/* binary weight file written by tools/onnx2ln */
+#define LN_WEIGHT_FILE_MAGIC "LNWTSBIN"
+#define LN_WEIGHT_FILE_MAGIC_LEN 8
+#define LN_WEIGHT_FILE_VERSION 3
+#define LN_WEIGHT_FILE_ALIGN 64
+
+/* weights are loaded in parallel in chunks of at most this many bytes */
+#define LN_WEIGHT_FILE_CHUNK_SIZE (4 << 20)
+
+/* codecs of the blobs in a weight file */
+enum ln_weight_codec {
+    LN_WEIGHT_CODEC_NONE = 0,
+    LN_WEIGHT_CODEC_LZ,         /* frames compressed by ln_lz_compress() */
+    LN_WEIGHT_CODEC_SIZE
+};
+typedef enum ln_weight_codec ln_weight_codec;
+
+/* statistics of loading a weight file */
+struct ln_weight_load_stat {
+    size_t  count;              /* number of loaded weights */
+    size_t  bytes;
+    int     threads;
+    double  time;               /* in seconds */
+};
+typedef struct ln_weight_load_stat ln_weight_load_stat;
+
 /* tensor entry used in tensor table */
 /* NOTE: ALWAYS access tensor entry via its name in tensor table, since the
    entry may be not the same during passes. It is owned by the tensor table. */
@@ -38,10 +64,21 @@ struct ln_tensor_entry {
     char        *creater;       /* operator name who creates the tensor */
     size_t       offset;
     int          isstatic;
+    int          inplace;       /* owner is only an in-place hint, which
+                                   mem_plan may drop */
+    int          scratch;       /* only used by its creater's run, which
+                                   mem_plan frees right after the creater */
+    int          dirty;         /* changed since the last run */
+    unsigned     version;       /* bumped along with `dirty`, for the data
+                                   ops derive from it and keep across runs */
+    int          written;       /* a root written by the run of some op, which
+                                   can't be a shared weight */
     ln_mem_type  mtype;
 };
 typedef struct ln_tensor_entry ln_tensor_entry;
 
+typedef int (*ln_tensor_filter_func)(const ln_tensor_entry *entry, void *arg);
+
 /* tensor entry used in op parameter */
 struct ln_tensor_list_entry {
     char            *name;
@@ -88,11 +125,29 @@ ln_hash *ln_tensor_table_create(void);
 int ln_tensor_table_insert(ln_hash *table, ln_tensor_entry *entry);
 int ln_tensor_table_remove(ln_hash *table, const char *name);
 ln_tensor_entry *ln_tensor_table_find(ln_hash *table, const char *name);
+ln_tensor_entry *ln_tensor_table_find_root(ln_hash *table, const char *name);
 void ln_tensor_table_free(ln_hash *table);
 void ln_tensor_table_set_data(ln_hash *table, const char *name, const void *data);
 void *ln_tensor_table_get_data(ln_hash *table, const char *name, void *data);
+void ln_tensor_table_set_frame(ln_hash *table, const char *name, int frame,
+                               const void *data);
+void *ln_tensor_table_get_frame(ln_hash *table, const char *name, int frame,
+                                void *data);
 size_t ln_tensor_table_data_size(ln_hash *table, const char *name);
+int ln_tensor_table_data_shape(ln_hash *table, const char *name, int *dims);
+const char *ln_tensor_table_data_dtype(ln_hash *table, const char *name);
+void *ln_tensor_table_data_ptr(ln_hash *table, const char *name);
 void ln_tensor_table_load_trt_weight_file(ln_hash *table, const char *file);
+int ln_tensor_is_weight_file(const char *file);
+void ln_tensor_table_load_weight_file(ln_hash *table, const char *file,
+                                      int nthreads, int verify,
+                                      ln_weight_load_stat *stat);
+void ln_tensor_table_load_data_file(ln_hash *table, const char *file,
+                                    int nthreads, int verify,
+                                    ln_weight_load_stat *stat);
+void *ln_tensor_table_map_weight_file(ln_hash *table, const char *file,
+                                      ln_tensor_filter_func lazy, void *arg,
+                                      size_t *size);
 
 #ifdef __cplusplus
 LN_CPPEND
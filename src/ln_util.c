@@ -29,6 +29,8 @@
 #include <time.h>
 #include <ctype.h>
 #include <math.h>
+#include <pthread.h>
+#include <endian.h>
 #include <sys/stat.h>
 
 #include "ln_util.h"
@@ -426,6 +428,94 @@ int ln_next_multiple_power2(int n, int power2)
     /* return n + (-n & 7); */
 }
 
+/* CRC-32 of zlib and gzip, reflected with polynomial 0xedb88320 */
+#define CRC32_POLY 0xedb88320U
+
+static uint32_t crc32_table[8][256];
+static pthread_once_t crc32_once = PTHREAD_ONCE_INIT;
+
+static void init_crc32_table(void)
+{
+    uint32_t c;
+    int i, j;
+
+    for (i = 0; i < 256; i++) {
+        c = i;
+        for (j = 0; j < 8; j++)
+            c = c & 1 ? (c >> 1) ^ CRC32_POLY : c >> 1;
+        crc32_table[0][i] = c;
+    }
+    for (i = 0; i < 256; i++) {
+        c = crc32_table[0][i];
+        for (j = 1; j < 8; j++) {
+            c = crc32_table[0][c & 0xff] ^ (c >> 8);
+            crc32_table[j][i] = c;
+        }
+    }
+}
+
+/* Update `crc` with `len` bytes of `buf`, 8 bytes at a time. Start with 0. */
+uint32_t ln_crc32(uint32_t crc, const void *buf, size_t len)
+{
+    const unsigned char *p = buf;
+    uint32_t lo, hi;
+
+    pthread_once(&crc32_once, init_crc32_table);
+    crc = ~crc;
+    for (; len && ((uintptr_t)p & 7); len--)
+        crc = crc32_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    for (; len >= 8; len -= 8, p += 8) {
+        memcpy(&lo, p, 4);
+        memcpy(&hi, p + 4, 4);
+        lo = le32toh(lo) ^ crc;
+        hi = le32toh(hi);
+        crc = crc32_table[7][lo & 0xff] ^ crc32_table[6][(lo >> 8) & 0xff] ^
+            crc32_table[5][(lo >> 16) & 0xff] ^ crc32_table[4][lo >> 24] ^
+            crc32_table[3][hi & 0xff] ^ crc32_table[2][(hi >> 8) & 0xff] ^
+            crc32_table[1][(hi >> 16) & 0xff] ^ crc32_table[0][hi >> 24];
+    }
+    for (; len; len--)
+        crc = crc32_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+
+    return ~crc;
+}
+
+/* a * b modulo the CRC-32 polynomial, in the reflected bit order */
+static uint32_t crc32_multmodp(uint32_t a, uint32_t b)
+{
+    uint32_t m = 1U << 31, p = 0;
+
+    for (;;) {
+        if (a & m) {
+            p ^= b;
+            if ((a & (m - 1)) == 0)
+                break;
+        }
+        m >>= 1;
+        b = b & 1 ? (b >> 1) ^ CRC32_POLY : b >> 1;
+    }
+    return p;
+}
+
+/*
+ * Return the CRC-32 of two concatenated blocks from their CRC-32s `crc1` and
+ * `crc2`, `len2` being the length of the second block, so that blocks can be
+ * checksummed in parallel.
+ */
+uint32_t ln_crc32_combine(uint32_t crc1, uint32_t crc2, size_t len2)
+{
+    uint32_t x2n = 1U << 30;    /* x^1, then x^(2^k) */
+    uint32_t p = 1U << 31;      /* x^0 */
+    uint64_t n = (uint64_t)len2 << 3;
+
+    for (; n; n >>= 1) {
+        if (n & 1)
+            p = crc32_multmodp(x2n, p);
+        x2n = crc32_multmodp(x2n, x2n);
+    }
+    return crc32_multmodp(p, crc1) ^ crc2;
+}
+
 static void err_doit(int errnoflag, int error, const char *fmt, va_list ap)
 {
     char buf[LN_MAXLINE];
@@ -91,6 +91,8 @@ int ln_str_cmp(const void *p1, const void *p2);
 void ln_img_submean(const unsigned char *data, const float *mean, float *out,
                     int H, int W, int C);
 int ln_next_multiple_power2(int n, int power2);
+uint32_t ln_crc32(uint32_t crc, const void *buf, size_t len);
+uint32_t ln_crc32_combine(uint32_t crc1, uint32_t crc2, size_t len2);
 void ln_err_msg(const char *fmt, ...);
 void ln_err_cont(int error, const char *fmt, ...);
 void ln_err_ret(const char *fmt, ...);
@@ -26,6 +26,7 @@
 #include <assert.h>
 #include "ln_op.h"
 #include "ln_arch.h"
+#include "arch/ln_cpu.h"
 
 struct priv_s {
     ln_tensor_entry *src_entry;
@@ -86,6 +87,7 @@ static void batchnorm_cpu_pre_run(ln_op_arg *op_arg)
     src = src_entry->tensor;
     src = src;
     ln_opck_tensor_mtype_eq(src_entry, LN_MEM_CPU);
+    ln_opck_tensor_dtype_eq(src_entry, TL_FLOAT);
     ln_opck_tensor_ndim(src_entry, 4);
 
     scale_list_entry = ln_tensor_list_find_by_arg_name(op_arg->tensors_in, "scale");
@@ -163,6 +165,8 @@ static void batchnorm_cpu_pre_run(ln_op_arg *op_arg)
     dst_entry = ln_tensor_entry_create(dst_name, dst);
     dst_entry->offset = dst_list_entry->offset;
     ln_tensor_entry_set_creater(dst_entry, op_arg->name);
+    ln_tensor_entry_set_owner(dst_entry, op_arg->tensor_table, src_name);
+    dst_entry->inplace = 1;
     dst_entry->mtype = LN_MEM_CPU;
     ln_tensor_table_insert(op_arg->tensor_table, dst_entry);
 
@@ -181,7 +185,20 @@ static void batchnorm_cpu_pre_run(ln_op_arg *op_arg)
 /* This function should only do the calculations. */
 static void batchnorm_cpu_run(ln_op_arg *op_arg)
 {
-    ln_msg_warn("%s(%s): 'run' not defined", op_arg->name, op_arg->optype);
+    struct priv_s *priv = op_arg->priv;
+    tl_tensor     *src = priv->src_entry->tensor;
+    tl_tensor     *scale = priv->scale_entry->tensor;
+    tl_tensor     *offset = priv->offset_entry->tensor;
+    tl_tensor     *mean = priv->mean_entry->tensor;
+    tl_tensor     *var = priv->var_entry->tensor;
+    tl_tensor     *dst = priv->dst_entry->tensor;
+    float          epsilon = priv->epsilon_entry->value_float;
+
+    /* begin custom code */
+    ln_cpu_sbatchnorm(src->data, dst->data, src->dims[0], src->dims[1],
+                      (size_t)src->dims[2] * src->dims[3], scale->data,
+                      offset->data, mean->data, var->data, epsilon);
+    /* end custom code */
 }
 
 /* This function should free all the memory allocated by other *_run()s. */
@@ -193,6 +210,17 @@ static void batchnorm_cpu_post_run(ln_op_arg *op_arg)
     ln_free(priv);
 }
 
+/* This function is used to manually set the tensor's offset address. */
+static size_t batchnorm_cpu_calc_offset(ln_op_arg *op_arg, ln_tensor_entry *te)
+{
+    struct priv_s   *priv = op_arg->priv;
+    ln_tensor_entry *src_entry = priv->src_entry;
+
+    /* begin custom code */
+    return src_entry->offset;
+    /* end custom code */
+}
+
 static const char *in_arg_names[] = {
     "src",
     "scale",
@@ -233,5 +261,5 @@ ln_op ln_opimpl_batchnorm_cpu = {
     .static_run = NULL,
     .run = batchnorm_cpu_run,
     .post_run = batchnorm_cpu_post_run,
-    .calc_offset = NULL,
+    .calc_offset = batchnorm_cpu_calc_offset,
 };
@@ -26,6 +26,7 @@
 #include <assert.h>
 #include "ln_op.h"
 #include "ln_arch.h"
+#include "arch/ln_cpu.h"
 
 struct priv_s {
     ln_tensor_entry *src_mean_entry;
@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2018-2020 Zhixu Zhao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* NOTE: this file is automatically generated by protos/op/channel_shuffle.op
+   using tools/addop.pl */
+
+#include <assert.h>
+#include "ln_op.h"
+#include "ln_arch.h"
+#include "arch/ln_cpu.h"
+
+struct priv_s {
+    ln_tensor_entry *src_entry;
+    ln_tensor_entry *dst_entry;
+    ln_param_entry  *axis_entry;
+    ln_param_entry  *group_entry;
+};
+
+/* This function should do the parameter checking and tensor shape inference. */
+static void channel_shuffle_cpu_pre_run(ln_op_arg *op_arg)
+{
+    char                 *src_name;
+    ln_tensor_list_entry *src_list_entry;
+    ln_tensor_entry      *src_entry;
+    tl_tensor            *src;
+    char                 *dst_name;
+    ln_tensor_list_entry *dst_list_entry;
+    ln_tensor_entry      *dst_entry;
+    tl_tensor            *dst;
+    int                   dst_ndim;
+    int                  *dst_dims;
+    tl_dtype              dst_dtype;
+    int                   axis;
+    ln_param_entry       *axis_entry;
+    int                   group;
+    ln_param_entry       *group_entry;
+    int                   tensors_in_n;
+    int                   tensors_out_n;
+    int                   params_n;
+    struct priv_s        *priv;
+
+    /* check tensors and parameters */
+    tensors_in_n = ln_tensor_list_length(op_arg->tensors_in);
+    ln_opck_tensors_in_len_eq(tensors_in_n, 1);
+
+    src_list_entry = ln_tensor_list_find_by_arg_name(op_arg->tensors_in, "src");
+    ln_opck_tensor_in_exist(src_list_entry, "src");
+    src_name = src_list_entry->name;
+    src_entry = ln_tensor_table_find(op_arg->tensor_table, src_name);
+    ln_opck_tensor_defined(src_entry, src_name);
+    src = src_entry->tensor;
+    src = src;
+    ln_opck_tensor_mtype_eq(src_entry, LN_MEM_CPU);
+
+    tensors_out_n = ln_tensor_list_length(op_arg->tensors_out);
+    ln_opck_tensors_out_len_eq(tensors_out_n, 1);
+
+    dst_list_entry = ln_tensor_list_find_by_arg_name(op_arg->tensors_out, "dst");
+    ln_opck_tensor_out_exist(dst_list_entry, "dst");
+    dst_name = dst_list_entry->name;
+    dst_entry = ln_tensor_table_find(op_arg->tensor_table, dst_name);
+    ln_opck_tensor_not_defined(dst_entry, dst_name);
+
+    params_n = ln_param_list_length(op_arg->params);
+    ln_opck_params_len_eq(params_n, 2);
+
+    axis_entry = ln_param_list_find(op_arg->params, "axis");
+    ln_opck_param_exist(axis_entry, "axis");
+    ln_opck_param_type(axis_entry, LN_PARAM_NUMBER);
+    axis = axis_entry->value_int;
+    ln_opck_param_int_ge(axis_entry, 0);
+    ln_opck_param_int_lt(axis_entry, src->ndim);
+    axis = axis;
+
+    group_entry = ln_param_list_find(op_arg->params, "group");
+    ln_opck_param_exist(group_entry, "group");
+    ln_opck_param_type(group_entry, LN_PARAM_NUMBER);
+    group = group_entry->value_int;
+    ln_opck_param_int_gt(group_entry, 0);
+    ln_opck_param_int_le(group_entry, src->dims[axis]);
+    group = group;
+    ln_opck_satisfy_msg(src->dims[axis] % group == 0, "'group' should divide 'src->dims[axis]'");
+
+    /* define output tensor shape, tensor data should be NULL */
+    dst_ndim = src->ndim;
+    dst_dims = src->dims;
+    dst_dtype = src->dtype;
+    dst = tl_tensor_create(NULL, dst_ndim, dst_dims, dst_dtype);
+    dst_entry = ln_tensor_entry_create(dst_name, dst);
+    dst_entry->offset = dst_list_entry->offset;
+    ln_tensor_entry_set_creater(dst_entry, op_arg->name);
+    dst_entry->mtype = LN_MEM_CPU;
+    ln_tensor_table_insert(op_arg->tensor_table, dst_entry);
+
+    /* use op_arg->priv to store private data to be used in other functions */
+    priv = ln_alloc(sizeof(struct priv_s));
+    priv->src_entry = src_entry;
+    priv->dst_entry = dst_entry;
+    priv->axis_entry = axis_entry;
+    priv->group_entry = group_entry;
+    op_arg->priv = priv;
+}
+
+/* This function should only do the calculations. */
+static void channel_shuffle_cpu_run(ln_op_arg *op_arg)
+{
+    struct priv_s *priv = op_arg->priv;
+    tl_tensor     *src = priv->src_entry->tensor;
+    tl_tensor     *dst = priv->dst_entry->tensor;
+    int            axis = priv->axis_entry->value_int;
+    int            group = priv->group_entry->value_int;
+
+    /* begin custom code */
+    {
+    int dims[4] = {1, group, src->dims[axis] / group, 1};
+    int axes[4] = {0, 2, 1, 3};
+    for (int i = 0; i < axis; i++)
+        dims[0] *= src->dims[i];
+    for (int i = axis + 1; i < src->ndim; i++)
+        dims[3] *= src->dims[i];
+    ln_cpu_transpose(src->data, dst->data, 4, dims, axes, tl_size_of(src->dtype));
+    }
+    /* end custom code */
+}
+
+/* This function should free all the memory allocated by other *_run()s. */
+static void channel_shuffle_cpu_post_run(ln_op_arg *op_arg)
+{
+    struct priv_s *priv = op_arg->priv;
+
+    ln_tensor_table_remove(op_arg->tensor_table, priv->dst_entry->name);
+    ln_free(priv);
+}
+
+static const char *in_arg_names[] = {
+    "src",
+    NULL
+};
+
+static const char *out_arg_names[] = {
+    "dst",
+    NULL
+};
+
+static const char *param_arg_names[] = {
+    "axis",
+    "group",
+    NULL
+};
+
+static const ln_param_type param_ptypes[] = {
+    LN_PARAM_NUMBER,
+    LN_PARAM_NUMBER,
+};
+
+/* specify other ln_op_arg fields */
+static ln_op_arg op_arg_channel_shuffle_cpu = {
+    .optype = "channel_shuffle_cpu",
+    .arch = "cpu",
+    .in_arg_names = in_arg_names,
+    .out_arg_names = out_arg_names,
+    .param_arg_names = param_arg_names,
+    .param_ptypes = param_ptypes,
+};
+
+/* struct used for op registration in ln_oplist.c */
+ln_op ln_opimpl_channel_shuffle_cpu = {
+    .op_arg = &op_arg_channel_shuffle_cpu,
+    .pre_run = channel_shuffle_cpu_pre_run,
+    .static_run = NULL,
+    .run = channel_shuffle_cpu_run,
+    .post_run = channel_shuffle_cpu_post_run,
+    .calc_offset = NULL,
+};
@@ -26,12 +26,20 @@
 #include <assert.h>
 #include "ln_op.h"
 #include "ln_arch.h"
+#include "arch/ln_cpu.h"
 
 struct priv_s {
     ln_tensor_entry *src_entry;
     ln_tensor_entry *weight_entry;
     ln_tensor_entry *bias_entry;
     ln_tensor_entry *dst_entry;
+    ln_tensor_entry *packed_entry;
+    ln_tensor_entry *col_entry;
+    ln_tensor_entry *weight_root;
+    unsigned         weight_version;
+    int              packed_valid;
+    int              keeps_packed;
+    int              im2col;
     ln_param_entry  *group_entry;
     ln_param_entry  *size_entry;
     ln_param_entry  *stride_entry;
@@ -62,6 +70,20 @@ static void conv2d_cpu_pre_run(ln_op_arg *op_arg)
     int                   dst_ndim;
     int                  *dst_dims;
     tl_dtype              dst_dtype;
+    char                 *packed_name;
+    ln_tensor_list_entry *packed_list_entry;
+    ln_tensor_entry      *packed_entry;
+    tl_tensor            *packed;
+    int                   packed_ndim;
+    int                  *packed_dims;
+    tl_dtype              packed_dtype;
+    char                 *col_name;
+    ln_tensor_list_entry *col_list_entry;
+    ln_tensor_entry      *col_entry;
+    tl_tensor            *col;
+    int                   col_ndim;
+    int                  *col_dims;
+    tl_dtype              col_dtype;
     int                   group;
     ln_param_entry       *group_entry;
     int                  *size;
@@ -91,6 +113,7 @@ static void conv2d_cpu_pre_run(ln_op_arg *op_arg)
     src = src_entry->tensor;
     src = src;
     ln_opck_tensor_mtype_eq(src_entry, LN_MEM_CPU);
+    ln_opck_tensor_dtype_eq(src_entry, TL_FLOAT);
     ln_opck_tensor_ndim(src_entry, 4);
 
     weight_list_entry = ln_tensor_list_find_by_arg_name(op_arg->tensors_in, "weight");
@@ -101,6 +124,7 @@ static void conv2d_cpu_pre_run(ln_op_arg *op_arg)
     weight = weight_entry->tensor;
     weight = weight;
     ln_opck_tensor_mtype_eq(weight_entry, LN_MEM_CPU);
+    ln_opck_tensor_dtype_eq(weight_entry, TL_FLOAT);
     ln_opck_tensor_ndim(weight_entry, 4);
 
     bias_list_entry = ln_tensor_list_find_by_arg_name(op_arg->tensors_in, "bias");
@@ -111,6 +135,7 @@ static void conv2d_cpu_pre_run(ln_op_arg *op_arg)
     bias = bias_entry->tensor;
     bias = bias;
     ln_opck_tensor_mtype_eq(bias_entry, LN_MEM_CPU);
+    ln_opck_tensor_dtype_eq(bias_entry, TL_FLOAT);
     ln_opck_tensor_ndim(bias_entry, 1);
     /* begin custom code */
     {
@@ -121,7 +146,7 @@ static void conv2d_cpu_pre_run(ln_op_arg *op_arg)
     /* end custom code */
 
     tensors_out_n = ln_tensor_list_length(op_arg->tensors_out);
-    ln_opck_tensors_out_len_eq(tensors_out_n, 1);
+    ln_opck_tensors_out_len_eq(tensors_out_n, 3);
 
     dst_list_entry = ln_tensor_list_find_by_arg_name(op_arg->tensors_out, "dst");
     ln_opck_tensor_out_exist(dst_list_entry, "dst");
@@ -129,6 +154,18 @@ static void conv2d_cpu_pre_run(ln_op_arg *op_arg)
     dst_entry = ln_tensor_table_find(op_arg->tensor_table, dst_name);
     ln_opck_tensor_not_defined(dst_entry, dst_name);
 
+    packed_list_entry = ln_tensor_list_find_by_arg_name(op_arg->tensors_out, "packed");
+    ln_opck_tensor_out_exist(packed_list_entry, "packed");
+    packed_name = packed_list_entry->name;
+    packed_entry = ln_tensor_table_find(op_arg->tensor_table, packed_name);
+    ln_opck_tensor_not_defined(packed_entry, packed_name);
+
+    col_list_entry = ln_tensor_list_find_by_arg_name(op_arg->tensors_out, "col");
+    ln_opck_tensor_out_exist(col_list_entry, "col");
+    col_name = col_list_entry->name;
+    col_entry = ln_tensor_table_find(op_arg->tensor_table, col_name);
+    ln_opck_tensor_not_defined(col_entry, col_name);
+
     params_n = ln_param_list_length(op_arg->params);
     ln_opck_params_len_eq(params_n, 6);
 
@@ -224,12 +261,60 @@ static void conv2d_cpu_pre_run(ln_op_arg *op_arg)
     ln_free(dst_dims);
     /* end custom code */
 
+    packed_ndim = 1;
+    packed_dtype = TL_FLOAT;
+    /* begin custom code */
+    {
+    int k = weight->dims[1] * size[0] * size[1];
+    packed_dims = ln_alloc(sizeof(int));
+    packed_dims[0] = group * ln_cpu_sgemm_pack_b_size(k, weight->dims[0] / group) /
+        sizeof(float);
+    }
+    /* end custom code */
+    packed = tl_tensor_create(NULL, packed_ndim, packed_dims, packed_dtype);
+    packed_entry = ln_tensor_entry_create(packed_name, packed);
+    packed_entry->offset = packed_list_entry->offset;
+    ln_tensor_entry_set_creater(packed_entry, op_arg->name);
+    packed_entry->isstatic = 1;
+    packed_entry->mtype = LN_MEM_CPU;
+    ln_tensor_table_insert(op_arg->tensor_table, packed_entry);
+    /* begin custom code */
+    ln_free(packed_dims);
+    /* end custom code */
+
+    col_ndim = 1;
+    col_dtype = TL_FLOAT;
+    /* begin custom code */
+    {
+    int oh = ln_output_dim_conv(src->dims[2], size[0], stride[0], padding[0] + padding[2], dilation[0]);
+    int ow = ln_output_dim_conv(src->dims[3], size[1], stride[1], padding[1] + padding[3], dilation[1]);
+    col_dims = ln_alloc(sizeof(int));
+    col_dims[0] = 1;
+    if (size[0] != 1 || size[1] != 1 || stride[0] != 1 || stride[1] != 1 ||
+        padding[0] != 0 || padding[1] != 0 || padding[2] != 0 ||
+        padding[3] != 0)
+        col_dims[0] = weight->dims[1] * size[0] * size[1] * oh * ow;
+    }
+    /* end custom code */
+    col = tl_tensor_create(NULL, col_ndim, col_dims, col_dtype);
+    col_entry = ln_tensor_entry_create(col_name, col);
+    col_entry->offset = col_list_entry->offset;
+    ln_tensor_entry_set_creater(col_entry, op_arg->name);
+    col_entry->scratch = 1;
+    col_entry->mtype = LN_MEM_CPU;
+    ln_tensor_table_insert(op_arg->tensor_table, col_entry);
+    /* begin custom code */
+    ln_free(col_dims);
+    /* end custom code */
+
     /* use op_arg->priv to store private data to be used in other functions */
     priv = ln_alloc(sizeof(struct priv_s));
     priv->src_entry = src_entry;
     priv->weight_entry = weight_entry;
     priv->bias_entry = bias_entry;
     priv->dst_entry = dst_entry;
+    priv->packed_entry = packed_entry;
+    priv->col_entry = col_entry;
     priv->group_entry = group_entry;
     priv->size_entry = size_entry;
     priv->stride_entry = stride_entry;
@@ -239,10 +324,91 @@ static void conv2d_cpu_pre_run(ln_op_arg *op_arg)
     op_arg->priv = priv;
 }
 
+/* This function runs only once per instance right after memory allocation. */
+static void conv2d_cpu_static_run(ln_op_arg *op_arg)
+{
+    struct priv_s *priv = op_arg->priv;
+    int           *size = priv->size_entry->value_array_int;
+    int           *stride = priv->stride_entry->value_array_int;
+    int           *padding = priv->padding_entry->value_array_int;
+
+    /* begin custom code */
+    /* packed on the first run rather than at load, which would touch every
+       page of weights mapped from a file before they are needed */
+    priv->weight_root = ln_tensor_table_find_root(op_arg->tensor_table,
+                                                  priv->weight_entry->name);
+    priv->packed_valid = 0;
+    priv->keeps_packed = priv->weight_root->isstatic &&
+        !priv->weight_root->written;
+    priv->im2col = size[0] != 1 || size[1] != 1 || stride[0] != 1 ||
+        stride[1] != 1 || padding[0] != 0 || padding[1] != 0 ||
+        padding[2] != 0 || padding[3] != 0;
+    /* end custom code */
+}
+
 /* This function should only do the calculations. */
 static void conv2d_cpu_run(ln_op_arg *op_arg)
 {
-    ln_msg_warn("%s(%s): 'run' not defined", op_arg->name, op_arg->optype);
+    struct priv_s *priv = op_arg->priv;
+    tl_tensor     *src = priv->src_entry->tensor;
+    tl_tensor     *weight = priv->weight_entry->tensor;
+    tl_tensor     *bias = priv->bias_entry->tensor;
+    tl_tensor     *dst = priv->dst_entry->tensor;
+    tl_tensor     *packed = priv->packed_entry->tensor;
+    tl_tensor     *col = priv->col_entry->tensor;
+    int            group = priv->group_entry->value_int;
+    int           *size = priv->size_entry->value_array_int;
+    int           *stride = priv->stride_entry->value_array_int;
+    int           *dilation = priv->dilation_entry->value_array_int;
+    int           *padding = priv->padding_entry->value_array_int;
+
+    /* begin custom code */
+    int ic = src->dims[1] / group;
+    int oc = weight->dims[0] / group;
+    int k = weight->dims[1] * size[0] * size[1];
+    int n = dst->dims[2] * dst->dims[3];
+    size_t src_size = (size_t)src->dims[1] * src->dims[2] * src->dims[3];
+    size_t dst_size = (size_t)dst->dims[1] * n;
+    size_t packed_len = ln_cpu_sgemm_pack_b_size(k, oc) / sizeof(float);
+    const float *src_data;
+    const float *col_data;
+    const float *w;
+    float *dst_data;
+    float *bias_data = bias->data;
+    float *packed_data = packed->data;
+
+    if (!priv->packed_valid ||
+        priv->weight_version != priv->weight_root->version) {
+        for (int g = 0; g < group; g++) {
+            /* dst^T = col^T * weight^T, so weight^T is the constant B matrix */
+            w = (float *)weight->data + (size_t)g * oc * k;
+            ln_cpu_sgemm_pack_b(k, oc, w, 1, k, packed_data + g * packed_len);
+        }
+        priv->packed_valid = priv->keeps_packed;
+        priv->weight_version = priv->weight_root->version;
+    }
+    for (int b = 0; b < src->dims[0]; b++) {
+        for (int g = 0; g < group; g++) {
+            src_data = (float *)src->data + b * src_size +
+                (size_t)g * ic * src->dims[2] * src->dims[3];
+            dst_data = (float *)dst->data + b * dst_size + (size_t)g * oc * n;
+            if (priv->im2col) {
+                ln_cpu_im2col(src_data, ic, src->dims[2], src->dims[3], size,
+                              stride, padding, dilation, dst->dims[2],
+                              dst->dims[3], col->data);
+                col_data = col->data;
+            } else {
+                col_data = src_data;
+            }
+            for (int o = 0; o < oc; o++) {
+                for (int i = 0; i < n; i++)
+                    dst_data[(size_t)o * n + i] = bias_data[g * oc + o];
+            }
+            ln_cpu_sgemm_packed(n, oc, k, 1, col_data, 1, n,
+                                packed_data + g * packed_len, 1, dst_data, 1, n);
+        }
+    }
+    /* end custom code */
 }
 
 /* This function should free all the memory allocated by other *_run()s. */
@@ -251,6 +417,8 @@ static void conv2d_cpu_post_run(ln_op_arg *op_arg)
     struct priv_s *priv = op_arg->priv;
 
     ln_tensor_table_remove(op_arg->tensor_table, priv->dst_entry->name);
+    ln_tensor_table_remove(op_arg->tensor_table, priv->packed_entry->name);
+    ln_tensor_table_remove(op_arg->tensor_table, priv->col_entry->name);
     ln_free(priv);
 }
 
@@ -263,6 +431,8 @@ static const char *in_arg_names[] = {
 
 static const char *out_arg_names[] = {
     "dst",
+    "packed",
+    "col",
     NULL
 };
 
@@ -299,7 +469,7 @@ static ln_op_arg op_arg_conv2d_cpu = {
 ln_op ln_opimpl_conv2d_cpu = {
     .op_arg = &op_arg_conv2d_cpu,
     .pre_run = conv2d_cpu_pre_run,
-    .static_run = NULL,
+    .static_run = conv2d_cpu_static_run,
     .run = conv2d_cpu_run,
     .post_run = conv2d_cpu_post_run,
     .calc_offset = NULL,
@@ -153,9 +153,9 @@ static void create_cuda_static_run(ln_op_arg *op_arg)
     size_t size = tl_tensor_size(dst);
     void *data_tmp = ln_alloc(size);
     if (!(ran[0] == 0 && ran[1] == 0)) {
-        srand(time(NULL));
+        unsigned int seed = time(NULL);
         for (int i = 0; i < dst->len; i++) {
-            double r = rand() * (ran[1] - ran[0]) / (double)RAND_MAX + ran[0];
+            double r = rand_r(&seed) * (ran[1] - ran[0]) / (double)RAND_MAX + ran[0];
             tl_convert(tl_padd(data_tmp, i, tl_size_of(dtype)), dtype, &r, TL_DOUBLE);
         }
     } else if (data[0] == 0 && data_entry->array_len == 1) {
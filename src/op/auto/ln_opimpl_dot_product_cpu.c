@@ -26,6 +26,7 @@
 #include <assert.h>
 #include "ln_op.h"
 #include "ln_arch.h"
+#include "arch/ln_cpu.h"
 
 struct priv_s {
     ln_tensor_entry *src1_entry;
@@ -120,7 +121,10 @@ static void dot_product_cpu_run(ln_op_arg *op_arg)
     tl_tensor     *dst = priv->dst_entry->tensor;
 
     /* begin custom code */
-    tl_tensor_dot_product(src1, src2, dst);
+    if (src1->dtype == TL_FLOAT)
+        *(float *)dst->data = ln_cpu_sdot(src1->len, src1->data, src2->data);
+    else
+        tl_tensor_dot_product(src1, src2, dst);
     /* end custom code */
 }
 
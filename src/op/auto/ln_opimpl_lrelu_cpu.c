@@ -26,6 +26,7 @@
 #include <assert.h>
 #include "ln_op.h"
 #include "ln_arch.h"
+#include "arch/ln_cpu.h"
 
 struct priv_s {
     ln_tensor_entry *src_entry;
@@ -93,6 +94,8 @@ static void lrelu_cpu_pre_run(ln_op_arg *op_arg)
     dst_entry = ln_tensor_entry_create(dst_name, dst);
     dst_entry->offset = dst_list_entry->offset;
     ln_tensor_entry_set_creater(dst_entry, op_arg->name);
+    ln_tensor_entry_set_owner(dst_entry, op_arg->tensor_table, src_name);
+    dst_entry->inplace = 1;
     dst_entry->mtype = LN_MEM_CPU;
     ln_tensor_table_insert(op_arg->tensor_table, dst_entry);
 
@@ -113,7 +116,10 @@ static void lrelu_cpu_run(ln_op_arg *op_arg)
     float          negslope = priv->negslope_entry->value_float;
 
     /* begin custom code */
-    tl_tensor_lrelu(src, dst, negslope);
+    if (src->dtype == TL_FLOAT)
+        ln_cpu_slrelu(src->len, src->data, dst->data, negslope);
+    else
+        tl_tensor_lrelu(src, dst, negslope);
     /* end custom code */
 }
 
@@ -126,6 +132,17 @@ static void lrelu_cpu_post_run(ln_op_arg *op_arg)
     ln_free(priv);
 }
 
+/* This function is used to manually set the tensor's offset address. */
+static size_t lrelu_cpu_calc_offset(ln_op_arg *op_arg, ln_tensor_entry *te)
+{
+    struct priv_s   *priv = op_arg->priv;
+    ln_tensor_entry *src_entry = priv->src_entry;
+
+    /* begin custom code */
+    return src_entry->offset;
+    /* end custom code */
+}
+
 static const char *in_arg_names[] = {
     "src",
     NULL
@@ -162,5 +179,5 @@ ln_op ln_opimpl_lrelu_cpu = {
     .static_run = NULL,
     .run = lrelu_cpu_run,
     .post_run = lrelu_cpu_post_run,
-    .calc_offset = NULL,
+    .calc_offset = lrelu_cpu_calc_offset,
 };
@@ -26,6 +26,7 @@
 #include <assert.h>
 #include "ln_op.h"
 #include "ln_arch.h"
+#include "arch/ln_cpu.h"
 
 struct priv_s {
     ln_tensor_entry *src_entry;
@@ -145,7 +146,22 @@ static void pick1d_cpu_pre_run(ln_op_arg *op_arg)
 /* This function should only do the calculations. */
 static void pick1d_cpu_run(ln_op_arg *op_arg)
 {
-    ln_msg_warn("%s(%s): 'run' not defined", op_arg->name, op_arg->optype);
+    struct priv_s *priv = op_arg->priv;
+    tl_tensor     *src = priv->src_entry->tensor;
+    tl_tensor     *src_index = priv->src_index_entry->tensor;
+    tl_tensor     *dst = priv->dst_entry->tensor;
+    int            len = priv->len_entry->value_int;
+    int            stride = priv->stride_entry->value_int;
+
+    /* begin custom code */
+    {
+    size_t size = tl_size_of(src->dtype) * stride;
+    const int32_t *index = src_index->data;
+    for (int i = 0; i < len; i++)
+        memcpy((char *)dst->data + i * size,
+               (char *)src->data + index[i] * size, size);
+    }
+    /* end custom code */
 }
 
 /* This function should free all the memory allocated by other *_run()s. */
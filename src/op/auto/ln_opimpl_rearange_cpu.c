@@ -26,6 +26,7 @@
 #include <assert.h>
 #include "ln_op.h"
 #include "ln_arch.h"
+#include "arch/ln_cpu.h"
 
 struct priv_s {
     ln_tensor_entry *src_entry;
@@ -164,7 +165,10 @@ static void rearange_cpu_run(ln_op_arg *op_arg)
     double         step = priv->step_entry->value_double;
 
     /* begin custom code */
-    tl_tensor_rearange(dst, start, stop, step);
+    if (dst->dtype == TL_FLOAT)
+        ln_cpu_sarange(dst->len, dst->data, start, step);
+    else
+        tl_tensor_rearange(dst, start, stop, step);
     /* end custom code */
 }
 
@@ -26,6 +26,7 @@
 #include <assert.h>
 #include "ln_op.h"
 #include "ln_arch.h"
+#include "arch/ln_cpu.h"
 
 struct priv_s {
     ln_tensor_entry *src_entry;
@@ -84,6 +85,8 @@ static void relu_cpu_pre_run(ln_op_arg *op_arg)
     dst_entry = ln_tensor_entry_create(dst_name, dst);
     dst_entry->offset = dst_list_entry->offset;
     ln_tensor_entry_set_creater(dst_entry, op_arg->name);
+    ln_tensor_entry_set_owner(dst_entry, op_arg->tensor_table, src_name);
+    dst_entry->inplace = 1;
     dst_entry->mtype = LN_MEM_CPU;
     ln_tensor_table_insert(op_arg->tensor_table, dst_entry);
 
@@ -97,7 +100,16 @@ static void relu_cpu_pre_run(ln_op_arg *op_arg)
 /* This function should only do the calculations. */
 static void relu_cpu_run(ln_op_arg *op_arg)
 {
-    ln_msg_warn("%s(%s): 'run' not defined", op_arg->name, op_arg->optype);
+    struct priv_s *priv = op_arg->priv;
+    tl_tensor     *src = priv->src_entry->tensor;
+    tl_tensor     *dst = priv->dst_entry->tensor;
+
+    /* begin custom code */
+    if (src->dtype == TL_FLOAT)
+        ln_cpu_slrelu(src->len, src->data, dst->data, 0);
+    else
+        tl_tensor_lrelu(src, dst, 0);
+    /* end custom code */
 }
 
 /* This function should free all the memory allocated by other *_run()s. */
@@ -109,6 +121,17 @@ static void relu_cpu_post_run(ln_op_arg *op_arg)
     ln_free(priv);
 }
 
+/* This function is used to manually set the tensor's offset address. */
+static size_t relu_cpu_calc_offset(ln_op_arg *op_arg, ln_tensor_entry *te)
+{
+    struct priv_s   *priv = op_arg->priv;
+    ln_tensor_entry *src_entry = priv->src_entry;
+
+    /* begin custom code */
+    return src_entry->offset;
+    /* end custom code */
+}
+
 static const char *in_arg_names[] = {
     "src",
     NULL
@@ -144,5 +167,5 @@ ln_op ln_opimpl_relu_cpu = {
     .static_run = NULL,
     .run = relu_cpu_run,
     .post_run = relu_cpu_post_run,
-    .calc_offset = NULL,
+    .calc_offset = relu_cpu_calc_offset,
 };
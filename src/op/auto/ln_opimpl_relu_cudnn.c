@@ -34,7 +34,6 @@ struct priv_s {
     cudnnTensorDescriptor_t     src_desc;
     cudnnTensorDescriptor_t     dst_desc;
     cudnnActivationDescriptor_t activation_desc;
-    ln_cudnn_context           *cudnn_context;
 };
 
 /* This function should do the parameter checking and tensor shape inference. */
@@ -107,9 +106,6 @@ static void relu_cudnn_static_run(ln_op_arg *op_arg)
     tl_tensor     *dst = priv->dst_entry->tensor;
 
     /* begin custom code */
-    ln_arch *arch = ln_hash_find(LN_ARCH.arch_table, "cudnn");
-    assert(arch);
-    priv->cudnn_context = arch->priv;
     priv->src_desc = ln_cudnn_tensor_nchw_init(src);
     priv->dst_desc = ln_cudnn_tensor_nchw_init(dst);
     LN_CUDNN_CK(cudnnCreateActivationDescriptor(&priv->activation_desc));
@@ -128,7 +124,7 @@ static void relu_cudnn_run(ln_op_arg *op_arg)
     tl_tensor     *dst = priv->dst_entry->tensor;
 
     /* begin custom code */
-    LN_CUDNN_CK(cudnnActivationForward(priv->cudnn_context->cudnn_handle,
+    LN_CUDNN_CK(cudnnActivationForward(ln_cudnn_context_get()->cudnn_handle,
                                        priv->activation_desc, NULL,
                                        priv->src_desc, src->data, NULL,
                                        priv->dst_desc, dst->data));
@@ -26,6 +26,7 @@
 #include <assert.h>
 #include "ln_op.h"
 #include "ln_arch.h"
+#include "arch/ln_cpu.h"
 
 struct priv_s {
     ln_tensor_entry *src_entry;
@@ -83,20 +84,43 @@ static void reshape_cpu_pre_run(ln_op_arg *op_arg)
     ln_opck_param_exist(dims_entry, "dims");
     ln_opck_param_type(dims_entry, LN_PARAM_ARRAY_NUMBER);
     dims = dims_entry->value_array_int;
-    ln_opck_param_array_int_ge(dims_entry, 1);
+    ln_opck_param_array_int_ge(dims_entry, -1);
     dims = dims;
     /* begin custom code */
     {
-        char shape1[LN_MAXLINE];
-        char shape2[LN_MAXLINE];
-        ln_opck_satisfy_msg(src->len == ln_compute_length(dims_entry->array_len, dims), "'src' (%s) tensor's length %d should be equal to the reshaped (%s) length %d", ln_sprint_shape(shape1, src->ndim, src->dims), src->len, ln_sprint_shape(shape2, dims_entry->array_len, dims), ln_compute_length(dims_entry->array_len, dims));
+        char shape[LN_MAXLINE];
+        int n_inferred = 0;
+        for (int i = 0; i < dims_entry->array_len; i++) {
+            ln_opck_satisfy_msg(dims[i] != 0 || i < src->ndim, "'dims' (%s) can't copy the dimension %d of 'src', which has %d dimensions", ln_sprint_shape(shape, dims_entry->array_len, dims), i, src->ndim);
+            if (dims[i] == -1)
+                n_inferred++;
+        }
+        ln_opck_satisfy_msg(n_inferred <= 1, "'dims' (%s) should have at most one -1", ln_sprint_shape(shape, dims_entry->array_len, dims));
     }
     /* end custom code */
 
     /* define output tensor shape, tensor data should be NULL */
     dst_ndim = dims_entry->array_len;
-    dst_dims = dims;
     dst_dtype = src->dtype;
+    /* begin custom code */
+    {
+    char shape1[LN_MAXLINE];
+    char shape2[LN_MAXLINE];
+    int inferred = -1;
+    int len = 1;
+    dst_dims = ln_alloc(sizeof(int)*dims_entry->array_len);
+    for (int i = 0; i < dims_entry->array_len; i++) {
+        dst_dims[i] = dims[i] == 0 ? src->dims[i] : dims[i];
+        if (dims[i] == -1)
+            inferred = i;
+        else
+            len *= dst_dims[i];
+    }
+    if (inferred >= 0)
+        dst_dims[inferred] = len ? src->len / len : 0;
+    ln_opck_satisfy_msg(src->len == ln_compute_length(dims_entry->array_len, dst_dims), "'src' (%s) tensor's length %d should be equal to the reshaped (%s) length %d", ln_sprint_shape(shape1, src->ndim, src->dims), src->len, ln_sprint_shape(shape2, dims_entry->array_len, dst_dims), ln_compute_length(dims_entry->array_len, dst_dims));
+    }
+    /* end custom code */
     dst = tl_tensor_create(NULL, dst_ndim, dst_dims, dst_dtype);
     dst_entry = ln_tensor_entry_create(dst_name, dst);
     dst_entry->offset = dst_list_entry->offset;
@@ -104,6 +128,9 @@ static void reshape_cpu_pre_run(ln_op_arg *op_arg)
     ln_tensor_entry_set_owner(dst_entry, op_arg->tensor_table, src_name);
     dst_entry->mtype = LN_MEM_CPU;
     ln_tensor_table_insert(op_arg->tensor_table, dst_entry);
+    /* begin custom code */
+    ln_free(dst_dims);
+    /* end custom code */
 
     /* use op_arg->priv to store private data to be used in other functions */
     priv = ln_alloc(sizeof(struct priv_s));
@@ -26,6 +26,7 @@
 #include <assert.h>
 #include "ln_op.h"
 #include "ln_arch.h"
+#include "arch/ln_cpu.h"
 
 struct priv_s {
     ln_tensor_entry *src_entry;
@@ -63,6 +64,7 @@ static void sigmoid_cpu_pre_run(ln_op_arg *op_arg)
     src = src_entry->tensor;
     src = src;
     ln_opck_tensor_mtype_eq(src_entry, LN_MEM_CPU);
+    ln_opck_tensor_dtype_eq(src_entry, TL_FLOAT);
 
     tensors_out_n = ln_tensor_list_length(op_arg->tensors_out);
     ln_opck_tensors_out_len_eq(tensors_out_n, 1);
@@ -84,6 +86,8 @@ static void sigmoid_cpu_pre_run(ln_op_arg *op_arg)
     dst_entry = ln_tensor_entry_create(dst_name, dst);
     dst_entry->offset = dst_list_entry->offset;
     ln_tensor_entry_set_creater(dst_entry, op_arg->name);
+    ln_tensor_entry_set_owner(dst_entry, op_arg->tensor_table, src_name);
+    dst_entry->inplace = 1;
     dst_entry->mtype = LN_MEM_CPU;
     ln_tensor_table_insert(op_arg->tensor_table, dst_entry);
 
@@ -97,7 +101,13 @@ static void sigmoid_cpu_pre_run(ln_op_arg *op_arg)
 /* This function should only do the calculations. */
 static void sigmoid_cpu_run(ln_op_arg *op_arg)
 {
-    ln_msg_warn("%s(%s): 'run' not defined", op_arg->name, op_arg->optype);
+    struct priv_s *priv = op_arg->priv;
+    tl_tensor     *src = priv->src_entry->tensor;
+    tl_tensor     *dst = priv->dst_entry->tensor;
+
+    /* begin custom code */
+    ln_cpu_ssigmoid(src->len, src->data, dst->data);
+    /* end custom code */
 }
 
 /* This function should free all the memory allocated by other *_run()s. */
@@ -109,6 +119,17 @@ static void sigmoid_cpu_post_run(ln_op_arg *op_arg)
     ln_free(priv);
 }
 
+/* This function is used to manually set the tensor's offset address. */
+static size_t sigmoid_cpu_calc_offset(ln_op_arg *op_arg, ln_tensor_entry *te)
+{
+    struct priv_s   *priv = op_arg->priv;
+    ln_tensor_entry *src_entry = priv->src_entry;
+
+    /* begin custom code */
+    return src_entry->offset;
+    /* end custom code */
+}
+
 static const char *in_arg_names[] = {
     "src",
     NULL
@@ -144,5 +165,5 @@ ln_op ln_opimpl_sigmoid_cpu = {
     .static_run = NULL,
     .run = sigmoid_cpu_run,
     .post_run = sigmoid_cpu_post_run,
-    .calc_offset = NULL,
+    .calc_offset = sigmoid_cpu_calc_offset,
 };
@@ -26,6 +26,7 @@
 #include <assert.h>
 #include "ln_op.h"
 #include "ln_arch.h"
+#include "arch/ln_cpu.h"
 
 struct priv_s {
     ln_tensor_entry *src_entry;
@@ -121,6 +122,7 @@ static void slice_cpu_pre_run(ln_op_arg *op_arg)
     dst_entry = ln_tensor_entry_create(dst_name, dst);
     dst_entry->offset = dst_list_entry->offset;
     ln_tensor_entry_set_creater(dst_entry, op_arg->name);
+    ln_tensor_entry_set_owner(dst_entry, op_arg->tensor_table, ln_compute_length(axis, src->dims) == 1 ? src_name : NULL);
     dst_entry->mtype = LN_MEM_CPU;
     ln_tensor_table_insert(op_arg->tensor_table, dst_entry);
     /* begin custom code */
@@ -148,7 +150,8 @@ static void slice_cpu_run(ln_op_arg *op_arg)
     int            len = priv->len_entry->value_int;
 
     /* begin custom code */
-    tl_tensor_slice(src, dst, axis, start, len);
+    if (ln_compute_length(axis, src->dims) != 1)
+        tl_tensor_slice(src, dst, axis, start, len);
     /* end custom code */
 }
 
@@ -161,6 +164,21 @@ static void slice_cpu_post_run(ln_op_arg *op_arg)
     ln_free(priv);
 }
 
+/* This function is used to manually set the tensor's offset address. */
+static size_t slice_cpu_calc_offset(ln_op_arg *op_arg, ln_tensor_entry *te)
+{
+    struct priv_s   *priv = op_arg->priv;
+    ln_tensor_entry *src_entry = priv->src_entry;
+    tl_tensor       *src = priv->src_entry->tensor;
+    int              axis = priv->axis_entry->value_int;
+    int              start = priv->start_entry->value_int;
+
+    /* begin custom code */
+    return src_entry->offset + tl_size_of(src->dtype) * start *
+        ln_compute_length(src->ndim - axis - 1, src->dims + axis + 1);
+    /* end custom code */
+}
+
 static const char *in_arg_names[] = {
     "src",
     NULL
@@ -201,5 +219,5 @@ ln_op ln_opimpl_slice_cpu = {
     .static_run = NULL,
     .run = slice_cpu_run,
     .post_run = slice_cpu_post_run,
-    .calc_offset = NULL,
+    .calc_offset = slice_cpu_calc_offset,
 };
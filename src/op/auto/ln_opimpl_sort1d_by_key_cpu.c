@@ -26,6 +26,7 @@
 #include <assert.h>
 #include "ln_op.h"
 #include "ln_arch.h"
+#include "arch/ln_cpu.h"
 
 struct priv_s {
     ln_tensor_entry *src_key_entry;
@@ -79,6 +80,7 @@ static void sort1d_by_key_cpu_pre_run(ln_op_arg *op_arg)
     src_key = src_key_entry->tensor;
     src_key = src_key;
     ln_opck_tensor_mtype_eq(src_key_entry, LN_MEM_CPU);
+    ln_opck_tensor_dtype_eq(src_key_entry, TL_FLOAT);
     ln_opck_tensor_ndim(src_key_entry, 1);
 
     src_val_list_entry = ln_tensor_list_find_by_arg_name(op_arg->tensors_in, "src_val");
@@ -155,7 +157,17 @@ static void sort1d_by_key_cpu_pre_run(ln_op_arg *op_arg)
 /* This function should only do the calculations. */
 static void sort1d_by_key_cpu_run(ln_op_arg *op_arg)
 {
-    ln_msg_warn("%s(%s): 'run' not defined", op_arg->name, op_arg->optype);
+    struct priv_s *priv = op_arg->priv;
+    tl_tensor     *src_key = priv->src_key_entry->tensor;
+    tl_tensor     *src_val = priv->src_val_entry->tensor;
+    tl_tensor     *dst_key = priv->dst_key_entry->tensor;
+    tl_tensor     *dst_val = priv->dst_val_entry->tensor;
+    int            dir = priv->dir_entry->value_int;
+
+    /* begin custom code */
+    ln_cpu_stopk(src_key->len, src_key->data, src_val->data, src_key->len,
+                 dir == TL_SORT_DIR_DESCENDING, dst_key->data, dst_val->data);
+    /* end custom code */
 }
 
 /* This function should free all the memory allocated by other *_run()s. */
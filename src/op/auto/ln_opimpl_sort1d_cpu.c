@@ -26,6 +26,7 @@
 #include <assert.h>
 #include "ln_op.h"
 #include "ln_arch.h"
+#include "arch/ln_cpu.h"
 
 struct priv_s {
     ln_tensor_entry *src_key_entry;
@@ -66,6 +67,7 @@ static void sort1d_cpu_pre_run(ln_op_arg *op_arg)
     src_key = src_key_entry->tensor;
     src_key = src_key;
     ln_opck_tensor_mtype_eq(src_key_entry, LN_MEM_CPU);
+    ln_opck_tensor_dtype_eq(src_key_entry, TL_FLOAT);
     ln_opck_tensor_ndim(src_key_entry, 1);
 
     tensors_out_n = ln_tensor_list_length(op_arg->tensors_out);
@@ -97,7 +99,7 @@ static void sort1d_cpu_pre_run(ln_op_arg *op_arg)
     dst_key_entry->offset = dst_key_list_entry->offset;
     ln_tensor_entry_set_creater(dst_key_entry, op_arg->name);
     ln_tensor_entry_set_owner(dst_key_entry, op_arg->tensor_table, src_key_name);
-    dst_key_entry->mtype = LN_MEM_NONE;
+    dst_key_entry->mtype = LN_MEM_CPU;
     ln_tensor_table_insert(op_arg->tensor_table, dst_key_entry);
 
     /* use op_arg->priv to store private data to be used in other functions */
@@ -111,7 +113,15 @@ static void sort1d_cpu_pre_run(ln_op_arg *op_arg)
 /* This function should only do the calculations. */
 static void sort1d_cpu_run(ln_op_arg *op_arg)
 {
-    ln_msg_warn("%s(%s): 'run' not defined", op_arg->name, op_arg->optype);
+    struct priv_s *priv = op_arg->priv;
+    tl_tensor     *src_key = priv->src_key_entry->tensor;
+    tl_tensor     *dst_key = priv->dst_key_entry->tensor;
+    int            dir = priv->dir_entry->value_int;
+
+    /* begin custom code */
+    ln_cpu_stopk(src_key->len, src_key->data, NULL, src_key->len,
+                 dir == TL_SORT_DIR_DESCENDING, dst_key->data, NULL);
+    /* end custom code */
 }
 
 /* This function should free all the memory allocated by other *_run()s. */
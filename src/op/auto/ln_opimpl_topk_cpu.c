@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) 2018-2020 Zhixu Zhao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* NOTE: this file is automatically generated by protos/op/topk.op
+   using tools/addop.pl */
+
+#include <assert.h>
+#include "ln_op.h"
+#include "ln_arch.h"
+#include "arch/ln_cpu.h"
+
+struct priv_s {
+    ln_tensor_entry *src_key_entry;
+    ln_tensor_entry *src_val_entry;
+    ln_tensor_entry *dst_key_entry;
+    ln_tensor_entry *dst_val_entry;
+    ln_param_entry  *k_entry;
+    ln_param_entry  *dir_entry;
+};
+
+/* This function should do the parameter checking and tensor shape inference. */
+static void topk_cpu_pre_run(ln_op_arg *op_arg)
+{
+    char                 *src_key_name;
+    ln_tensor_list_entry *src_key_list_entry;
+    ln_tensor_entry      *src_key_entry;
+    tl_tensor            *src_key;
+    char                 *src_val_name;
+    ln_tensor_list_entry *src_val_list_entry;
+    ln_tensor_entry      *src_val_entry;
+    tl_tensor            *src_val;
+    char                 *dst_key_name;
+    ln_tensor_list_entry *dst_key_list_entry;
+    ln_tensor_entry      *dst_key_entry;
+    tl_tensor            *dst_key;
+    int                   dst_key_ndim;
+    int                  *dst_key_dims;
+    tl_dtype              dst_key_dtype;
+    char                 *dst_val_name;
+    ln_tensor_list_entry *dst_val_list_entry;
+    ln_tensor_entry      *dst_val_entry;
+    tl_tensor            *dst_val;
+    int                   dst_val_ndim;
+    int                  *dst_val_dims;
+    tl_dtype              dst_val_dtype;
+    int                   k;
+    ln_param_entry       *k_entry;
+    int                   dir;
+    ln_param_entry       *dir_entry;
+    int                   tensors_in_n;
+    int                   tensors_out_n;
+    int                   params_n;
+    struct priv_s        *priv;
+
+    /* check tensors and parameters */
+    tensors_in_n = ln_tensor_list_length(op_arg->tensors_in);
+    ln_opck_tensors_in_len_eq(tensors_in_n, 2);
+
+    src_key_list_entry = ln_tensor_list_find_by_arg_name(op_arg->tensors_in, "src_key");
+    ln_opck_tensor_in_exist(src_key_list_entry, "src_key");
+    src_key_name = src_key_list_entry->name;
+    src_key_entry = ln_tensor_table_find(op_arg->tensor_table, src_key_name);
+    ln_opck_tensor_defined(src_key_entry, src_key_name);
+    src_key = src_key_entry->tensor;
+    src_key = src_key;
+    ln_opck_tensor_mtype_eq(src_key_entry, LN_MEM_CPU);
+    ln_opck_tensor_dtype_eq(src_key_entry, TL_FLOAT);
+    ln_opck_tensor_ndim(src_key_entry, 1);
+
+    src_val_list_entry = ln_tensor_list_find_by_arg_name(op_arg->tensors_in, "src_val");
+    ln_opck_tensor_in_exist(src_val_list_entry, "src_val");
+    src_val_name = src_val_list_entry->name;
+    src_val_entry = ln_tensor_table_find(op_arg->tensor_table, src_val_name);
+    ln_opck_tensor_defined(src_val_entry, src_val_name);
+    src_val = src_val_entry->tensor;
+    src_val = src_val;
+    ln_opck_tensor_mtype_eq(src_val_entry, LN_MEM_CPU);
+    ln_opck_tensor_dtype_eq(src_val_entry, TL_INT32);
+    ln_opck_tensor_ndim(src_val_entry, 1);
+    ln_opck_tensor_len(src_val_entry, src_key->len);
+
+    tensors_out_n = ln_tensor_list_length(op_arg->tensors_out);
+    ln_opck_tensors_out_len_eq(tensors_out_n, 2);
+
+    dst_key_list_entry = ln_tensor_list_find_by_arg_name(op_arg->tensors_out, "dst_key");
+    ln_opck_tensor_out_exist(dst_key_list_entry, "dst_key");
+    dst_key_name = dst_key_list_entry->name;
+    dst_key_entry = ln_tensor_table_find(op_arg->tensor_table, dst_key_name);
+    ln_opck_tensor_not_defined(dst_key_entry, dst_key_name);
+
+    dst_val_list_entry = ln_tensor_list_find_by_arg_name(op_arg->tensors_out, "dst_val");
+    ln_opck_tensor_out_exist(dst_val_list_entry, "dst_val");
+    dst_val_name = dst_val_list_entry->name;
+    dst_val_entry = ln_tensor_table_find(op_arg->tensor_table, dst_val_name);
+    ln_opck_tensor_not_defined(dst_val_entry, dst_val_name);
+
+    params_n = ln_param_list_length(op_arg->params);
+    ln_opck_params_len_eq(params_n, 2);
+
+    k_entry = ln_param_list_find(op_arg->params, "k");
+    ln_opck_param_exist(k_entry, "k");
+    ln_opck_param_type(k_entry, LN_PARAM_NUMBER);
+    k = k_entry->value_int;
+    ln_opck_param_int_gt(k_entry, 0);
+    ln_opck_param_int_le(k_entry, src_key->len);
+    k = k;
+
+    dir_entry = ln_param_list_find(op_arg->params, "dir");
+    ln_opck_param_exist(dir_entry, "dir");
+    ln_opck_param_type(dir_entry, LN_PARAM_STRING);
+    dir = tl_sort_dir_from_str(dir_entry->value_string);
+    dir_entry->value_int = dir;
+    dir = dir;
+    ln_opck_satisfy_msg(dir != -1, "'dir' should be a supported tl_sort_dir");
+
+    /* define output tensor shape, tensor data should be NULL */
+    dst_key_ndim = 1;
+    dst_key_dtype = src_key->dtype;
+    /* begin custom code */
+    {
+    dst_key_dims = ln_alloc(sizeof(int) * 1);
+    dst_key_dims[0] = k;
+    }
+    /* end custom code */
+    dst_key = tl_tensor_create(NULL, dst_key_ndim, dst_key_dims, dst_key_dtype);
+    dst_key_entry = ln_tensor_entry_create(dst_key_name, dst_key);
+    dst_key_entry->offset = dst_key_list_entry->offset;
+    ln_tensor_entry_set_creater(dst_key_entry, op_arg->name);
+    dst_key_entry->mtype = LN_MEM_CPU;
+    ln_tensor_table_insert(op_arg->tensor_table, dst_key_entry);
+    /* begin custom code */
+    ln_free(dst_key_dims);
+    /* end custom code */
+
+    dst_val_ndim = 1;
+    dst_val_dtype = src_val->dtype;
+    /* begin custom code */
+    {
+    dst_val_dims = ln_alloc(sizeof(int) * 1);
+    dst_val_dims[0] = k;
+    }
+    /* end custom code */
+    dst_val = tl_tensor_create(NULL, dst_val_ndim, dst_val_dims, dst_val_dtype);
+    dst_val_entry = ln_tensor_entry_create(dst_val_name, dst_val);
+    dst_val_entry->offset = dst_val_list_entry->offset;
+    ln_tensor_entry_set_creater(dst_val_entry, op_arg->name);
+    dst_val_entry->mtype = LN_MEM_CPU;
+    ln_tensor_table_insert(op_arg->tensor_table, dst_val_entry);
+    /* begin custom code */
+    ln_free(dst_val_dims);
+    /* end custom code */
+
+    /* use op_arg->priv to store private data to be used in other functions */
+    priv = ln_alloc(sizeof(struct priv_s));
+    priv->src_key_entry = src_key_entry;
+    priv->src_val_entry = src_val_entry;
+    priv->dst_key_entry = dst_key_entry;
+    priv->dst_val_entry = dst_val_entry;
+    priv->k_entry = k_entry;
+    priv->dir_entry = dir_entry;
+    op_arg->priv = priv;
+}
+
+/* This function should only do the calculations. */
+static void topk_cpu_run(ln_op_arg *op_arg)
+{
+    struct priv_s *priv = op_arg->priv;
+    tl_tensor     *src_key = priv->src_key_entry->tensor;
+    tl_tensor     *src_val = priv->src_val_entry->tensor;
+    tl_tensor     *dst_key = priv->dst_key_entry->tensor;
+    tl_tensor     *dst_val = priv->dst_val_entry->tensor;
+    int            k = priv->k_entry->value_int;
+    int            dir = priv->dir_entry->value_int;
+
+    /* begin custom code */
+    ln_cpu_stopk(src_key->len, src_key->data, src_val->data, k,
+                 dir == TL_SORT_DIR_DESCENDING, dst_key->data, dst_val->data);
+    /* end custom code */
+}
+
+/* This function should free all the memory allocated by other *_run()s. */
+static void topk_cpu_post_run(ln_op_arg *op_arg)
+{
+    struct priv_s *priv = op_arg->priv;
+
+    ln_tensor_table_remove(op_arg->tensor_table, priv->dst_key_entry->name);
+    ln_tensor_table_remove(op_arg->tensor_table, priv->dst_val_entry->name);
+    ln_free(priv);
+}
+
+static const char *in_arg_names[] = {
+    "src_key",
+    "src_val",
+    NULL
+};
+
+static const char *out_arg_names[] = {
+    "dst_key",
+    "dst_val",
+    NULL
+};
+
+static const char *param_arg_names[] = {
+    "k",
+    "dir",
+    NULL
+};
+
+static const ln_param_type param_ptypes[] = {
+    LN_PARAM_NUMBER,
+    LN_PARAM_STRING,
+};
+
+/* specify other ln_op_arg fields */
+static ln_op_arg op_arg_topk_cpu = {
+    .optype = "topk_cpu",
+    .arch = "cpu",
+    .in_arg_names = in_arg_names,
+    .out_arg_names = out_arg_names,
+    .param_arg_names = param_arg_names,
+    .param_ptypes = param_ptypes,
+};
+
+/* struct used for op registration in ln_oplist.c */
+ln_op ln_opimpl_topk_cpu = {
+    .op_arg = &op_arg_topk_cpu,
+    .pre_run = topk_cpu_pre_run,
+    .static_run = NULL,
+    .run = topk_cpu_run,
+    .post_run = topk_cpu_post_run,
+    .calc_offset = NULL,
+};
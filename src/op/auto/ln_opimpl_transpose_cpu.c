@@ -26,6 +26,7 @@
 #include <assert.h>
 #include "ln_op.h"
 #include "ln_arch.h"
+#include "arch/ln_cpu.h"
 
 struct priv_s {
     ln_tensor_entry *src_entry;
@@ -133,7 +134,11 @@ static void transpose_cpu_run(ln_op_arg *op_arg)
     int           *axes = priv->axes_entry->value_array_int;
 
     /* begin custom code */
-    tl_tensor_transpose(src, dst, axes);
+    if (src->ndim <= LN_CPU_MAXDIM)
+        ln_cpu_transpose(src->data, dst->data, src->ndim, src->dims, axes,
+                         tl_size_of(src->dtype));
+    else
+        tl_tensor_transpose(src, dst, axes);
     /* end custom code */
 }
 
@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2018-2020 Zhixu Zhao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <assert.h>
+#include "ln_op.h"
+#include "arch/ln_cpu.h"
+
+/*
+ * elew_chain_cpu is created by the cpu combiner from runs of pointwise ops.
+ * Its tensors_in are "src0", "src1", ..., where "src0" is the tensor flowing
+ * through the chain, and its "code" param is a flattened list of
+ * [opcode, src, imm] triples decoded into an ln_cpu_ew_inst program.
+ */
+struct priv_s {
+    ln_tensor_entry **src_entries;
+    const float     **srcs;
+    int               src_n;
+    ln_tensor_entry  *dst_entry;
+    ln_cpu_ew_inst   *prog;
+    int               prog_len;
+};
+
+/*
+ * This function should do the parameter checking and tensor shape inference.
+ */
+static void elew_chain_cpu_pre_run(ln_op_arg *op_arg)
+{
+    ln_tensor_list_entry *tle;
+    ln_tensor_list_entry *dst_list_entry;
+    ln_tensor_entry **src_entries;
+    ln_tensor_entry *src0_entry;
+    ln_tensor_entry *dst_entry;
+    ln_param_entry *code_entry;
+    ln_cpu_ew_inst *prog;
+    tl_tensor *src0;
+    tl_tensor *dst;
+    char arg_name[LN_MAX_NAME_LEN];
+    int src_n;
+    int prog_len;
+    int i;
+
+    /* check tensors and parameters */
+    src_n = ln_tensor_list_length(op_arg->tensors_in);
+    ln_opck_tensors_in_len_gt(src_n, 0);
+    src_entries = ln_alloc(sizeof(ln_tensor_entry *) * src_n);
+    for (i = 0; i < src_n; i++) {
+        snprintf(arg_name, LN_MAX_NAME_LEN, "src%d", i);
+        tle = ln_tensor_list_find_by_arg_name(op_arg->tensors_in, arg_name);
+        ln_opck_tensor_in_exist(tle, arg_name);
+        src_entries[i] = ln_tensor_table_find(op_arg->tensor_table, tle->name);
+        ln_opck_tensor_defined(src_entries[i], tle->name);
+        ln_opck_tensor_mtype_eq(src_entries[i], LN_MEM_CPU);
+        ln_opck_tensor_dtype_eq(src_entries[i], TL_FLOAT);
+        ln_opck_tensor_issameshape(src_entries[i], src_entries[0]);
+    }
+    src0_entry = src_entries[0];
+    src0 = src0_entry->tensor;
+
+    ln_opck_tensors_out_len_eq(ln_tensor_list_length(op_arg->tensors_out), 1);
+    dst_list_entry = ln_tensor_list_find_by_arg_name(op_arg->tensors_out, "dst");
+    ln_opck_tensor_out_exist(dst_list_entry, "dst");
+    dst_entry = ln_tensor_table_find(op_arg->tensor_table, dst_list_entry->name);
+    ln_opck_tensor_not_defined(dst_entry, dst_list_entry->name);
+
+    ln_opck_params_len_eq(ln_param_list_length(op_arg->params), 1);
+    code_entry = ln_param_list_find(op_arg->params, "code");
+    ln_opck_param_exist(code_entry, "code");
+    ln_opck_param_type(code_entry, LN_PARAM_ARRAY_NUMBER);
+    ln_opck_param_array_len_gt(code_entry, 0);
+    ln_opck_satisfy_msg(code_entry->array_len % 3 == 0,
+                        "'code' should be a list of [opcode, src, imm] triples");
+    prog_len = code_entry->array_len / 3;
+    prog = ln_alloc(sizeof(ln_cpu_ew_inst) * prog_len);
+    for (i = 0; i < prog_len; i++) {
+        prog[i].opcode = code_entry->value_array_int[i * 3];
+        prog[i].src = code_entry->value_array_int[i * 3 + 1];
+        prog[i].imm = code_entry->value_array_double[i * 3 + 2];
+        ln_opck_satisfy_msg(prog[i].opcode >= 0 &&
+                            prog[i].opcode < LN_CPU_EW_OPCODE_SIZE,
+                            "instruction %d's opcode should be in [0, %d)",
+                            i, LN_CPU_EW_OPCODE_SIZE);
+        ln_opck_satisfy_msg(prog[i].src >= -1 && prog[i].src < src_n,
+                            "instruction %d's src should be in [-1, %d)",
+                            i, src_n);
+    }
+
+    /* define output tensor shape, tensor data should be NULL */
+    dst = tl_tensor_create(NULL, src0->ndim, src0->dims, src0->dtype);
+    dst_entry = ln_tensor_entry_create(dst_list_entry->name, dst);
+    dst_entry->offset = dst_list_entry->offset;
+    ln_tensor_entry_set_creater(dst_entry, op_arg->name);
+    ln_tensor_entry_set_owner(dst_entry, op_arg->tensor_table, src0_entry->name);
+    dst_entry->inplace = 1;
+    dst_entry->mtype = LN_MEM_CPU;
+    ln_tensor_table_insert(op_arg->tensor_table, dst_entry);
+
+    struct priv_s *priv;
+    priv = ln_alloc(sizeof(struct priv_s));
+    priv->src_entries = src_entries;
+    priv->srcs = ln_alloc(sizeof(float *) * src_n);
+    priv->src_n = src_n;
+    priv->dst_entry = dst_entry;
+    priv->prog = prog;
+    priv->prog_len = prog_len;
+    op_arg->priv = priv;
+}
+
+/* This function should only do the calculations. */
+static void elew_chain_cpu_run(ln_op_arg *op_arg)
+{
+    struct priv_s *priv = op_arg->priv;
+    tl_tensor *dst = priv->dst_entry->tensor;
+    int i;
+
+    for (i = 0; i < priv->src_n; i++)
+        priv->srcs[i] = priv->src_entries[i]->tensor->data;
+    ln_cpu_selew_chain(dst->len, priv->srcs, dst->data,
+                       priv->prog, priv->prog_len);
+}
+
+/*
+ * This function should free all the memory allocated by other *_run()s.
+ */
+static void elew_chain_cpu_post_run(ln_op_arg *op_arg)
+{
+    struct priv_s *priv = op_arg->priv;
+
+    ln_tensor_table_remove(op_arg->tensor_table, priv->dst_entry->name);
+    ln_free(priv->src_entries);
+    ln_free(priv->srcs);
+    ln_free(priv->prog);
+    ln_free(op_arg->priv);
+}
+
+/* This function is used to manually set the tensor's offset address. */
+static size_t elew_chain_cpu_calc_offset(ln_op_arg *op_arg,
+                                         ln_tensor_entry *te)
+{
+    struct priv_s *priv = op_arg->priv;
+
+    return priv->src_entries[0]->offset;
+}
+
+static const char *in_arg_names[] = {
+    NULL
+};
+
+static const char *out_arg_names[] = {
+    "dst",
+    NULL
+};
+
+static const char *param_arg_names[] = {
+    "code",
+    NULL
+};
+
+static const ln_param_type param_ptypes[] = {
+    LN_PARAM_ARRAY_NUMBER
+};
+
+/* specify other ln_op_arg fields */
+static ln_op_arg op_arg_elew_chain_cpu = {
+    .optype = "elew_chain_cpu",
+    .arch = "cpu",
+    .in_arg_names = in_arg_names,
+    .out_arg_names = out_arg_names,
+    .param_arg_names = param_arg_names,
+    .param_ptypes = param_ptypes,
+};
+
+/* struct used for op registration in ln_oplist.c */
+ln_op ln_opimpl_elew_chain_cpu = {
+    .op_arg = &op_arg_elew_chain_cpu,
+    .pre_run = elew_chain_cpu_pre_run,
+    .static_run = NULL,
+    .run = elew_chain_cpu_run,
+    .post_run = elew_chain_cpu_post_run,
+    .calc_offset = elew_chain_cpu_calc_offset,
+};
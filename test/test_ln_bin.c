@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2018-2020 Zhixu Zhao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <unistd.h>
+#include <check.h>
+#include <tensorlight/tl_check.h>
+#include "lightnettest/ln_test.h"
+#include "ln_bin.h"
+#include "ln_json.h"
+#include "ln_arch.h"
+
+static char file[] = "/tmp/test_ln_bin_XXXXXX"LN_BIN_SUFFIX;
+
+static void checked_setup(void)
+{
+    int fd;
+
+    ln_arch_init();
+    fd = mkstemps(file, strlen(LN_BIN_SUFFIX));
+    ck_assert_int_ge(fd, 0);
+    close(fd);
+}
+
+static void checked_teardown(void)
+{
+    unlink(file);
+    strcpy(file, "/tmp/test_ln_bin_XXXXXX"LN_BIN_SUFFIX);
+    ln_arch_cleanup();
+}
+
+/* Print `ctx` to a binary IR, read it back and compare their JSON IRs. */
+static void check_round_trip(ln_context *ctx)
+{
+    ln_context *bin_ctx;
+    char *json_str, *bin_json_str;
+
+    ln_context_print(ctx, file);
+    ck_assert_int_eq(ln_bin_is_bin_file(file), 1);
+
+    bin_ctx = ln_context_create();
+    ln_context_init(bin_ctx, file);
+    ck_assert_int_eq(ln_list_length(bin_ctx->ops), ln_list_length(ctx->ops));
+    for (int i = 0; i < LN_MEM_TYPE_SIZE; i++) {
+        ck_assert_uint_eq(bin_ctx->mem_sizes[i], ctx->mem_sizes[i]);
+        ck_assert_uint_eq(bin_ctx->weight_sizes[i], ctx->weight_sizes[i]);
+    }
+    if (ctx->inputs)
+        ck_assert_str_eq(bin_ctx->inputs, ctx->inputs);
+    else
+        ck_assert_ptr_eq(bin_ctx->inputs, NULL);
+
+    json_str = ln_json_create_json_str(ctx);
+    bin_json_str = ln_json_create_json_str(bin_ctx);
+    ck_assert_str_eq(bin_json_str, json_str);
+
+    ln_free(json_str);
+    ln_free(bin_json_str);
+    ln_context_cleanup(bin_ctx);
+    ln_context_free(bin_ctx);
+}
+
+LN_TEST_START(test_ln_bin_is_bin_name)
+{
+    ck_assert_int_eq(ln_bin_is_bin_name("net"LN_BIN_SUFFIX), 1);
+    ck_assert_int_eq(ln_bin_is_bin_name("net.json"), 0);
+    ck_assert_int_eq(ln_bin_is_bin_name("net"), 0);
+    ck_assert_int_eq(ln_bin_is_bin_file(LN_TEST_DIR"/data/test_ops.json"), 0);
+    ck_assert_int_eq(ln_bin_is_bin_file("-"), 0);
+}
+LN_TEST_END
+
+LN_TEST_START(test_ln_bin_round_trip)
+{
+    ln_context *ctx;
+
+    ctx = ln_context_create();
+    ln_context_init(ctx, LN_TEST_DIR"/data/test_ops.json");
+    check_round_trip(ctx);
+    ln_context_cleanup(ctx);
+    ln_context_free(ctx);
+}
+LN_TEST_END
+
+LN_TEST_START(test_ln_bin_round_trip_compiled)
+{
+    ln_context *ctx;
+
+    ctx = ln_context_create();
+    ln_context_init(ctx, LN_TEST_DIR"/data/test_dirty.json");
+    ln_context_set_inputs(ctx, "input");
+    ln_context_compile(ctx, "cpu", NULL);
+    check_round_trip(ctx);
+    ln_context_cleanup(ctx);
+    ln_context_free(ctx);
+}
+LN_TEST_END
+
+/* roots written by op runs stay out of the weights of the parsed plan */
+LN_TEST_START(test_ln_bin_load_written)
+{
+    ln_context *ctx, *bin_ctx;
+
+    ctx = ln_context_create();
+    ln_context_init(ctx, LN_TEST_DIR"/data/test_run_written.json");
+    ln_context_set_inputs(ctx, "input");
+    ln_context_compile(ctx, "cpu", NULL);
+    ln_context_print(ctx, file);
+
+    bin_ctx = ln_context_create();
+    ln_context_init(bin_ctx, file);
+    ck_assert_int_eq(ln_context_is_weight(bin_ctx, "index"), 0);
+    ck_assert_int_eq(ln_context_is_weight(bin_ctx, "scale"), 1);
+    ln_context_load(bin_ctx, NULL);
+    ln_context_run(bin_ctx);
+    ln_context_unload(bin_ctx);
+
+    ln_context_cleanup(bin_ctx);
+    ln_context_free(bin_ctx);
+    ln_context_cleanup(ctx);
+    ln_context_free(ctx);
+}
+LN_TEST_END
+
+LN_TEST_TCASE_START(bin, checked_setup, checked_teardown)
+{
+    LN_TEST_ADD_TEST(test_ln_bin_is_bin_name);
+    LN_TEST_ADD_TEST(test_ln_bin_round_trip);
+    LN_TEST_ADD_TEST(test_ln_bin_round_trip_compiled);
+    LN_TEST_ADD_TEST(test_ln_bin_load_written);
+}
+LN_TEST_TCASE_END
+
+LN_TEST_ADD_TCASE(bin);
@@ -0,0 +1,825 @@
+/*
+ * Copyright (c) 2018-2020 Zhixu Zhao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <pthread.h>
+#include <unistd.h>
+#include <check.h>
+#include <tensorlight/tl_check.h>
+#include "lightnettest/ln_test.h"
+#include "ln_arch.h"
+#include "ln_context.h"
+#include "ln_pass.h"
+
+static void checked_setup(void)
+{
+    ln_arch_init();
+}
+
+static void checked_teardown(void)
+{
+    ln_arch_cleanup();
+}
+
+static void check_batch(ln_context *ctx, int batch)
+{
+    ln_tensor_entry *te;
+    float frame[6];
+    float res[6];
+
+    te = ln_tensor_table_find(ctx->tensor_table, "input");
+    ck_assert_int_eq(te->tensor->dims[0], batch);
+    te = ln_tensor_table_find(ctx->tensor_table, "reshape1");
+    ck_assert_int_eq(te->tensor->ndim, 2);
+    ck_assert_int_eq(te->tensor->dims[0], batch);
+    ck_assert_int_eq(te->tensor->dims[1], 6);
+    te = ln_tensor_table_find(ctx->tensor_table, "reshape2");
+    ck_assert_int_eq(te->tensor->ndim, 3);
+    ck_assert_int_eq(te->tensor->dims[0], batch);
+    ck_assert_int_eq(te->tensor->dims[1], 3);
+    ck_assert_int_eq(te->tensor->dims[2], 2);
+    te = ln_tensor_table_find(ctx->tensor_table, "reshape3");
+    ck_assert_int_eq(te->tensor->dims[0], batch);
+    ck_assert_int_eq(te->tensor->dims[1], 6);
+    ck_assert_int_eq(ln_context_data_size(ctx, "relu2"),
+                     sizeof(float) * 6 * batch);
+
+    ln_context_load(ctx, NULL);
+    for (int n = 0; n < batch; n++) {
+        for (int i = 0; i < 6; i++)
+            frame[i] = (i % 2 ? -1 : 1) * (n * 6 + i);
+        ln_context_set_frame(ctx, "input", n, frame);
+    }
+    ln_context_run(ctx);
+    for (int n = 0; n < batch; n++) {
+        ln_context_get_frame(ctx, "relu2", n, res);
+        for (int i = 0; i < 6; i++)
+            ck_assert_float_eq(res[i], i % 2 ? 0 : n * 6 + i);
+    }
+    ln_context_unload(ctx);
+}
+
+LN_TEST_START(test_ln_context_set_batch)
+{
+    ln_context *ctx;
+
+    /* before compiling */
+    ctx = ln_context_create();
+    ln_context_init(ctx, LN_TEST_DIR"/data/test_batch.json");
+    ln_context_set_batch(ctx, "input", 4);
+    ln_context_compile(ctx, "cpu", NULL);
+    check_batch(ctx, 4);
+    ln_context_cleanup(ctx);
+    ln_context_free(ctx);
+
+    /* after compiling, memory is re-planned */
+    ctx = ln_context_create();
+    ln_context_init(ctx, LN_TEST_DIR"/data/test_batch.json");
+    ln_context_compile(ctx, "cpu", NULL);
+    ln_context_set_batch(ctx, "input", 3);
+    check_batch(ctx, 3);
+    ln_context_set_batch(ctx, "input", 1);
+    check_batch(ctx, 1);
+    ln_context_cleanup(ctx);
+    ln_context_free(ctx);
+}
+LN_TEST_END
+
+#define N_THREADS 8
+#define N_RUNS 20
+#define INPUT_LEN (3 * 8 * 8)
+#define OUTPUT_LEN (4 * 4 * 4)
+
+struct concurrent_arg {
+    float input[INPUT_LEN];
+    float expect[OUTPUT_LEN];
+    int   ok;
+};
+
+static ln_context *concurrent_context(void)
+{
+    ln_context *ctx;
+
+    ctx = ln_context_create();
+    ln_context_init(ctx, LN_TEST_DIR"/data/test_concurrent.json");
+    ln_context_compile(ctx, "cpu", NULL);
+    ln_context_load(ctx, NULL);
+    return ctx;
+}
+
+static void concurrent_free(ln_context *ctx)
+{
+    ln_context_unload(ctx);
+    ln_context_cleanup(ctx);
+    ln_context_free(ctx);
+}
+
+static void *concurrent_worker(void *p)
+{
+    struct concurrent_arg *arg = p;
+    float res[OUTPUT_LEN];
+    ln_context *ctx;
+
+    ln_arch_init();
+    ctx = concurrent_context();
+    arg->ok = 1;
+    for (int i = 0; i < N_RUNS; i++) {
+        ln_context_set_data(ctx, "input", arg->input);
+        ln_context_run(ctx);
+        ln_context_get_data(ctx, "sigmoid1", res);
+        if (memcmp(res, arg->expect, sizeof(res)))
+            arg->ok = 0;
+    }
+    concurrent_free(ctx);
+    ln_arch_cleanup();
+    return NULL;
+}
+
+LN_TEST_START(test_ln_context_concurrent)
+{
+    struct concurrent_arg args[N_THREADS];
+    pthread_t threads[N_THREADS];
+    ln_context *ctx;
+
+    /* results of a single context running the inputs one by one */
+    ctx = concurrent_context();
+    for (int t = 0; t < N_THREADS; t++) {
+        for (int i = 0; i < INPUT_LEN; i++)
+            args[t].input[i] = (i * (t + 3) % 17) / 4.0 - 2;
+        ln_context_set_data(ctx, "input", args[t].input);
+        ln_context_run(ctx);
+        ln_context_get_data(ctx, "sigmoid1", args[t].expect);
+    }
+    concurrent_free(ctx);
+
+    for (int t = 0; t < N_THREADS; t++)
+        ck_assert_int_eq(pthread_create(&threads[t], NULL, concurrent_worker,
+                                        &args[t]), 0);
+    for (int t = 0; t < N_THREADS; t++) {
+        pthread_join(threads[t], NULL);
+        ck_assert_int_eq(args[t].ok, 1);
+    }
+}
+LN_TEST_END
+
+static ln_context *shared_context(void)
+{
+    ln_context *ctx;
+
+    ctx = ln_context_create();
+    ln_context_init(ctx, LN_TEST_DIR"/data/test_concurrent.json");
+    ln_context_set_inputs(ctx, "input");
+    ln_context_compile(ctx, "cpu", NULL);
+    return ctx;
+}
+
+static void check_shared_run(ln_context *ctx, const float *input,
+                             const float *expect)
+{
+    float res[OUTPUT_LEN];
+
+    ln_context_set_data(ctx, "input", input);
+    ln_context_run(ctx);
+    ln_context_get_data(ctx, "sigmoid1", res);
+    ck_assert_int_eq(memcmp(res, expect, sizeof(res)), 0);
+}
+
+LN_TEST_START(test_ln_context_share_weights)
+{
+    ln_context *ctx1, *ctx2, *ctx3;
+    ln_tensor_entry *te1, *te2, *te3;
+    float input1[INPUT_LEN], input2[INPUT_LEN];
+    float expect1[OUTPUT_LEN], expect2[OUTPUT_LEN];
+    const char *image = LN_TEST_DIR"/data/test_share_weights.img";
+
+    for (int i = 0; i < INPUT_LEN; i++) {
+        input1[i] = (i % 13) / 4.0 - 1.5;
+        input2[i] = (i % 7) / 2.0 - 1.5;
+    }
+
+    ctx1 = shared_context();
+    ck_assert_int_gt(ctx1->weight_sizes[LN_MEM_CPU], 0);
+    ck_assert_int_eq(ln_context_is_weight(ctx1, "conv1_wts"), 1);
+    ck_assert_int_eq(ln_context_is_weight(ctx1, "input"), 0);
+    ln_context_load(ctx1, NULL);
+    ln_context_set_data(ctx1, "input", input1);
+    ln_context_run(ctx1);
+    ln_context_get_data(ctx1, "sigmoid1", expect1);
+    ln_context_set_data(ctx1, "input", input2);
+    ln_context_run(ctx1);
+    ln_context_get_data(ctx1, "sigmoid1", expect2);
+
+    /* weights aligned differently are planned differently */
+    ctx2 = shared_context();
+    ln_context_set_mem_align(ctx2, 256);
+    ck_assert_int_eq(ln_context_can_share_weights(ctx2, ctx1), 0);
+    ln_context_cleanup(ctx2);
+    ln_context_free(ctx2);
+
+    ctx2 = shared_context();
+    ck_assert_int_eq(ln_context_can_share_weights(ctx2, ctx1), 1);
+    ln_context_share_weights(ctx2, ctx1);
+    ln_context_load(ctx2, NULL);
+    te1 = ln_tensor_table_find(ctx1->tensor_table, "conv1_wts");
+    te2 = ln_tensor_table_find(ctx2->tensor_table, "conv1_wts");
+    ck_assert_ptr_eq(te1->tensor->data, te2->tensor->data);
+    te1 = ln_tensor_table_find(ctx1->tensor_table, "input");
+    te2 = ln_tensor_table_find(ctx2->tensor_table, "input");
+    ck_assert_ptr_ne(te1->tensor->data, te2->tensor->data);
+
+    /* the weights conv1 packs are planned in each context, as large as
+       conv1_wts at least */
+    ck_assert_int_eq(ln_context_is_weight(ctx1, "conv1_packed"), 0);
+    te1 = ln_tensor_table_find(ctx1->tensor_table, "conv1_packed");
+    te2 = ln_tensor_table_find(ctx2->tensor_table, "conv1_packed");
+    te3 = ln_tensor_table_find(ctx2->tensor_table, "conv1_wts");
+    ck_assert_ptr_ne(te1->tensor->data, te2->tensor->data);
+    ck_assert_uint_ge(tl_tensor_size(te2->tensor), tl_tensor_size(te3->tensor));
+    ck_assert_uint_ge(ctx2->mem_sizes[LN_MEM_CPU], tl_tensor_size(te2->tensor));
+
+    /* both keep their own inputs and activations */
+    ln_context_set_data(ctx1, "input", input1);
+    check_shared_run(ctx2, input2, expect2);
+    check_shared_run(ctx1, input1, expect1);
+
+    /* the weights stay alive as long as a context uses them */
+    ln_context_save_weights(ctx1, image);
+    ln_context_unload(ctx1);
+    check_shared_run(ctx2, input1, expect1);
+
+    ctx3 = shared_context();
+    ln_context_map_weights(ctx3, image);
+    ln_context_load(ctx3, NULL);
+    te2 = ln_tensor_table_find(ctx2->tensor_table, "conv1_bias");
+    te3 = ln_tensor_table_find(ctx3->tensor_table, "conv1_bias");
+    ck_assert_ptr_ne(te2->tensor->data, te3->tensor->data);
+    ck_assert_int_eq(memcmp(te2->tensor->data, te3->tensor->data,
+                            tl_tensor_size(te2->tensor)), 0);
+    check_shared_run(ctx3, input2, expect2);
+    ln_context_unload(ctx3);
+    ck_assert_int_eq(remove(image), 0);
+
+    ln_context_unload(ctx2);
+    ln_context_cleanup(ctx1);
+    ln_context_free(ctx1);
+    ln_context_cleanup(ctx2);
+    ln_context_free(ctx2);
+    ln_context_cleanup(ctx3);
+    ln_context_free(ctx3);
+}
+LN_TEST_END
+
+static ln_context *run_written_context(void)
+{
+    ln_context *ctx;
+
+    ctx = ln_context_create();
+    ln_context_init(ctx, LN_TEST_DIR"/data/test_run_written.json");
+    ln_context_set_inputs(ctx, "input");
+    ln_context_compile(ctx, "cpu", NULL);
+    return ctx;
+}
+
+static void check_run_written(ln_context *ctx, const float *input,
+                              const int32_t *expect)
+{
+    int32_t res[8];
+
+    ln_context_set_data(ctx, "input", input);
+    ln_context_run(ctx);
+    ln_context_get_data(ctx, "sort_index", res);
+    ck_assert_int_eq(memcmp(res, expect, sizeof(res)), 0);
+}
+
+LN_TEST_START(test_ln_context_share_run_written)
+{
+    ln_context *ctx1, *ctx2, *ctx3;
+    ln_tensor_entry *te1, *te2;
+    float input1[] = {1, 1, 1, 1, 1, 1, 1, 1};
+    float input2[] = {-1, -1, -1, -1, -1, -1, -1, -1};
+    int32_t expect1[] = {6, 4, 2, 0, 1, 3, 5, 7};
+    int32_t expect2[] = {7, 5, 3, 1, 0, 2, 4, 6};
+    const char *image = LN_TEST_DIR"/data/test_run_written.img";
+
+    /* rearange1 and sort1 write index in place in every run */
+    ctx1 = run_written_context();
+    ck_assert_int_eq(ln_context_is_weight(ctx1, "scale"), 1);
+    ck_assert_int_eq(ln_context_is_weight(ctx1, "index"), 0);
+    ck_assert_int_eq(ln_context_is_weight(ctx1, "sort_index"), 0);
+    ln_context_load(ctx1, NULL);
+    ln_context_save_weights(ctx1, image);
+
+    ctx2 = run_written_context();
+    ln_context_share_weights(ctx2, ctx1);
+    ln_context_load(ctx2, NULL);
+    te1 = ln_tensor_table_find(ctx1->tensor_table, "index");
+    te2 = ln_tensor_table_find(ctx2->tensor_table, "index");
+    ck_assert_ptr_ne(te1->tensor->data, te2->tensor->data);
+
+    ctx3 = run_written_context();
+    ln_context_map_weights(ctx3, image);
+    ln_context_load(ctx3, NULL);
+
+    check_run_written(ctx1, input1, expect1);
+    check_run_written(ctx2, input2, expect2);
+    check_run_written(ctx3, input1, expect1);
+    check_run_written(ctx1, input2, expect2);
+    check_run_written(ctx2, input1, expect1);
+
+    ln_context_unload(ctx3);
+    ln_context_unload(ctx2);
+    ln_context_unload(ctx1);
+    ck_assert_int_eq(remove(image), 0);
+    ln_context_cleanup(ctx1);
+    ln_context_free(ctx1);
+    ln_context_cleanup(ctx2);
+    ln_context_free(ctx2);
+    ln_context_cleanup(ctx3);
+    ln_context_free(ctx3);
+}
+LN_TEST_END
+
+/* a context whose weights are in a binary weight file */
+static ln_context *lazy_context(void)
+{
+    ln_context *ctx;
+    ln_op *op;
+
+    ctx = ln_context_create();
+    ln_context_init(ctx, LN_TEST_DIR"/data/test_concurrent.json");
+    ln_context_set_inputs(ctx, "input");
+    op = ln_op_table_find(ctx->op_table, "conv1_wts");
+    ln_param_list_find(op->op_arg->params, "from_file")->value_bool = 1;
+    op = ln_op_table_find(ctx->op_table, "conv1_bias");
+    ln_param_list_find(op->op_arg->params, "from_file")->value_bool = 1;
+    ln_context_compile(ctx, "cpu", NULL);
+    return ctx;
+}
+
+static void write_weight(FILE *fp, ln_context *ctx, const char *name)
+{
+    ln_tensor_entry *te = ln_tensor_table_find(ctx->tensor_table, name);
+    uint32_t name_len = strlen(name), dtype_len = strlen("TL_FLOAT");
+    uint64_t size = tl_tensor_size(te->tensor);
+    char pad[LN_WEIGHT_FILE_ALIGN] = {0};
+
+    fwrite(&name_len, sizeof(name_len), 1, fp);
+    fwrite(&dtype_len, sizeof(dtype_len), 1, fp);
+    fwrite(&size, sizeof(size), 1, fp);
+    fwrite(name, name_len, 1, fp);
+    fwrite("TL_FLOAT", dtype_len, 1, fp);
+    fwrite(pad, -ftell(fp) & (LN_WEIGHT_FILE_ALIGN - 1), 1, fp);
+    fwrite(te->tensor->data, size, 1, fp);
+}
+
+/* kB of the mapping holding `addr` that are in memory of this process */
+static size_t mapped_rss(const void *addr)
+{
+    char line[256];
+    void *start, *end;
+    size_t rss = 0;
+    int found = 0;
+    FILE *fp;
+
+    fp = fopen("/proc/self/smaps", "r");
+    ck_assert_ptr_ne(fp, NULL);
+    while (fgets(line, sizeof(line), fp)) {
+        if (sscanf(line, "%p-%p ", &start, &end) == 2)
+            found = start <= addr && addr < end;
+        else if (found && sscanf(line, "Rss: %zu kB", &rss) == 1)
+            break;
+    }
+    fclose(fp);
+    return rss;
+}
+
+LN_TEST_START(test_ln_context_lazy_weights)
+{
+    ln_context *ctx1, *ctx2, *ctx3;
+    ln_tensor_entry *te1, *te2;
+    float input[INPUT_LEN], expect[OUTPUT_LEN];
+    const char *file = LN_TEST_DIR"/data/test_lazy_weights.wts";
+    const char *image = LN_TEST_DIR"/data/test_lazy_weights.img";
+    uint32_t version = 1, count = 2;
+    FILE *fp;
+
+    for (int i = 0; i < INPUT_LEN; i++)
+        input[i] = (i % 11) / 4.0 - 1.5;
+
+    ctx1 = shared_context();
+    ln_context_load(ctx1, NULL);
+    ln_context_set_data(ctx1, "input", input);
+    ln_context_run(ctx1);
+    ln_context_get_data(ctx1, "sigmoid1", expect);
+    fp = fopen(file, "wb");
+    ck_assert_ptr_ne(fp, NULL);
+    fwrite(LN_WEIGHT_FILE_MAGIC, LN_WEIGHT_FILE_MAGIC_LEN, 1, fp);
+    fwrite(&version, sizeof(version), 1, fp);
+    fwrite(&count, sizeof(count), 1, fp);
+    write_weight(fp, ctx1, "conv1_wts");
+    write_weight(fp, ctx1, "conv1_bias");
+    fclose(fp);
+
+    ctx2 = lazy_context();
+    ln_context_set_lazy_weights(ctx2, 1);
+    ln_context_load(ctx2, file);
+    ck_assert_ptr_ne(ctx2->prefetch, NULL);
+    te1 = ln_tensor_table_find(ctx1->tensor_table, "conv1_wts");
+    te2 = ln_tensor_table_find(ctx2->tensor_table, "conv1_wts");
+    /* loading doesn't touch the mapped weights */
+    ck_assert_int_eq(mapped_rss(te2->tensor->data), 0);
+    ck_assert_int_eq(memcmp(te1->tensor->data, te2->tensor->data,
+                            tl_tensor_size(te1->tensor)), 0);
+    check_shared_run(ctx2, input, expect);
+    check_shared_run(ctx2, input, expect);
+
+    /* the image of lazy weights has the mapped weights too */
+    ln_context_save_weights(ctx2, image);
+    ctx3 = lazy_context();
+    ln_context_map_weights(ctx3, image);
+    ln_context_load(ctx3, NULL);
+    check_shared_run(ctx3, input, expect);
+
+    ln_context_unload(ctx3);
+    ln_context_unload(ctx2);
+    ln_context_unload(ctx1);
+    ck_assert_int_eq(remove(image), 0);
+    ck_assert_int_eq(remove(file), 0);
+    ln_context_cleanup(ctx1);
+    ln_context_free(ctx1);
+    ln_context_cleanup(ctx2);
+    ln_context_free(ctx2);
+    ln_context_cleanup(ctx3);
+    ln_context_free(ctx3);
+}
+LN_TEST_END
+
+#define N_FRAMES 16
+
+static void async_done(ln_context *ctx, void *data)
+{
+    ln_context_get_data(ctx, "sigmoid1", data);
+}
+
+LN_TEST_START(test_ln_context_run_async)
+{
+    ln_context *ctx;
+    float inputs[N_FRAMES][INPUT_LEN];
+    float expect[N_FRAMES][OUTPUT_LEN];
+    float res[N_FRAMES][OUTPUT_LEN];
+    float last[OUTPUT_LEN];
+
+    for (int f = 0; f < N_FRAMES; f++) {
+        for (int i = 0; i < INPUT_LEN; i++)
+            inputs[f][i] = (i * (f + 5) % 23) / 6.0 - 2;
+    }
+
+    ctx = shared_context();
+    ln_context_load(ctx, NULL);
+    for (int f = 0; f < N_FRAMES; f++) {
+        ln_context_set_data(ctx, "input", inputs[f]);
+        ln_context_run(ctx);
+        ln_context_get_data(ctx, "sigmoid1", expect[f]);
+    }
+
+    /* the next frame is set while the previous ones are run */
+    for (int f = 0; f < N_FRAMES; f++) {
+        ln_context_set_data(ctx, "input", inputs[f]);
+        ln_context_run_async(ctx, async_done, res[f]);
+    }
+    ln_context_wait(ctx);
+    for (int f = 0; f < N_FRAMES; f++)
+        ck_assert_int_eq(memcmp(res[f], expect[f], sizeof(res[f])), 0);
+
+    /* unset inputs keep their last data, and get_data waits for the runs */
+    ln_context_run_async(ctx, NULL, NULL);
+    ln_context_get_data(ctx, "sigmoid1", last);
+    ck_assert_int_eq(memcmp(last, expect[N_FRAMES-1], sizeof(last)), 0);
+
+    /* synchronous runs go through the worker as well */
+    check_shared_run(ctx, inputs[3], expect[3]);
+
+    ln_context_unload(ctx);
+    ln_context_cleanup(ctx);
+    ln_context_free(ctx);
+}
+LN_TEST_END
+
+struct reentrant_arg {
+    const float *input;         /* run in the callback */
+    float        res[OUTPUT_LEN];
+    float        inline_res[OUTPUT_LEN];
+};
+
+static void reentrant_done(ln_context *ctx, void *data)
+{
+    struct reentrant_arg *arg = data;
+
+    ln_context_get_data(ctx, "sigmoid1", arg->res);
+    ln_context_set_data(ctx, "input", arg->input);
+    ln_context_run(ctx);
+    ln_context_get_data(ctx, "sigmoid1", arg->inline_res);
+}
+
+LN_TEST_START(test_ln_context_run_async_reentrant)
+{
+    ln_context *ctx;
+    float inputs[N_FRAMES][INPUT_LEN];
+    float expect[N_FRAMES][OUTPUT_LEN];
+    struct reentrant_arg args[N_FRAMES / 2];
+
+    for (int f = 0; f < N_FRAMES; f++) {
+        for (int i = 0; i < INPUT_LEN; i++)
+            inputs[f][i] = (i * (f + 3) % 19) / 5.0 - 2;
+    }
+
+    ctx = shared_context();
+    ln_context_load(ctx, NULL);
+    for (int f = 0; f < N_FRAMES; f++) {
+        ln_context_set_data(ctx, "input", inputs[f]);
+        ln_context_run(ctx);
+        ln_context_get_data(ctx, "sigmoid1", expect[f]);
+    }
+
+    /* callbacks run the context in place on the worker thread, between the
+       submitted runs, which still get their staged inputs */
+    for (int f = 0; f < N_FRAMES / 2; f++) {
+        args[f].input = inputs[f + N_FRAMES / 2];
+        ln_context_set_data(ctx, "input", inputs[f]);
+        ln_context_run_async(ctx, reentrant_done, &args[f]);
+    }
+    ln_context_wait(ctx);
+    for (int f = 0; f < N_FRAMES / 2; f++) {
+        ck_assert_int_eq(memcmp(args[f].res, expect[f], sizeof(args[f].res)),
+                         0);
+        ck_assert_int_eq(memcmp(args[f].inline_res, expect[f + N_FRAMES / 2],
+                                sizeof(args[f].inline_res)), 0);
+    }
+
+    ln_context_unload(ctx);
+    ln_context_cleanup(ctx);
+    ln_context_free(ctx);
+}
+LN_TEST_END
+
+static const ln_op_step *find_step(const ln_context *ctx, const char *opname)
+{
+    const ln_op_step *step;
+
+    for (step = ctx->steps; step->run; step++) {
+        if (ln_streq(step->op_arg->name, opname))
+            return step;
+    }
+    return NULL;
+}
+
+LN_TEST_START(test_ln_context_dirty)
+{
+    ln_context *ctx;
+    ln_tensor_entry *te;
+    float input[] = {1, 2, 3, 4, 5, 6};
+    float weight[] = {-1, -2, -3, -4, -5, -6};
+    float expect1[] = {1, 6, 15, 8, 20, 36};
+    float expect2[] = {-2, -12, -30, -16, -40, -72};
+    float res[6];
+
+    ctx = ln_context_create();
+    ln_context_init(ctx, LN_TEST_DIR"/data/test_dirty.json");
+    ln_context_set_inputs(ctx, "input");
+    ln_context_compile(ctx, "cpu", NULL);
+    ln_context_load(ctx, NULL);
+
+    ck_assert_ptr_ne(find_step(ctx, "transpose1")->ins, NULL);
+
+    ln_context_set_data(ctx, "input", input);
+    ln_context_run(ctx);
+    ln_context_get_data(ctx, "elew1", res);
+    for (int i = 0; i < 6; i++)
+        ck_assert_float_eq(res[i], expect1[i]);
+
+    /* transpose1 is skipped while its weight is clean, so its poked data
+       stays */
+    te = ln_tensor_table_find(ctx->tensor_table, "transpose1");
+    memset(te->tensor->data, 0, sizeof(res));
+    for (int i = 0; i < 6; i++)
+        input[i] *= 2;
+    ln_context_set_data(ctx, "input", input);
+    ln_context_run(ctx);
+    ln_context_get_data(ctx, "elew1", res);
+    for (int i = 0; i < 6; i++)
+        ck_assert_float_eq(res[i], 0);
+
+    /* setting the weight re-runs it */
+    ln_context_set_data(ctx, "weight", weight);
+    ln_context_run(ctx);
+    ln_context_get_data(ctx, "elew1", res);
+    for (int i = 0; i < 6; i++)
+        ck_assert_float_eq(res[i], expect2[i]);
+
+    ln_context_unload(ctx);
+    ln_context_cleanup(ctx);
+    ln_context_free(ctx);
+}
+LN_TEST_END
+
+LN_TEST_START(test_ln_context_conv_weight)
+{
+    ln_context *ctx1, *ctx2;
+    float input[INPUT_LEN], weight[4 * 3 * 3 * 3], negated[4 * 3 * 3 * 3];
+    float expect1[OUTPUT_LEN], expect2[OUTPUT_LEN];
+
+    for (int i = 0; i < INPUT_LEN; i++)
+        input[i] = (i % 13) / 4.0 - 1.5;
+
+    ctx1 = shared_context();
+    ln_context_load(ctx1, NULL);
+    ln_context_get_data(ctx1, "conv1_wts", weight);
+    for (int i = 0; i < 4 * 3 * 3 * 3; i++)
+        negated[i] = -weight[i];
+    ln_context_set_data(ctx1, "input", input);
+    ln_context_run(ctx1);
+    ln_context_get_data(ctx1, "sigmoid1", expect1);
+
+    /* a context packing the negated weights on its first run */
+    ctx2 = shared_context();
+    ln_context_load(ctx2, NULL);
+    ln_context_set_data(ctx2, "conv1_wts", negated);
+    ln_context_set_data(ctx2, "input", input);
+    ln_context_run(ctx2);
+    ln_context_get_data(ctx2, "sigmoid1", expect2);
+    ck_assert_int_ne(memcmp(expect1, expect2, sizeof(expect1)), 0);
+    ln_context_unload(ctx2);
+    ln_context_cleanup(ctx2);
+    ln_context_free(ctx2);
+
+    /* conv1 repacks its weight once it is set after the first run */
+    ln_context_set_data(ctx1, "conv1_wts", negated);
+    check_shared_run(ctx1, input, expect2);
+
+    /* and after a reload, which loads the original weights again */
+    ln_context_unload(ctx1);
+    ln_context_load(ctx1, NULL);
+    check_shared_run(ctx1, input, expect1);
+    ln_context_set_data(ctx1, "conv1_wts", negated);
+    check_shared_run(ctx1, input, expect2);
+
+    ln_context_unload(ctx1);
+    ln_context_cleanup(ctx1);
+    ln_context_free(ctx1);
+}
+LN_TEST_END
+
+LN_TEST_START(test_ln_context_cached_param)
+{
+    ln_context *ctx;
+    float input[] = {1, 1, 1, 1, 1, 1};
+    float expect1[] = {0, -1, -2, 3, 5, 7};
+    float expect2[] = {0.5, 0, -0.5, 3, 5, 7};
+    float res[6];
+
+    ctx = ln_context_create();
+    ln_context_init(ctx, LN_TEST_DIR"/data/test_cached_param.json");
+    ln_context_set_inputs(ctx, "input");
+    ln_context_compile(ctx, "cpu", NULL);
+    ln_context_load(ctx, NULL);
+
+    ck_assert_ptr_ne(find_step(ctx, "lrelu1")->ins, NULL);
+    /* fprint1 is only there for its side effect */
+    ck_assert_ptr_eq(find_step(ctx, "fprint1")->ins, NULL);
+
+    ln_context_set_data(ctx, "input", input);
+    ln_context_run(ctx);
+    ln_context_get_data(ctx, "elew1", res);
+    for (int i = 0; i < 6; i++)
+        ck_assert_float_eq(res[i], expect1[i]);
+
+    /* lrelu1's inputs are clean, but its param changed */
+    remove("test_cached_param.txt");
+    ln_context_set_param(ctx, "lrelu1", "negslope", 0.25);
+    ln_context_run(ctx);
+    ln_context_get_data(ctx, "elew1", res);
+    for (int i = 0; i < 6; i++)
+        ck_assert_float_eq(res[i], expect2[i]);
+    ck_assert_int_eq(access("test_cached_param.txt", F_OK), 0);
+    remove("test_cached_param.txt");
+
+    ln_context_unload(ctx);
+    ln_context_cleanup(ctx);
+    ln_context_free(ctx);
+}
+LN_TEST_END
+
+LN_TEST_START(test_ln_context_data_ptr)
+{
+    ln_context *ctx;
+    float input[] = {1, -2, 3, -4, 5, -6};
+    float expect[] = {1, 0, 3, 0, 5, 0};
+    int dims[2];
+    float *res;
+
+    ctx = ln_context_create();
+    ln_context_init(ctx, LN_TEST_DIR"/data/test_batch.json");
+    ln_context_set_batch(ctx, "input", 2);
+    ln_context_compile(ctx, "cpu", NULL);
+    ck_assert_int_eq(ln_context_data_shape(ctx, "input", NULL), 3);
+    ck_assert_int_eq(ln_context_data_shape(ctx, "relu2", dims), 2);
+    ck_assert_array_int_eq(dims, ck_array(int, 2, 6), 2);
+    ck_assert_str_eq(ln_context_data_dtype(ctx, "relu2"), "TL_FLOAT");
+
+    ln_context_load(ctx, NULL);
+    ln_context_set_frame(ctx, "input", 0, input);
+    ln_context_set_frame(ctx, "input", 1, input);
+    ln_context_run(ctx);
+    res = ln_context_data_ptr(ctx, "relu2");
+    ck_assert_ptr_ne(res, NULL);
+    for (int i = 0; i < 12; i++)
+        ck_assert_float_eq(res[i], expect[i % 6]);
+
+    ln_context_unload(ctx);
+    ln_context_cleanup(ctx);
+    ln_context_free(ctx);
+}
+LN_TEST_END
+
+static ln_pass_stat *find_pass_stat(ln_context *ctx, const char *name)
+{
+    ln_pass_stat *stat;
+
+    LN_LIST_FOREACH(stat, ctx->pass_stats) {
+        if (ln_streq(stat->name, name))
+            return stat;
+    }
+    return NULL;
+}
+
+LN_TEST_START(test_ln_context_time_passes)
+{
+    ln_context *ctx;
+    ln_pass_stat *stat;
+
+    ctx = ln_context_create();
+    ln_context_init(ctx, LN_TEST_DIR"/data/test_batch.json");
+    ln_context_compile(ctx, "cpu", NULL);
+    ck_assert_ptr_eq(ctx->pass_stats, NULL);
+    ln_context_cleanup(ctx);
+    ln_context_free(ctx);
+
+    ctx = ln_context_create();
+    ln_context_init(ctx, LN_TEST_DIR"/data/test_batch.json");
+    ln_context_set_time_passes(ctx, 1);
+    ln_context_compile(ctx, "cpu", NULL);
+
+    stat = ctx->pass_stats->data;
+    ck_assert_str_eq(stat->name, "total");
+    ck_assert_int_eq(stat->runs, 1);
+    ck_assert(stat->time >= 0);
+    ck_assert_uint_gt(stat->lookups, 0);
+
+    stat = find_pass_stat(ctx, "mem_plan");
+    ck_assert_ptr_ne(stat, NULL);
+    ck_assert_int_eq(stat->runs, 1);
+    ck_assert_uint_gt(stat->max_ops, 0);
+    ck_assert_ptr_ne(find_pass_stat(ctx, "expander"), NULL);
+    ck_assert_ptr_ne(find_pass_stat(ctx, "combiner"), NULL);
+
+    ln_context_cleanup(ctx);
+    ln_context_free(ctx);
+}
+LN_TEST_END
+
+LN_TEST_TCASE_START(context, checked_setup, checked_teardown)
+{
+    LN_TEST_ADD_TEST(test_ln_context_set_batch);
+    LN_TEST_ADD_TEST(test_ln_context_concurrent);
+    LN_TEST_ADD_TEST(test_ln_context_share_weights);
+    LN_TEST_ADD_TEST(test_ln_context_share_run_written);
+    LN_TEST_ADD_TEST(test_ln_context_lazy_weights);
+    LN_TEST_ADD_TEST(test_ln_context_run_async);
+    LN_TEST_ADD_TEST(test_ln_context_run_async_reentrant);
+    LN_TEST_ADD_TEST(test_ln_context_dirty);
+    LN_TEST_ADD_TEST(test_ln_context_conv_weight);
+    LN_TEST_ADD_TEST(test_ln_context_cached_param);
+    LN_TEST_ADD_TEST(test_ln_context_time_passes);
+    LN_TEST_ADD_TEST(test_ln_context_data_ptr);
+}
+LN_TEST_TCASE_END
+
+LN_TEST_ADD_TCASE(context);
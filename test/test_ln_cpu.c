@@ -0,0 +1,391 @@
+/*
+ * Copyright (c) 2018-2020 Zhixu Zhao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <stdlib.h>
+#include <check.h>
+#include <tensorlight/tl_check.h>
+#include "lightnettest/ln_test.h"
+#include "arch/ln_cpu.h"
+
+static void checked_setup(void)
+{
+}
+
+static void checked_teardown(void)
+{
+}
+
+static float *random_floats(size_t n)
+{
+    float *data = ln_alloc(sizeof(float) * n);
+
+    for (size_t i = 0; i < n; i++)
+        data[i] = (float)rand() / RAND_MAX - 0.5;
+    return data;
+}
+
+static void naive_transpose(const void *src, void *dst, int ndim,
+                            const int *dims, const int *axes, size_t size)
+{
+    int coord[LN_CPU_MAXDIM], dst_dims[LN_CPU_MAXDIM];
+    size_t len = 1, si, di;
+
+    for (int i = 0; i < ndim; i++) {
+        dst_dims[i] = dims[axes[i]];
+        len *= dims[i];
+    }
+    for (di = 0; di < len; di++) {
+        size_t t = di;
+        for (int i = ndim - 1; i >= 0; i--) {
+            coord[axes[i]] = t % dst_dims[i];
+            t /= dst_dims[i];
+        }
+        si = 0;
+        for (int i = 0; i < ndim; i++)
+            si = si * dims[i] + coord[i];
+        memcpy((char *)dst + di * size, (const char *)src + si * size, size);
+    }
+}
+
+static void naive_sgemm(int m, int n, int k, float alpha,
+                        const float *a, int rsa, int csa,
+                        const float *b, int rsb, int csb, float beta,
+                        float *c, int rsc, int csc)
+{
+    for (int i = 0; i < m; i++) {
+        for (int j = 0; j < n; j++) {
+            double sum = 0;
+            for (int p = 0; p < k; p++)
+                sum += a[i * rsa + p * csa] * b[p * rsb + j * csb];
+            c[i * rsc + j * csc] = alpha * sum + beta * c[i * rsc + j * csc];
+        }
+    }
+}
+
+#define PARALLEL_N 37
+#define NESTED_N 3
+
+static void mark_nested(void *arg, int id, int n)
+{
+    int *marks = arg;
+
+    ck_assert_int_eq(n, NESTED_N);
+    __sync_fetch_and_add(&marks[id], 1);
+}
+
+/* each share marks itself, and share 1 runs a nested parallel job */
+static void mark_share(void *arg, int id, int n)
+{
+    int *marks = arg;
+
+    ck_assert_int_eq(n, PARALLEL_N);
+    __sync_fetch_and_add(&marks[id], 1);
+    if (id == 1)
+        ln_cpu_run_parallel(NESTED_N, mark_nested, marks + PARALLEL_N);
+}
+
+LN_TEST_START(test_ln_cpu_run_parallel)
+{
+    int marks[PARALLEL_N + NESTED_N];
+
+    /* the pool of workers is reused across jobs */
+    for (int t = 0; t < 100; t++) {
+        memset(marks, 0, sizeof(marks));
+        ln_cpu_run_parallel(PARALLEL_N, mark_share, marks);
+        for (int i = 0; i < PARALLEL_N + NESTED_N; i++)
+            ck_assert_int_eq(marks[i], 1);
+    }
+}
+LN_TEST_END
+
+static const int gemm_shapes[][3] = {
+    {1, 1, 1}, {5, 7, 3}, {17, 33, 300}, {130, 9, 513}, {300, 260, 70},
+};
+
+LN_TEST_START(test_ln_cpu_sgemm)
+{
+    for (size_t t = 0; t < sizeof(gemm_shapes) / sizeof(gemm_shapes[0]); t++) {
+        int m = gemm_shapes[t][0], n = gemm_shapes[t][1], k = gemm_shapes[t][2];
+        float *a = random_floats(m * k);
+        float *b = random_floats(k * n);
+        float *c = random_floats(m * n);
+        float *c_true = ln_clone(c, sizeof(float) * m * n);
+
+        /* row-major A, transposed B, column-major C */
+        naive_sgemm(m, n, k, 1.5, a, k, 1, b, 1, k, 0.5, c_true, 1, m);
+        ln_cpu_sgemm(m, n, k, 1.5, a, k, 1, b, 1, k, 0.5, c, 1, m);
+        for (int i = 0; i < m * n; i++)
+            ck_assert_float_eq_tol(c[i], c_true[i], 1e-4);
+
+        ln_free(a);
+        ln_free(b);
+        ln_free(c);
+        ln_free(c_true);
+    }
+}
+LN_TEST_END
+
+LN_TEST_START(test_ln_cpu_sgemm_packed)
+{
+    for (size_t t = 0; t < sizeof(gemm_shapes) / sizeof(gemm_shapes[0]); t++) {
+        int m = gemm_shapes[t][0], n = gemm_shapes[t][1], k = gemm_shapes[t][2];
+        float *a = random_floats(m * k);
+        float *b = random_floats(k * n);
+        float *c = ln_alloc(sizeof(float) * m * n);
+        float *c_true = ln_alloc(sizeof(float) * m * n);
+        float *packed_b = ln_alloc(ln_cpu_sgemm_pack_b_size(k, n));
+
+        ln_cpu_sgemm_pack_b(k, n, b, n, 1, packed_b);
+        naive_sgemm(m, n, k, 1, a, k, 1, b, n, 1, 0, c_true, n, 1);
+        ln_cpu_sgemm_packed(m, n, k, 1, a, k, 1, packed_b, 0, c, n, 1);
+        for (int i = 0; i < m * n; i++)
+            ck_assert_float_eq_tol(c[i], c_true[i], 1e-4);
+
+        ln_free(a);
+        ln_free(b);
+        ln_free(c);
+        ln_free(c_true);
+        ln_free(packed_b);
+    }
+}
+LN_TEST_END
+
+LN_TEST_START(test_ln_cpu_sdot)
+{
+    size_t n = 1000003;
+    float *x = random_floats(n);
+    float *y = random_floats(n);
+    double sum = 0;
+
+    for (size_t i = 0; i < n; i++)
+        sum += x[i] * y[i];
+    ck_assert_float_eq_tol(ln_cpu_sdot(n, x, y), sum, 1e-2);
+    ck_assert_float_eq_tol(ln_cpu_sdot(7, x, y),
+                           x[0]*y[0] + x[1]*y[1] + x[2]*y[2] + x[3]*y[3] +
+                           x[4]*y[4] + x[5]*y[5] + x[6]*y[6], 1e-6);
+
+    ln_free(x);
+    ln_free(y);
+}
+LN_TEST_END
+
+LN_TEST_START(test_ln_cpu_selew_chain)
+{
+    size_t n = 1003;
+    float *x = random_floats(n);
+    float *y = random_floats(n);
+    float *dst = ln_alloc(sizeof(float) * n);
+    const float *srcs[] = {x, y};
+    ln_cpu_ew_inst prog[] = {
+        {LN_CPU_EW_SIGMOID, 0, 0},
+        {LN_CPU_EW_MUL, 0, 0},
+        {LN_CPU_EW_RSUB, 1, 0},
+        {LN_CPU_EW_LRELU, 0, 0.1},
+        {LN_CPU_EW_MAX, -1, 0},
+        {LN_CPU_EW_ADD, 1, 0},
+    };
+    float r;
+
+    ln_cpu_selew_chain(n, srcs, dst, prog, sizeof(prog) / sizeof(prog[0]));
+    for (size_t i = 0; i < n; i++) {
+        r = x[i] / (1 + expf(-x[i]));
+        r = y[i] - r;
+        r = r > 0 ? r : r * 0.1f;
+        r = r + y[i];
+        ck_assert_float_eq_tol(dst[i], r, 1e-5);
+    }
+
+    /* in place */
+    ln_cpu_selew_chain(n, srcs, x, prog, sizeof(prog) / sizeof(prog[0]));
+    for (size_t i = 0; i < n; i++)
+        ck_assert_float_eq_tol(x[i], dst[i], 1e-6);
+
+    ln_free(x);
+    ln_free(y);
+    ln_free(dst);
+}
+LN_TEST_END
+
+LN_TEST_START(test_ln_cpu_transpose)
+{
+    struct {
+        int ndim;
+        int dims[LN_CPU_MAXDIM];
+        int axes[LN_CPU_MAXDIM];
+    } cases[] = {
+        {2, {37, 53}, {1, 0}},
+        {4, {2, 19, 7, 9}, {0, 2, 3, 1}},
+        {4, {3, 5, 6, 7}, {2, 0, 3, 1}},
+        {5, {1, 4, 6, 5, 3}, {0, 2, 1, 3, 4}},
+        {4, {1, 8, 1, 33}, {3, 2, 0, 1}},
+        {3, {4, 5, 6}, {0, 1, 2}},
+        {3, {64, 1, 70}, {2, 1, 0}},
+    };
+    size_t sizes[] = {1, 2, 4, 8};
+    size_t len, nbytes;
+    uint8_t *src, *dst, *ref;
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        len = 1;
+        for (int i = 0; i < cases[c].ndim; i++)
+            len *= cases[c].dims[i];
+        for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+            nbytes = len * sizes[s];
+            src = ln_alloc(nbytes);
+            dst = ln_alloc(nbytes);
+            ref = ln_alloc(nbytes);
+            for (size_t i = 0; i < nbytes; i++)
+                src[i] = rand();
+            ln_cpu_transpose(src, dst, cases[c].ndim, cases[c].dims,
+                             cases[c].axes, sizes[s]);
+            naive_transpose(src, ref, cases[c].ndim, cases[c].dims,
+                            cases[c].axes, sizes[s]);
+            ck_assert_int_eq(memcmp(dst, ref, nbytes), 0);
+            ln_free(src);
+            ln_free(dst);
+            ln_free(ref);
+        }
+    }
+}
+LN_TEST_END
+
+LN_TEST_START(test_ln_cpu_stopk)
+{
+    size_t n = 1000;
+    size_t ks[] = {1, 64, 999, 1000, 2000};
+    float *key, *dst_key, *ref_key;
+    int32_t *val, *dst_val, *ref_val;
+    size_t i, j, k;
+    float kt;
+    int32_t vt;
+
+    key = ln_alloc(sizeof(float) * n);
+    val = ln_alloc(sizeof(int32_t) * n);
+    dst_key = ln_alloc(sizeof(float) * n);
+    dst_val = ln_alloc(sizeof(int32_t) * n);
+    ref_key = ln_alloc(sizeof(float) * n);
+    ref_val = ln_alloc(sizeof(int32_t) * n);
+    for (i = 0; i < n; i++) {
+        key[i] = rand() % 97 - 48;
+        val[i] = i;
+    }
+
+    for (int desc = 0; desc < 2; desc++) {
+        /* stable insertion sort as the reference */
+        for (i = 0; i < n; i++) {
+            kt = key[i];
+            vt = val[i];
+            for (j = i; j > 0 && (desc ? ref_key[j - 1] < kt :
+                                  ref_key[j - 1] > kt); j--) {
+                ref_key[j] = ref_key[j - 1];
+                ref_val[j] = ref_val[j - 1];
+            }
+            ref_key[j] = kt;
+            ref_val[j] = vt;
+        }
+        for (size_t c = 0; c < sizeof(ks) / sizeof(ks[0]); c++) {
+            k = ks[c] < n ? ks[c] : n;
+            ln_cpu_stopk(n, key, val, ks[c], desc, dst_key, dst_val);
+            for (i = 0; i < k; i++) {
+                ck_assert_float_eq(dst_key[i], ref_key[i]);
+                ck_assert_int_eq(dst_val[i], ref_val[i]);
+            }
+        }
+
+        /* in place, without values */
+        memcpy(dst_key, key, sizeof(float) * n);
+        ln_cpu_stopk(n, dst_key, NULL, n, desc, dst_key, NULL);
+        for (i = 0; i < n; i++)
+            ck_assert_float_eq(dst_key[i], ref_key[i]);
+    }
+
+    ln_free(key);
+    ln_free(val);
+    ln_free(dst_key);
+    ln_free(dst_val);
+    ln_free(ref_key);
+    ln_free(ref_val);
+}
+LN_TEST_END
+
+LN_TEST_START(test_ln_cpu_im2col)
+{
+    int c = 3, h = 7, w = 6, oc = 5;
+    int size[] = {3, 2};
+    int stride[] = {2, 1};
+    int padding[] = {1, 0, 1, 1};
+    int dilation[] = {1, 2};
+    int oh = (h + padding[0] + padding[2] - dilation[0] * (size[0] - 1) - 1) /
+        stride[0] + 1;
+    int ow = (w + padding[1] + padding[3] - dilation[1] * (size[1] - 1) - 1) /
+        stride[1] + 1;
+    int k = c * size[0] * size[1];
+    float *src = random_floats(c * h * w);
+    float *weight = random_floats(oc * k);
+    float *col = ln_alloc(sizeof(float) * k * oh * ow);
+    float *dst = ln_alloc(sizeof(float) * oc * oh * ow);
+
+    ln_cpu_im2col(src, c, h, w, size, stride, padding, dilation, oh, ow, col);
+    ln_cpu_sgemm(oc, oh * ow, k, 1, weight, k, 1, col, oh * ow, 1, 0,
+                 dst, oh * ow, 1);
+    for (int o = 0; o < oc; o++) {
+        for (int y = 0; y < oh; y++) {
+            for (int x = 0; x < ow; x++) {
+                double sum = 0;
+                for (int i = 0; i < c; i++) {
+                    for (int kh = 0; kh < size[0]; kh++) {
+                        for (int kw = 0; kw < size[1]; kw++) {
+                            int iy = y * stride[0] - padding[0] + kh * dilation[0];
+                            int ix = x * stride[1] - padding[1] + kw * dilation[1];
+                            if (iy < 0 || iy >= h || ix < 0 || ix >= w)
+                                continue;
+                            sum += src[(i * h + iy) * w + ix] *
+                                weight[((o * c + i) * size[0] + kh) * size[1] + kw];
+                        }
+                    }
+                }
+                ck_assert_float_eq_tol(dst[(o * oh + y) * ow + x], sum, 1e-4);
+            }
+        }
+    }
+
+    ln_free(src);
+    ln_free(weight);
+    ln_free(col);
+    ln_free(dst);
+}
+LN_TEST_END
+
+LN_TEST_TCASE_START(cpu, checked_setup, checked_teardown)
+{
+    LN_TEST_ADD_TEST(test_ln_cpu_run_parallel);
+    LN_TEST_ADD_TEST(test_ln_cpu_sgemm);
+    LN_TEST_ADD_TEST(test_ln_cpu_sgemm_packed);
+    LN_TEST_ADD_TEST(test_ln_cpu_sdot);
+    LN_TEST_ADD_TEST(test_ln_cpu_selew_chain);
+    LN_TEST_ADD_TEST(test_ln_cpu_transpose);
+    LN_TEST_ADD_TEST(test_ln_cpu_stopk);
+    LN_TEST_ADD_TEST(test_ln_cpu_im2col);
+}
+LN_TEST_TCASE_END
+
+LN_TEST_ADD_TCASE(cpu);
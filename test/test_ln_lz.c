@@ -0,0 +1,124 @@
+/*
+ * Copyright (c) 2018-2020 Zhixu Zhao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <check.h>
+#include <tensorlight/tl_check.h>
+#include "lightnettest/ln_test.h"
+#include "ln_lz.h"
+
+static void checked_setup(void)
+{
+}
+
+static void checked_teardown(void)
+{
+}
+
+static size_t round_trip(const void *src, size_t size)
+{
+    size_t cap = ln_lz_compress_bound(size), packed_size;
+    char *packed = ln_alloc(cap);
+    char *res = ln_alloc(size + 1);
+
+    packed_size = ln_lz_compress(src, size, packed, cap);
+    ck_assert_uint_gt(packed_size, 0);
+    ck_assert_uint_le(packed_size, cap);
+    ck_assert_int_eq(ln_lz_decompress(packed, packed_size, res, size), 0);
+    ck_assert_int_eq(memcmp(src, res, size), 0);
+    /* a wrong size is an error */
+    ck_assert_int_eq(ln_lz_decompress(packed, packed_size, res, size + 1), -1);
+    if (size > 0)
+        ck_assert_int_eq(ln_lz_decompress(packed, packed_size, res, size - 1),
+                         -1);
+    ln_free(packed);
+    ln_free(res);
+    return packed_size;
+}
+
+LN_TEST_START(test_ln_lz_round_trip)
+{
+    size_t size = 1 << 20;
+    unsigned char *buf = ln_alloc(size);
+    float *fbuf = (float *)buf;
+    unsigned seed = 1;
+
+    for (size_t n = 0; n < 40; n++) {
+        for (size_t i = 0; i < n; i++)
+            buf[i] = i % 3;
+        round_trip(buf, n);
+    }
+
+    memset(buf, 0, size);
+    ck_assert_uint_lt(round_trip(buf, size), size / 200);
+
+    for (size_t i = 0; i < size; i++)
+        buf[i] = rand_r(&seed);
+    ck_assert_uint_le(round_trip(buf, size), ln_lz_compress_bound(size));
+
+    for (size_t i = 0; i < size / sizeof(float); i++)
+        fbuf[i] = i % 1000 < 700 ? 0 : (float)(i % 7) / 3;
+    ck_assert_uint_lt(round_trip(buf, size), size / 4);
+
+    for (size_t i = 0; i < size; i++)
+        buf[i] = "lightnet"[i % 8] + (i % 4099 == 0);
+    ck_assert_uint_lt(round_trip(buf, size), size / 20);
+
+    ln_free(buf);
+}
+LN_TEST_END
+
+LN_TEST_START(test_ln_lz_decompress_corrupt)
+{
+    unsigned char buf[64];
+    /* literal "ab", then a match of 4 at offset 2, then literal "c" */
+    unsigned char good[] = {0x20, 'a', 'b', 0x02, 0x00, 0x10, 'c'};
+    unsigned char bad_offset[] = {0x20, 'a', 'b', 0x03, 0x00, 0x10, 'c'};
+    unsigned char zero_offset[] = {0x20, 'a', 'b', 0x00, 0x00, 0x10, 'c'};
+    unsigned char short_literal[] = {0x50, 'a', 'b'};
+    unsigned char short_offset[] = {0x20, 'a', 'b', 0x02};
+    unsigned char short_length[] = {0xf0, 255};
+
+    ck_assert_int_eq(ln_lz_decompress(good, sizeof(good), buf, 7), 0);
+    ck_assert_int_eq(memcmp(buf, "abababc", 7), 0);
+    ck_assert_int_eq(ln_lz_decompress(good, sizeof(good), buf, 6), -1);
+    ck_assert_int_eq(ln_lz_decompress(bad_offset, sizeof(bad_offset), buf, 7),
+                     -1);
+    ck_assert_int_eq(ln_lz_decompress(zero_offset, sizeof(zero_offset), buf, 7),
+                     -1);
+    ck_assert_int_eq(ln_lz_decompress(short_literal, sizeof(short_literal),
+                                      buf, 5), -1);
+    ck_assert_int_eq(ln_lz_decompress(short_offset, sizeof(short_offset),
+                                      buf, 6), -1);
+    ck_assert_int_eq(ln_lz_decompress(short_length, sizeof(short_length),
+                                      buf, sizeof(buf)), -1);
+    ck_assert_uint_eq(ln_lz_compress(good, sizeof(good), buf, 8), 0);
+}
+LN_TEST_END
+
+LN_TEST_TCASE_START(lz, checked_setup, checked_teardown)
+{
+    LN_TEST_ADD_TEST(test_ln_lz_round_trip);
+    LN_TEST_ADD_TEST(test_ln_lz_decompress_corrupt);
+}
+LN_TEST_TCASE_END
+
+LN_TEST_ADD_TCASE(lz);
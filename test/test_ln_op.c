@@ -276,6 +276,25 @@ LN_TEST_START(test_ln_op_list_do_run)
 }
 LN_TEST_END
 
+LN_TEST_START(test_ln_op_list_flatten_run)
+{
+    ln_op_step *steps;
+    int count = run_count;
+
+    opimpl1.run = NULL;
+    steps = ln_op_list_flatten_run(test_op_list);
+    opimpl1.run = run1;
+    ck_assert_ptr_eq(steps[0].run, run0);
+    ck_assert_ptr_eq(steps[0].op_arg, &op_arg0);
+    ck_assert_ptr_eq(steps[1].run, run2);
+    ck_assert_ptr_eq(steps[1].op_arg, &op_arg2);
+    ck_assert_ptr_eq(steps[2].run, NULL);
+    ln_op_steps_do_run(steps);
+    ck_assert_int_eq(run_count, count + 2);
+    ln_free(steps);
+}
+LN_TEST_END
+
 LN_TEST_START(test_ln_op_list_do_post_run)
 {
     ln_op_list_do_post_run(test_op_list);
@@ -296,6 +315,7 @@ LN_TEST_TCASE_START(op, checked_setup, checked_teardown)
     LN_TEST_ADD_TEST(test_ln_op_list_do_pre_run);
     LN_TEST_ADD_TEST(test_ln_op_list_do_static_run);
     LN_TEST_ADD_TEST(test_ln_op_list_do_run);
+    LN_TEST_ADD_TEST(test_ln_op_list_flatten_run);
     LN_TEST_ADD_TEST(test_ln_op_list_do_post_run);
 }
 LN_TEST_TCASE_END
@@ -244,9 +244,107 @@ LN_TEST_START(test_ln_parse)
 }
 LN_TEST_END
 
+/* keys out of order, comments, escapes and unknown keys */
+static const char *stream_json_str = "\
+{\n\
+    // ops come before the sizes\n\
+    \"ops\": [\n\
+        {\n\
+            \"params\": [\n\
+                {\"value\": [true, false], \"arg_name\": \"flags\"},\n\
+                {\"arg_name\": \"msg\", \"value\": \"a\\\"b\\n\\u00e9\"},\n\
+                {\"arg_name\": \"names\", \"value\": [\"x\", \"y\"]},\n\
+                {\"arg_name\": \"none\", \"value\": null},\n\
+                {\"arg_name\": \"ran\", \"value\": [-1.5e1, 2]}\n\
+            ],\n\
+            \"tensors_out\": [{\"dims\": [2, 3], \"arg_name\": \"dst\",\n\
+                             \"name\": \"t1\", \"offset_h\": 1,\n\
+                             \"offset_l\": 8}],\n\
+            \"tensors_in\": [],\n\
+            \"optype\": \"create\", /* after\n\
+                                       the params */\n\
+            \"name\": \"op1\",\n\
+            \"extra\": {\"nested\": [1, {\"a\": null}]}\n\
+        }\n\
+    ],\n\
+    \"inputs\": \"t1\",\n";
+
+LN_TEST_START(test_ln_json_fparse)
+{
+    ln_context *stream_ctx;
+    ln_param_entry *pe;
+    ln_tensor_list_entry *tle;
+    ln_list *ops;
+    ln_op *op;
+    char *str;
+    size_t size;
+    FILE *fp;
+    int i;
+
+    fp = open_memstream(&str, &size);
+    fputs(stream_json_str, fp);
+    for (i = 0; i < 2; i++) {
+        fprintf(fp, "    \"%s_h\": [", i ? "weight_sizes" : "mem_sizes");
+        for (int j = 0; j < LN_MEM_TYPE_SIZE; j++)
+            fprintf(fp, "%s%d", j ? ", " : "", i);
+        fprintf(fp, "],\n    \"%s_l\": [", i ? "weight_sizes" : "mem_sizes");
+        for (int j = 0; j < LN_MEM_TYPE_SIZE; j++)
+            fprintf(fp, "%s%d", j ? ", " : "", j + 1);
+        fprintf(fp, "]%s\n", i ? "" : ",");
+    }
+    fputs("}\n", fp);
+    fclose(fp);
+
+    stream_ctx = ln_context_create();
+    fp = fmemopen(str, strlen(str), "r");
+    ops = ln_json_fparse(fp, stream_ctx);
+    fclose(fp);
+
+    ck_assert_int_eq(ln_list_length(ops), 1);
+    ck_assert_ptr_eq(stream_ctx->ops, ops);
+    op = ops->data;
+    assert_op_eq(op, "create", "op1");
+    ck_assert_int_eq(ln_list_length(TENSORS_IN), 0);
+    tle = TENSORS_OUT->data;
+    ck_assert_str_eq(tle->arg_name, "dst");
+    ck_assert_str_eq(tle->name, "t1");
+    ck_assert_uint_eq(tle->offset, (1UL << 32) + 8);
+
+    pe = ln_param_list_find(PARAMS, "flags");
+    ck_assert_int_eq(pe->type, LN_PARAM_ARRAY_BOOL);
+    ck_assert_int_eq(pe->array_len, 2);
+    ck_assert_int_eq(pe->value_array_bool[0], LN_TRUE);
+    ck_assert_int_eq(pe->value_array_bool[1], LN_FALSE);
+    pe = ln_param_list_find(PARAMS, "msg");
+    ck_assert_int_eq(pe->type, LN_PARAM_STRING);
+    ck_assert_str_eq(pe->value_string, "a\"b\n\xc3\xa9");
+    pe = ln_param_list_find(PARAMS, "names");
+    ck_assert_int_eq(pe->type, LN_PARAM_ARRAY_STRING);
+    ck_assert_str_eq(pe->value_array_string[0], "x");
+    ck_assert_str_eq(pe->value_array_string[1], "y");
+    pe = ln_param_list_find(PARAMS, "none");
+    ck_assert_int_eq(pe->type, LN_PARAM_NULL);
+    pe = ln_param_list_find(PARAMS, "ran");
+    ck_assert_int_eq(pe->type, LN_PARAM_ARRAY_NUMBER);
+    ck_assert_array_int_eq(pe->value_array_int, ARR(int,-15,2), 2);
+
+    ck_assert_str_eq(stream_ctx->inputs, "t1");
+    for (i = 0; i < LN_MEM_TYPE_SIZE; i++) {
+        ck_assert_uint_eq(stream_ctx->mem_sizes[i], i + 1);
+        ck_assert_uint_eq(stream_ctx->weight_sizes[i], (1UL << 32) + i + 1);
+    }
+
+    ln_op_list_free_lists_too(ops);
+    stream_ctx->ops = NULL;
+    ln_context_free(stream_ctx);
+    free(str);
+}
+LN_TEST_END
+
 LN_TEST_TCASE_START(parse, checked_setup, checked_teardown)
 {
     LN_TEST_ADD_TEST(test_ln_parse);
+    LN_TEST_ADD_TEST(test_ln_json_fparse);
 }
 LN_TEST_TCASE_END
 
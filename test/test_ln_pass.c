@@ -342,10 +342,350 @@ LN_TEST_START(test_ln_pass_mem)
 }
 LN_TEST_END
 
+LN_TEST_START(test_ln_pass_mem_inplace)
+{
+    ln_context *ctx_inplace;
+    char *json_str_inplace;
+    ln_tensor_entry *te;
+    size_t relu1_offset, lrelu1_offset;
+
+    ctx_inplace = ln_context_create();
+    json_str_inplace = ln_read_text(LN_TEST_DIR"/data/test_inplace.json");
+    ln_json_parse(json_str_inplace, ctx_inplace);
+    ln_context_init_ops(ctx_inplace);
+
+    ln_pass_mem_plan(ctx_inplace);
+
+    /* static src, not in-place */
+    te = ln_tensor_table_find(ctx_inplace->tensor_table, "relu1");
+    ck_assert_ptr_eq(te->owner, NULL);
+    relu1_offset = te->offset;
+    ck_assert_int_eq(ln_context_is_weight(ctx_inplace, "create1"), 1);
+    ck_assert_int_eq(ln_context_is_weight(ctx_inplace, "relu1"), 0);
+
+    /* relu1 has no other consumer, in-place */
+    te = ln_tensor_table_find(ctx_inplace->tensor_table, "lrelu1");
+    ck_assert_str_eq(te->owner, "relu1");
+    ck_assert_int_eq(te->offset, relu1_offset);
+    lrelu1_offset = te->offset;
+
+    /* lrelu1 is read by elew1 later, not in-place */
+    te = ln_tensor_table_find(ctx_inplace->tensor_table, "relu2");
+    ck_assert_ptr_eq(te->owner, NULL);
+    ck_assert_int_ne(te->offset, lrelu1_offset);
+
+    ln_context_cleanup_ops(ctx_inplace);
+    ln_context_free(ctx_inplace);
+    ln_free(json_str_inplace);
+}
+LN_TEST_END
+
+LN_TEST_START(test_ln_pass_mem_inplace_output)
+{
+    ln_context *ctx_out;
+    char *json_str_out;
+    ln_tensor_entry *te;
+    size_t relu1_offset, relu1_size, relu2_offset;
+
+    ctx_out = ln_context_create();
+    json_str_out = ln_read_text(LN_TEST_DIR"/data/test_inplace_output.json");
+    ln_json_parse(json_str_out, ctx_out);
+    ln_context_init_ops(ctx_out);
+
+    ln_pass_mem_plan(ctx_out);
+
+    /* lrelu1 is an output of the model, in-place on relu1 */
+    te = ln_tensor_table_find(ctx_out->tensor_table, "lrelu1");
+    ck_assert_str_eq(te->owner, "relu1");
+    te = ln_tensor_table_find(ctx_out->tensor_table, "relu1");
+    relu1_offset = te->offset;
+    relu1_size = tl_tensor_size(te->tensor);
+
+    /* the next branch must not reuse the memory of relu1 */
+    te = ln_tensor_table_find(ctx_out->tensor_table, "relu2");
+    relu2_offset = te->offset;
+    ck_assert(relu2_offset >= relu1_offset + relu1_size ||
+              relu2_offset + tl_tensor_size(te->tensor) <= relu1_offset);
+
+    ln_context_cleanup_ops(ctx_out);
+    ln_context_free(ctx_out);
+    ln_free(json_str_out);
+}
+LN_TEST_END
+
+LN_TEST_START(test_ln_pass_mem_scratch)
+{
+    ln_context *ctx_scratch;
+    ln_tensor_entry *te1, *te2;
+    size_t col1_end;
+
+    ctx_scratch = ln_context_create();
+    ln_context_init(ctx_scratch, LN_TEST_DIR"/data/test_scratch.json");
+    ln_context_set_inputs(ctx_scratch, "input");
+    ln_context_compile(ctx_scratch, "cpu", NULL);
+
+    /* the im2col buffer of conv1 is freed once conv1 is done, for conv2 */
+    te1 = ln_tensor_table_find(ctx_scratch->tensor_table, "conv1_col");
+    ck_assert_int_eq(te1->scratch, 1);
+    ck_assert_int_eq(ln_context_is_weight(ctx_scratch, "conv1_col"), 0);
+    col1_end = te1->offset + tl_tensor_size(te1->tensor);
+    te2 = ln_tensor_table_find(ctx_scratch->tensor_table, "conv2_col");
+    ck_assert_int_eq(te2->scratch, 1);
+    ck_assert(te2->offset < col1_end &&
+              te2->offset + tl_tensor_size(te2->tensor) > te1->offset);
+
+    ln_context_load(ctx_scratch, NULL);
+    ln_context_run(ctx_scratch);
+    ln_context_unload(ctx_scratch);
+    ln_context_cleanup(ctx_scratch);
+    ln_context_free(ctx_scratch);
+}
+LN_TEST_END
+
+LN_TEST_START(test_ln_pass_mem_align)
+{
+    ln_context *ctx_align;
+    char *json_str_align;
+    ln_tensor_entry *te;
+    const char *names[] = {"create1", "relu1", "relu2", "elew1"};
+    int i;
+
+    ctx_align = ln_context_create();
+    json_str_align = ln_read_text(LN_TEST_DIR"/data/test_inplace.json");
+    ln_json_parse(json_str_align, ctx_align);
+    ln_context_init_ops(ctx_align);
+
+    ln_pass_mem_plan(ctx_align);
+    for (i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        te = ln_tensor_table_find(ctx_align->tensor_table, names[i]);
+        ck_assert_int_eq(te->offset % 64, 0);
+    }
+
+    ln_context_set_mem_align(ctx_align, 256);
+    for (i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        te = ln_tensor_table_find(ctx_align->tensor_table, names[i]);
+        ck_assert_int_eq(te->offset % 256, 0);
+    }
+    ck_assert_int_eq(ctx_align->mem_sizes[LN_MEM_CPU] % 256, 0);
+
+    ln_context_cleanup_ops(ctx_align);
+    ln_context_free(ctx_align);
+    ln_free(json_str_align);
+}
+LN_TEST_END
+
+LN_TEST_START(test_ln_pass_elew_chain)
+{
+    ln_context *ctx_chain;
+    ln_op *op;
+    float x[] = {-2, -1, 0, 1, 2, 3};
+    float res[6];
+    float y;
+    int i;
+
+    ctx_chain = ln_context_create();
+    ln_context_init(ctx_chain, LN_TEST_DIR"/data/test_elew_chain.json");
+    ln_context_compile(ctx_chain, "cpu", NULL);
+
+    /* sigmoid1, elew1, lrelu1, elew2 and relu1 collapse into one op */
+    ck_assert_int_eq(ln_list_length(ctx_chain->ops), 3);
+    op = ln_op_list_find_by_name(ctx_chain->ops, "sigmoid1");
+    assert_op_eq(op, "elew_chain_cpu", "sigmoid1");
+    ck_assert_str_eq(ln_tensor_list_find_name(TENSORS_IN, "src0"), "create1");
+    ck_assert_str_eq(ln_tensor_list_find_name(TENSORS_IN, "src1"), "create2");
+    ck_assert_str_eq(ln_tensor_list_find_name(TENSORS_OUT, "dst"), "relu1");
+
+    ln_context_load(ctx_chain, NULL);
+    ln_context_run(ctx_chain);
+    ln_context_get_data(ctx_chain, "relu1", res);
+    for (i = 0; i < 6; i++) {
+        y = x[i] / (1 + expf(-x[i]));
+        y = y > 0 ? y : y * 0.5;
+        y = 1 - y;
+        y = y > 0 ? y : 0;
+        ck_assert_float_eq_tol(res[i], y, 1e-5);
+    }
+
+    ln_context_unload(ctx_chain);
+    ln_context_cleanup(ctx_chain);
+    ln_context_free(ctx_chain);
+}
+LN_TEST_END
+
+LN_TEST_START(test_ln_pass_channel_shuffle)
+{
+    ln_context *ctx_shuffle;
+    ln_param_entry *param_entry;
+    ln_op *op;
+    float res[12];
+    float expect[] = {0, 1, 4, 5, 8, 9, 2, 3, 6, 7, 10, 11};
+
+    ctx_shuffle = ln_context_create();
+    ln_context_init(ctx_shuffle, LN_TEST_DIR"/data/test_channel_shuffle.json");
+    ln_context_compile(ctx_shuffle, "cpu", NULL);
+
+    ck_assert_int_eq(ln_list_length(ctx_shuffle->ops), 2);
+    op = ln_op_list_find_by_name(ctx_shuffle->ops, "transpose1");
+    assert_op_eq(op, "channel_shuffle_cpu", "transpose1");
+    ck_assert_str_eq(ln_tensor_list_find_name(TENSORS_IN, "src"), "create1");
+    ck_assert_str_eq(ln_tensor_list_find_name(TENSORS_OUT, "dst"), "reshape2");
+    param_entry = ln_param_list_find(PARAMS, "axis");
+    ck_assert_int_eq(param_entry->value_int, 1);
+    param_entry = ln_param_list_find(PARAMS, "group");
+    ck_assert_int_eq(param_entry->value_int, 3);
+
+    ln_context_load(ctx_shuffle, NULL);
+    ln_context_run(ctx_shuffle);
+    ln_context_get_data(ctx_shuffle, "reshape2", res);
+    for (int i = 0; i < 12; i++)
+        ck_assert_float_eq(res[i], expect[i]);
+
+    ln_context_unload(ctx_shuffle);
+    ln_context_cleanup(ctx_shuffle);
+    ln_context_free(ctx_shuffle);
+}
+LN_TEST_END
+
+LN_TEST_START(test_ln_pass_topk)
+{
+    ln_context *ctx_topk;
+    ln_param_entry *param_entry;
+    ln_op *op;
+    float res_score[3];
+    float res_bbox[4];
+    float expect_score[] = {0.9, 0.9, 0.7};
+    float expect_bbox[] = {2, 3, 8, 9};
+
+    ctx_topk = ln_context_create();
+    ln_context_init(ctx_topk, LN_TEST_DIR"/data/test_topk.json");
+    ln_context_compile(ctx_topk, "cpu", NULL);
+
+    op = ln_op_list_find_by_name(ctx_topk->ops, "sort");
+    assert_op_eq(op, "topk_cpu", "sort");
+    ck_assert_str_eq(ln_tensor_list_find_name(TENSORS_OUT, "dst_val"),
+                     "sort_index");
+    param_entry = ln_param_list_find(PARAMS, "k");
+    ck_assert_int_eq(param_entry->value_int, 3);
+    param_entry = ln_param_list_find(PARAMS, "dir");
+    ck_assert_str_eq(param_entry->value_string, "TL_SORT_DIR_DESCENDING");
+
+    ln_context_load(ctx_topk, NULL);
+    for (int n = 0; n < 2; n++) {
+        ln_context_run(ctx_topk);
+        ln_context_get_data(ctx_topk, "pick_score", res_score);
+        ln_context_get_data(ctx_topk, "pick_bbox", res_bbox);
+        for (int i = 0; i < 3; i++)
+            ck_assert_float_eq(res_score[i], expect_score[i]);
+        for (int i = 0; i < 4; i++)
+            ck_assert_float_eq(res_bbox[i], expect_bbox[i]);
+    }
+
+    ln_context_unload(ctx_topk);
+    ln_context_cleanup(ctx_topk);
+    ln_context_free(ctx_topk);
+}
+LN_TEST_END
+
+LN_TEST_START(test_ln_pass_slice_view)
+{
+    ln_context *ctx_slice;
+    ln_tensor_entry *te;
+    size_t relu1_offset;
+    float res1[6];
+    float res2[6];
+    float expect1[] = {4, 5, 6, 7, 8, 9};
+    float expect2[] = {1, 3, 5, 7, 9, 11};
+
+    ctx_slice = ln_context_create();
+    ln_context_init(ctx_slice, LN_TEST_DIR"/data/test_slice_view.json");
+    ln_context_compile(ctx_slice, "cpu", NULL);
+
+    te = ln_tensor_table_find(ctx_slice->tensor_table, "relu1");
+    relu1_offset = te->offset;
+
+    /* nothing before axis 1, a view of relu1 */
+    te = ln_tensor_table_find(ctx_slice->tensor_table, "slice1");
+    ck_assert_str_eq(te->owner, "relu1");
+    ck_assert_int_eq(te->offset, relu1_offset + 2 * 2 * sizeof(float));
+
+    /* strided, copied */
+    te = ln_tensor_table_find(ctx_slice->tensor_table, "slice2");
+    ck_assert_ptr_eq(te->owner, NULL);
+
+    /* nothing reads relu1 after relu2, which can run in-place on the view */
+    te = ln_tensor_table_find(ctx_slice->tensor_table, "relu2");
+    ck_assert_str_eq(te->owner, "slice1");
+    ck_assert_int_eq(te->offset, relu1_offset + 2 * 2 * sizeof(float));
+
+    ln_context_load(ctx_slice, NULL);
+    ln_context_run(ctx_slice);
+    ln_context_get_data(ctx_slice, "relu2", res1);
+    ln_context_get_data(ctx_slice, "slice2", res2);
+    for (int i = 0; i < 6; i++) {
+        ck_assert_float_eq(res1[i], expect1[i]);
+        ck_assert_float_eq(res2[i], expect2[i]);
+    }
+
+    ln_context_unload(ctx_slice);
+    ln_context_cleanup(ctx_slice);
+    ln_context_free(ctx_slice);
+}
+LN_TEST_END
+
+LN_TEST_START(test_ln_pass_slice_output)
+{
+    ln_context *ctx_slice;
+    ln_tensor_entry *te;
+    size_t relu1_offset, relu1_size;
+    float res1[6];
+    float res2[6];
+    float expect1[] = {4, 5, 6, 7, 8, 9};
+    float expect2[] = {0, 1, 2, 3, 4, 5};
+
+    ctx_slice = ln_context_create();
+    ln_context_init(ctx_slice, LN_TEST_DIR"/data/test_slice_output.json");
+    ln_context_compile(ctx_slice, "cpu", NULL);
+
+    /* slice1 is an output of the model, a view of relu1 */
+    te = ln_tensor_table_find(ctx_slice->tensor_table, "slice1");
+    ck_assert_str_eq(te->owner, "relu1");
+    te = ln_tensor_table_find(ctx_slice->tensor_table, "relu1");
+    relu1_offset = te->offset;
+    relu1_size = tl_tensor_size(te->tensor);
+
+    /* the next branch must not reuse the memory of relu1 */
+    te = ln_tensor_table_find(ctx_slice->tensor_table, "relu2");
+    ck_assert(te->offset >= relu1_offset + relu1_size ||
+              te->offset + tl_tensor_size(te->tensor) <= relu1_offset);
+
+    ln_context_load(ctx_slice, NULL);
+    ln_context_run(ctx_slice);
+    ln_context_get_data(ctx_slice, "slice1", res1);
+    ln_context_get_data(ctx_slice, "relu3", res2);
+    for (int i = 0; i < 6; i++) {
+        ck_assert_float_eq(res1[i], expect1[i]);
+        ck_assert_float_eq(res2[i], expect2[i]);
+    }
+
+    ln_context_unload(ctx_slice);
+    ln_context_cleanup(ctx_slice);
+    ln_context_free(ctx_slice);
+}
+LN_TEST_END
+
 LN_TEST_TCASE_START(pass, checked_setup, checked_teardown)
 {
     LN_TEST_ADD_TEST(test_ln_pass_combiner);
     LN_TEST_ADD_TEST(test_ln_pass_mem);
+    LN_TEST_ADD_TEST(test_ln_pass_mem_inplace);
+    LN_TEST_ADD_TEST(test_ln_pass_mem_inplace_output);
+    LN_TEST_ADD_TEST(test_ln_pass_mem_scratch);
+    LN_TEST_ADD_TEST(test_ln_pass_mem_align);
+    LN_TEST_ADD_TEST(test_ln_pass_elew_chain);
+    LN_TEST_ADD_TEST(test_ln_pass_channel_shuffle);
+    LN_TEST_ADD_TEST(test_ln_pass_topk);
+    LN_TEST_ADD_TEST(test_ln_pass_slice_view);
+    LN_TEST_ADD_TEST(test_ln_pass_slice_output);
 }
 LN_TEST_TCASE_END
 
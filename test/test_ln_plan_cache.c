@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2018-2020 Zhixu Zhao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <check.h>
+#include <tensorlight/tl_check.h>
+#include "lightnettest/ln_test.h"
+#include "ln_plan_cache.h"
+#include "ln_arch.h"
+
+#define SOURCE LN_TEST_DIR"/data/test_concurrent.json"
+
+static ln_plan_cache *cache;
+
+static void checked_setup(void)
+{
+    ln_arch_init();
+    cache = ln_plan_cache_create(SOURCE, "cpu", NULL, "input", 2);
+}
+
+static void checked_teardown(void)
+{
+    ln_plan_cache_free(cache);
+    ln_arch_cleanup();
+}
+
+static void *data_of(ln_context *ctx, const char *tname)
+{
+    return ln_tensor_table_find(ctx->tensor_table, tname)->tensor->data;
+}
+
+static void assert_dims(ln_context *ctx, const char *tname, const int *dims)
+{
+    ln_tensor_entry *te;
+
+    te = ln_tensor_table_find(ctx->tensor_table, tname);
+    ck_assert_int_eq(te->tensor->ndim, 4);
+    ck_assert_array_int_eq(te->tensor->dims, dims, 4);
+}
+
+LN_TEST_START(test_ln_plan_cache_get)
+{
+    ln_context *ctx1, *ctx2, *ctx3;
+    int dims1[] = {1, 3, 8, 8};
+    int dims2[] = {2, 3, 16, 16};
+    int dims3[] = {1, 3, 4, 4};
+    int out_dims1[] = {1, 4, 4, 4};
+    int out_dims2[] = {2, 4, 8, 8};
+
+    ctx1 = ln_plan_cache_get(cache, dims1);
+    assert_dims(ctx1, "sigmoid1", out_dims1);
+    ctx2 = ln_plan_cache_get(cache, dims2);
+    assert_dims(ctx2, "sigmoid1", out_dims2);
+    ck_assert_ptr_ne(ctx1, ctx2);
+    ck_assert_int_eq(ln_plan_cache_size(cache), 2);
+
+    /* the specialized plans share the weights */
+    ck_assert_ptr_eq(data_of(ctx1, "conv1_wts"), data_of(ctx2, "conv1_wts"));
+    ck_assert_ptr_ne(data_of(ctx1, "input"), data_of(ctx2, "input"));
+
+    /* ctx2 is the least recently used after getting ctx1 again */
+    ck_assert_ptr_eq(ln_plan_cache_get(cache, dims1), ctx1);
+    ctx3 = ln_plan_cache_get(cache, dims3);
+    ck_assert_int_eq(ln_plan_cache_size(cache), 2);
+    ck_assert_ptr_eq(ln_plan_cache_get(cache, dims1), ctx1);
+    ck_assert_ptr_eq(ln_plan_cache_get(cache, dims3), ctx3);
+    ck_assert_ptr_eq(data_of(ctx1, "conv1_wts"), data_of(ctx3, "conv1_wts"));
+}
+LN_TEST_END
+
+LN_TEST_START(test_ln_plan_cache_run)
+{
+    ln_context *ctx, *ctx_batch;
+    int dims[] = {1, 3, 16, 16};
+    int dims_batch[] = {2, 3, 16, 16};
+    float input[3 * 16 * 16];
+    float expect[4 * 8 * 8];
+    float res[4 * 8 * 8];
+
+    for (int i = 0; i < 3 * 16 * 16; i++)
+        input[i] = (i % 13) / 4.0 - 1.5;
+
+    ctx = ln_context_create();
+    ln_context_init(ctx, SOURCE);
+    ln_context_set_dims(ctx, "input", dims);
+    ln_context_compile(ctx, "cpu", NULL);
+    ln_context_load(ctx, NULL);
+    ln_context_set_data(ctx, "input", input);
+    ln_context_run(ctx);
+    ln_context_get_data(ctx, "sigmoid1", expect);
+    ln_context_unload(ctx);
+    ln_context_cleanup(ctx);
+    ln_context_free(ctx);
+
+    ctx_batch = ln_plan_cache_get(cache, dims_batch);
+    ln_context_set_frame(ctx_batch, "input", 0, input);
+    ln_context_set_frame(ctx_batch, "input", 1, input);
+    ln_context_run(ctx_batch);
+    for (int n = 0; n < 2; n++) {
+        ln_context_get_frame(ctx_batch, "sigmoid1", n, res);
+        for (int i = 0; i < 4 * 8 * 8; i++)
+            ck_assert_float_eq_tol(res[i], expect[i], 1e-6);
+    }
+}
+LN_TEST_END
+
+LN_TEST_TCASE_START(plan_cache, checked_setup, checked_teardown)
+{
+    LN_TEST_ADD_TEST(test_ln_plan_cache_get);
+    LN_TEST_ADD_TEST(test_ln_plan_cache_run);
+}
+LN_TEST_TCASE_END
+
+LN_TEST_ADD_TCASE(plan_cache);
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2018-2020 Zhixu Zhao
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <check.h>
+#include <tensorlight/tl_check.h>
+#include "lightnettest/ln_test.h"
+#include "ln_report.h"
+#include "ln_arch.h"
+
+static ln_context *ctx;
+
+static void checked_setup(void)
+{
+    ln_arch_init();
+    ctx = ln_context_create();
+    ln_context_init(ctx, LN_TEST_DIR"/data/test_dirty.json");
+    ln_context_set_inputs(ctx, "input");
+    ln_context_compile(ctx, "cpu", NULL);
+}
+
+static void checked_teardown(void)
+{
+    ln_context_cleanup(ctx);
+    ln_context_free(ctx);
+    ln_arch_cleanup();
+}
+
+static char *report(ln_report_format format)
+{
+    char *buf;
+    size_t size;
+    FILE *fp;
+
+    fp = open_memstream(&buf, &size);
+    ln_report_mem_plan(fp, ctx, format);
+    fclose(fp);
+    return buf;
+}
+
+LN_TEST_START(test_ln_report_format_of)
+{
+    ck_assert_int_eq(ln_report_format_of("plan.svg"), LN_REPORT_SVG);
+    ck_assert_int_eq(ln_report_format_of("plan.html"), LN_REPORT_HTML);
+    ck_assert_int_eq(ln_report_format_of("plan.txt"), LN_REPORT_TEXT);
+    ck_assert_int_eq(ln_report_format_of("plan"), LN_REPORT_TEXT);
+}
+LN_TEST_END
+
+LN_TEST_START(test_ln_report_mem_plan)
+{
+    char line[LN_MAXLINE];
+    char *buf;
+
+    buf = report(LN_REPORT_TEXT);
+
+    /* input, transpose1 and the unread elew1 live till the last op, each
+       of 24 bytes padded to the 64-byte alignment */
+    snprintf(line, sizeof(line), "%12lu %12d %9d %9d  %s\n",
+             ln_tensor_table_find(ctx->tensor_table, "transpose1")->offset,
+             64, 0, 3, "transpose1");
+    ck_assert_ptr_ne(strstr(buf, line), NULL);
+    snprintf(line, sizeof(line), "%12lu %12d %9d %9d  %s\n",
+             ln_tensor_table_find(ctx->tensor_table, "elew1")->offset,
+             64, 3, 3, "elew1");
+    ck_assert_ptr_ne(strstr(buf, line), NULL);
+    snprintf(line, sizeof(line),
+             "LN_MEM_CPU memory: %lu bytes planned, 192 bytes live at most at op 3 'elew1'",
+             ctx->mem_sizes[LN_MEM_CPU]);
+    ck_assert_ptr_ne(strstr(buf, line), NULL);
+    ck_assert_ptr_ne(strstr(buf, "LN_MEM_CPU weights:"), NULL);
+    ln_free(buf);
+
+    buf = report(LN_REPORT_HTML);
+    ck_assert_ptr_ne(strstr(buf, "<svg"), NULL);
+    ck_assert_ptr_ne(strstr(buf, "<title>transpose1: "), NULL);
+    ck_assert_ptr_ne(strstr(buf, "</html>"), NULL);
+    ln_free(buf);
+}
+LN_TEST_END
+
+LN_TEST_START(test_ln_report_mem_plan_views)
+{
+    ln_context *view_ctx;
+    char line[LN_MAXLINE];
+    char *buf;
+    size_t size;
+    FILE *fp;
+
+    /* relu1 is last read by transpose1 at op 3, but its unread view
+       reshape1 keeps it till the last op, as mem_plan does */
+    view_ctx = ln_context_create();
+    ln_context_init(view_ctx, LN_TEST_DIR"/data/test_report_view.json");
+    ln_context_set_inputs(view_ctx, "input");
+    ln_context_compile(view_ctx, "cpu", NULL);
+    fp = open_memstream(&buf, &size);
+    ln_report_mem_plan(fp, view_ctx, LN_REPORT_TEXT);
+    fclose(fp);
+    snprintf(line, sizeof(line), "%12lu %12d %9d %9d  %s\n",
+             ln_tensor_table_find(view_ctx->tensor_table, "relu1")->offset,
+             64, 1, 4, "relu1");
+    ck_assert_ptr_ne(strstr(buf, line), NULL);
+    ln_free(buf);
+    ln_context_cleanup(view_ctx);
+    ln_context_free(view_ctx);
+}
+LN_TEST_END
+
+LN_TEST_TCASE_START(report, checked_setup, checked_teardown)
+{
+    LN_TEST_ADD_TEST(test_ln_report_format_of);
+    LN_TEST_ADD_TEST(test_ln_report_mem_plan);
+    LN_TEST_ADD_TEST(test_ln_report_mem_plan_views);
+}
+LN_TEST_TCASE_END
+
+LN_TEST_ADD_TCASE(report);
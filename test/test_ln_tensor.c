@@ -20,10 +20,13 @@
  * SOFTWARE.
  */
 
+#include <unistd.h>
+#include <sys/mman.h>
 #include <check.h>
 #include <tensorlight/tl_check.h>
 #include "lightnettest/ln_test.h"
 #include "ln_tensor.h"
+#include "ln_lz.h"
 
 #define ARR(type, varg...) (type[]){varg}
 
@@ -133,11 +136,340 @@ LN_TEST_START(test_ln_tensor_table_load_trt_weight_file)
 }
 LN_TEST_END
 
+/* Write a record and return the offset of its data. */
+static uint64_t write_weight_record(FILE *fp, const char *name,
+                                    const char *dtype, const void *data,
+                                    uint64_t size)
+{
+    uint32_t name_len = strlen(name);
+    uint32_t dtype_len = strlen(dtype);
+    char pad[LN_WEIGHT_FILE_ALIGN] = {0};
+    long offset;
+
+    fwrite(&name_len, sizeof(name_len), 1, fp);
+    fwrite(&dtype_len, sizeof(dtype_len), 1, fp);
+    fwrite(&size, sizeof(size), 1, fp);
+    fwrite(name, name_len, 1, fp);
+    fwrite(dtype, dtype_len, 1, fp);
+    offset = ftell(fp);
+    fwrite(pad, (LN_WEIGHT_FILE_ALIGN - offset % LN_WEIGHT_FILE_ALIGN) %
+           LN_WEIGHT_FILE_ALIGN, 1, fp);
+    offset = ftell(fp);
+    fwrite(data, size, 1, fp);
+    return offset;
+}
+
+static void write_weight_index_entry(FILE *fp, const char *name,
+                                     const char *dtype, const void *data,
+                                     uint64_t size, uint64_t offset)
+{
+    uint32_t crc32 = ln_crc32(0, data, size);
+    uint32_t name_len = strlen(name);
+    uint32_t dtype_len = strlen(dtype);
+    uint32_t reserved = 0;
+    char pad[8] = {0};
+
+    fwrite(&offset, sizeof(offset), 1, fp);
+    fwrite(&size, sizeof(size), 1, fp);
+    fwrite(&crc32, sizeof(crc32), 1, fp);
+    fwrite(&name_len, sizeof(name_len), 1, fp);
+    fwrite(&dtype_len, sizeof(dtype_len), 1, fp);
+    fwrite(&reserved, sizeof(reserved), 1, fp);
+    fwrite(name, name_len, 1, fp);
+    fwrite(dtype, dtype_len, 1, fp);
+    fwrite(pad, (8 - (name_len + dtype_len) % 8) % 8, 1, fp);
+}
+
+/* Write a blob aligned, compressed in frames of `frame_size` if it isn't 0,
+   and return its offset. */
+static uint64_t write_weight_blob(FILE *fp, const void *data, uint64_t size,
+                                  uint32_t frame_size, uint64_t *stored_size)
+{
+    char pad[LN_WEIGHT_FILE_ALIGN] = {0};
+    uint32_t nframes, *frames;
+    uint64_t offset, start, n;
+    char *packed;
+
+    offset = ftell(fp);
+    fwrite(pad, (LN_WEIGHT_FILE_ALIGN - offset % LN_WEIGHT_FILE_ALIGN) %
+           LN_WEIGHT_FILE_ALIGN, 1, fp);
+    offset = ftell(fp);
+    if (frame_size == 0) {
+        fwrite(data, size, 1, fp);
+        *stored_size = size;
+        return offset;
+    }
+
+    nframes = (size + frame_size - 1) / frame_size;
+    frames = ln_alloc(sizeof(uint32_t) * nframes);
+    packed = ln_alloc(ln_lz_compress_bound(frame_size));
+    fwrite(&frame_size, sizeof(frame_size), 1, fp);
+    fwrite(&nframes, sizeof(nframes), 1, fp);
+    fwrite(frames, sizeof(uint32_t), nframes, fp);
+    for (uint32_t i = 0; i < nframes; i++) {
+        start = (uint64_t)i * frame_size;
+        n = size - start < frame_size ? size - start : frame_size;
+        frames[i] = ln_lz_compress((const char *)data + start, n, packed,
+                                   ln_lz_compress_bound(frame_size));
+        fwrite(packed, frames[i], 1, fp);
+    }
+    *stored_size = ftell(fp) - offset;
+    fseek(fp, offset + 2 * sizeof(uint32_t), SEEK_SET);
+    fwrite(frames, sizeof(uint32_t), nframes, fp);
+    fseek(fp, 0, SEEK_END);
+    ln_free(frames);
+    ln_free(packed);
+    return offset;
+}
+
+static void write_weight_index_entry_v3(FILE *fp, const char *name,
+                                        const char *dtype, const void *data,
+                                        uint64_t size, uint64_t offset,
+                                        uint64_t stored_size, uint32_t codec)
+{
+    uint32_t crc32 = ln_crc32(0, data, size);
+    uint32_t name_len = strlen(name);
+    uint32_t dtype_len = strlen(dtype);
+    char pad[8] = {0};
+
+    fwrite(&offset, sizeof(offset), 1, fp);
+    fwrite(&size, sizeof(size), 1, fp);
+    fwrite(&stored_size, sizeof(stored_size), 1, fp);
+    fwrite(&crc32, sizeof(crc32), 1, fp);
+    fwrite(&codec, sizeof(codec), 1, fp);
+    fwrite(&name_len, sizeof(name_len), 1, fp);
+    fwrite(&dtype_len, sizeof(dtype_len), 1, fp);
+    fwrite(name, name_len, 1, fp);
+    fwrite(dtype, dtype_len, 1, fp);
+    fwrite(pad, (8 - (name_len + dtype_len) % 8) % 8, 1, fp);
+}
+
+static int lazy_all(const ln_tensor_entry *te, void *arg)
+{
+    return 1;
+}
+
+LN_TEST_START(test_ln_tensor_table_load_weight_file)
+{
+    ln_hash *table;
+    ln_tensor_entry *te;
+    tl_tensor *wts1, *wts2;
+    float wts1_data[] = {1.2, 1e-3, -3e-2, +2e+5, 0, 1.2};
+    int8_t wts2_data[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 0};
+    int32_t unused_data[] = {1, 2, 3};
+    uint32_t version = 1, count = 3;
+    char file[] = "/tmp/test_ln_tensor_XXXXXX";
+    FILE *fp;
+    int fd;
+
+    fd = mkstemp(file);
+    ck_assert_int_ge(fd, 0);
+    fp = fdopen(fd, "wb");
+    fwrite(LN_WEIGHT_FILE_MAGIC, LN_WEIGHT_FILE_MAGIC_LEN, 1, fp);
+    fwrite(&version, sizeof(version), 1, fp);
+    fwrite(&count, sizeof(count), 1, fp);
+    write_weight_record(fp, "wts1", "TL_FLOAT", wts1_data, sizeof(wts1_data));
+    write_weight_record(fp, "unused", "TL_INT32", unused_data,
+                        sizeof(unused_data));
+    write_weight_record(fp, "wts2", "TL_INT8", wts2_data, sizeof(wts2_data));
+    fclose(fp);
+
+    wts1 = tl_tensor_zeros(2, ARR(int, 2, 3), TL_FLOAT);
+    wts2 = tl_tensor_zeros(1, ARR(int, 10), TL_INT8);
+    table = ln_tensor_table_create();
+    te = ln_tensor_entry_create("wts1", wts1);
+    te->mtype = LN_MEM_CPU;
+    ln_tensor_table_insert(table, te);
+    te = ln_tensor_entry_create("wts2", wts2);
+    te->mtype = LN_MEM_CPU;
+    ln_tensor_table_insert(table, te);
+
+    ck_assert_int_eq(ln_tensor_is_weight_file(file), 1);
+    ck_assert_int_eq(ln_tensor_is_weight_file(
+                         LN_TEST_DIR"/data/test_trt_weight.wts"), 0);
+    ln_tensor_table_load_data_file(table, file, 0, 0, NULL);
+    for (int i = 0; i < 6; i++)
+        ck_assert_float_eq(wts1_data[i], ((float*)wts1->data)[i]);
+    for (int i = 0; i < 10; i++)
+        ck_assert_int_eq(wts2_data[i], ((int8_t*)wts2->data)[i]);
+
+    unlink(file);
+    tl_free(wts1->data);
+    tl_free(wts2->data);
+    ln_tensor_table_free(table);
+}
+LN_TEST_END
+
+LN_TEST_START(test_ln_tensor_table_load_weight_file_indexed)
+{
+    ln_hash *table;
+    ln_tensor_entry *te;
+    tl_tensor *wts1, *wts2;
+    ln_weight_load_stat stat;
+    int nbig = 3 * LN_WEIGHT_FILE_CHUNK_SIZE / sizeof(float) + 100;
+    float *wts1_data;
+    int8_t wts2_data[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 0};
+    int32_t unused_data[] = {1, 2, 3};
+    uint32_t version = 2, count = 3;
+    uint64_t offsets[3], index_offset = 0;
+    char file[] = "/tmp/test_ln_tensor_XXXXXX";
+    FILE *fp;
+    int fd;
+
+    wts1_data = ln_alloc(sizeof(float) * nbig);
+    for (int i = 0; i < nbig; i++)
+        wts1_data[i] = i * 0.5f - 7;
+
+    fd = mkstemp(file);
+    ck_assert_int_ge(fd, 0);
+    fp = fdopen(fd, "wb");
+    fwrite(LN_WEIGHT_FILE_MAGIC, LN_WEIGHT_FILE_MAGIC_LEN, 1, fp);
+    fwrite(&version, sizeof(version), 1, fp);
+    fwrite(&count, sizeof(count), 1, fp);
+    fwrite(&index_offset, sizeof(index_offset), 1, fp);
+    offsets[0] = write_weight_record(fp, "wts2", "TL_INT8", wts2_data,
+                                     sizeof(wts2_data));
+    offsets[1] = write_weight_record(fp, "wts1", "TL_FLOAT", wts1_data,
+                                     sizeof(float) * nbig);
+    offsets[2] = write_weight_record(fp, "unused", "TL_INT32", unused_data,
+                                     sizeof(unused_data));
+    index_offset = ftell(fp);
+    write_weight_index_entry(fp, "wts2", "TL_INT8", wts2_data,
+                             sizeof(wts2_data), offsets[0]);
+    write_weight_index_entry(fp, "wts1", "TL_FLOAT", wts1_data,
+                             sizeof(float) * nbig, offsets[1]);
+    write_weight_index_entry(fp, "unused", "TL_INT32", unused_data,
+                             sizeof(unused_data), offsets[2]);
+    fseek(fp, LN_WEIGHT_FILE_MAGIC_LEN + 8, SEEK_SET);
+    fwrite(&index_offset, sizeof(index_offset), 1, fp);
+    fclose(fp);
+
+    wts1 = tl_tensor_zeros(1, ARR(int, nbig), TL_FLOAT);
+    wts2 = tl_tensor_zeros(1, ARR(int, 10), TL_INT8);
+    table = ln_tensor_table_create();
+    te = ln_tensor_entry_create("wts1", wts1);
+    te->mtype = LN_MEM_CPU;
+    ln_tensor_table_insert(table, te);
+    te = ln_tensor_entry_create("wts2", wts2);
+    te->mtype = LN_MEM_CPU;
+    ln_tensor_table_insert(table, te);
+
+    ln_tensor_table_load_data_file(table, file, 3, 1, &stat);
+    ck_assert_int_eq(memcmp(wts1_data, wts1->data, sizeof(float) * nbig), 0);
+    for (int i = 0; i < 10; i++)
+        ck_assert_int_eq(wts2_data[i], ((int8_t*)wts2->data)[i]);
+    ck_assert_int_eq(stat.count, 2);
+    ck_assert_int_eq(stat.bytes, sizeof(float) * nbig + sizeof(wts2_data));
+    ck_assert_int_eq(stat.threads, 3);
+
+    memset(wts1->data, 0, sizeof(float) * nbig);
+    ln_tensor_table_load_weight_file(table, file, 1, 0, NULL);
+    ck_assert_int_eq(memcmp(wts1_data, wts1->data, sizeof(float) * nbig), 0);
+
+    unlink(file);
+    ln_free(wts1_data);
+    tl_free(wts1->data);
+    tl_free(wts2->data);
+    ln_tensor_table_free(table);
+}
+LN_TEST_END
+
+LN_TEST_START(test_ln_tensor_table_load_weight_file_compressed)
+{
+    ln_hash *table;
+    ln_tensor_entry *te;
+    tl_tensor *wts1, *wts2, *wts3;
+    ln_weight_load_stat stat;
+    int nbig = 5 * (1 << 18) + 100;
+    float *wts1_data;
+    int8_t wts2_data[] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 0};
+    uint32_t version = LN_WEIGHT_FILE_VERSION, count = 3;
+    uint64_t offsets[2], stored_sizes[2], index_offset = 0;
+    char file[] = "/tmp/test_ln_tensor_XXXXXX";
+    size_t map_size;
+    char *map;
+    FILE *fp;
+    int fd;
+
+    wts1_data = ln_alloc(sizeof(float) * nbig);
+    for (int i = 0; i < nbig; i++)
+        wts1_data[i] = i % 37 == 0 ? i * 0.5f : 0;
+
+    fd = mkstemp(file);
+    ck_assert_int_ge(fd, 0);
+    fp = fdopen(fd, "wb");
+    fwrite(LN_WEIGHT_FILE_MAGIC, LN_WEIGHT_FILE_MAGIC_LEN, 1, fp);
+    fwrite(&version, sizeof(version), 1, fp);
+    fwrite(&count, sizeof(count), 1, fp);
+    fwrite(&index_offset, sizeof(index_offset), 1, fp);
+    offsets[0] = write_weight_blob(fp, wts1_data, sizeof(float) * nbig,
+                                   1 << 20, &stored_sizes[0]);
+    offsets[1] = write_weight_blob(fp, wts2_data, sizeof(wts2_data), 0,
+                                   &stored_sizes[1]);
+    ck_assert_uint_lt(stored_sizes[0], sizeof(float) * nbig / 4);
+    index_offset = ftell(fp);
+    write_weight_index_entry_v3(fp, "wts1", "TL_FLOAT", wts1_data,
+                                sizeof(float) * nbig, offsets[0],
+                                stored_sizes[0], LN_WEIGHT_CODEC_LZ);
+    write_weight_index_entry_v3(fp, "wts2", "TL_INT8", wts2_data,
+                                sizeof(wts2_data), offsets[1],
+                                stored_sizes[1], LN_WEIGHT_CODEC_NONE);
+    write_weight_index_entry_v3(fp, "wts3", "TL_INT8", wts2_data,
+                                sizeof(wts2_data), offsets[1],
+                                stored_sizes[1], LN_WEIGHT_CODEC_NONE);
+    fseek(fp, LN_WEIGHT_FILE_MAGIC_LEN + 8, SEEK_SET);
+    fwrite(&index_offset, sizeof(index_offset), 1, fp);
+    fclose(fp);
+
+    wts1 = tl_tensor_zeros(1, ARR(int, nbig), TL_FLOAT);
+    wts2 = tl_tensor_zeros(1, ARR(int, 10), TL_INT8);
+    wts3 = tl_tensor_zeros(1, ARR(int, 10), TL_INT8);
+    table = ln_tensor_table_create();
+    te = ln_tensor_entry_create("wts1", wts1);
+    te->mtype = LN_MEM_CPU;
+    ln_tensor_table_insert(table, te);
+    te = ln_tensor_entry_create("wts2", wts2);
+    te->mtype = LN_MEM_CPU;
+    ln_tensor_table_insert(table, te);
+    te = ln_tensor_entry_create("wts3", wts3);
+    te->mtype = LN_MEM_CPU;
+    ln_tensor_table_insert(table, te);
+
+    ln_tensor_table_load_data_file(table, file, 4, 1, &stat);
+    ck_assert_int_eq(memcmp(wts1_data, wts1->data, sizeof(float) * nbig), 0);
+    ck_assert_int_eq(memcmp(wts2_data, wts2->data, sizeof(wts2_data)), 0);
+    ck_assert_int_eq(memcmp(wts2_data, wts3->data, sizeof(wts2_data)), 0);
+    ck_assert_int_eq(stat.count, 3);
+    ck_assert_int_eq(stat.threads, 4);
+
+    memset(wts1->data, 0, sizeof(float) * nbig);
+    tl_free(wts2->data);
+    tl_free(wts3->data);
+    map = ln_tensor_table_map_weight_file(table, file, lazy_all, NULL,
+                                          &map_size);
+    ck_assert_int_eq(memcmp(wts1_data, wts1->data, sizeof(float) * nbig), 0);
+    ck_assert_ptr_eq(wts2->data, map + offsets[1]);
+    ck_assert_ptr_eq(wts3->data, map + offsets[1]);
+    ck_assert_int_eq(memcmp(wts2_data, wts3->data, sizeof(wts2_data)), 0);
+    munmap(map, map_size);
+
+    unlink(file);
+    ln_free(wts1_data);
+    tl_free(wts1->data);
+    wts2->data = NULL;
+    wts3->data = NULL;
+    ln_tensor_table_free(table);
+}
+LN_TEST_END
+
 LN_TEST_TCASE_START(tensor, checked_setup, checked_teardown)
 {
     LN_TEST_ADD_TEST(test_ln_tensor_list);
     LN_TEST_ADD_TEST(test_ln_tensor_table);
     LN_TEST_ADD_TEST(test_ln_tensor_table_load_trt_weight_file);
+    LN_TEST_ADD_TEST(test_ln_tensor_table_load_weight_file);
+    LN_TEST_ADD_TEST(test_ln_tensor_table_load_weight_file_indexed);
+    LN_TEST_ADD_TEST(test_ln_tensor_table_load_weight_file_compressed);
 }
 LN_TEST_TCASE_END
 
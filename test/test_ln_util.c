@@ -159,6 +159,28 @@ LN_TEST_START(test_ln_is_prefix_plus_digit)
 }
 LN_TEST_END
 
+LN_TEST_START(test_ln_crc32)
+{
+    const char *str = "123456789";
+    char buf[1000];
+    uint32_t crc1, crc2;
+    size_t i;
+
+    ck_assert_uint_eq(ln_crc32(0, str, 0), 0);
+    ck_assert_uint_eq(ln_crc32(0, str, strlen(str)), 0xcbf43926);
+    crc1 = ln_crc32(0, str, 4);
+    ck_assert_uint_eq(ln_crc32(crc1, str + 4, 5), 0xcbf43926);
+
+    for (i = 0; i < sizeof(buf); i++)
+        buf[i] = (char)(i * 31 + 7);
+    crc1 = ln_crc32(0, buf + 1, 333);
+    crc2 = ln_crc32(0, buf + 334, sizeof(buf) - 334);
+    ck_assert_uint_eq(ln_crc32_combine(crc1, crc2, sizeof(buf) - 334),
+                      ln_crc32(0, buf + 1, sizeof(buf) - 1));
+    ck_assert_uint_eq(ln_crc32_combine(crc1, 0, 0), crc1);
+}
+LN_TEST_END
+
 LN_TEST_TCASE_START(util, checked_setup, checked_teardown)
 {
     LN_TEST_ADD_TEST(test_ln_strcat_delim_alloc);
@@ -167,6 +189,7 @@ LN_TEST_TCASE_START(util, checked_setup, checked_teardown)
     LN_TEST_ADD_TEST(test_ln_autopadding_deconv);
     LN_TEST_ADD_TEST(test_ln_suffixed);
     LN_TEST_ADD_TEST(test_ln_is_prefix_plus_digit);
+    LN_TEST_ADD_TEST(test_ln_crc32);
 }
 LN_TEST_TCASE_END
 
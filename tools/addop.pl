@@ -131,6 +131,9 @@ sub gen_head_block {
     push @headers, "#include <assert.h>";
     push @headers, "#include \"ln_op.h\"";
     push @headers, "#include \"ln_arch.h\"";
+    if ($op->{arch} eq "cpu") {
+        push @headers, "#include \"arch/ln_cpu.h\"";
+    }
     if ($op->{arch} eq "cuda") {
         push @headers, "#include \"arch/ln_cuda.h\"";
     }
@@ -633,9 +636,15 @@ sub gen_output_tensor_def {
         if (exists $tensor->{owner}) {
             push @states, "ln_tensor_entry_set_owner(${arg_name}_entry, op_arg->tensor_table, $tensor->{owner});";
         }
+        if (exists $tensor->{inplace} and $tensor->{inplace}) {
+            push @states, "${arg_name}_entry->inplace = 1;";
+        }
         if (exists $tensor->{static}) {
             push @states, "${arg_name}_entry->isstatic = 1;";
         }
+        if (exists $tensor->{scratch} and $tensor->{scratch}) {
+            push @states, "${arg_name}_entry->scratch = 1;";
+        }
         if (exists $tensor->{mtype}) {
             push @states, "${arg_name}_entry->mtype = $tensor->{mtype};";
         } else {
@@ -680,7 +689,7 @@ sub have_variable {
     my $variable = shift;
     my $ret;
 
-    if ($code_str =~ /((?<!->)|(?<!.)|(?<!\w))(?=\w)$variable\b/) {
+    if ($code_str =~ /(?<!->)(?<!\.)(?<!\w)$variable\b/) {
         $ret = 1;
     } else {
         $ret = 0;
@@ -24,7 +24,7 @@ CUFLAGS += -O2
 endif
 
 INCPATHS += -I/usr/local/include -I. -I$(CURDIR)
-LDFLAGS += -L/usr/local/lib -lm
+LDFLAGS += -L/usr/local/lib -lm -lpthread
 # cannot use ifeq/ifneq because they expand immediately
 INCPATHS += $(if $(REQUIRES),$(shell pkg-config --cflags '$(REQUIRES)'))
 LDFLAGS += $(if $(REQUIRES),$(shell pkg-config --libs '$(REQUIRES)'))
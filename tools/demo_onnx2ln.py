@@ -6,10 +6,18 @@ import onnx
 import onnx2ln
 import json
 
-onnx_path = sys.argv[1]
+# --compress compresses the weights in WEIGHT_FILE
+compress = '--compress' in sys.argv[1:]
+args = [arg for arg in sys.argv[1:] if arg != '--compress']
+if len(args) < 1:
+    print("usage: %s [--compress] ONNX_MODEL [WEIGHT_FILE]"%sys.argv[0], file=sys.stderr)
+    exit(1)
+onnx_path = args[0]
+# weights are embedded in the IR if no WEIGHT_FILE is given
+weight_path = args[1] if len(args) > 1 else None
 onnx_model = onnx.load(onnx_path)
 # print(onnx_model)
-ln_model = onnx2ln.onnx_get_model(onnx_model.graph)
+ln_model = onnx2ln.onnx_get_model(onnx_model.graph, weight_path, compress)
 # print(ln_model)
 ln_model_json = json.dumps(ln_model, indent=4)
 print(ln_model_json);
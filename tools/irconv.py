@@ -0,0 +1,267 @@
+#! /usr/bin/env python3
+
+# Convert a LightNet IR between the JSON and the binary format. The layout of
+# the binary format is described in src/ln_bin.c.
+
+import argparse
+import json
+import re
+import struct
+import sys
+
+MAGIC = b'LNIRBIN\0'
+VERSION = 1
+SUFFIX = '.lnb'
+ALIGN = 8
+NOSTR = 0xffffffff
+
+# ln_param_type
+PARAM_NULL, PARAM_STRING, PARAM_NUMBER, PARAM_BOOL, \
+    PARAM_ARRAY_STRING, PARAM_ARRAY_NUMBER, PARAM_ARRAY_BOOL = range(7)
+
+HEADER = struct.Struct('<8sIIIIIIII')
+OP = struct.Struct('<IIIIII')
+TENSOR = struct.Struct('<IIQ')
+PARAM = struct.Struct('<IiII8s')
+
+def err_exit(msg):
+    sys.stderr.write('irconv: ' + msg + '\n')
+    exit(1)
+
+def strip_comments(text):
+    # keep strings, blank // and /* */ comments like ln_json_parse() does
+    pattern = re.compile(r'("(?:[^"\\]|\\.)*")|//[^\n]*|/\*.*?\*/', re.S)
+    return pattern.sub(lambda m: m.group(1) or
+                       re.sub(r'[^\n]', ' ', m.group(0)), text)
+
+def int2size(high, low):
+    return ((high & 0xffffffff) << 32) | (low & 0xffffffff)
+
+def size2int(size):
+    def signed(v):
+        return v - (1 << 32) if v >= (1 << 31) else v
+    return signed((size >> 32) & 0xffffffff), signed(size & 0xffffffff)
+
+def json_number(v):
+    return int(v) if float(v).is_integer() and abs(v) < 2**53 else v
+
+def param_type(name, value):
+    if value is None:
+        return PARAM_NULL
+    if isinstance(value, bool):
+        return PARAM_BOOL
+    if isinstance(value, (int, float)):
+        return PARAM_NUMBER
+    if isinstance(value, str):
+        return PARAM_STRING
+    if isinstance(value, list):
+        if not value:
+            err_exit("param %s's value is an empty array"%name)
+        types = set(param_type(name, v) for v in value)
+        if len(types) != 1 or types & {PARAM_NULL} or \
+           isinstance(value[0], list):
+            err_exit("param %s's value is inconsistent among its elements"%name)
+        return {PARAM_STRING: PARAM_ARRAY_STRING,
+                PARAM_NUMBER: PARAM_ARRAY_NUMBER,
+                PARAM_BOOL: PARAM_ARRAY_BOOL}[types.pop()]
+    err_exit("param %s's value is an unsupported JSON type"%name)
+
+class Writer:
+    def __init__(self):
+        self.buf = bytearray()
+        self.strtab = bytearray()
+        self.strs = {}
+
+    def put(self, data):
+        offset = len(self.buf)
+        self.buf += data
+        return offset
+
+    def align(self):
+        self.buf += b'\0' * (-len(self.buf) % ALIGN)
+        return len(self.buf)
+
+    def str(self, s):
+        if s is None:
+            return NOSTR
+        if s not in self.strs:
+            self.strs[s] = len(self.strtab)
+            self.strtab += s.encode() + b'\0'
+        return self.strs[s]
+
+    def tensors(self, tensors):
+        for t in tensors:
+            offset = int2size(t.get('offset_h', 0), t.get('offset_l', 0))
+            self.put(TENSOR.pack(self.str(t['arg_name']), self.str(t['name']),
+                                 offset))
+
+    def param(self, p):
+        name, value = p['arg_name'], p['value']
+        ptype = param_type(name, value)
+        array_len = len(value) if isinstance(value, list) else 0
+        if ptype == PARAM_NULL:
+            raw = b'\0' * 8
+        elif ptype == PARAM_STRING:
+            raw = struct.pack('<I4x', self.str(value))
+        elif ptype == PARAM_NUMBER:
+            raw = struct.pack('<d', value)
+        elif ptype == PARAM_BOOL:
+            raw = struct.pack('<I4x', 1 if value else 0)
+        else:
+            if ptype == PARAM_ARRAY_NUMBER:
+                data = struct.pack('<%dd'%array_len, *value)
+            elif ptype == PARAM_ARRAY_BOOL:
+                data = struct.pack('<%dI'%array_len,
+                                   *(1 if v else 0 for v in value))
+            else:
+                data = struct.pack('<%dI'%array_len,
+                                   *(self.str(v) for v in value))
+            raw = struct.pack('<Q', self.put(data))
+            self.align()
+        return PARAM.pack(self.str(name), ptype, array_len, 0, raw)
+
+    def op(self, op):
+        offset = self.put(OP.pack(self.str(op['name']), self.str(op['optype']),
+                                  len(op['tensors_in']), len(op['tensors_out']),
+                                  len(op['params']), 0))
+        self.tensors(op['tensors_in'])
+        self.tensors(op['tensors_out'])
+        params_offset = self.put(b'\0' * PARAM.size * len(op['params']))
+        for i, p in enumerate(op['params']):
+            start = params_offset + i * PARAM.size
+            self.buf[start:start + PARAM.size] = self.param(p)
+        return offset
+
+def json2bin(model):
+    w = Writer()
+    ops = model['ops']
+    w.put(b'\0' * HEADER.size)
+    mem_type_count = 0
+    if 'mem_sizes_h' in model and 'mem_sizes_l' in model:
+        mem_type_count = len(model['mem_sizes_h'])
+        for key in ('mem_sizes', 'weight_sizes'):
+            sizes = [int2size(h, l) for h, l in zip(model[key + '_h'],
+                                                    model[key + '_l'])]
+            w.put(struct.pack('<%dQ'%mem_type_count, *sizes))
+    ops_offset = w.put(b'\0' * 4 * len(ops))
+    w.align()
+    for i, op in enumerate(ops):
+        w.buf[ops_offset + 4*i:ops_offset + 4*i + 4] = \
+            struct.pack('<I', w.op(op))
+    inputs = w.str(model.get('inputs'))
+    strtab = w.align()
+    w.put(w.strtab)
+    w.buf[:HEADER.size] = HEADER.pack(MAGIC, VERSION, len(ops), mem_type_count,
+                                      inputs, ops_offset, strtab,
+                                      len(w.strtab), 0)
+    return bytes(w.buf)
+
+def bin2json(buf):
+    (magic, version, op_count, mem_type_count, inputs, ops_offset, strtab,
+     strtab_size, _) = HEADER.unpack_from(buf, 0)
+    if magic != MAGIC:
+        err_exit('bad magic number')
+    if version != VERSION:
+        err_exit('unsupported version %d'%version)
+
+    def string(ref):
+        if ref == NOSTR:
+            return None
+        end = buf.index(b'\0', strtab + ref)
+        return buf[strtab + ref:end].decode()
+
+    model = {}
+    if mem_type_count:
+        sizes = struct.unpack_from('<%dQ'%(2*mem_type_count), buf, HEADER.size)
+        for i, key in enumerate(('mem_sizes', 'weight_sizes')):
+            pairs = [size2int(s) for s in
+                     sizes[i*mem_type_count:(i+1)*mem_type_count]]
+            model[key + '_h'] = [h for h, l in pairs]
+            model[key + '_l'] = [l for h, l in pairs]
+    if string(inputs) is not None:
+        model['inputs'] = string(inputs)
+
+    def tensors(offset, n):
+        result = []
+        for i in range(n):
+            arg_name, name, toffset = TENSOR.unpack_from(buf, offset + i*TENSOR.size)
+            tensor = {'arg_name': string(arg_name), 'name': string(name)}
+            if toffset:
+                tensor['offset_h'], tensor['offset_l'] = size2int(toffset)
+            result.append(tensor)
+        return result
+
+    def param(offset):
+        arg_name, ptype, array_len, _, raw = PARAM.unpack_from(buf, offset)
+        if ptype == PARAM_NULL:
+            value = None
+        elif ptype == PARAM_STRING:
+            value = string(struct.unpack_from('<I', raw)[0])
+        elif ptype == PARAM_NUMBER:
+            value = json_number(struct.unpack('<d', raw)[0])
+        elif ptype == PARAM_BOOL:
+            value = struct.unpack_from('<I', raw)[0] != 0
+        else:
+            array = struct.unpack('<Q', raw)[0]
+            if ptype == PARAM_ARRAY_NUMBER:
+                value = [json_number(v) for v in
+                         struct.unpack_from('<%dd'%array_len, buf, array)]
+            elif ptype == PARAM_ARRAY_BOOL:
+                value = [v != 0 for v in
+                         struct.unpack_from('<%dI'%array_len, buf, array)]
+            elif ptype == PARAM_ARRAY_STRING:
+                value = [string(v) for v in
+                         struct.unpack_from('<%dI'%array_len, buf, array)]
+            else:
+                err_exit('unsupported param type %d'%ptype)
+        return {'arg_name': string(arg_name), 'value': value}
+
+    model['ops'] = []
+    for op_offset in struct.unpack_from('<%dI'%op_count, buf, ops_offset):
+        name, optype, n_in, n_out, n_params, _ = OP.unpack_from(buf, op_offset)
+        offset = op_offset + OP.size
+        tensors_in = tensors(offset, n_in)
+        offset += n_in * TENSOR.size
+        tensors_out = tensors(offset, n_out)
+        offset += n_out * TENSOR.size
+        params = [param(offset + i*PARAM.size) for i in range(n_params)]
+        model['ops'].append({'name': string(name), 'optype': string(optype),
+                             'tensors_in': tensors_in,
+                             'tensors_out': tensors_out,
+                             'params': params})
+    return model
+
+def main():
+    parser = argparse.ArgumentParser(
+        description='Convert a LightNet IR from JSON to the binary format, or '
+        'from the binary format to JSON, depending on the format of INFILE. '
+        'Read from standard input if INFILE is not given.')
+    parser.add_argument('infile', nargs='?', metavar='INFILE')
+    parser.add_argument('-o', '--outfile', metavar='OUTFILE',
+                        help='output file name (print to standard output '
+                        'without this)')
+    args = parser.parse_args()
+
+    if args.infile:
+        with open(args.infile, 'rb') as f:
+            data = f.read()
+    else:
+        data = sys.stdin.buffer.read()
+
+    if data.startswith(MAGIC):
+        out = (json.dumps(bin2json(data), indent=4) + '\n').encode()
+    else:
+        try:
+            model = json.loads(strip_comments(data.decode()))
+        except ValueError as e:
+            err_exit('syntax error: %s'%e)
+        out = json2bin(model)
+
+    if args.outfile:
+        with open(args.outfile, 'wb') as f:
+            f.write(out)
+    else:
+        sys.stdout.buffer.write(out)
+
+if __name__ == '__main__':
+    main()
@@ -5,5 +5,5 @@ sys.path.append(os.path.split(os.path.realpath(__file__))[0])
 
 import backend
 
-def onnx_get_model(onnx_graph):
-    return backend.get_model(onnx_graph)
+def onnx_get_model(onnx_graph, weight_file=None, compress=False):
+    return backend.get_model(onnx_graph, weight_file, compress)
@@ -18,6 +18,8 @@ from node_converter import new_opname
 from node_converter import new_create_op
 from node_converter import tensor_proto_to_tensor
 from node_converter import onnx_node_to_ln_op
+from node_converter import set_weight_file
+from weight_file import WeightFile
 from type_converter import dtype_onnx2tl
 
 def add_value_info_for_constants(model : onnx.ModelProto):
@@ -76,7 +78,13 @@ def add_value_info_for_constants(model : onnx.ModelProto):
 
     return add_const_value_infos_to_graph(model.graph)
 
-def get_model(onnx_model):
+def get_model(onnx_model, weight_file=None, compress=False):
+    """
+    Convert `onnx_model` to a LightNet IR model. If `weight_file` is given,
+    the data of initializers and constants are written to that binary file
+    and loaded with `from_file` instead of being embedded in the IR. With
+    `compress`, the weights in the file are compressed where it pays off.
+    """
     if not isinstance(onnx_model, ModelProto) and not isinstance(onnx_model, GraphProto):
         raise TypeError('get_model() only accepts ModelProto or GraphProto '
                         'incorrect type: {}'.format(type(onnx_model)))
@@ -88,42 +96,51 @@ def get_model(onnx_model):
     onnx_graph = onnx_model.graph
     # print(onnx_graph)
     # exit()
-    if onnx_graph.initializer:
-        input_tensors = onnx_initializer_to_data_tensors(
-            onnx_graph.initializer);
-        initialized = {init.name for init in onnx_graph.initializer}
-    else:
-        input_tensors = []
-        initialized = set()
-
-    # creating empty tensors for currently unknown inputs
-    for value_info in onnx_graph.input:
-        if value_info.name in initialized:
-            continue
-        shape = list(
-            d.dim_value if (d.dim_value > 0 and d.dim_param == "") else None
-            for d in value_info.type.tensor_type.shape.dim)
-        tensor = {'name': value_info.name,
-                  'dtype': dtype_onnx2tl(value_info.name, value_info.type.tensor_type.elem_type),
-                  'dims': shape,
-                  'data': None}
-        input_tensors.append((value_info.name, tensor))
-
-    value_infos = {vi.name: vi for vi in onnx_graph.value_info}
-    for vi in onnx_graph.output:
-        value_infos[vi.name] = vi
-    tensor_dict = dict(input_tensors)
-    tensor_dict['__value_infos'] = value_infos
-    model = {'ops': []}
-
-    for tensor in input_tensors:
-        model['ops'].append(new_create_op(tensor[1]))
-
-    for node in onnx_graph.node:
-        onnx_node = OnnxNode(node)
-        ops = onnx_node_to_ln_op(onnx_node, tensor_dict)
-        for op in ops:
-            model['ops'].append(op)
+    # set before converting the initializers, whose data is only listed
+    # without a weight file
+    wf = None if weight_file is None else WeightFile(weight_file, compress)
+    set_weight_file(wf)
+    try:
+        if onnx_graph.initializer:
+            input_tensors = onnx_initializer_to_data_tensors(
+                onnx_graph.initializer);
+            initialized = {init.name for init in onnx_graph.initializer}
+        else:
+            input_tensors = []
+            initialized = set()
+
+        # creating empty tensors for currently unknown inputs
+        for value_info in onnx_graph.input:
+            if value_info.name in initialized:
+                continue
+            shape = list(
+                d.dim_value if (d.dim_value > 0 and d.dim_param == "") else None
+                for d in value_info.type.tensor_type.shape.dim)
+            tensor = {'name': value_info.name,
+                      'dtype': dtype_onnx2tl(value_info.name, value_info.type.tensor_type.elem_type),
+                      'dims': shape,
+                      'data': None}
+            input_tensors.append((value_info.name, tensor))
+
+        value_infos = {vi.name: vi for vi in onnx_graph.value_info}
+        for vi in onnx_graph.output:
+            value_infos[vi.name] = vi
+        tensor_dict = dict(input_tensors)
+        tensor_dict['__value_infos'] = value_infos
+        model = {'ops': []}
+
+        for tensor in input_tensors:
+            model['ops'].append(new_create_op(tensor[1]))
+
+        for node in onnx_graph.node:
+            onnx_node = OnnxNode(node)
+            ops = onnx_node_to_ln_op(onnx_node, tensor_dict)
+            for op in ops:
+                model['ops'].append(op)
+    finally:
+        set_weight_file(None)
+        if wf is not None:
+            wf.close()
 
     return model
 
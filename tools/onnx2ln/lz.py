@@ -0,0 +1,69 @@
+import struct
+
+# LZ4 block format compressor producing blocks that ln_lz_decompress() in
+# src/ln_lz.c reads. It is slower than the C one, but a model is converted
+# only once.
+MIN_MATCH = 4
+MAX_OFFSET = 65535
+LAST_LITERALS = 5
+MFLIMIT = 12
+SKIP_TRIGGER = 6
+
+def _put_length(out, length):
+    while length >= 255:
+        out.append(255)
+        length -= 255
+    out.append(length)
+
+def _put_sequence(out, src, anchor, lit_len, match_len=0, offset=0):
+    token = min(lit_len, 15) << 4
+    if match_len:
+        token |= min(match_len - MIN_MATCH, 15)
+    out.append(token)
+    if lit_len >= 15:
+        _put_length(out, lit_len - 15)
+    out += src[anchor:anchor + lit_len]
+    if not match_len:
+        return
+    out += struct.pack('<H', offset)
+    if match_len - MIN_MATCH >= 15:
+        _put_length(out, match_len - MIN_MATCH - 15)
+
+def compress(src):
+    """Compress the bytes `src` to an LZ4 block and return it as bytes."""
+    src = bytes(src)
+    size = len(src)
+    out = bytearray()
+    if size < MFLIMIT + 1:
+        _put_sequence(out, src, 0, size)
+        return bytes(out)
+
+    table = {}
+    ip = anchor = missed = 0
+    match_limit = size - MFLIMIT
+    end = size - LAST_LITERALS
+    while ip < match_limit:
+        key = src[ip:ip + MIN_MATCH]
+        ref = table.get(key)
+        table[key] = ip
+        if ref is None or ip - ref > MAX_OFFSET:
+            ip += 1 + (missed >> SKIP_TRIGGER)
+            missed += 1
+            continue
+        missed = 0
+        while ip > anchor and ref > 0 and src[ip - 1] == src[ref - 1]:
+            ip -= 1
+            ref -= 1
+        length = MIN_MATCH
+        step = 64
+        while step >= 1:
+            while (ip + length + step <= end and
+                   src[ip + length:ip + length + step] ==
+                   src[ref + length:ref + length + step]):
+                length += step
+            step //= 4
+        _put_sequence(out, src, anchor, ip - anchor, length, ip - ref)
+        ip += length
+        anchor = ip
+    _put_sequence(out, src, anchor, size - anchor)
+    return bytes(out)
@@ -6,6 +6,13 @@ from onnx import numpy_helper
 from pb_wrapper import OnnxNode
 from type_converter import dtype_onnx2tl
 
+# WeightFile that new_create_op() writes tensor data to, if not None
+weight_file = None
+
+def set_weight_file(wf):
+    global weight_file
+    weight_file = wf
+
 def new_opname(optype):
     if not hasattr(new_opname, 'opname_count'):
         new_opname.opname_count = {}
@@ -50,19 +57,36 @@ def find_shape_in_tensor_dict(tensor_dict, name):
 
     return None
 
+# With a weight file, the data of a tensor converted from a TensorProto is
+# only listed when an op reads it as a parameter, by tensor_data().
 def tensor_proto_to_tensor(tensor_proto):
-    def tensor2list(onnx_tensor):
-        # Use the onnx.numpy_helper because the data may be raw
-        return numpy_helper.to_array(onnx_tensor).flatten().tolist()
     tp = tensor_proto
+    # Use the onnx.numpy_helper because the data may be raw
+    array = numpy_helper.to_array(tp)
+    data = array.flatten().tolist() if weight_file is None else None
     tensor = (tp.name, {'name': tp.name,
                         'dtype': dtype_onnx2tl(tp.name, tp.data_type),
                         'dims': list(d for d in tp.dims),
-                        'data': tensor2list(tp)})
+                        'data': data,
+                        'array': array})
     return tensor
 
+def tensor_data(tensor):
+    if tensor['data'] is None and tensor.get('array') is not None:
+        return tensor['array'].flatten().tolist()
+    return tensor['data']
+
 def new_create_op(tensor):
-    data = [0] if tensor['data'] is None else tensor['data']
+    from_file = False
+    if tensor['data'] is None and tensor.get('array') is None:
+        data = [0]
+    elif weight_file is not None:
+        weight_file.add(tensor['name'], tensor['dtype'],
+                        tensor.get('array', tensor['data']))
+        data = [0]
+        from_file = True
+    else:
+        data = tensor['data']
     op = {'name': new_opname("create"),
           'optype': 'create',
           'tensors_in': [],
@@ -71,7 +95,7 @@ def new_create_op(tensor):
                      {'arg_name': 'dims', 'value': tensor['dims']},
                      {'arg_name': 'data', 'value': data},
                      {'arg_name': 'ran', 'value': [0, 0]},
-                     {'arg_name': 'from_file', 'value': False}]}
+                     {'arg_name': 'from_file', 'value': from_file}]}
     return op
 
 def Add(node, tensor_dict):
@@ -237,15 +261,8 @@ def Constant(node, tensor_dict):
                                     'dims': None, # TODO: do shape inference
                                     'data': None}
 
-    op = {'name': new_opname('create'),
-          'optype': 'create',
-          'tensors_in': [],
-          'tensors_out': [{'arg_name': 'dst', 'name': node.outputs[0]}],
-          'params': [{'arg_name': 'dtype', 'value': tensor['dtype']},
-                     {'arg_name': 'dims', 'value': tensor['dims']},
-                     {'arg_name': 'data', 'value': tensor['data']},
-                     {'arg_name': 'ran', 'value': [0, 0]},
-                     {'arg_name': 'from_file', 'value': False}]}
+    tensor['name'] = node.outputs[0]
+    op = new_create_op(tensor)
     return [op]
 
 def Div(node, tensor_dict):
@@ -369,8 +386,8 @@ def Reshape(node, tensor_dict):
     shape = find_shape_in_tensor_dict(tensor_dict, node.outputs[0])
     if shape is not None:
         new_shape = shape
-    elif tensor_dict[node.inputs[1]]['data'] is not None:
-        new_shape = tensor_dict[node.inputs[1]]['data']
+    elif tensor_data(tensor_dict[node.inputs[1]]) is not None:
+        new_shape = tensor_data(tensor_dict[node.inputs[1]])
     else:
         error("'%s' for node '%s' doesn't support dynamically supplied 'shape' tensor '%s' now"%(node.op_type, node.name, node.inputs[1]))
 
@@ -398,7 +415,7 @@ def Resize(node, tensor_dict):
         error("'%s' for node '%s' doesn't support 'mode' == '%s'"%(node.op_type, node.name, node.attrs['mode']))
 
     assert node.inputs[1] in tensor_dict
-    if tensor_dict[node.inputs[1]]['data'] is None:
+    if tensor_data(tensor_dict[node.inputs[1]]) is None:
         error("'%s' for node '%s' doesn't support dynamically supplied 'scales' tensor now"%(node.op_type, node.name))
 
     tensor_dict[node.outputs[0]] = {'name': node.outputs[0],
@@ -410,7 +427,7 @@ def Resize(node, tensor_dict):
           'tensors_in': [{'arg_name': 'src', 'name': node.inputs[0]}],
           'tensors_out': [{'arg_name': 'dst', 'name': node.outputs[0]}],
           'params': [{'arg_name': 'mode', 'value': mode},
-                     {'arg_name': 'scales', 'value': tensor_dict[node.inputs[1]]['data']}]}
+                     {'arg_name': 'scales', 'value': tensor_data(tensor_dict[node.inputs[1]])}]}
 
     return [op]
 
@@ -434,17 +451,17 @@ def Slice(node, tensor_dict):
     assert node.inputs[2] in tensor_dict
     assert node.inputs[3] in tensor_dict
     assert node.inputs[4] in tensor_dict
-    if tensor_dict[node.inputs[1]]['data'] is None:
+    if tensor_data(tensor_dict[node.inputs[1]]) is None:
         error("'%s' for node '%s' doesn't support dynamically supplied 'starts' tensor now"%(node.op_type, node.name))
-    if tensor_dict[node.inputs[2]]['data'] is None:
+    if tensor_data(tensor_dict[node.inputs[2]]) is None:
         error("'%s' for node '%s' doesn't support dynamically supplied 'ends' tensor now"%(node.op_type, node.name))
-    if tensor_dict[node.inputs[3]]['data'] is None:
+    if tensor_data(tensor_dict[node.inputs[3]]) is None:
         error("'%s' for node '%s' doesn't support dynamically supplied 'axes' tensor now"%(node.op_type, node.name))
-    if tensor_dict[node.inputs[4]]['data'] is None:
+    if tensor_data(tensor_dict[node.inputs[4]]) is None:
         error("'%s' for node '%s' doesn't support dynamically supplied 'steps' tensor now"%(node.op_type, node.name))
-    if len(tensor_dict[node.inputs[1]]['data']) != 1 or len(tensor_dict[node.inputs[2]]['data']) != 1 or len(tensor_dict[node.inputs[3]]['data']) != 1 or len(tensor_dict[node.inputs[4]]['data']) != 1:
+    if len(tensor_data(tensor_dict[node.inputs[1]])) != 1 or len(tensor_data(tensor_dict[node.inputs[2]])) != 1 or len(tensor_data(tensor_dict[node.inputs[3]])) != 1 or len(tensor_data(tensor_dict[node.inputs[4]])) != 1:
         error("'%s' for node '%s' only support slice on one axis now"%(node.op_type, node.name))
-    if tensor_dict[node.inputs[4]]['data'][0] != 1:
+    if tensor_data(tensor_dict[node.inputs[4]])[0] != 1:
         error("'%s' for node '%s' only support 'steps' == 1 now"%(node.op_type, node.name))
 
     tensor_dict[node.outputs[0]] = {'name': node.outputs[0],
@@ -455,9 +472,9 @@ def Slice(node, tensor_dict):
           'optype': 'slice',
           'tensors_in': [{'arg_name': 'src', 'name': node.inputs[0]}],
           'tensors_out': [{'arg_name': 'dst', 'name': node.outputs[0]}],
-          'params': [{'arg_name': 'start', 'value': tensor_dict[node.inputs[1]]['data'][0]},
-                     {'arg_name': 'axis', 'value': tensor_dict[node.inputs[3]]['data'][0]},
-                     {'arg_name': 'len', 'value': tensor_dict[node.inputs[2]]['data'][0]-tensor_dict[node.inputs[1]]['data'][0]}]}
+          'params': [{'arg_name': 'start', 'value': tensor_data(tensor_dict[node.inputs[1]])[0]},
+                     {'arg_name': 'axis', 'value': tensor_data(tensor_dict[node.inputs[3]])[0]},
+                     {'arg_name': 'len', 'value': tensor_data(tensor_dict[node.inputs[2]])[0]-tensor_data(tensor_dict[node.inputs[1]])[0]}]}
 
     return [op]
 
@@ -507,7 +524,7 @@ def Upsample(node, tensor_dict):
         error("'%s' for node '%s' doesn't support 'mode' == '%s'"%(node.op_type, node.name, node.attrs['mode']))
 
     assert node.inputs[1] in tensor_dict
-    if tensor_dict[node.inputs[1]]['data'] is None:
+    if tensor_data(tensor_dict[node.inputs[1]]) is None:
         error("'%s' for node '%s' doesn't support dynamically supplied 'scales' tensor now"%(node.op_type, node.name))
 
     tensor_dict[node.outputs[0]] = {'name': node.outputs[0],
@@ -519,7 +536,7 @@ def Upsample(node, tensor_dict):
           'tensors_in': [{'arg_name': 'src', 'name': node.inputs[0]}],
           'tensors_out': [{'arg_name': 'dst', 'name': node.outputs[0]}],
           'params': [{'arg_name': 'mode', 'value': mode},
-                     {'arg_name': 'scales', 'value': tensor_dict[node.inputs[1]]['data']}]}
+                     {'arg_name': 'scales', 'value': tensor_data(tensor_dict[node.inputs[1]])}]}
 
     return [op]
 
@@ -0,0 +1,99 @@
+import hashlib
+import struct
+import zlib
+import numpy as np
+
+import lz
+
+# Binary weight file loaded by ln_tensor_table_load_weight_file(), see
+# src/ln_tensor.c for the layout.
+MAGIC = b'LNWTSBIN'
+VERSION = 3
+ALIGN = 64
+
+CODEC_NONE = 0
+CODEC_LZ = 1
+# compressed blobs are split into frames of this many bytes, which are
+# decompressed in parallel
+FRAME_SIZE = 1 << 20
+
+TL_TYPE_TO_NUMPY_TYPE = {
+    'TL_DOUBLE': np.float64,
+    'TL_FLOAT': np.float32,
+    'TL_INT64': np.int64,
+    'TL_INT32': np.int32,
+    'TL_INT16': np.int16,
+    'TL_INT8': np.int8,
+    'TL_UINT64': np.uint64,
+    'TL_UINT32': np.uint32,
+    'TL_UINT16': np.uint16,
+    'TL_UINT8': np.uint8,
+    'TL_BOOL': np.int32,        # tl_bool_t is an enum
+}
+
+def compress_frames(data):
+    """
+    Return `data` compressed in frames of FRAME_SIZE bytes with a frame
+    table, or None if it doesn't compress to less than 7/8 of its size.
+    """
+    frames = [lz.compress(data[i:i + FRAME_SIZE])
+              for i in range(0, len(data), FRAME_SIZE)]
+    packed = struct.pack('<II', FRAME_SIZE, len(frames))
+    packed += struct.pack('<{}I'.format(len(frames)), *map(len, frames))
+    packed += b''.join(frames)
+    if len(packed) >= len(data) * 7 // 8:
+        return None
+    return packed
+
+class WeightFile:
+    """
+    Writer of a binary weight file. Weights of identical data share a blob.
+    With `compress`, blobs are compressed if it saves enough space.
+    """
+    def __init__(self, path, compress=False):
+        self.path = path
+        self.compress = compress
+        self.index = []
+        self.blobs = {}
+        self.file = open(path, 'wb')
+        # the entry count and the index offset are patched in close()
+        self.file.write(struct.pack('<8sIIQ', MAGIC, VERSION, 0, 0))
+
+    def add(self, name, dtype, data):
+        if dtype not in TL_TYPE_TO_NUMPY_TYPE:
+            raise ValueError("unsupported dtype {} of weight {}".format(dtype, name))
+        np_dtype = np.dtype(TL_TYPE_TO_NUMPY_TYPE[dtype]).newbyteorder('<')
+        array = np.ascontiguousarray(data, dtype=np_dtype)
+        data_bytes = array.tobytes()
+        key = (len(data_bytes), hashlib.sha256(data_bytes).digest())
+        if key not in self.blobs:
+            self.blobs[key] = self.write_blob(data_bytes)
+        offset, stored_size, crc32, codec = self.blobs[key]
+        self.index.append((offset, len(data_bytes), stored_size, crc32, codec,
+                           name.encode(), dtype.encode()))
+
+    def write_blob(self, data_bytes):
+        crc32 = zlib.crc32(data_bytes) & 0xffffffff
+        packed = compress_frames(data_bytes) if self.compress else None
+        self.file.write(b'\0' * (-self.file.tell() % ALIGN))
+        offset = self.file.tell()
+        if packed is None:
+            self.file.write(data_bytes)
+            return offset, len(data_bytes), crc32, CODEC_NONE
+        self.file.write(packed)
+        return offset, len(packed), crc32, CODEC_LZ
+
+    def close(self):
+        self.file.write(b'\0' * (-self.file.tell() % 8))
+        index_offset = self.file.tell()
+        for (offset, size, stored_size, crc32, codec,
+             name_bytes, dtype_bytes) in self.index:
+            self.file.write(struct.pack('<QQQIIII', offset, size, stored_size,
+                                        crc32, codec, len(name_bytes),
+                                        len(dtype_bytes)))
+            self.file.write(name_bytes)
+            self.file.write(dtype_bytes)
+            self.file.write(b'\0' * (-(len(name_bytes) + len(dtype_bytes)) % 8))
+        self.file.seek(len(MAGIC) + 4)
+        self.file.write(struct.pack('<IQ', len(self.index), index_offset))
+        self.file.close()
@@ -12,6 +12,7 @@ import util
 from handler import handler
 
 lib.init()
+context.declare_prototypes()
 arch.init()
 
 __version__ = option.version()
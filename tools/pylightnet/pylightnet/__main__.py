@@ -9,15 +9,31 @@ def main(argv):
     ln.msg.init(option)
     ctx = ln.context.create()
     ln.context.init(ctx, ln.option.get_source(option))
+    if ln.option.get_batch(option):
+        ln.context.set_batch(ctx, ln.option.get_inputs(option),
+                             ln.option.get_batch(option))
+    if ln.option.get_mem_align(option):
+        ln.context.set_mem_align(ctx, ln.option.get_mem_align(option))
 
     if (ln.option.get_compile(option)):
+        if ln.option.get_time_passes(option) or ln.option.get_debug(option):
+            ln.context.set_time_passes(ctx, 1)
         ln.context.compile(ctx, ln.option.get_target(option),
                            ln.option.get_datafile(option))
 
     if not ln.util.streq(ln.option.get_outfile(option), b"!"):
         ln.context.Print(ctx, ln.option.get_outfile(option))
 
+    if ln.option.get_mem_report(option):
+        ln.context.print_mem_plan(ctx, ln.option.get_mem_report(option))
+
     if ln.option.get_run(option):
+        if ln.option.get_load_threads(option):
+            ln.context.set_load_threads(ctx, ln.option.get_load_threads(option))
+        if ln.option.get_verify_weights(option):
+            ln.context.set_verify_weights(ctx, 1)
+        if ln.option.get_lazy_weights(option):
+            ln.context.set_lazy_weights(ctx, 1)
         ln.context.load(ctx, ln.option.get_datafile(option))
         ln.context.run(ctx)
         ln.context.unload(ctx)
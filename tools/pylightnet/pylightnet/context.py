@@ -1,13 +1,79 @@
 from ctypes import *
 import lib
 
+# the callback object should be kept alive until its run finishes
+RUN_CALLBACK = CFUNCTYPE(None, c_void_p, c_void_p)
+
+# argtypes and restype of the wrapped functions, without which ctypes passes
+# and returns pointers as C ints, truncating them on 64-bit systems
+PROTOTYPES = {
+    'ln_context_create': ([], c_void_p),
+    'ln_context_free': ([c_void_p], None),
+    'ln_context_init': ([c_void_p, c_char_p], None),
+    'ln_context_set_batch': ([c_void_p, c_char_p, c_int], None),
+    'ln_context_set_dims': ([c_void_p, c_char_p, POINTER(c_int)], None),
+    'ln_context_set_inputs': ([c_void_p, c_char_p], None),
+    'ln_context_set_mem_align': ([c_void_p, c_size_t], None),
+    'ln_context_compile': ([c_void_p, c_char_p, c_char_p], None),
+    'ln_context_set_time_passes': ([c_void_p, c_int], None),
+    'ln_context_print': ([c_void_p, c_char_p], None),
+    'ln_context_print_mem_plan': ([c_void_p, c_char_p], None),
+    'ln_context_set_load_threads': ([c_void_p, c_int], None),
+    'ln_context_set_verify_weights': ([c_void_p, c_int], None),
+    'ln_context_set_lazy_weights': ([c_void_p, c_int], None),
+    'ln_context_load': ([c_void_p, c_char_p], None),
+    'ln_context_loaded_bytes': ([c_void_p, POINTER(c_double)], c_size_t),
+    'ln_context_share_weights': ([c_void_p, c_void_p], None),
+    'ln_context_save_weights': ([c_void_p, c_char_p], None),
+    'ln_context_map_weights': ([c_void_p, c_char_p], None),
+    'ln_context_set_data': ([c_void_p, c_char_p, c_void_p], None),
+    'ln_context_get_data': ([c_void_p, c_char_p, c_void_p], c_void_p),
+    'ln_context_set_frame': ([c_void_p, c_char_p, c_int, c_void_p], None),
+    'ln_context_get_frame': ([c_void_p, c_char_p, c_int, c_void_p],
+                             c_void_p),
+    'ln_context_data_size': ([c_void_p, c_char_p], c_size_t),
+    'ln_context_data_shape': ([c_void_p, c_char_p, POINTER(c_int)], c_int),
+    'ln_context_data_dtype': ([c_void_p, c_char_p], c_char_p),
+    'ln_context_data_ptr': ([c_void_p, c_char_p], c_void_p),
+    # variadic, the values after pname should be ctypes instances unless
+    # they are ints or bytes
+    'ln_context_set_param': ([c_void_p, c_char_p, c_char_p], None),
+    'ln_context_run': ([c_void_p], None),
+    'ln_context_run_async': ([c_void_p, RUN_CALLBACK, c_void_p], None),
+    'ln_context_wait': ([c_void_p], None),
+    'ln_context_unload': ([c_void_p], None),
+    'ln_context_cleanup': ([c_void_p], None),
+    'ln_plan_cache_create': ([c_char_p, c_char_p, c_char_p, c_char_p, c_int],
+                             c_void_p),
+    'ln_plan_cache_free': ([c_void_p], None),
+    'ln_plan_cache_get': ([c_void_p, POINTER(c_int)], c_void_p),
+}
+
+# called once liblightnet.so is loaded
+def declare_prototypes():
+    for name, (argtypes, restype) in PROTOTYPES.items():
+        func = getattr(lib.libln, name)
+        func.argtypes = argtypes
+        func.restype = restype
+
 def create():
-    lib.libln.ln_context_create.restype = c_void_p
     return lib.libln.ln_context_create()
 
 def init(ctx, source):
     lib.libln.ln_context_init(ctx, source)
 
+def set_batch(ctx, inputs, batch):
+    lib.libln.ln_context_set_batch(ctx, inputs, batch)
+
+def set_dims(ctx, inputs, dims):
+    lib.libln.ln_context_set_dims(ctx, inputs, (c_int * len(dims))(*dims))
+
+def set_inputs(ctx, inputs):
+    lib.libln.ln_context_set_inputs(ctx, inputs)
+
+def set_mem_align(ctx, align):
+    lib.libln.ln_context_set_mem_align(ctx, align)
+
 def cleanup(ctx):
     lib.libln.ln_context_cleanup(ctx)
 
@@ -17,27 +83,131 @@ def free(ctx):
 def compile(ctx, target, datafile):
     lib.libln.ln_context_compile(ctx, target, datafile)
 
+def set_time_passes(ctx, time_passes):
+    lib.libln.ln_context_set_time_passes(ctx, time_passes)
+
 def Print(ctx, outfile):
     lib.libln.ln_context_print(ctx, outfile)
 
+def print_mem_plan(ctx, outfile):
+    lib.libln.ln_context_print_mem_plan(ctx, outfile)
+
+def set_load_threads(ctx, nthreads):
+    lib.libln.ln_context_set_load_threads(ctx, nthreads)
+
+def set_verify_weights(ctx, verify):
+    lib.libln.ln_context_set_verify_weights(ctx, verify)
+
+def set_lazy_weights(ctx, lazy):
+    lib.libln.ln_context_set_lazy_weights(ctx, lazy)
+
 def load(ctx, datafile):
     lib.libln.ln_context_load(ctx, datafile)
 
+def loaded_bytes(ctx):
+    time = c_double()
+    nbytes = lib.libln.ln_context_loaded_bytes(ctx, byref(time))
+    return nbytes, time.value
+
+def share_weights(ctx, src):
+    lib.libln.ln_context_share_weights(ctx, src)
+
+def save_weights(ctx, file):
+    lib.libln.ln_context_save_weights(ctx, file)
+
+def map_weights(ctx, file):
+    lib.libln.ln_context_map_weights(ctx, file)
+
 def set_data(ctx, tname, data):
     lib.libln.ln_context_set_data(ctx, tname, data)
 
 def get_data(ctx, tname, data):
-    lib.libln.ln_context_get_data.restype = c_void_p
     return lib.libln.ln_context_get_data(ctx, tname, data)
 
+def set_frame(ctx, tname, frame, data):
+    lib.libln.ln_context_set_frame(ctx, tname, frame, data)
+
+def get_frame(ctx, tname, frame, data):
+    return lib.libln.ln_context_get_frame(ctx, tname, frame, data)
+
 def data_size(ctx, tname):
-    lib.libln.ln_context_data_size.restype = c_size_t
     return lib.libln.ln_context_data_size(ctx, tname)
 
+def data_shape(ctx, tname):
+    ndim = lib.libln.ln_context_data_shape(ctx, tname, None)
+    dims = (c_int * ndim)()
+    lib.libln.ln_context_data_shape(ctx, tname, dims)
+    return tuple(dims)
+
+def data_dtype(ctx, tname):
+    return lib.libln.ln_context_data_dtype(ctx, tname)
+
+def data_ptr(ctx, tname):
+    return lib.libln.ln_context_data_ptr(ctx, tname)
+
+NUMPY_DTYPES = {
+    b'TL_DOUBLE': 'float64',
+    b'TL_FLOAT': 'float32',
+    b'TL_INT64': 'int64',
+    b'TL_INT32': 'int32',
+    b'TL_INT16': 'int16',
+    b'TL_INT8': 'int8',
+    b'TL_UINT64': 'uint64',
+    b'TL_UINT32': 'uint32',
+    b'TL_UINT16': 'uint16',
+    b'TL_UINT8': 'uint8',
+    b'TL_BOOL': 'int32',
+}
+
+def numpy_dtype(ctx, tname):
+    import numpy
+    return numpy.dtype(NUMPY_DTYPES[data_dtype(ctx, tname)])
+
+# Set the data of tensor `tname` from `data`, a NumPy array or any object with
+# the buffer protocol, which is read in place if it is C-contiguous with the
+# tensor's dtype, and converted otherwise.
+def set_input(ctx, tname, data):
+    import numpy
+    dtype = numpy_dtype(ctx, tname)
+    if not isinstance(data, numpy.ndarray):
+        try:
+            data = numpy.frombuffer(data, dtype)
+        except TypeError:
+            data = numpy.asarray(data, dtype)
+    data = numpy.ascontiguousarray(data, dtype)
+    if data.nbytes != data_size(ctx, tname):
+        raise ValueError("%s has %d bytes, but tensor %s has %d" %
+                         (data.shape, data.nbytes, tname,
+                          data_size(ctx, tname)))
+    set_data(ctx, tname, c_void_p(data.ctypes.data))
+
+# Return the data of tensor `tname` as a NumPy array. Unless `copy` is True or
+# `out` is given, a tensor in CPU memory is returned as a view of it, valid
+# until `unload()` and overwritten by the next run. Otherwise it is copied
+# into `out`, or a new array.
+def get_output(ctx, tname, out=None, copy=False):
+    import numpy
+    dtype = numpy_dtype(ctx, tname)
+    shape = data_shape(ctx, tname)
+    size = data_size(ctx, tname)
+    if out is None and not copy:
+        ptr = data_ptr(ctx, tname)
+        if ptr:
+            buf = (c_char * size).from_address(ptr)
+            return numpy.frombuffer(buf, dtype).reshape(shape)
+    if out is None:
+        out = numpy.empty(shape, dtype)
+    elif (out.dtype != dtype or out.nbytes != size or
+          not out.flags['C_CONTIGUOUS'] or not out.flags['WRITEABLE']):
+        raise ValueError("out should be a writable C-contiguous %s array "
+                         "of %d bytes" % (dtype, size))
+    get_data(ctx, tname, c_void_p(out.ctypes.data))
+    return out
+
 def set_param(ctx, opname, pname, *args):
     if len(args) == 1:
         lib.libln.ln_context_set_param(ctx, opname, pname, args[0])
-    elif len(args == 2):
+    elif len(args) == 2:
         lib.libln.ln_context_set_param(ctx, opname, pname, args[0], args[1])
     else:
         assert False;
@@ -45,5 +215,33 @@ def set_param(ctx, opname, pname, *args):
 def run(ctx):
     lib.libln.ln_context_run(ctx)
 
+# callbacks of the runs submitted by run_async(), kept alive until wait() or
+# unload()
+callbacks = {}
+
+# `callback` is called as callback(ctx, data) on the worker thread, and is
+# wrapped by RUN_CALLBACK unless it already is, or None
+def run_async(ctx, callback, data=None):
+    if callback is not None and not isinstance(callback, RUN_CALLBACK):
+        callback = RUN_CALLBACK(callback)
+    callbacks.setdefault(ctx, []).append(callback)
+    lib.libln.ln_context_run_async(ctx, callback, data)
+
+def wait(ctx):
+    lib.libln.ln_context_wait(ctx)
+    callbacks.pop(ctx, None)
+
 def unload(ctx):
     lib.libln.ln_context_unload(ctx)
+    callbacks.pop(ctx, None)
+
+def plan_cache_create(source, target, datafile, inputs, capacity):
+    return lib.libln.ln_plan_cache_create(source, target, datafile, inputs,
+                                          capacity)
+
+def plan_cache_free(cache):
+    lib.libln.ln_plan_cache_free(c_void_p(cache))
+
+def plan_cache_get(cache, dims):
+    return lib.libln.ln_plan_cache_get(c_void_p(cache),
+                                       (c_int * len(dims))(*dims))
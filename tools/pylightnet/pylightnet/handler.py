@@ -65,6 +65,19 @@ class handler(object):
             name_bytes = ln.lib.str2bytes(name)
             ln.context.get_data(self.ctx, name_bytes, data)
 
+    def set_inputs(self, data_dict):
+        for name, data in data_dict.items():
+            name_bytes = ln.lib.str2bytes(name)
+            ln.context.set_input(self.ctx, name_bytes, data)
+
+    def get_outputs(self, names, copy=False):
+        out_dict = {}
+        for name in names:
+            name_bytes = ln.lib.str2bytes(name)
+            out_dict[name] = ln.context.get_output(self.ctx, name_bytes,
+                                                   copy=copy)
+        return out_dict
+
     def set_param(self, param_dict):
         for opname, param in param_dict.items():
             opname_bytes = ln.lib.str2bytes(opname)
@@ -11,6 +11,8 @@ def init():
     global libln
     if not libln is None:
         return
+    # functions of a CDLL release the GIL while they run, so that threads can
+    # compile, load and run different contexts concurrently
     libln = cdll.LoadLibrary("liblightnet.so")
     # print("initialize liblightnet.so")
 
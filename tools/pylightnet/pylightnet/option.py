@@ -32,6 +32,38 @@ def get_datafile(option):
     lib.libln.ln_option_get_datafile.restype = c_char_p
     return lib.libln.ln_option_get_datafile(option)
 
+def get_inputs(option):
+    lib.libln.ln_option_get_inputs.restype = c_char_p
+    return lib.libln.ln_option_get_inputs(option)
+
+def get_mem_report(option):
+    lib.libln.ln_option_get_mem_report.restype = c_char_p
+    return lib.libln.ln_option_get_mem_report(option)
+
+def get_batch(option):
+    lib.libln.ln_option_get_batch.restype = c_int
+    return lib.libln.ln_option_get_batch(option)
+
+def get_mem_align(option):
+    lib.libln.ln_option_get_mem_align.restype = c_int
+    return lib.libln.ln_option_get_mem_align(option)
+
+def get_load_threads(option):
+    lib.libln.ln_option_get_load_threads.restype = c_int
+    return lib.libln.ln_option_get_load_threads(option)
+
+def get_verify_weights(option):
+    lib.libln.ln_option_get_verify_weights.restype = c_int
+    return lib.libln.ln_option_get_verify_weights(option)
+
+def get_lazy_weights(option):
+    lib.libln.ln_option_get_lazy_weights.restype = c_int
+    return lib.libln.ln_option_get_lazy_weights(option)
+
+def get_time_passes(option):
+    lib.libln.ln_option_get_time_passes.restype = c_int
+    return lib.libln.ln_option_get_time_passes(option)
+
 def get_compile(option):
     lib.libln.ln_option_get_datafile.restype = c_int
     return lib.libln.ln_option_get_compile(option)